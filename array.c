@@ -1,23 +1,22 @@
 #include "compiler.h"
 #include "helpers/vector.h"
-#include <assert.h>
 
 
 struct array_brackets* array_brackets_new()
 {
-    struct array_brackets* brackets = calloc(1,sizeof(struct array_brackets));
+    struct array_brackets* brackets = arena_calloc(1,sizeof(struct array_brackets));
     brackets->n_brackets = vector_create(sizeof(struct node*));
     return brackets;
 }
 
 void array_brackets_free(struct array_brackets* brackets)
 {
-    free(brackets);
+    arena_free(brackets);
 }
 
 void array_brackets_add(struct array_brackets* brackets,struct node* bracket_node)
 {
-    assert(bracket_node->type == NODE_TYPE_BRACKET);
+    compiler_assert(bracket_node->type == NODE_TYPE_BRACKET);
     vector_push(brackets->n_brackets,&bracket_node);
 }
 
@@ -29,7 +28,8 @@ struct vector* array_brackets_node_vector(struct array_brackets* brackets)
 size_t array_brackets_calculate_size_from_index(struct datatype* dtype, struct array_brackets* brackets, int index)
 {
     struct vector* array_vec = array_brackets_node_vector(brackets);
-    size_t size = dtype->size;
+    // char* names[3] -> every element is a pointer
+    size_t size = datatype_element_size(dtype);
     if(index >= vector_count(array_vec))
     {
         //char* abc;
@@ -47,7 +47,7 @@ size_t array_brackets_calculate_size_from_index(struct datatype* dtype, struct a
     //Check if all bracket numbers are literal numbers not variables
     while (array_bracket_node)
     {
-        assert(array_bracket_node->bracket.inner->type == NODE_TYPE_NUMBER);
+        compiler_assert(array_bracket_node->bracket.inner->type == NODE_TYPE_NUMBER);
         int number = array_bracket_node->bracket.inner->llnum;
         size *= number;
         array_bracket_node = vector_peek_ptr(array_vec);
@@ -67,7 +67,7 @@ size_t array_brackets_calculate_size(struct datatype* dtype, struct array_bracke
 
 int array_total_indexes(struct datatype* dtype)
 {
-    assert(dtype->flags & DATATYPE_FLAG_IS_ARRAY);
+    compiler_assert(dtype->flags & DATATYPE_FLAG_IS_ARRAY);
     struct array_brackets* brackets = dtype->array.brackets;
     return vector_count(brackets->n_brackets);
 }
\ No newline at end of file
@@ -0,0 +1,1487 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include "helpers/buffer.h"
+#include <stdlib.h>
+#include <ctype.h>
+
+/*
+ * Integrated assembler for the subset of NASM the code generators write
+ *
+ * Every line is encoded as soon as it is read, references to labels are remembered as relocations.
+ * When all lines are done, the references to labels inside the same section are filled in
+ * and the rest is left for the linker (elf.c writes them as ELF relocations)
+ *
+ * Jumps forward and calls always use the 32 bit relative form, so the size of an instruction never depends on a label
+ * that comes later and one pass is enough. Jumps back to a label close enough use the 2 byte form
+ */
+
+enum
+{
+    ASSEMBLER_OPERAND_NONE,
+    ASSEMBLER_OPERAND_REGISTER,
+    ASSEMBLER_OPERAND_IMMEDIATE,
+    ASSEMBLER_OPERAND_MEMORY
+};
+
+// The register numbers used in the ModRM byte
+enum
+{
+    ASSEMBLER_REGISTER_EAX,
+    ASSEMBLER_REGISTER_ECX,
+    ASSEMBLER_REGISTER_EDX,
+    ASSEMBLER_REGISTER_EBX,
+    ASSEMBLER_REGISTER_ESP,
+    ASSEMBLER_REGISTER_EBP,
+    ASSEMBLER_REGISTER_ESI,
+    ASSEMBLER_REGISTER_EDI,
+    ASSEMBLER_REGISTER_NONE = -1
+};
+
+struct assembler_operand
+{
+    int type;
+
+    // 1, 2 or 4 bytes, 0 if the operand doesn't say (i.e [ebp-4] or 5)
+    int size;
+
+    // For ASSEMBLER_OPERAND_REGISTER
+    int reg;
+
+    // For ASSEMBLER_OPERAND_MEMORY, [base + index * scale + value + symbol]
+    int base;
+    int index;
+    int scale;
+
+    // The immediate or the displacement of the memory operand
+    long long value;
+    // Label added to the value, NULL if there is none
+    struct assembler_symbol* symbol;
+};
+
+struct assembler_register
+{
+    const char* name;
+    int reg;
+    int size;
+};
+
+static struct assembler_register assembler_registers[] = {
+    {"eax", ASSEMBLER_REGISTER_EAX, 4}, {"ecx", ASSEMBLER_REGISTER_ECX, 4}, {"edx", ASSEMBLER_REGISTER_EDX, 4}, {"ebx", ASSEMBLER_REGISTER_EBX, 4},
+    {"esp", ASSEMBLER_REGISTER_ESP, 4}, {"ebp", ASSEMBLER_REGISTER_EBP, 4}, {"esi", ASSEMBLER_REGISTER_ESI, 4}, {"edi", ASSEMBLER_REGISTER_EDI, 4},
+    {"ax", 0, 2}, {"cx", 1, 2}, {"dx", 2, 2}, {"bx", 3, 2}, {"sp", 4, 2}, {"bp", 5, 2}, {"si", 6, 2}, {"di", 7, 2},
+    {"al", 0, 1}, {"cl", 1, 1}, {"dl", 2, 1}, {"bl", 3, 1}, {"ah", 4, 1}, {"ch", 5, 1}, {"dh", 6, 1}, {"bh", 7, 1},
+    {NULL, 0, 0}
+};
+
+// Condition codes of jcc and setcc, the number is added to the opcode
+struct assembler_condition
+{
+    const char* name;
+    int code;
+};
+
+static struct assembler_condition assembler_conditions[] = {
+    {"o", 0}, {"no", 1}, {"b", 2}, {"c", 2}, {"nae", 2}, {"ae", 3}, {"nb", 3}, {"nc", 3},
+    {"e", 4}, {"z", 4}, {"ne", 5}, {"nz", 5}, {"be", 6}, {"na", 6}, {"a", 7}, {"nbe", 7},
+    {"s", 8}, {"ns", 9}, {"p", 10}, {"pe", 10}, {"np", 11}, {"po", 11},
+    {"l", 12}, {"nge", 12}, {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15}, {"nle", 15},
+    {NULL, 0}
+};
+
+// add, or, adc, sbb, and, sub, xor, cmp share their encodings, only the number in the ModRM byte differs
+static const char* assembler_arithmetic_names[] = {"add", "or", "adc", "sbb", "and", "sub", "xor", "cmp", NULL};
+
+// Same for the shifts, the numbers are the ModRM extension of the D3/C1 opcodes
+struct assembler_shift
+{
+    const char* name;
+    int extension;
+};
+
+static struct assembler_shift assembler_shifts[] = {
+    {"rol", 0}, {"ror", 1}, {"shl", 4}, {"sal", 4}, {"shr", 5}, {"sar", 7}, {NULL, 0}
+};
+
+static void assembler_error(struct assembler* assembler, const char* message, const char* text)
+{
+    compiler_error(assembler->process, "Assembler: %s \"%s\" on assembly line %i", message, text, assembler->line);
+}
+
+struct assembler* assembler_new(struct compiler_process* process)
+{
+    static const char* section_names[] = {
+        [ASSEMBLER_SECTION_TEXT] = ".text",
+        [ASSEMBLER_SECTION_DATA] = ".data",
+        [ASSEMBLER_SECTION_BSS] = ".bss",
+        [ASSEMBLER_SECTION_RODATA] = ".rodata"
+    };
+
+    struct assembler* assembler = arena_calloc(1, sizeof(struct assembler));
+    assembler->process = process;
+    assembler->symbols = vector_create(sizeof(struct assembler_symbol*));
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        assembler->sections[i].name = section_names[i];
+        assembler->sections[i].data = i == ASSEMBLER_SECTION_BSS ? NULL : buffer_create();
+        assembler->sections[i].relocations = vector_create(sizeof(struct assembler_relocation));
+    }
+    assembler->current_section = ASSEMBLER_SECTION_TEXT;
+    return assembler;
+}
+
+void assembler_free(struct assembler* assembler)
+{
+    for (int i = 0; i < vector_count(assembler->symbols); i++)
+    {
+        struct assembler_symbol* symbol = vector_peek_ptr_at(assembler->symbols, i);
+        arena_free((char*)symbol->name);
+        arena_free(symbol);
+    }
+    vector_free(assembler->symbols);
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        if (assembler->sections[i].data)
+        {
+            buffer_free(assembler->sections[i].data);
+        }
+        vector_free(assembler->sections[i].relocations);
+    }
+    arena_free((char*)assembler->last_global_label);
+    arena_free(assembler);
+}
+
+static struct assembler_section* assembler_section(struct assembler* assembler)
+{
+    return &assembler->sections[assembler->current_section];
+}
+
+static unsigned int assembler_offset(struct assembler* assembler)
+{
+    return assembler_section(assembler)->size;
+}
+
+static void assembler_emit_byte(struct assembler* assembler, int byte)
+{
+    struct assembler_section* section = assembler_section(assembler);
+    if (!section->data)
+    {
+        assembler_error(assembler, "Data in the .bss section, only resb/resw/resd are allowed", section->name);
+    }
+    buffer_write(section->data, (char)byte);
+    section->size++;
+}
+
+static void assembler_emit_value(struct assembler* assembler, long long value, int size)
+{
+    for (int i = 0; i < size; i++)
+    {
+        assembler_emit_byte(assembler, (value >> (i * 8)) & 0xff);
+    }
+}
+
+static void assembler_add_relocation(struct assembler* assembler, int type, struct assembler_symbol* symbol, int addend)
+{
+    struct assembler_relocation relocation = {};
+    relocation.type = type;
+    relocation.offset = assembler_offset(assembler);
+    relocation.symbol = symbol;
+    relocation.addend = addend;
+    vector_push(assembler_section(assembler)->relocations, &relocation);
+}
+
+// A 4 byte value that can be the address of a label
+static void assembler_emit_dword(struct assembler* assembler, long long value, struct assembler_symbol* symbol)
+{
+    if (symbol)
+    {
+        assembler_add_relocation(assembler, ASSEMBLER_RELOCATION_ABSOLUTE, symbol, value);
+        value = 0;
+    }
+    assembler_emit_value(assembler, value, 4);
+}
+
+// The name of the label, .if_end_5 in the function main is main.if_end_5 just like in NASM
+static char* assembler_label_name(struct assembler* assembler, const char* name)
+{
+    if (name[0] == '.' && assembler->last_global_label)
+    {
+        char* full_name = arena_malloc(strlen(assembler->last_global_label) + strlen(name) + 1);
+        sprintf(full_name, "%s%s", assembler->last_global_label, name);
+        return full_name;
+    }
+    return arena_strdup(name);
+}
+
+static struct assembler_symbol* assembler_symbol(struct assembler* assembler, const char* name)
+{
+    char* full_name = assembler_label_name(assembler, name);
+    for (int i = 0; i < vector_count(assembler->symbols); i++)
+    {
+        struct assembler_symbol* symbol = vector_peek_ptr_at(assembler->symbols, i);
+        if (S_EQ(symbol->name, full_name))
+        {
+            arena_free(full_name);
+            return symbol;
+        }
+    }
+
+    struct assembler_symbol* symbol = arena_calloc(1, sizeof(struct assembler_symbol));
+    symbol->name = full_name;
+    vector_push(assembler->symbols, &symbol);
+    return symbol;
+}
+
+static void assembler_define_label(struct assembler* assembler, const char* name)
+{
+    if (name[0] != '.')
+    {
+        arena_free((char*)assembler->last_global_label);
+        assembler->last_global_label = arena_strdup(name);
+    }
+
+    struct assembler_symbol* symbol = assembler_symbol(assembler, name);
+    if (symbol->is_defined)
+    {
+        assembler_error(assembler, "Label defined twice", name);
+    }
+    symbol->is_defined = true;
+    symbol->section = assembler->current_section;
+    symbol->offset = assembler_offset(assembler);
+}
+
+static char* assembler_trim(char* str)
+{
+    while (isspace(*str))
+    {
+        str++;
+    }
+
+    char* end = str + strlen(str);
+    while (end > str && isspace(end[-1]))
+    {
+        end--;
+    }
+    *end = 0;
+    return str;
+}
+
+// Removes the comment, a ; inside a character literal (';') isn't a comment
+static void assembler_strip_comment(char* line)
+{
+    char quote = 0;
+    for (char* c = line; *c; c++)
+    {
+        if (quote)
+        {
+            if (*c == quote)
+            {
+                quote = 0;
+            }
+            continue;
+        }
+
+        if (*c == '\'' || *c == '"')
+        {
+            quote = *c;
+        }
+        else if (*c == ';')
+        {
+            *c = 0;
+            return;
+        }
+    }
+}
+
+// Splits "eax, [ebp-4]" into its operands, commas inside quotes don't split. Returns the amount of parts
+static int assembler_split_operands(char* text, char** parts_out, int max_parts)
+{
+    int total = 0;
+    char quote = 0;
+    char* start = text;
+    if (!*assembler_trim(text))
+    {
+        return 0;
+    }
+
+    for (char* c = text; ; c++)
+    {
+        if (quote && *c && *c != quote)
+        {
+            continue;
+        }
+        if (quote)
+        {
+            quote = *c == quote ? 0 : quote;
+            if (*c)
+            {
+                continue;
+            }
+        }
+
+        if (*c == '\'' || *c == '"')
+        {
+            quote = *c;
+            continue;
+        }
+
+        if (*c == ',' || *c == 0)
+        {
+            bool is_end = *c == 0;
+            *c = 0;
+            if (total < max_parts)
+            {
+                parts_out[total] = assembler_trim(start);
+            }
+            total++;
+            start = c + 1;
+            if (is_end)
+            {
+                break;
+            }
+        }
+    }
+    return total;
+}
+
+static struct assembler_register* assembler_find_register(const char* name)
+{
+    for (int i = 0; assembler_registers[i].name; i++)
+    {
+        if (S_EQ(assembler_registers[i].name, name))
+        {
+            return &assembler_registers[i];
+        }
+    }
+    return NULL;
+}
+
+static int assembler_size_keyword(const char* word)
+{
+    int size = 0;
+    if (S_EQ(word, "byte"))
+    {
+        size = 1;
+    }
+    else if (S_EQ(word, "word"))
+    {
+        size = 2;
+    }
+    else if (S_EQ(word, "dword"))
+    {
+        size = 4;
+    }
+    return size;
+}
+
+static bool assembler_is_label_char(char c)
+{
+    return isalnum(c) || c == '_' || c == '.' || c == '$' || c == '@';
+}
+
+static bool assembler_parse_number(const char* text, long long* value_out)
+{
+    if (text[0] == '\'' && text[1] && text[2] == '\'')
+    {
+        *value_out = (unsigned char)text[1];
+        return true;
+    }
+
+    // NASM numbers are decimal unless they start with 0x, 010 is ten and not eight
+    char* end = NULL;
+    bool is_hex = (text[0] == '0' || text[0] == '-') && strstr(text, "0x") == text + (text[0] == '-');
+    long long value = strtoll(text, &end, is_hex ? 16 : 10);
+    if (end == text || *end)
+    {
+        return false;
+    }
+    *value_out = value;
+    return true;
+}
+
+// One part of [ebx + eax*4 - 8] or sym+8
+static void assembler_parse_term(struct assembler* assembler, char* term, int sign, struct assembler_operand* operand, bool is_memory)
+{
+    term = assembler_trim(term);
+    char* star = strchr(term, '*');
+    if (star)
+    {
+        *star = 0;
+        struct assembler_register* reg = assembler_find_register(assembler_trim(term));
+        long long scale = 0;
+        if (!is_memory || !reg || !assembler_parse_number(assembler_trim(star + 1), &scale))
+        {
+            assembler_error(assembler, "Invalid scaled index", term);
+        }
+        operand->index = reg->reg;
+        operand->scale = scale;
+        return;
+    }
+
+    struct assembler_register* reg = assembler_find_register(term);
+    if (reg)
+    {
+        if (!is_memory || sign < 0)
+        {
+            assembler_error(assembler, "Register can't be used here", term);
+        }
+
+        if (operand->base == ASSEMBLER_REGISTER_NONE)
+        {
+            operand->base = reg->reg;
+        }
+        else
+        {
+            operand->index = reg->reg;
+            operand->scale = 1;
+        }
+        return;
+    }
+
+    long long value = 0;
+    if (assembler_parse_number(term, &value))
+    {
+        operand->value += sign * value;
+        return;
+    }
+
+    for (char* c = term; *c; c++)
+    {
+        if (!assembler_is_label_char(*c))
+        {
+            assembler_error(assembler, "Invalid expression", term);
+        }
+    }
+
+    if (operand->symbol || sign < 0)
+    {
+        assembler_error(assembler, "Only one label can be added to a value", term);
+    }
+    operand->symbol = assembler_symbol(assembler, term);
+}
+
+// Parses expressions made of + and -, i.e ebp-4 or str_1+2
+static void assembler_parse_expression(struct assembler* assembler, char* text, struct assembler_operand* operand, bool is_memory)
+{
+    int sign = 1;
+    char* start = text;
+    for (char* c = text; ; c++)
+    {
+        // The minus of a number at the start isn't an operator
+        bool is_operator = (*c == '+' || *c == '-') && c != text;
+        if (!is_operator && *c)
+        {
+            continue;
+        }
+
+        char saved = *c;
+        *c = 0;
+        if (*assembler_trim(start))
+        {
+            assembler_parse_term(assembler, start, sign, operand, is_memory);
+        }
+        if (!saved)
+        {
+            break;
+        }
+        sign = saved == '-' ? -1 : 1;
+        start = c + 1;
+    }
+}
+
+static void assembler_parse_operand(struct assembler* assembler, char* text, struct assembler_operand* operand)
+{
+    memset(operand, 0, sizeof(struct assembler_operand));
+    operand->base = ASSEMBLER_REGISTER_NONE;
+    operand->index = ASSEMBLER_REGISTER_NONE;
+    text = assembler_trim(text);
+
+    // dword [ebp-4], byte [eax], dword 5
+    char* space = strchr(text, ' ');
+    if (space)
+    {
+        *space = 0;
+        int size = assembler_size_keyword(text);
+        if (size)
+        {
+            operand->size = size;
+            text = assembler_trim(space + 1);
+        }
+        else
+        {
+            *space = ' ';
+        }
+    }
+
+    if (text[0] == '[')
+    {
+        char* end = strrchr(text, ']');
+        if (!end)
+        {
+            assembler_error(assembler, "Missing ]", text);
+        }
+        *end = 0;
+        operand->type = ASSEMBLER_OPERAND_MEMORY;
+        assembler_parse_expression(assembler, text + 1, operand, true);
+        return;
+    }
+
+    struct assembler_register* reg = assembler_find_register(text);
+    if (reg)
+    {
+        operand->type = ASSEMBLER_OPERAND_REGISTER;
+        operand->reg = reg->reg;
+        operand->size = reg->size;
+        return;
+    }
+
+    operand->type = ASSEMBLER_OPERAND_IMMEDIATE;
+    assembler_parse_expression(assembler, text, operand, false);
+}
+
+static bool assembler_fits_in_byte(struct assembler_operand* operand)
+{
+    return !operand->symbol && operand->value >= -128 && operand->value <= 127;
+}
+
+static int assembler_scale_bits(struct assembler* assembler, int scale)
+{
+    int bits = 0;
+    switch (scale)
+    {
+    case 1:
+        bits = 0;
+        break;
+    case 2:
+        bits = 1;
+        break;
+    case 4:
+        bits = 2;
+        break;
+    case 8:
+        bits = 3;
+        break;
+    default:
+        assembler_error(assembler, "Invalid scale", "");
+    }
+    return bits;
+}
+
+// The ModRM byte (and SIB byte and displacement) for a register or memory operand
+static void assembler_emit_modrm(struct assembler* assembler, int reg_field, struct assembler_operand* rm)
+{
+    if (rm->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_emit_byte(assembler, 0xC0 | (reg_field << 3) | rm->reg);
+        return;
+    }
+
+    if (rm->type != ASSEMBLER_OPERAND_MEMORY)
+    {
+        assembler_error(assembler, "Expected a register or memory operand", "");
+    }
+
+    // [label] or [1234]
+    if (rm->base == ASSEMBLER_REGISTER_NONE && rm->index == ASSEMBLER_REGISTER_NONE)
+    {
+        assembler_emit_byte(assembler, (reg_field << 3) | 0b101);
+        assembler_emit_dword(assembler, rm->value, rm->symbol);
+        return;
+    }
+
+    int mod = 0b10;
+    if (!rm->symbol && rm->value == 0 && rm->base != ASSEMBLER_REGISTER_EBP && rm->base != ASSEMBLER_REGISTER_NONE)
+    {
+        mod = 0b00;
+    }
+    else if (assembler_fits_in_byte(rm) && rm->base != ASSEMBLER_REGISTER_NONE)
+    {
+        mod = 0b01;
+    }
+
+    if (rm->index == ASSEMBLER_REGISTER_NONE && rm->base != ASSEMBLER_REGISTER_ESP)
+    {
+        assembler_emit_byte(assembler, (mod << 6) | (reg_field << 3) | rm->base);
+    }
+    else
+    {
+        // The SIB byte, [base + index * scale], without a base the displacement is always 4 bytes
+        if (rm->base == ASSEMBLER_REGISTER_NONE)
+        {
+            mod = 0b00;
+        }
+        int index = rm->index == ASSEMBLER_REGISTER_NONE ? ASSEMBLER_REGISTER_ESP : rm->index;
+        int base = rm->base == ASSEMBLER_REGISTER_NONE ? ASSEMBLER_REGISTER_EBP : rm->base;
+        int scale = rm->index == ASSEMBLER_REGISTER_NONE ? 0 : assembler_scale_bits(assembler, rm->scale);
+        assembler_emit_byte(assembler, (mod << 6) | (reg_field << 3) | 0b100);
+        assembler_emit_byte(assembler, (scale << 6) | (index << 3) | base);
+        if (rm->base == ASSEMBLER_REGISTER_NONE)
+        {
+            assembler_emit_dword(assembler, rm->value, rm->symbol);
+            return;
+        }
+    }
+
+    if (mod == 0b01)
+    {
+        assembler_emit_value(assembler, rm->value, 1);
+    }
+    else if (mod == 0b10)
+    {
+        assembler_emit_dword(assembler, rm->value, rm->symbol);
+    }
+}
+
+static void assembler_emit_immediate(struct assembler* assembler, struct assembler_operand* immediate, int size)
+{
+    if (size == 4)
+    {
+        assembler_emit_dword(assembler, immediate->value, immediate->symbol);
+        return;
+    }
+
+    if (immediate->symbol)
+    {
+        assembler_error(assembler, "The address of a label doesn't fit in a byte or word", immediate->symbol->name);
+    }
+    assembler_emit_value(assembler, immediate->value, size);
+}
+
+// The size of the operation, registers decide it, otherwise byte/word/dword written before the memory operand
+static int assembler_operation_size(struct assembler_operand* a, struct assembler_operand* b)
+{
+    int size = 4;
+    if (a && a->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        size = a->size;
+    }
+    else if (b && b->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        size = b->size;
+    }
+    else if (a && a->size)
+    {
+        size = a->size;
+    }
+    else if (b && b->size)
+    {
+        size = b->size;
+    }
+    return size;
+}
+
+static void assembler_emit_size_prefix(struct assembler* assembler, int size)
+{
+    if (size == 2)
+    {
+        // Operand size override, the 32 bit instruction works on 16 bits
+        assembler_emit_byte(assembler, 0x66);
+    }
+}
+
+// An instruction that has the byte form at opcode and the word/dword form at opcode + 1
+static void assembler_emit_sized_opcode(struct assembler* assembler, int opcode, int size)
+{
+    assembler_emit_size_prefix(assembler, size);
+    assembler_emit_byte(assembler, size == 1 ? opcode : opcode + 1);
+}
+
+static bool assembler_is_register_or_memory(struct assembler_operand* operand)
+{
+    return operand->type == ASSEMBLER_OPERAND_REGISTER || operand->type == ASSEMBLER_OPERAND_MEMORY;
+}
+
+// add, or, adc, sbb, and, sub, xor, cmp
+static void assembler_encode_arithmetic(struct assembler* assembler, int extension, struct assembler_operand* dst, struct assembler_operand* src)
+{
+    int size = assembler_operation_size(dst, src);
+    if (src->type == ASSEMBLER_OPERAND_IMMEDIATE)
+    {
+        if (size != 1 && assembler_fits_in_byte(src))
+        {
+            assembler_emit_size_prefix(assembler, size);
+            assembler_emit_byte(assembler, 0x83);
+            assembler_emit_modrm(assembler, extension, dst);
+            assembler_emit_value(assembler, src->value, 1);
+            return;
+        }
+        assembler_emit_sized_opcode(assembler, 0x80, size);
+        assembler_emit_modrm(assembler, extension, dst);
+        assembler_emit_immediate(assembler, src, size);
+        return;
+    }
+
+    if (src->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        // add r/m, reg
+        assembler_emit_sized_opcode(assembler, extension * 8, size);
+        assembler_emit_modrm(assembler, src->reg, dst);
+        return;
+    }
+
+    if (dst->type != ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_error(assembler, "Both operands can't be memory", "");
+    }
+    // add reg, r/m
+    assembler_emit_sized_opcode(assembler, extension * 8 + 2, size);
+    assembler_emit_modrm(assembler, dst->reg, src);
+}
+
+static void assembler_encode_mov(struct assembler* assembler, struct assembler_operand* dst, struct assembler_operand* src)
+{
+    int size = assembler_operation_size(dst, src);
+    if (src->type == ASSEMBLER_OPERAND_IMMEDIATE)
+    {
+        if (dst->type == ASSEMBLER_OPERAND_REGISTER)
+        {
+            // mov eax, 5 -> B8 05 00 00 00
+            assembler_emit_size_prefix(assembler, size);
+            assembler_emit_byte(assembler, (size == 1 ? 0xB0 : 0xB8) + dst->reg);
+            assembler_emit_immediate(assembler, src, size);
+            return;
+        }
+        assembler_emit_sized_opcode(assembler, 0xC6, size);
+        assembler_emit_modrm(assembler, 0, dst);
+        assembler_emit_immediate(assembler, src, size);
+        return;
+    }
+
+    // mov eax, [abc] and mov [abc], eax have a shorter form without the ModRM byte
+    bool is_eax_with_address = false;
+    struct assembler_operand* memory = src->type == ASSEMBLER_OPERAND_MEMORY ? src : dst;
+    struct assembler_operand* reg = src->type == ASSEMBLER_OPERAND_MEMORY ? dst : src;
+    if (memory->type == ASSEMBLER_OPERAND_MEMORY && reg->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        is_eax_with_address = reg->reg == ASSEMBLER_REGISTER_EAX && memory->base == ASSEMBLER_REGISTER_NONE && memory->index == ASSEMBLER_REGISTER_NONE;
+    }
+    if (is_eax_with_address)
+    {
+        assembler_emit_sized_opcode(assembler, memory == src ? 0xA0 : 0xA2, size);
+        assembler_emit_dword(assembler, memory->value, memory->symbol);
+        return;
+    }
+
+    if (src->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_emit_sized_opcode(assembler, 0x88, size);
+        assembler_emit_modrm(assembler, src->reg, dst);
+        return;
+    }
+
+    if (dst->type != ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_error(assembler, "Both operands can't be memory", "");
+    }
+    assembler_emit_sized_opcode(assembler, 0x8A, size);
+    assembler_emit_modrm(assembler, dst->reg, src);
+}
+
+// movzx eax, al / movsx eax, word [ebx]
+static void assembler_encode_extend(struct assembler* assembler, int opcode, struct assembler_operand* dst, struct assembler_operand* src)
+{
+    int source_size = src->size ? src->size : 1;
+    if (dst->type != ASSEMBLER_OPERAND_REGISTER || source_size == 4)
+    {
+        assembler_error(assembler, "Invalid operands for movzx/movsx", "");
+    }
+    assembler_emit_size_prefix(assembler, dst->size);
+    assembler_emit_byte(assembler, 0x0F);
+    assembler_emit_byte(assembler, source_size == 1 ? opcode : opcode + 1);
+    assembler_emit_modrm(assembler, dst->reg, src);
+}
+
+static void assembler_encode_push(struct assembler* assembler, struct assembler_operand* operand)
+{
+    if (operand->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_emit_byte(assembler, 0x50 + operand->reg);
+    }
+    else if (operand->type == ASSEMBLER_OPERAND_IMMEDIATE)
+    {
+        if (assembler_fits_in_byte(operand))
+        {
+            assembler_emit_byte(assembler, 0x6A);
+            assembler_emit_value(assembler, operand->value, 1);
+            return;
+        }
+        assembler_emit_byte(assembler, 0x68);
+        assembler_emit_dword(assembler, operand->value, operand->symbol);
+    }
+    else
+    {
+        assembler_emit_byte(assembler, 0xFF);
+        assembler_emit_modrm(assembler, 6, operand);
+    }
+}
+
+static void assembler_encode_pop(struct assembler* assembler, struct assembler_operand* operand)
+{
+    if (operand->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        assembler_emit_byte(assembler, 0x58 + operand->reg);
+        return;
+    }
+    assembler_emit_byte(assembler, 0x8F);
+    assembler_emit_modrm(assembler, 0, operand);
+}
+
+// imul ecx, imul eax, 8, imul eax, eax, 8, imul eax, dword [ebp-4]
+static void assembler_encode_imul(struct assembler* assembler, struct assembler_operand* operands, int total_operands)
+{
+    if (total_operands == 1)
+    {
+        int size = assembler_operation_size(&operands[0], NULL);
+        assembler_emit_sized_opcode(assembler, 0xF6, size);
+        assembler_emit_modrm(assembler, 5, &operands[0]);
+        return;
+    }
+
+    struct assembler_operand* dst = &operands[0];
+    struct assembler_operand* src = &operands[1];
+    struct assembler_operand* immediate = total_operands == 3 ? &operands[2] : NULL;
+    if (total_operands == 2 && src->type == ASSEMBLER_OPERAND_IMMEDIATE)
+    {
+        // imul eax, 8 is the short form of imul eax, eax, 8
+        immediate = src;
+        src = dst;
+    }
+
+    if (dst->type != ASSEMBLER_OPERAND_REGISTER || dst->size == 1)
+    {
+        assembler_error(assembler, "imul needs a 16 or 32 bit register destination", "");
+    }
+
+    assembler_emit_size_prefix(assembler, dst->size);
+    if (!immediate)
+    {
+        assembler_emit_byte(assembler, 0x0F);
+        assembler_emit_byte(assembler, 0xAF);
+        assembler_emit_modrm(assembler, dst->reg, src);
+        return;
+    }
+
+    bool is_short = assembler_fits_in_byte(immediate);
+    assembler_emit_byte(assembler, is_short ? 0x6B : 0x69);
+    assembler_emit_modrm(assembler, dst->reg, src);
+    assembler_emit_immediate(assembler, immediate, is_short ? 1 : dst->size);
+}
+
+static void assembler_encode_shift(struct assembler* assembler, int extension, struct assembler_operand* dst, struct assembler_operand* count)
+{
+    int size = assembler_operation_size(dst, NULL);
+    if (count->type == ASSEMBLER_OPERAND_REGISTER)
+    {
+        if (count->reg != ASSEMBLER_REGISTER_ECX || count->size != 1)
+        {
+            assembler_error(assembler, "Shifts by a register must use cl", "");
+        }
+        assembler_emit_sized_opcode(assembler, 0xD2, size);
+        assembler_emit_modrm(assembler, extension, dst);
+        return;
+    }
+
+    if (count->type != ASSEMBLER_OPERAND_IMMEDIATE || count->symbol)
+    {
+        assembler_error(assembler, "Invalid shift count", "");
+    }
+    assembler_emit_sized_opcode(assembler, 0xC0, size);
+    assembler_emit_modrm(assembler, extension, dst);
+    assembler_emit_value(assembler, count->value, 1);
+}
+
+// jmp label, call label, je label, the distance is always 4 bytes
+static void assembler_emit_relative_target(struct assembler* assembler, struct assembler_operand* target)
+{
+    if (target->type != ASSEMBLER_OPERAND_IMMEDIATE || !target->symbol)
+    {
+        assembler_error(assembler, "Expected a label", "");
+    }
+    assembler_add_relocation(assembler, ASSEMBLER_RELOCATION_RELATIVE, target->symbol, target->value);
+    assembler_emit_value(assembler, 0, 4);
+}
+
+// A jump back to a label that is already known and close enough, jmp .while_start_5 -> EB F0
+static bool assembler_encode_short_jump(struct assembler* assembler, int short_opcode, struct assembler_operand* target)
+{
+    struct assembler_symbol* symbol = target->symbol;
+    if (target->type != ASSEMBLER_OPERAND_IMMEDIATE || !symbol || !symbol->is_defined || symbol->section != assembler->current_section)
+    {
+        return false;
+    }
+
+    long long distance = symbol->offset + target->value - (assembler_offset(assembler) + 2);
+    if (distance < -128 || distance > 127)
+    {
+        return false;
+    }
+    assembler_emit_byte(assembler, short_opcode);
+    assembler_emit_value(assembler, distance, 1);
+    return true;
+}
+
+// call label or call [function_call_5], jmp label or jmp eax
+static void assembler_encode_jump_or_call(struct assembler* assembler, int relative_opcode, int extension, struct assembler_operand* target)
+{
+    if (relative_opcode == 0xE9 && assembler_encode_short_jump(assembler, 0xEB, target))
+    {
+        return;
+    }
+
+    if (target->type == ASSEMBLER_OPERAND_IMMEDIATE)
+    {
+        assembler_emit_byte(assembler, relative_opcode);
+        assembler_emit_relative_target(assembler, target);
+        return;
+    }
+
+    assembler_emit_byte(assembler, 0xFF);
+    assembler_emit_modrm(assembler, extension, target);
+}
+
+static int assembler_condition_code(const char* name)
+{
+    for (int i = 0; assembler_conditions[i].name; i++)
+    {
+        if (S_EQ(assembler_conditions[i].name, name))
+        {
+            return assembler_conditions[i].code;
+        }
+    }
+    return -1;
+}
+
+// Instructions that only have an opcode, i.e ret, cdq
+static bool assembler_encode_no_operands(struct assembler* assembler, const char* mnemonic, bool has_rep_prefix)
+{
+    struct
+    {
+        const char* name;
+        int opcode;
+    } instructions[] = {
+        {"ret", 0xC3}, {"cdq", 0x99}, {"leave", 0xC9}, {"nop", 0x90}, {"cld", 0xFC}, {"hlt", 0xF4},
+        {"movsb", 0xA4}, {"movsd", 0xA5}, {"stosb", 0xAA}, {"stosd", 0xAB},
+        {NULL, 0}
+    };
+
+    for (int i = 0; instructions[i].name; i++)
+    {
+        if (S_EQ(instructions[i].name, mnemonic))
+        {
+            if (has_rep_prefix)
+            {
+                assembler_emit_byte(assembler, 0xF3);
+            }
+            assembler_emit_byte(assembler, instructions[i].opcode);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void assembler_expect_operands(struct assembler* assembler, const char* mnemonic, int total_operands, int expected)
+{
+    if (total_operands != expected)
+    {
+        assembler_error(assembler, "Wrong amount of operands for", mnemonic);
+    }
+}
+
+// F7 group, not neg mul imul div idiv, test is done separately
+static int assembler_unary_extension(const char* mnemonic)
+{
+    struct
+    {
+        const char* name;
+        int extension;
+    } instructions[] = {
+        {"not", 2}, {"neg", 3}, {"mul", 4}, {"div", 6}, {"idiv", 7}, {NULL, 0}
+    };
+
+    for (int i = 0; instructions[i].name; i++)
+    {
+        if (S_EQ(instructions[i].name, mnemonic))
+        {
+            return instructions[i].extension;
+        }
+    }
+    return -1;
+}
+
+static void assembler_encode_instruction(struct assembler* assembler, char* mnemonic, char* operands_text)
+{
+    bool has_rep_prefix = false;
+    if (S_EQ(mnemonic, "rep"))
+    {
+        // rep movsd, the real instruction is the first operand
+        has_rep_prefix = true;
+        mnemonic = assembler_trim(operands_text);
+        operands_text = "";
+    }
+
+    if (assembler_section(assembler)->data == NULL)
+    {
+        assembler_error(assembler, "Instruction in the .bss section", mnemonic);
+    }
+
+    if (assembler_encode_no_operands(assembler, mnemonic, has_rep_prefix))
+    {
+        return;
+    }
+
+    char* operand_texts[3];
+    char operands_copy[512];
+    strncpy(operands_copy, operands_text, sizeof(operands_copy) - 1);
+    operands_copy[sizeof(operands_copy) - 1] = 0;
+    int total_operands = assembler_split_operands(operands_copy, operand_texts, 3);
+    if (total_operands > 3)
+    {
+        assembler_error(assembler, "Too many operands for", mnemonic);
+    }
+
+    struct assembler_operand operands[3];
+    for (int i = 0; i < total_operands; i++)
+    {
+        assembler_parse_operand(assembler, operand_texts[i], &operands[i]);
+    }
+
+    for (int i = 0; assembler_arithmetic_names[i]; i++)
+    {
+        if (S_EQ(assembler_arithmetic_names[i], mnemonic))
+        {
+            assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+            assembler_encode_arithmetic(assembler, i, &operands[0], &operands[1]);
+            return;
+        }
+    }
+
+    for (int i = 0; assembler_shifts[i].name; i++)
+    {
+        if (S_EQ(assembler_shifts[i].name, mnemonic))
+        {
+            assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+            assembler_encode_shift(assembler, assembler_shifts[i].extension, &operands[0], &operands[1]);
+            return;
+        }
+    }
+
+    int extension = assembler_unary_extension(mnemonic);
+    if (extension != -1)
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_emit_sized_opcode(assembler, 0xF6, assembler_operation_size(&operands[0], NULL));
+        assembler_emit_modrm(assembler, extension, &operands[0]);
+        return;
+    }
+
+    if (mnemonic[0] == 'j' && assembler_condition_code(mnemonic + 1) != -1)
+    {
+        // je label -> 0F 84 rel32
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        if (assembler_encode_short_jump(assembler, 0x70 + assembler_condition_code(mnemonic + 1), &operands[0]))
+        {
+            return;
+        }
+        assembler_emit_byte(assembler, 0x0F);
+        assembler_emit_byte(assembler, 0x80 + assembler_condition_code(mnemonic + 1));
+        assembler_emit_relative_target(assembler, &operands[0]);
+        return;
+    }
+
+    if (strncmp(mnemonic, "set", 3) == 0 && assembler_condition_code(mnemonic + 3) != -1)
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_emit_byte(assembler, 0x0F);
+        assembler_emit_byte(assembler, 0x90 + assembler_condition_code(mnemonic + 3));
+        assembler_emit_modrm(assembler, 0, &operands[0]);
+        return;
+    }
+
+    if (S_EQ(mnemonic, "mov"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+        assembler_encode_mov(assembler, &operands[0], &operands[1]);
+    }
+    else if (S_EQ(mnemonic, "movzx") || S_EQ(mnemonic, "movsx"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+        assembler_encode_extend(assembler, S_EQ(mnemonic, "movzx") ? 0xB6 : 0xBE, &operands[0], &operands[1]);
+    }
+    else if (S_EQ(mnemonic, "lea"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+        if (operands[0].type != ASSEMBLER_OPERAND_REGISTER || operands[1].type != ASSEMBLER_OPERAND_MEMORY)
+        {
+            assembler_error(assembler, "lea needs a register and a memory operand", operands_text);
+        }
+        assembler_emit_byte(assembler, 0x8D);
+        assembler_emit_modrm(assembler, operands[0].reg, &operands[1]);
+    }
+    else if (S_EQ(mnemonic, "push"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_encode_push(assembler, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "pop"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_encode_pop(assembler, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "inc") || S_EQ(mnemonic, "dec"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        if (operands[0].type == ASSEMBLER_OPERAND_REGISTER && operands[0].size == 4)
+        {
+            // inc eax -> 40
+            assembler_emit_byte(assembler, (S_EQ(mnemonic, "inc") ? 0x40 : 0x48) + operands[0].reg);
+            return;
+        }
+        assembler_emit_sized_opcode(assembler, 0xFE, assembler_operation_size(&operands[0], NULL));
+        assembler_emit_modrm(assembler, S_EQ(mnemonic, "inc") ? 0 : 1, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "imul"))
+    {
+        if (total_operands < 1)
+        {
+            assembler_error(assembler, "Wrong amount of operands for", mnemonic);
+        }
+        assembler_encode_imul(assembler, operands, total_operands);
+    }
+    else if (S_EQ(mnemonic, "test"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 2);
+        int size = assembler_operation_size(&operands[0], &operands[1]);
+        if (operands[1].type == ASSEMBLER_OPERAND_IMMEDIATE)
+        {
+            assembler_emit_sized_opcode(assembler, 0xF6, size);
+            assembler_emit_modrm(assembler, 0, &operands[0]);
+            assembler_emit_immediate(assembler, &operands[1], size);
+            return;
+        }
+        if (operands[1].type != ASSEMBLER_OPERAND_REGISTER)
+        {
+            assembler_error(assembler, "Invalid operands for test", operands_text);
+        }
+        assembler_emit_sized_opcode(assembler, 0x84, size);
+        assembler_emit_modrm(assembler, operands[1].reg, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "jmp"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_encode_jump_or_call(assembler, 0xE9, 4, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "call"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_encode_jump_or_call(assembler, 0xE8, 2, &operands[0]);
+    }
+    else if (S_EQ(mnemonic, "int"))
+    {
+        assembler_expect_operands(assembler, mnemonic, total_operands, 1);
+        assembler_emit_byte(assembler, 0xCD);
+        assembler_emit_immediate(assembler, &operands[0], 1);
+    }
+    else
+    {
+        assembler_error(assembler, "Unknown instruction", mnemonic);
+    }
+}
+
+static int assembler_data_size(const char* directive)
+{
+    int size = 0;
+    if (S_EQ(directive, "db") || S_EQ(directive, "resb"))
+    {
+        size = 1;
+    }
+    else if (S_EQ(directive, "dw") || S_EQ(directive, "resw"))
+    {
+        size = 2;
+    }
+    else if (S_EQ(directive, "dd") || S_EQ(directive, "resd"))
+    {
+        size = 4;
+    }
+    else if (S_EQ(directive, "dq") || S_EQ(directive, "resq"))
+    {
+        size = 8;
+    }
+    return size;
+}
+
+// db 'h','i',0 / dd str_1 / dd 5
+static void assembler_encode_data(struct assembler* assembler, int size, char* items_text)
+{
+    char* items[1024];
+    int total_items = assembler_split_operands(items_text, items, 1024);
+    if (total_items > 1024)
+    {
+        assembler_error(assembler, "Too many values in one line", "");
+    }
+
+    for (int i = 0; i < total_items; i++)
+    {
+        char* item = items[i];
+        size_t length = strlen(item);
+        if (length >= 2 && (item[0] == '\'' || item[0] == '"') && item[length - 1] == item[0])
+        {
+            // Every character of 'abc' is its own value
+            for (size_t j = 1; j < length - 1; j++)
+            {
+                assembler_emit_value(assembler, (unsigned char)item[j], size);
+            }
+            continue;
+        }
+
+        struct assembler_operand value;
+        assembler_parse_operand(assembler, item, &value);
+        if (value.type != ASSEMBLER_OPERAND_IMMEDIATE)
+        {
+            assembler_error(assembler, "Invalid data value", item);
+        }
+
+        if (value.symbol && size != 4)
+        {
+            assembler_error(assembler, "The address of a label has to be stored with dd", item);
+        }
+        if (size == 4)
+        {
+            assembler_emit_dword(assembler, value.value, value.symbol);
+            continue;
+        }
+        assembler_emit_value(assembler, value.value, size);
+    }
+}
+
+static void assembler_reserve(struct assembler* assembler, unsigned int bytes)
+{
+    struct assembler_section* section = assembler_section(assembler);
+    if (section->data)
+    {
+        // resb outside of .bss is just zeros
+        for (unsigned int i = 0; i < bytes; i++)
+        {
+            assembler_emit_byte(assembler, 0);
+        }
+        return;
+    }
+    section->size += bytes;
+}
+
+static void assembler_select_section(struct assembler* assembler, const char* name)
+{
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        if (S_EQ(assembler->sections[i].name, name))
+        {
+            assembler->current_section = i;
+            return;
+        }
+    }
+    assembler_error(assembler, "Unknown section", name);
+}
+
+static long long assembler_expect_number(struct assembler* assembler, char* text)
+{
+    long long value = 0;
+    if (!assembler_parse_number(assembler_trim(text), &value))
+    {
+        assembler_error(assembler, "Expected a number", text);
+    }
+    return value;
+}
+
+// Directives and instructions, the label is already removed from the line
+static void assembler_encode_statement(struct assembler* assembler, char* statement)
+{
+    char* rest = statement;
+    while (*rest && !isspace(*rest))
+    {
+        rest++;
+    }
+    if (*rest)
+    {
+        *rest = 0;
+        rest++;
+    }
+    char* word = statement;
+    rest = assembler_trim(rest);
+
+    if (S_EQ(word, "section"))
+    {
+        assembler_select_section(assembler, rest);
+    }
+    else if (S_EQ(word, "global") || S_EQ(word, "extern"))
+    {
+        assembler_symbol(assembler, rest)->is_global = true;
+    }
+    else if (S_EQ(word, "times"))
+    {
+        // times 40 db 0
+        char* count_text = rest;
+        while (*rest && !isspace(*rest))
+        {
+            rest++;
+        }
+        if (*rest)
+        {
+            *rest = 0;
+            rest++;
+        }
+        long long count = assembler_expect_number(assembler, count_text);
+        rest = assembler_trim(rest);
+        char* directive = rest;
+        while (*rest && !isspace(*rest))
+        {
+            rest++;
+        }
+        if (*rest)
+        {
+            *rest = 0;
+            rest++;
+        }
+
+        int size = assembler_data_size(directive);
+        if (!size || directive[0] == 'r')
+        {
+            assembler_error(assembler, "times only supports db/dw/dd/dq", directive);
+        }
+        long long value = assembler_expect_number(assembler, rest);
+        if (value == 0 && !assembler_section(assembler)->data)
+        {
+            assembler_reserve(assembler, count * size);
+            return;
+        }
+        for (long long i = 0; i < count; i++)
+        {
+            assembler_emit_value(assembler, value, size);
+        }
+    }
+    else if (assembler_data_size(word) && word[0] == 'r')
+    {
+        assembler_reserve(assembler, assembler_expect_number(assembler, rest) * assembler_data_size(word));
+    }
+    else if (assembler_data_size(word))
+    {
+        assembler_encode_data(assembler, assembler_data_size(word), rest);
+    }
+    else if (S_EQ(word, "align") || S_EQ(word, "alignb"))
+    {
+        long long alignment = assembler_expect_number(assembler, rest);
+        while (alignment > 0 && assembler_offset(assembler) % alignment)
+        {
+            if (assembler_section(assembler)->data)
+            {
+                // Padding inside code has to be executable, nop
+                assembler_emit_byte(assembler, assembler->current_section == ASSEMBLER_SECTION_TEXT ? 0x90 : 0);
+                continue;
+            }
+            assembler_reserve(assembler, 1);
+        }
+    }
+    else
+    {
+        assembler_encode_instruction(assembler, word, rest);
+    }
+}
+
+static void assembler_encode_line(struct assembler* assembler, char* line)
+{
+    assembler_strip_comment(line);
+    line = assembler_trim(line);
+    if (!*line)
+    {
+        return;
+    }
+
+    // label: or label: db 5
+    char* colon = line;
+    while (assembler_is_label_char(*colon))
+    {
+        colon++;
+    }
+    if (*colon == ':' && colon != line)
+    {
+        *colon = 0;
+        assembler_define_label(assembler, line);
+        line = assembler_trim(colon + 1);
+        if (!*line)
+        {
+            return;
+        }
+    }
+
+    assembler_encode_statement(assembler, line);
+}
+
+// Fills in the jumps and calls to labels of the same section, the rest stays for the linker
+static void assembler_resolve_relocations(struct assembler* assembler)
+{
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        struct assembler_section* section = &assembler->sections[i];
+        struct vector* relocations = vector_create(sizeof(struct assembler_relocation));
+        for (int j = 0; j < vector_count(section->relocations); j++)
+        {
+            struct assembler_relocation* relocation = vector_at(section->relocations, j);
+            struct assembler_symbol* symbol = relocation->symbol;
+            if (!symbol->is_defined && strchr(symbol->name, '.'))
+            {
+                // A C name has no dots, main.if_end_5 can only be a local label that was never written
+                assembler_error(assembler, "Local label isn't defined", symbol->name);
+            }
+            if (!symbol->is_defined && !symbol->is_global)
+            {
+                // NASM would report it, the code generator calls functions it only saw a prototype of with extern
+                symbol->is_global = true;
+            }
+
+            bool is_local_jump = relocation->type == ASSEMBLER_RELOCATION_RELATIVE && symbol->is_defined && symbol->section == i;
+            if (is_local_jump)
+            {
+                int distance = symbol->offset + relocation->addend - (relocation->offset + 4);
+                memcpy((char*)buffer_ptr(section->data) + relocation->offset, &distance, 4);
+                continue;
+            }
+            vector_push(relocations, relocation);
+        }
+        vector_free(section->relocations);
+        section->relocations = relocations;
+    }
+}
+
+int assembler_assemble_text(struct assembler* assembler, const char* source)
+{
+    const char* start = source;
+    assembler->line = 0;
+    while (*start)
+    {
+        const char* end = strchr(start, '\n');
+        size_t length = end ? (size_t)(end - start) : strlen(start);
+        char* line = arena_malloc(length + 1);
+        memcpy(line, start, length);
+        line[length] = 0;
+        assembler->line++;
+        assembler_encode_line(assembler, line);
+        arena_free(line);
+        start += length;
+        if (*start == '\n')
+        {
+            start++;
+        }
+    }
+
+    assembler_resolve_relocations(assembler);
+    return ASSEMBLER_ALL_OK;
+}
+
+int assembler_assemble(struct compiler_process* process, const char* source, FILE* out)
+{
+    struct assembler* assembler = assembler_new(process);
+    int res = assembler_assemble_text(assembler, source);
+    if (res == ASSEMBLER_ALL_OK)
+    {
+        res = elf_write_object(assembler, out);
+    }
+    assembler_free(assembler);
+    return res;
+}
@@ -0,0 +1,23 @@
+// Fills an array and sums it over and over
+int values[4000];
+
+int main()
+{
+    int i;
+    for (i = 0; i < 4000; i++)
+    {
+        values[i] = i * 7 + 3;
+    }
+
+    int sum = 0;
+    int round;
+    for (round = 0; round < 2001; round++)
+    {
+        for (i = 0; i < 4000; i++)
+        {
+            // Kept below 65536, an int that overflows makes gcc -O2 free to return anything
+            sum = (sum + values[i]) & 65535;
+        }
+    }
+    return sum & 255;
+}
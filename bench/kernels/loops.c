@@ -0,0 +1,17 @@
+// Nested counting loops with a little arithmetic
+int main()
+{
+    int sum = 0;
+    int i = 0;
+    while (i < 3000)
+    {
+        int j = 0;
+        while (j < 3000)
+        {
+            sum = (sum + (i ^ j) * 3 - j) & 65535;
+            j = j + 1;
+        }
+        i = i + 1;
+    }
+    return sum & 255;
+}
@@ -0,0 +1,17 @@
+// Naive Fibonacci, mostly calls and returns
+int fib(int n)
+{
+    if (n < 2)
+    {
+        return n;
+    }
+    int a = fib(n - 1);
+    int b = fib(n - 2);
+    return a + b;
+}
+
+int main()
+{
+    int result = fib(30);
+    return result & 255;
+}
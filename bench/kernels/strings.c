@@ -0,0 +1,55 @@
+// Length, copy and compare of character strings
+char source[256];
+char copy[256];
+
+int length(char* s)
+{
+    int n = 0;
+    while (s[n])
+    {
+        n = n + 1;
+    }
+    return n;
+}
+
+void string_copy(char* to, char* from)
+{
+    int i = 0;
+    while (from[i])
+    {
+        to[i] = from[i];
+        i = i + 1;
+    }
+    to[i] = 0;
+}
+
+int compare(char* a, char* b)
+{
+    int i = 0;
+    while (a[i] && a[i] == b[i])
+    {
+        i = i + 1;
+    }
+    return a[i] - b[i];
+}
+
+int main()
+{
+    int i;
+    for (i = 0; i < 200; i++)
+    {
+        source[i] = 97 + i % 26;
+    }
+    source[200] = 0;
+
+    int total = 0;
+    int round;
+    for (round = 0; round < 20000; round++)
+    {
+        string_copy(copy, source);
+        int n = length(copy);
+        int difference = compare(copy, source);
+        total = total + n + difference + (round & 3);
+    }
+    return total & 255;
+}
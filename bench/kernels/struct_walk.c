@@ -0,0 +1,31 @@
+// Follows a list of structures linked by index
+struct item
+{
+    int value;
+    int weight;
+    int next;
+};
+
+struct item items[1024];
+
+int main()
+{
+    int i;
+    for (i = 0; i < 1024; i++)
+    {
+        items[i].value = i * 3;
+        items[i].weight = i & 15;
+        items[i].next = (i * 389 + 1) & 1023;
+    }
+
+    int total = 0;
+    int current = 0;
+    int step;
+    for (step = 0; step < 5000000; step++)
+    {
+        struct item* it = &items[current];
+        total = (total + it->value * it->weight) & 65535;
+        current = it->next;
+    }
+    return total & 255;
+}
@@ -0,0 +1,48 @@
+// A tiny interpreter, every step is a switch on the opcode
+int program[8];
+
+int run(int steps)
+{
+    int acc = 0;
+    int pc = 0;
+    while (steps > 0)
+    {
+        switch (program[pc])
+        {
+        case 0:
+            acc = acc + 3;
+            break;
+        case 1:
+            acc = acc - 1;
+            break;
+        case 2:
+            acc = acc * 5;
+            break;
+        case 3:
+            acc = acc ^ 170;
+            break;
+        case 4:
+            acc = acc & 65535;
+            break;
+        case 5:
+            acc = acc + pc;
+            break;
+        default:
+            acc = acc >> 1;
+        }
+        pc = (pc + 1) & 7;
+        steps = steps - 1;
+    }
+    return acc;
+}
+
+int main()
+{
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        program[i] = (i * 5) % 7;
+    }
+    int result = run(10000000);
+    return result & 255;
+}
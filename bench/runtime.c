@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/*
+ * Runtime benchmark of the generated code
+ *
+ * make bench-runtime
+ * ./build/bench_runtime [-repeat=N] [-kernels=DIR]
+ *
+ * Every kernel in bench/kernels is built four ways and run -repeat times:
+ *
+ *  ./main            ./main kernel.c kernel.o object -fintegrated-as
+ *  ./main -fuse-ir   the same through the IR
+ *  gcc -O0           gcc -m32 -O0 -c kernel.c
+ *  gcc -O2           gcc -m32 -O2 -c kernel.c
+ *
+ * and linked with $CC -m32 -no-pie (gcc if CC isn't set), the same way ./main -o links. The median time and the
+ * instructions the program ran (when perf events are allowed, - otherwise) are printed, with how many times
+ * slower it is than the gcc builds. A kernel returns a checksum from main, a build that returns something else than
+ * gcc -O0 is marked WRONG
+ */
+
+#define BENCH_OUTPUT_DIRECTORY "./build/bench"
+#define BENCH_MAX_KERNELS 64
+
+struct bench_variant
+{
+    const char* name;
+    // %s is the kernel, %s the object
+    const char* build_cmd;
+};
+
+static struct bench_variant bench_variants[] = {
+    {"./main", "./main %s %s object -fintegrated-as > /dev/null"},
+    {"./main -fuse-ir", "./main %s %s object -fintegrated-as -fuse-ir > /dev/null"},
+    {"gcc -O0", "gcc -m32 -O0 -c %s -o %s"},
+    {"gcc -O2", "gcc -m32 -O2 -c %s -o %s"},
+};
+
+enum
+{
+    BENCH_VARIANT_GCC_O0 = 2,
+    BENCH_VARIANT_GCC_O2 = 3,
+    BENCH_TOTAL_VARIANTS = sizeof(bench_variants) / sizeof(struct bench_variant)
+};
+
+struct bench_run
+{
+    bool built;
+    int exit_code;
+    double median_ms;
+    // -1 if they couldn't be counted
+    long long instructions;
+};
+
+static double bench_now_ms()
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// Counts the user space instructions of the child from its exec
+static int bench_open_instruction_counter(pid_t child)
+{
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HARDWARE,
+        .size = sizeof(struct perf_event_attr),
+        .config = PERF_COUNT_HW_INSTRUCTIONS,
+        .disabled = 1,
+        .enable_on_exec = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1};
+    return syscall(SYS_perf_event_open, &attr, child, -1, -1, 0);
+}
+
+// Runs the program once, the child waits until the counter is attached to it
+static bool bench_run_once(const char* program, double* ms_out, int* exit_code_out, long long* instructions_out)
+{
+    int start_pipe[2];
+    if (pipe(start_pipe) != 0)
+    {
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        char go;
+        close(start_pipe[1]);
+        if (read(start_pipe[0], &go, 1) != 1)
+        {
+            _exit(127);
+        }
+        execl(program, program, (char*)NULL);
+        _exit(127);
+    }
+    close(start_pipe[0]);
+    if (child < 0)
+    {
+        close(start_pipe[1]);
+        return false;
+    }
+
+    int counter = bench_open_instruction_counter(child);
+    double start = bench_now_ms();
+    if (write(start_pipe[1], "g", 1) != 1)
+    {
+        close(start_pipe[1]);
+        return false;
+    }
+    close(start_pipe[1]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    *ms_out = bench_now_ms() - start;
+    *exit_code_out = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    *instructions_out = -1;
+    long long count = 0;
+    if (counter >= 0 && read(counter, &count, sizeof(count)) == sizeof(count))
+    {
+        *instructions_out = count;
+    }
+    if (counter >= 0)
+    {
+        close(counter);
+    }
+    return true;
+}
+
+static int bench_compare_doubles(const void* a, const void* b)
+{
+    double value_a = *(const double*)a;
+    double value_b = *(const double*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+static bool bench_build(const char* kernel_path, const char* name, int variant, char* program_out, size_t program_size)
+{
+    char object[512];
+    char cmd[2048];
+    snprintf(object, sizeof(object), "%s/%s.%i.o", BENCH_OUTPUT_DIRECTORY, name, variant);
+    snprintf(program_out, program_size, "%s/%s.%i", BENCH_OUTPUT_DIRECTORY, name, variant);
+
+    snprintf(cmd, sizeof(cmd), bench_variants[variant].build_cmd, kernel_path, object);
+    if (system(cmd) != 0)
+    {
+        return false;
+    }
+
+    const char* cc = getenv("CC");
+    snprintf(cmd, sizeof(cmd), "%s -m32 -no-pie %s -o %s", cc && *cc ? cc : "gcc", object, program_out);
+    return system(cmd) == 0;
+}
+
+static void bench_kernel(const char* kernel_path, const char* name, int repeat, struct bench_run* runs)
+{
+    double* times = calloc(repeat, sizeof(double));
+    for (int variant = 0; variant < BENCH_TOTAL_VARIANTS; variant++)
+    {
+        struct bench_run* run = &runs[variant];
+        char program[512];
+        memset(run, 0, sizeof(struct bench_run));
+        run->built = bench_build(kernel_path, name, variant, program, sizeof(program));
+        if (!run->built)
+        {
+            continue;
+        }
+
+        run->instructions = -1;
+        for (int i = 0; i < repeat; i++)
+        {
+            long long instructions = -1;
+            if (!bench_run_once(program, &times[i], &run->exit_code, &instructions))
+            {
+                run->built = false;
+                break;
+            }
+            // The same program runs the same instructions, the first count is kept
+            if (run->instructions < 0)
+            {
+                run->instructions = instructions;
+            }
+        }
+        qsort(times, repeat, sizeof(double), bench_compare_doubles);
+        run->median_ms = times[repeat / 2];
+    }
+    free(times);
+}
+
+static void bench_print_ratio(struct bench_run* run, struct bench_run* base)
+{
+    if (run->built && base->built && base->median_ms > 0)
+    {
+        printf(" %8.2fx", run->median_ms / base->median_ms);
+        return;
+    }
+    printf(" %9s", "-");
+}
+
+static int bench_compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int main(int argc, char** argv)
+{
+    int repeat = 5;
+    const char* kernels_directory = "./bench/kernels";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-repeat=", 8) == 0)
+        {
+            repeat = atoi(argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "-kernels=", 9) == 0)
+        {
+            kernels_directory = argv[i] + 9;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (repeat < 1)
+    {
+        fprintf(stderr, "-repeat has to be at least 1\n");
+        return 1;
+    }
+
+    DIR* dir = opendir(kernels_directory);
+    if (!dir)
+    {
+        fprintf(stderr, "Could not open %s\n", kernels_directory);
+        return 1;
+    }
+    char* kernels[BENCH_MAX_KERNELS];
+    int total_kernels = 0;
+    struct dirent* dirent = NULL;
+    while ((dirent = readdir(dir)) != NULL && total_kernels < BENCH_MAX_KERNELS)
+    {
+        size_t length = strlen(dirent->d_name);
+        if (length > 2 && strcmp(dirent->d_name + length - 2, ".c") == 0)
+        {
+            kernels[total_kernels++] = strndup(dirent->d_name, length - 2);
+        }
+    }
+    closedir(dir);
+    qsort(kernels, total_kernels, sizeof(char*), bench_compare_names);
+
+    if (system("mkdir -p " BENCH_OUTPUT_DIRECTORY) != 0)
+    {
+        return 1;
+    }
+
+    printf("%-16s %-16s %5s %10s %14s %9s %9s\n", "kernel", "build", "exit", "median ms", "instructions", "vs -O0", "vs -O2");
+    int res = 0;
+    for (int i = 0; i < total_kernels; i++)
+    {
+        char kernel_path[512];
+        snprintf(kernel_path, sizeof(kernel_path), "%s/%s.c", kernels_directory, kernels[i]);
+        struct bench_run runs[BENCH_TOTAL_VARIANTS];
+        bench_kernel(kernel_path, kernels[i], repeat, runs);
+
+        struct bench_run* reference = &runs[BENCH_VARIANT_GCC_O0];
+        for (int variant = 0; variant < BENCH_TOTAL_VARIANTS; variant++)
+        {
+            struct bench_run* run = &runs[variant];
+            printf("%-16s %-16s", kernels[i], bench_variants[variant].name);
+            if (!run->built)
+            {
+                printf(" failed to build or run\n");
+                continue;
+            }
+
+            printf(" %5i %10.2f", run->exit_code, run->median_ms);
+            if (run->instructions >= 0)
+            {
+                printf(" %14lld", run->instructions);
+            }
+            else
+            {
+                printf(" %14s", "-");
+            }
+            bench_print_ratio(run, &runs[BENCH_VARIANT_GCC_O0]);
+            bench_print_ratio(run, &runs[BENCH_VARIANT_GCC_O2]);
+            if (reference->built && run->exit_code != reference->exit_code)
+            {
+                printf(" WRONG");
+                res = 1;
+            }
+            printf("\n");
+        }
+        free(kernels[i]);
+    }
+    return res;
+}
@@ -0,0 +1,377 @@
+#include "compiler.h"
+#include <stdlib.h>
+
+/*
+ * Compiler throughput benchmark
+ *
+ * make bench
+ * ./build/bench_throughput [-scale=N] [-repeat=N] [-baseline=FILE] [-save-baseline=FILE] [-fail-below=RATIO] [compiler flags]
+ *
+ * Every workload is a generated program that stresses one part of the compiler, bigger with -scale. It is compiled
+ * -repeat times with compile_source and the time report, the median of every phase is printed together with how many
+ * tokens, nodes and instructions were made in a second. The speeds are compared with the ones stored in the baseline,
+ * -save-baseline writes the current ones. The baseline only means something on the machine it was saved on
+ */
+
+struct bench_workload
+{
+    const char* name;
+    // Writes a program of the given scale to out
+    void (*generate)(FILE* out, int scale);
+};
+
+struct bench_result
+{
+    struct compile_report report;
+    double total_ms;
+};
+
+struct bench_baseline
+{
+    char name[64];
+    double tokens_per_sec;
+    double nodes_per_sec;
+    double instructions_per_sec;
+};
+
+// Many small functions calling each other, every call is resolved against all of them
+static void bench_generate_functions(FILE* out, int scale)
+{
+    int total = 200 * scale;
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "int f%i(int a, int b)\n{\n    int c = a + b * %i;\n    return c - %s;\n}\n", i, i, i ? "f0(a, b)" : "a");
+    }
+    fprintf(out, "int main()\n{\n    int sum = 0;\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    sum = sum + f%i(%i, 2);\n", i, i);
+    }
+    fprintf(out, "    return sum;\n}\n");
+}
+
+// Long chains of operators with nested parentheses
+static void bench_generate_expressions(FILE* out, int scale)
+{
+    int total = 20 * scale;
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "int e%i(int a, int b, int c)\n{\n    return ", i);
+        for (int depth = 0; depth < 16; depth++)
+        {
+            fprintf(out, "(a + ");
+        }
+        for (int term = 0; term < 100; term++)
+        {
+            if (term)
+            {
+                fprintf(out, " %c ", "+-*&|^"[term % 6]);
+            }
+            fprintf(out, "%i %c b", term + 1, "+-"[term % 2]);
+        }
+        for (int depth = 0; depth < 16; depth++)
+        {
+            fprintf(out, " * c)");
+        }
+        fprintf(out, ";\n}\n");
+    }
+    fprintf(out, "int main()\n{\n    return e0(1, 2, 3);\n}\n");
+}
+
+static void bench_generate_switch(FILE* out, int scale)
+{
+    int total = 500 * scale;
+    fprintf(out, "int dispatch(int x)\n{\n    int r = 0;\n    switch (x)\n    {\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    case %i:\n        r = x * %i + %i;\n        break;\n", i * 3, i, i % 7);
+    }
+    fprintf(out, "    default:\n        r = -1;\n    }\n    return r;\n}\nint main()\n{\n    return dispatch(9);\n}\n");
+}
+
+// Every use of a global is looked up in the symbol table
+static void bench_generate_globals(FILE* out, int scale)
+{
+    int total = 1000 * scale;
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "int g%i;\n", i);
+    }
+    fprintf(out, "int main()\n{\n    int sum = 0;\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    g%i = %i;\n    sum = sum + g%i;\n", i, i, total - i - 1);
+    }
+    fprintf(out, "    return sum;\n}\n");
+}
+
+// Member access walks the members of the structure
+static void bench_generate_structs(FILE* out, int scale)
+{
+    int total = 200 * scale;
+    fprintf(out, "struct big\n{\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    int m%i;\n", i);
+    }
+    fprintf(out, "};\nstruct big b;\nint main()\n{\n    struct big* p = &b;\n    int sum = 0;\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    b.m%i = %i;\n    sum = sum + p->m%i;\n", i, i, total - i - 1);
+    }
+    fprintf(out, "    return sum;\n}\n");
+}
+
+static void bench_generate_strings(FILE* out, int scale)
+{
+    int total = 1000 * scale;
+    fprintf(out, "int printf(const char* fmt, ...);\nint main()\n{\n");
+    for (int i = 0; i < total; i++)
+    {
+        // Every fourth string is the end of another one, the string table shares them
+        if (i % 4 == 3)
+        {
+            fprintf(out, "    printf(\"entry %i\\n\");\n", i - 1);
+            continue;
+        }
+        fprintf(out, "    printf(\"message number %i of the string table\\n\");\n", i);
+    }
+    fprintf(out, "    return 0;\n}\n");
+}
+
+// Blocks inside blocks, every one of them is a scope
+static void bench_generate_nesting(FILE* out, int scale)
+{
+    int depth = 40 * scale;
+    fprintf(out, "int main()\n{\n    int x = 0;\n    int i = 0;\n");
+    for (int i = 0; i < depth; i++)
+    {
+        fprintf(out, i % 2 ? "    while (i < %i)\n    {\n        i = i + 1;\n" : "    if (x < %i)\n    {\n        x = x + 1;\n", i + 1);
+    }
+    for (int i = 0; i < depth; i++)
+    {
+        fprintf(out, "    }\n");
+    }
+    fprintf(out, "    return x + i;\n}\n");
+}
+
+// Every local is an element of the stack frame, using one searches the frame
+static void bench_generate_locals(FILE* out, int scale)
+{
+    int total = 300 * scale;
+    fprintf(out, "int main()\n{\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    int l%i = %i;\n", i, i);
+    }
+    fprintf(out, "    int sum = 0;\n");
+    for (int i = 0; i < total; i++)
+    {
+        fprintf(out, "    sum = sum + l%i;\n", total - i - 1);
+    }
+    fprintf(out, "    return sum;\n}\n");
+}
+
+static struct bench_workload bench_workloads[] = {
+    {"functions", bench_generate_functions},
+    {"expressions", bench_generate_expressions},
+    {"switch", bench_generate_switch},
+    {"globals", bench_generate_globals},
+    {"structs", bench_generate_structs},
+    {"strings", bench_generate_strings},
+    {"nesting", bench_generate_nesting},
+    {"locals", bench_generate_locals},
+};
+
+#define BENCH_TOTAL_WORKLOADS (int)(sizeof(bench_workloads) / sizeof(struct bench_workload))
+
+static int bench_compare_results(const void* a, const void* b)
+{
+    const struct bench_result* result_a = a;
+    const struct bench_result* result_b = b;
+    return (result_a->total_ms > result_b->total_ms) - (result_a->total_ms < result_b->total_ms);
+}
+
+// The median compilation, false if the program didn't compile
+static bool bench_run(struct bench_workload* workload, int scale, int repeat, int flags, struct bench_result* median)
+{
+    char* source = NULL;
+    size_t source_size = 0;
+    FILE* out = open_memstream(&source, &source_size);
+    workload->generate(out, scale);
+    fclose(out);
+
+    struct bench_result* results = calloc(repeat, sizeof(struct bench_result));
+    bool ok = true;
+    for (int i = 0; i < repeat && ok; i++)
+    {
+        struct compiler_output output;
+        ok = compile_source(source, source_size, flags | COMPILE_PROCESS_TIME_REPORT, &output) == COMPILER_FILE_COMPILED_OK;
+        if (ok)
+        {
+            results[i].report = *output.report;
+            for (int phase = 0; phase < COMPILE_TOTAL_PHASES; phase++)
+            {
+                results[i].total_ms += output.report->phases[phase].wall_ms;
+            }
+        }
+        for (int d = 0; d < output.total_diagnostics; d++)
+        {
+            fprintf(stderr, "%s: %s on line %i, col %i\n", workload->name, output.diagnostics[d].message, output.diagnostics[d].line, output.diagnostics[d].col);
+        }
+        compiler_output_free(&output);
+    }
+
+    if (ok)
+    {
+        qsort(results, repeat, sizeof(struct bench_result), bench_compare_results);
+        *median = results[repeat / 2];
+    }
+    free(results);
+    free(source);
+    return ok;
+}
+
+static double bench_per_sec(size_t count, double ms)
+{
+    return ms > 0 ? count * 1000.0 / ms : 0;
+}
+
+static int bench_load_baseline(const char* filename, struct bench_baseline* baseline)
+{
+    FILE* file = fopen(filename, "r");
+    if (!file)
+    {
+        return 0;
+    }
+
+    int total = 0;
+    char line[256];
+    while (total < BENCH_TOTAL_WORKLOADS && fgets(line, sizeof(line), file))
+    {
+        struct bench_baseline* entry = &baseline[total];
+        if (line[0] != '#' && sscanf(line, "%63s %lf %lf %lf", entry->name, &entry->tokens_per_sec, &entry->nodes_per_sec, &entry->instructions_per_sec) == 4)
+        {
+            total++;
+        }
+    }
+    fclose(file);
+    return total;
+}
+
+static struct bench_baseline* bench_find_baseline(struct bench_baseline* baseline, int total, const char* name)
+{
+    for (int i = 0; i < total; i++)
+    {
+        if (S_EQ(baseline[i].name, name))
+        {
+            return &baseline[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    int scale = 1;
+    int repeat = 5;
+    int flags = 0;
+    double fail_below = 0;
+    const char* baseline_filename = NULL;
+    const char* save_filename = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (compile_flag_parse(argv[i], &flags))
+        {
+            continue;
+        }
+        if (strncmp(argv[i], "-scale=", 7) == 0)
+        {
+            scale = atoi(argv[i] + 7);
+        }
+        else if (strncmp(argv[i], "-repeat=", 8) == 0)
+        {
+            repeat = atoi(argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "-baseline=", 10) == 0)
+        {
+            baseline_filename = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "-save-baseline=", 15) == 0)
+        {
+            save_filename = argv[i] + 15;
+        }
+        else if (strncmp(argv[i], "-fail-below=", 12) == 0)
+        {
+            fail_below = atof(argv[i] + 12);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (scale < 1 || repeat < 1)
+    {
+        fprintf(stderr, "-scale and -repeat have to be at least 1\n");
+        return 1;
+    }
+
+    struct bench_baseline baseline[BENCH_TOTAL_WORKLOADS];
+    int total_baseline = baseline_filename ? bench_load_baseline(baseline_filename, baseline) : 0;
+    FILE* save = save_filename ? fopen(save_filename, "w") : NULL;
+    if (save)
+    {
+        fprintf(save, "# workload tokens/s nodes/s instructions/s, -scale=%i\n", scale);
+    }
+
+    printf("%-12s %8s %8s %8s %9s %9s %9s %9s %9s %9s %12s %12s %12s %8s\n", "workload", "tokens", "nodes", "instrs",
+           "lex ms", "parse ms", "valid ms", "pass ms", "cgen ms", "total ms", "tokens/s", "nodes/s", "instrs/s", "vs base");
+    int res = 0;
+    for (int i = 0; i < BENCH_TOTAL_WORKLOADS; i++)
+    {
+        struct bench_workload* workload = &bench_workloads[i];
+        struct bench_result result;
+        if (!bench_run(workload, scale, repeat, flags, &result))
+        {
+            printf("%-12s failed to compile\n", workload->name);
+            res = 1;
+            continue;
+        }
+
+        struct compile_report* report = &result.report;
+        double tokens_per_sec = bench_per_sec(report->tokens, result.total_ms);
+        double nodes_per_sec = bench_per_sec(report->nodes, result.total_ms);
+        double instructions_per_sec = bench_per_sec(report->instructions, result.total_ms);
+        printf("%-12s %8zu %8zu %8zu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %12.0f %12.0f %12.0f", workload->name,
+               report->tokens, report->nodes, report->instructions,
+               report->phases[COMPILE_PHASE_LEX].wall_ms, report->phases[COMPILE_PHASE_PARSE].wall_ms,
+               report->phases[COMPILE_PHASE_VALIDATE].wall_ms, report->phases[COMPILE_PHASE_AST_PASSES].wall_ms,
+               report->phases[COMPILE_PHASE_CODEGEN].wall_ms, result.total_ms,
+               tokens_per_sec, nodes_per_sec, instructions_per_sec);
+
+        // The speed in tokens is compared, the same program always has the same tokens
+        struct bench_baseline* base = bench_find_baseline(baseline, total_baseline, workload->name);
+        if (base && base->tokens_per_sec > 0)
+        {
+            double ratio = tokens_per_sec / base->tokens_per_sec;
+            printf(" %7.2fx%s", ratio, ratio < fail_below ? " SLOWER" : "");
+            if (ratio < fail_below)
+            {
+                res = 1;
+            }
+        }
+        printf("\n");
+
+        if (save)
+        {
+            fprintf(save, "%s %.0f %.0f %.0f\n", workload->name, tokens_per_sec, nodes_per_sec, instructions_per_sec);
+        }
+    }
+
+    if (save)
+    {
+        fclose(save);
+    }
+    return res;
+}
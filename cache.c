@@ -0,0 +1,308 @@
+#include "compiler.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/*
+ * Compilation cache
+ *
+ * The output of compile_file is stored on disk, a second compilation of the same source with the same flags and the
+ * same compiler copies it instead of running any phase
+ *
+ * <cache directory>/<hash of source, flags and compiler>.cache
+ * | header | source | output |
+ *
+ * The source is kept in the entry too, a hit is only a hit if it is exactly the same, two sources with the same hash
+ * can't give each other their output. Using an entry updates its modification time, when the directory gets bigger
+ * than max_size the entries used the longest time ago are removed
+ */
+
+#define COMPILER_CACHE_MAGIC "CCCACHE1"
+
+struct compiler_cache_entry_header
+{
+    char magic[8];
+    uint32_t flags;
+    uint32_t unused;
+    uint64_t compiler_id;
+    uint64_t source_size;
+    uint64_t output_size;
+};
+
+// FNV-1a, the whole source is compared on a hit so it only has to spread the entries
+static uint64_t compiler_cache_hash(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// A new build of the compiler may generate different code, the size and the time of the executable are part of the key
+static uint64_t compiler_cache_compiler_id()
+{
+    uint64_t id = compiler_cache_hash(14695981039346656037ull, COMPILER_VERSION, strlen(COMPILER_VERSION));
+    struct stat exe;
+    if (stat("/proc/self/exe", &exe) == 0)
+    {
+        uint64_t values[] = {exe.st_size, exe.st_mtim.tv_sec, exe.st_mtim.tv_nsec};
+        id = compiler_cache_hash(id, values, sizeof(values));
+    }
+    return id;
+}
+
+static bool compiler_cache_read_file(const char* filename, char** data_out, size_t* size_out)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = malloc(size > 0 ? size : 1);
+    bool ok = size >= 0 && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok)
+    {
+        free(data);
+        return false;
+    }
+    *data_out = data;
+    *size_out = size;
+    return true;
+}
+
+static bool compiler_cache_write_file(const char* filename, const char* data, size_t size)
+{
+    FILE* file = fopen(filename, "wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool ok = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+// mkdir -p
+static void compiler_cache_create_directory(const char* directory)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s", directory);
+    for (char* c = path + 1; *c; c++)
+    {
+        if (*c == '/')
+        {
+            *c = 0;
+            mkdir(path, 0755);
+            *c = '/';
+        }
+    }
+    mkdir(path, 0755);
+}
+
+const char* compiler_cache_default_directory()
+{
+    static _Thread_local char directory[PATH_MAX];
+    const char* xdg_cache = getenv("XDG_CACHE_HOME");
+    const char* home = getenv("HOME");
+    if (xdg_cache && *xdg_cache)
+    {
+        snprintf(directory, sizeof(directory), "%s/c_compiler", xdg_cache);
+    }
+    else
+    {
+        snprintf(directory, sizeof(directory), "%s/.cache/c_compiler", home && *home ? home : "/tmp");
+    }
+    return directory;
+}
+
+// Copies the output of the entry to out_filename if the entry was made from the same source, flags and compiler
+static bool compiler_cache_lookup(const char* entry_path, struct compiler_cache_entry_header* expected, const char* source, const char* out_filename)
+{
+    char* entry = NULL;
+    size_t entry_size = 0;
+    if (!compiler_cache_read_file(entry_path, &entry, &entry_size))
+    {
+        return false;
+    }
+
+    struct compiler_cache_entry_header* header = (struct compiler_cache_entry_header*)entry;
+    bool hit = entry_size >= sizeof(struct compiler_cache_entry_header) &&
+               memcmp(header->magic, expected->magic, sizeof(header->magic)) == 0 &&
+               header->flags == expected->flags &&
+               header->compiler_id == expected->compiler_id &&
+               header->source_size == expected->source_size &&
+               entry_size == sizeof(struct compiler_cache_entry_header) + header->source_size + header->output_size &&
+               memcmp(entry + sizeof(struct compiler_cache_entry_header), source, expected->source_size) == 0;
+    if (hit)
+    {
+        const char* output = entry + sizeof(struct compiler_cache_entry_header) + header->source_size;
+        hit = compiler_cache_write_file(out_filename, output, header->output_size);
+        // Recently used, eviction goes by the modification time
+        utimensat(AT_FDCWD, entry_path, NULL, 0);
+    }
+    free(entry);
+    return hit;
+}
+
+struct compiler_cache_file
+{
+    char* path;
+    off_t size;
+    struct timespec used;
+};
+
+static int compiler_cache_compare_used(const void* a, const void* b)
+{
+    const struct compiler_cache_file* file_a = a;
+    const struct compiler_cache_file* file_b = b;
+    if (file_a->used.tv_sec != file_b->used.tv_sec)
+    {
+        return file_a->used.tv_sec < file_b->used.tv_sec ? -1 : 1;
+    }
+    return file_a->used.tv_nsec < file_b->used.tv_nsec ? -1 : file_a->used.tv_nsec > file_b->used.tv_nsec;
+}
+
+// Removes the least recently used entries until the cache fits into max_size
+static void compiler_cache_evict(struct compiler_cache* cache)
+{
+    DIR* dir = opendir(cache->directory);
+    if (!dir)
+    {
+        return;
+    }
+
+    struct compiler_cache_file* files = NULL;
+    size_t total_files = 0;
+    size_t capacity = 0;
+    off_t total_size = 0;
+    struct dirent* dirent = NULL;
+    while ((dirent = readdir(dir)) != NULL)
+    {
+        size_t length = strlen(dirent->d_name);
+        if (length < 6 || !S_EQ(dirent->d_name + length - 6, ".cache"))
+        {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, dirent->d_name);
+        struct stat st;
+        if (stat(path, &st) != 0)
+        {
+            continue;
+        }
+
+        if (total_files == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            files = realloc(files, capacity * sizeof(struct compiler_cache_file));
+        }
+        files[total_files++] = (struct compiler_cache_file){.path = strdup(path), .size = st.st_size, .used = st.st_mtim};
+        total_size += st.st_size;
+    }
+    closedir(dir);
+
+    qsort(files, total_files, sizeof(struct compiler_cache_file), compiler_cache_compare_used);
+    for (size_t i = 0; i < total_files; i++)
+    {
+        // Another compiler may have removed it already
+        if (total_size > (off_t)cache->max_size && (unlink(files[i].path) == 0 || errno == ENOENT))
+        {
+            total_size -= files[i].size;
+        }
+        free(files[i].path);
+    }
+    free(files);
+}
+
+// The entry is written to a temporary file first, a compiler reading the entry at the same time never sees half of it
+static void compiler_cache_store(struct compiler_cache* cache, const char* entry_path, struct compiler_cache_entry_header* header, const char* source, const char* out_filename)
+{
+    char* output = NULL;
+    size_t output_size = 0;
+    if (!compiler_cache_read_file(out_filename, &output, &output_size))
+    {
+        return;
+    }
+    header->output_size = output_size;
+
+    char tmp_path[PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/tmp.XXXXXX", cache->directory);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0)
+    {
+        free(output);
+        return;
+    }
+
+    FILE* file = fdopen(fd, "wb");
+    bool ok = fwrite(header, sizeof(struct compiler_cache_entry_header), 1, file) == 1 &&
+              fwrite(source, 1, header->source_size, file) == header->source_size &&
+              fwrite(output, 1, output_size, file) == output_size;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path, entry_path) != 0)
+    {
+        unlink(tmp_path);
+    }
+    free(output);
+
+    if (cache->max_size)
+    {
+        compiler_cache_evict(cache);
+    }
+}
+
+int compile_file_cached(struct compiler_cache* cache, const char* filename, const char* out_filename, int flags)
+{
+    // The IR dump and the time report have to be printed, they are only made by really compiling. The profile
+    // file isn't part of the key, the output depends on $C_COMPILER_PROFILE and what the file has in it
+    if (!cache || flags & (COMPILE_PROCESS_DUMP_IR | COMPILE_PROCESS_EXEC_JIT | COMPILE_PROCESS_TIME_REPORT | COMPILE_PROCESS_TIME_REPORT_JSON | COMPILE_PROCESS_PROFILE_GENERATE | COMPILE_PROCESS_PROFILE_USE))
+    {
+        return compile_file(filename, out_filename, flags);
+    }
+
+    char* source = NULL;
+    size_t source_size = 0;
+    if (!compiler_cache_read_file(filename, &source, &source_size))
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    // NASM isn't run by compile_file and the driver's flags only say how it runs, they don't change the output
+    struct compiler_cache_entry_header header = {
+        .magic = COMPILER_CACHE_MAGIC,
+        .flags = flags & ~(COMPILE_PROCESS_EXECUTE_NASM | COMPILE_PROCESS_NO_ECHO | COMPILE_PROCESS_THREADED),
+        .compiler_id = compiler_cache_compiler_id(),
+        .source_size = source_size
+    };
+    uint64_t key = compiler_cache_hash(14695981039346656037ull, &header, sizeof(header));
+    key = compiler_cache_hash(key, source, source_size);
+
+    compiler_cache_create_directory(cache->directory);
+    char entry_path[PATH_MAX];
+    snprintf(entry_path, sizeof(entry_path), "%s/%016llx.cache", cache->directory, (unsigned long long)key);
+
+    int res = COMPILER_FILE_COMPILED_OK;
+    if (!compiler_cache_lookup(entry_path, &header, source, out_filename))
+    {
+        res = compile_file(filename, out_filename, flags);
+        if (res == COMPILER_FILE_COMPILED_OK)
+        {
+            compiler_cache_store(cache, entry_path, &header, source, out_filename);
+        }
+    }
+    free(source);
+    return res;
+}
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "compiler.h"
+
+/*
+ * ./client takes the same arguments as ./main and sends them to the compile server (./main -fserver), the output
+ * and the exit code are the ones ./main would give. When there is no server or it can't do the request ./main,
+ * next to ./client, is run instead
+ */
+
+// The cwd and the arguments only go to a server run by the same user, anyone can create a socket at the path in /tmp
+static bool client_server_trusted(int fd)
+{
+    struct ucred credentials;
+    socklen_t size = sizeof(credentials);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == getuid();
+}
+
+static int client_connect(const char* socket_path)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || !client_server_trusted(fd)))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static bool client_write_all(int fd, const void* data, size_t size)
+{
+    const char* ptr = data;
+    while (size)
+    {
+        // A server that refuses the client closes the connection, the write fails instead of raising SIGPIPE
+        ssize_t res = send(fd, ptr, size, MSG_NOSIGNAL);
+        if (res < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            return false;
+        }
+        ptr += res;
+        size -= res;
+    }
+    return true;
+}
+
+static bool client_read_all(int fd, void* data, size_t size)
+{
+    char* ptr = data;
+    while (size)
+    {
+        ssize_t res = read(fd, ptr, size);
+        if (res < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            return false;
+        }
+        ptr += res;
+        size -= res;
+    }
+    return true;
+}
+
+// Copies size bytes of the response to out
+static bool client_forward(int fd, FILE* out, uint32_t size)
+{
+    char data[4096];
+    while (size)
+    {
+        uint32_t chunk = size < sizeof(data) ? size : sizeof(data);
+        if (!client_read_all(fd, data, chunk))
+        {
+            return false;
+        }
+        fwrite(data, 1, chunk, out);
+        size -= chunk;
+    }
+    return true;
+}
+
+// Sends the request, false if there was no usable response
+static bool client_send(int fd, int argc, char** argv, struct compile_server_response* response)
+{
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd)))
+    {
+        return false;
+    }
+
+    struct compile_server_request request = {.argc = argc - 1, .size = strlen(cwd) + 1};
+    for (int i = 1; i < argc; i++)
+    {
+        request.size += strlen(argv[i]) + 1;
+    }
+
+    bool ok = client_write_all(fd, &request, sizeof(request)) && client_write_all(fd, cwd, strlen(cwd) + 1);
+    for (int i = 1; i < argc && ok; i++)
+    {
+        ok = client_write_all(fd, argv[i], strlen(argv[i]) + 1);
+    }
+    return ok && client_read_all(fd, response, sizeof(*response));
+}
+
+// Runs ./main from the directory of ./client with the same arguments
+static int client_run_locally(char** argv)
+{
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length < 0)
+    {
+        length = 0;
+    }
+    path[length] = 0;
+    char* slash = strrchr(path, '/');
+    if (slash)
+    {
+        strcpy(slash + 1, "main");
+    }
+    else
+    {
+        strcpy(path, "./main");
+    }
+
+    argv[0] = path;
+    execv(path, argv);
+    fprintf(stderr, "Could not run %s\n", path);
+    return -1;
+}
+
+int main(int argc, char** argv)
+{
+    int fd = client_connect(compile_server_default_socket());
+    if (fd < 0)
+    {
+        return client_run_locally(argv);
+    }
+
+    struct compile_server_response response;
+    if (!client_send(fd, argc, argv, &response) || response.run_locally)
+    {
+        close(fd);
+        return client_run_locally(argv);
+    }
+
+    client_forward(fd, stdout, response.stdout_size);
+    client_forward(fd, stderr, response.stderr_size);
+    close(fd);
+    return response.exit_code;
+}
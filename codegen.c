@@ -2,12 +2,11 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include "helpers/vector.h"
-#include <assert.h>
 
 #define STRUCTURE_PUSH_START_POSITION_ONE 1
 
-static struct compiler_process* current_process = NULL;
-static struct node* current_function = NULL;
+// The file this thread is generating code for, the state of the generator is in current_process->generator
+static _Thread_local struct compiler_process* current_process = NULL;
 int codegen_remove_uninheritable_flags(int flags);
 void codegen_stack_add_no_compile_time_stack_frame_restore(size_t stack_size);
 void asm_pop_ebp_no_stack_frame_restore();
@@ -23,8 +22,21 @@ void asm_push_args(const char *ins, va_list args)
 {
 	va_list args2;
 	va_copy(args2, args);
-	vfprintf(stdout, ins, args);
-	fprintf(stdout, "\n");
+	COMPILE_REPORT_COUNT(instructions);
+	// A block that rarely runs is written after the function, see codegen_begin_cold_block
+	if (current_process->generator->in_cold_block)
+	{
+		vfprintf(current_process->generator->cold_blocks, ins, args);
+		fprintf(current_process->generator->cold_blocks, "\n");
+		va_end(args2);
+		return;
+	}
+	// With exec-jit stdout belongs to the program being run, the library API and the driver don't print anything
+	if (!(current_process->flags & (COMPILE_PROCESS_EXEC_JIT | COMPILE_PROCESS_LIBRARY | COMPILE_PROCESS_NO_ECHO)))
+	{
+		vfprintf(stdout, ins, args);
+		fprintf(stdout, "\n");
+	}
 	if (current_process->ofile)
 	{
 		vfprintf(current_process->ofile, ins, args2);
@@ -56,6 +68,7 @@ void codegen_generate_body(struct node* node, struct history* history);;
 void codegen_generate_structure_push(struct resolver_entity* entity, struct history* history, int start_pos);
 bool codegen_resolve_node_for_value(struct node* node, struct history* history);
 void codegen_generate_expressionable(struct node* node, struct history* history);
+void codegen_generate_move_struct(struct datatype* dtype, const char* base_address,int offset);
 void codegen_plus_or_minus_string_for_value(char* out, int val, size_t len);
 void codegen_generate_exp_node(struct node* node, struct history*history);
 const char*codegen_sub_register(const char* original_register, size_t size);
@@ -91,7 +104,7 @@ struct response
 void codegen_response_expect()
 {
     // Whenever someone expects a response, first we put an empty response to the stack
-    struct response* res = calloc(1,sizeof (struct response));
+    struct response* res = arena_calloc(1,sizeof (struct response));
     vector_push(current_process->generator->responses,&res);
 }
 
@@ -138,14 +151,14 @@ bool codegen_response_has_entity(struct response* res)
 
 static struct history* history_begin(int flags)
 {
-    struct history* history = calloc(1,sizeof(history));
+    struct history* history = arena_calloc(1,sizeof(struct history));
     history->flags = flags;
     return history;
 }
 
 static struct history* history_down(struct history* history, int flags)
 {
-    struct history* new_history = calloc(1,sizeof(struct history));
+    struct history* new_history = arena_calloc(1,sizeof(struct history));
     memcpy(new_history,history,sizeof(struct history));
     new_history->flags = flags;
 
@@ -179,7 +192,7 @@ struct node* codegen_node_next()
 int asm_push_ins_pop_or_ignore(const char* fmt, int expecting_stack_entity_type,const char* expecting_stack_entity_name,...)
 {
 	// Pop the entity with the given type and name or return ELEMENT_NOT_FOUND if the element doesn't exist
-	if (!stackframe_back_expect(current_function,expecting_stack_entity_type,expecting_stack_entity_name))
+	if (!stackframe_back_expect(current_process->generator->current_function,expecting_stack_entity_type,expecting_stack_entity_name))
 	{
 		return STACK_FRAME_ELEMENT_FLAG_ELEMENT_NOT_FOUND;
 	}
@@ -189,9 +202,9 @@ int asm_push_ins_pop_or_ignore(const char* fmt, int expecting_stack_entity_type,
 	va_start(args,expecting_stack_entity_name);
 	asm_push_args(tmp_buf,args);
 	va_end(args);
-	struct stack_frame_element* element = stackframe_back(current_function);
+	struct stack_frame_element* element = stackframe_back(current_process->generator->current_function);
 	int flags = element->flags;
-	stackframe_pop_expecting(current_function,expecting_stack_entity_type,expecting_stack_entity_name);
+	stackframe_pop_expecting(current_process->generator->current_function,expecting_stack_entity_type,expecting_stack_entity_name);
 	return flags;
 }
 
@@ -205,8 +218,8 @@ void asm_push_ins_push_with_data(const char* fmt, int stack_entity_type, const c
     va_end(args);
     flags |= STACK_FRAME_ELEMENT_FLAG_HAS_DATATYPE;
     // Assert that we are in a function, because we work with stack and that's only possible in a  function
-    assert(current_function);
-    stackframe_push(current_function,&(struct stack_frame_element){.type=stack_entity_type,.name=stack_entity_name,.flags=flags,.data=*data});
+    compiler_assert(current_process->generator->current_function);
+    stackframe_push(current_process->generator->current_function,&(struct stack_frame_element){.type=stack_entity_type,.name=stack_entity_name,.flags=flags,.data=*data});
 }
 
 void asm_push_ins_push_with_flags(const char* fmt, int stack_entity_type, const char*stack_entity_name, int flags,...)
@@ -217,8 +230,8 @@ void asm_push_ins_push_with_flags(const char* fmt, int stack_entity_type, const
     va_start(args,flags);
     asm_push_args(tmp_buff,args);
     va_end(args);
-    assert(current_function);
-    stackframe_push(current_function,&(struct stack_frame_element){.flags = flags,.type = stack_entity_type,.name = stack_entity_name});
+    compiler_assert(current_process->generator->current_function);
+    stackframe_push(current_process->generator->current_function,&(struct stack_frame_element){.flags = flags,.type = stack_entity_type,.name = stack_entity_name});
 }
 
 void asm_push(const char* ins, ...)
@@ -232,9 +245,19 @@ void asm_push(const char* ins, ...)
 void asm_push_no_nl(const char* ins,...)
 {
     va_list args;
-    va_start(args,ins);
-    vfprintf(stdout,ins,args);
-    va_end(args);
+    if (current_process->generator->in_cold_block)
+    {
+        va_start(args,ins);
+        vfprintf(current_process->generator->cold_blocks,ins,args);
+        va_end(args);
+        return;
+    }
+    if (!(current_process->flags & (COMPILE_PROCESS_EXEC_JIT | COMPILE_PROCESS_LIBRARY | COMPILE_PROCESS_NO_ECHO)))
+    {
+        va_start(args,ins);
+        vfprintf(stdout,ins,args);
+        va_end(args);
+    }
     if (current_process->ofile)
     {
         va_list args;
@@ -252,8 +275,8 @@ void asm_push_ins_push(const char* fmt, int stack_entity_type, const char* stack
     va_start(args,stack_entity_name);
     asm_push_args(tmp_buff,args);
     va_end(args);
-    assert(current_function);
-    stackframe_push(current_function,&(struct stack_frame_element){.type = stack_entity_type,.name=stack_entity_name});
+    compiler_assert(current_process->generator->current_function);
+    stackframe_push(current_process->generator->current_function,&(struct stack_frame_element){.type = stack_entity_type,.name=stack_entity_name});
 }
 
 int asm_push_ins_pop(const char* fmt, int expecting_stack_entity_type, const char* expecting_stack_entity_name,...)
@@ -265,10 +288,10 @@ int asm_push_ins_pop(const char* fmt, int expecting_stack_entity_type, const cha
     asm_push_args(tmp_buff,args);
     va_end(args);
     // Make sure we are in a function because we only use the stack in functions
-    assert(current_function);
-    struct stack_frame_element* element = stackframe_back(current_function);
+    compiler_assert(current_process->generator->current_function);
+    struct stack_frame_element* element = stackframe_back(current_process->generator->current_function);
     int flags = element->flags;
-    stackframe_pop_expecting(current_function,expecting_stack_entity_type,expecting_stack_entity_name);
+    stackframe_pop_expecting(current_process->generator->current_function,expecting_stack_entity_type,expecting_stack_entity_name);
     return flags;
 }
 
@@ -287,7 +310,7 @@ void codegen_data_section_add(const char* data, ...)
 {
 	va_list args;
 	va_start(args,data);
-	char* new_data = malloc(256);
+	char* new_data = arena_malloc(256);
 	vsprintf(new_data,data,args);
 
 	vector_push(current_process->generator->custom_data_sections,&new_data);
@@ -298,7 +321,7 @@ void codegen_stack_sub_with_name(size_t stack_size, const char*name)
 {
     if (stack_size != 0)
     {
-        stackframe_sub(current_function,STACK_FRAME_ELEMENT_TYPE_UNKNOWN,name,stack_size);
+        stackframe_sub(current_process->generator->current_function,STACK_FRAME_ELEMENT_TYPE_UNKNOWN,name,stack_size);
         asm_push("sub esp, %lld",stack_size);
     }
 }
@@ -317,7 +340,7 @@ void codegen_stack_add_with_name(size_t stack_size, const char* name)
 {
     if (stack_size != 0)
     {
-        stackframe_add(current_function,STACK_FRAME_ELEMENT_TYPE_UNKNOWN,name,stack_size);
+        stackframe_add(current_process->generator->current_function,STACK_FRAME_ELEMENT_TYPE_UNKNOWN,name,stack_size);
         asm_push("add esp, %lld",stack_size);
     }
 }
@@ -328,12 +351,23 @@ void codegen_stack_add(size_t stack_size)
 }
 
 
+// FNV-1a, good enough to spread the string literals over the buckets
+static unsigned int codegen_string_hash(const char* str)
+{
+    unsigned int hash = 2166136261u;
+    for (const char* c = str; *c; c++)
+    {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    return hash % CODEGEN_STRING_TABLE_BUCKETS;
+}
+
 const char* codegen_get_label_for_string(const char* str)
 {
     const char* result = NULL;
     struct code_generator* generator = current_process->generator;
-    vector_set_peek_pointer(generator->string_table,0);
-    struct string_table_element* current = vector_peek_ptr(generator->string_table);
+    struct string_table_element* current = generator->string_buckets[codegen_string_hash(str)];
     while (current)
     {
         if (S_EQ(current->str,str))
@@ -341,9 +375,9 @@ const char* codegen_get_label_for_string(const char* str)
             result = current->label;
             break;
         }
-        current = vector_peek_ptr(generator->string_table);
+        current = current->next_in_bucket;
     }
-
+    return result;
 }
 
 const char* codegen_register_string(const char* str)
@@ -354,29 +388,42 @@ const char* codegen_register_string(const char* str)
         // We already registered this string, just return the label pointing to the string memory
         return label;
     }
-    struct string_table_element* str_elem = calloc(1, sizeof(struct string_table_element));
-    int label_id = codegen_label_count();
-    sprintf((char*)str_elem->label, "str_%i", label_id);
+    char new_label[50];
+    sprintf(new_label, "str_%s%i", current_process->generator->label_namespace, codegen_label_count());
+    return codegen_register_string_with_label(str, new_label);
+}
+
+const char* codegen_register_string_with_label(const char* str, const char* label)
+{
+    struct string_table_element* str_elem = arena_calloc(1, sizeof(struct string_table_element));
+    strncpy((char*)str_elem->label, label, sizeof(str_elem->label) - 1);
     str_elem->str = str;
     vector_push(current_process->generator->string_table,&str_elem);
+
+    struct string_table_element** bucket = &current_process->generator->string_buckets[codegen_string_hash(str)];
+    str_elem->next_in_bucket = *bucket;
+    *bucket = str_elem;
     return str_elem->label;
 }
 struct code_generator* codegenerator_new(struct compiler_process* process)
 {
-    struct code_generator* generator = calloc(1, sizeof(struct code_generator));
+    struct code_generator* generator = arena_calloc(1, sizeof(struct code_generator));
     generator->string_table = vector_create(sizeof(struct string_table_element*));
+    generator->string_buckets = arena_calloc(CODEGEN_STRING_TABLE_BUCKETS, sizeof(struct string_table_element*));
     generator->entry_points = vector_create(sizeof(struct codegen_entry_point*));
     generator->exit_points = vector_create(sizeof(struct codegen_exit_point*));
     generator->responses = vector_create(sizeof(struct response*));
 	generator->_switch.switches = vector_create(sizeof(struct generator_switch_stmt_entity));
 	generator->custom_data_sections = vector_create(sizeof(const char*));
+    generator->label_namespace = "";
+    generator->profile_sites = vector_create(sizeof(struct profile_site));
     return generator;
 }
 
 void codegen_register_exit_point(int exit_point_id)
 {
     struct code_generator* gen = current_process->generator;
-    struct codegen_exit_point* exit_point = calloc(1, sizeof(struct codegen_exit_point));
+    struct codegen_exit_point* exit_point = arena_calloc(1, sizeof(struct codegen_exit_point));
     exit_point->id = exit_point_id;
     vector_push(gen->exit_points,&exit_point);
 }
@@ -389,9 +436,7 @@ struct codegen_exit_point* codegen_current_exit_point()
 
 int codegen_label_count()
 {
-    static int count = 0;
-    count++;
-    return count;
+    return ++current_process->generator->label_count;
 }
 
 void codegen_begin_exit_point()
@@ -404,9 +449,9 @@ void codegen_end_exit_point()
 {
     struct code_generator*gen = current_process->generator;
     struct codegen_exit_point* exit_point = codegen_current_exit_point();
-    assert(exit_point);
+    compiler_assert(exit_point);
     asm_push(".exit_point_%i:",exit_point->id);
-    free(exit_point);
+    arena_free(exit_point);
     // Pops off the most recent exit point so the second latest can be worked with
     vector_pop(gen->exit_points);
 }
@@ -424,13 +469,17 @@ void codegen_goto_exit_point(struct node* node)
 {
     struct code_generator* gen = current_process->generator;
     struct codegen_exit_point* exit_point = codegen_current_exit_point();
+    if (!exit_point)
+    {
+        compiler_node_error(current_process, node, "break isn't inside a loop or a switch");
+    }
     asm_push("jmp .exit_point_%i",exit_point->id);
 }
 
 void codegen_register_entry_point(int entry_point_id)
 {
     struct code_generator* gen = current_process->generator;
-    struct codegen_entry_point* entry_point = calloc(1, sizeof(struct codegen_entry_point));
+    struct codegen_entry_point* entry_point = arena_calloc(1, sizeof(struct codegen_entry_point));
     entry_point->id = entry_point_id;
     vector_push(gen->entry_points,&entry_point);
 
@@ -453,8 +502,8 @@ void codegen_end_entry_point()
 {
     struct code_generator*gen = current_process->generator;
     struct codegen_entry_point* entry_point = codegen_current_entry_point();
-    assert(entry_point);
-    free(entry_point);
+    compiler_assert(entry_point);
+    arena_free(entry_point);
     vector_pop(gen->entry_points);
 }
 
@@ -463,6 +512,10 @@ void codegen_goto_entry_point(struct node* current_node)
 {
     struct code_generator* gen = current_process->generator;
     struct codegen_entry_point* entry_point = codegen_current_entry_point();
+    if (!entry_point)
+    {
+        compiler_node_error(current_process, current_node, "continue isn't inside a loop");
+    }
     asm_push("jmp .entry_point_%i",entry_point->id);
 }
 
@@ -540,7 +593,7 @@ static const char* asm_keyword_for_size(size_t size, char*tmp_buff)
             break;
         default:
             // means size * db
-            sprintf(tmp_buff, "times %lld db",(unsigned long)size);
+            sprintf(tmp_buff, "times %lu db",(unsigned long)size);
             return tmp_buff;
     }
 
@@ -548,10 +601,195 @@ static const char* asm_keyword_for_size(size_t size, char*tmp_buff)
     return tmp_buff;
 }
 
+// A new section directive is only pushed when the section of the global variable changes
+static void codegen_switch_data_section(const char* section)
+{
+    if (current_process->generator->current_data_section && S_EQ(current_process->generator->current_data_section, section))
+    {
+        return;
+    }
+    asm_push("section %s", section);
+    current_process->generator->current_data_section = section;
+}
+
+static void codegen_find_non_zero_element(struct node* value_node, struct datatype* dtype, int offset, void* private)
+{
+    bool* non_zero = private;
+    if (value_node->type != NODE_TYPE_NUMBER || value_node->llnum != 0)
+    {
+        *non_zero = true;
+    }
+}
+
+static bool codegen_global_variable_is_zero(struct node* node)
+{
+    if (!node->var.val)
+    {
+        // Global variables without a value are zero in C
+        return true;
+    }
+    if (node->var.val->type == NODE_TYPE_INITIALIZER_LIST)
+    {
+        // int table[100] = {0}; can still go to .bss
+        bool non_zero = false;
+        initializer_for_each_element(current_process,&node->var.type,node->var.val,codegen_find_non_zero_element,&non_zero);
+        return !non_zero;
+    }
+    return node->var.val->type == NODE_TYPE_NUMBER && node->var.val->llnum == 0;
+}
+
+/*
+ * const int x = 5;     -> .rodata, the program can't change it
+ * int y = 5;           -> .data
+ * int z; int table[N]; -> .bss, only the size is stored in the object file, the loader maps zero pages for it
+ */
+static const char* codegen_section_for_global_variable(struct node* node)
+{
+    // const char* is a pointer to const data, the pointer itself can still change
+    bool is_const = (node->var.type.flags & DATATYPE_FLAG_IS_CONST) && !(node->var.type.flags & DATATYPE_FLAG_IS_POINTER);
+    if (is_const)
+    {
+        return ".rodata";
+    }
+
+    if (codegen_global_variable_is_zero(node))
+    {
+        return ".bss";
+    }
+    return ".data";
+}
+
+// Generate RESB RESD etc. depending on the size of the variable, for the .bss section
+static const char* asm_reserve_keyword_for_size(size_t size, char* tmp_buff)
+{
+    switch (size) {
+        case DATA_SIZE_BYTE:
+            strcpy(tmp_buff, "resb 1");
+            break;
+        case DATA_SIZE_WORD:
+            strcpy(tmp_buff, "resw 1");
+            break;
+        case DATA_SIZE_DWORD:
+            strcpy(tmp_buff, "resd 1");
+            break;
+        default:
+            sprintf(tmp_buff, "resb %llu", (unsigned long long)size);
+            break;
+    }
+    return tmp_buff;
+}
+
+// A variable that is all zero, in .bss only the space is reserved
+static void codegen_generate_global_variable_zero(struct node* node)
+{
+    char tmp_buff[256];
+    if (S_EQ(current_process->generator->current_data_section, ".bss"))
+    {
+        asm_push("%s: %s", node->var.name, asm_reserve_keyword_for_size(variable_size(node), tmp_buff));
+        return;
+    }
+    asm_push("%s: %s 0", node->var.name, asm_keyword_for_size(variable_size(node),tmp_buff));
+}
+
+/*
+ * The bytes of a global variable with an initializer list, built at compile time
+ *
+ * int table[4] = {1, 2};   ->   table:
+ *                               db 1,0,0,0,2,0,0,0,0,0,0,0,0,0,0,0
+ */
+struct codegen_global_data
+{
+    struct node* var_node;
+    unsigned char* bytes;
+    // The label whose address is stored at an offset i.e. char* names[] = {"a", "b"}, NULL if there is none
+    const char** labels;
+};
+
+static void codegen_global_data_element(struct node* value_node, struct datatype* dtype, int offset, void* private)
+{
+    struct codegen_global_data* data = private;
+    if (value_node->type == NODE_TYPE_STRING && dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        // char name[8] = "abc"
+        memcpy(data->bytes + offset, value_node->sval, initializer_string_length(value_node,dtype));
+        return;
+    }
+
+    if (value_node->type == NODE_TYPE_STRING)
+    {
+        data->labels[offset] = codegen_register_string(value_node->sval);
+        return;
+    }
+
+    if (value_node->type != NODE_TYPE_NUMBER)
+    {
+        compiler_error(current_process,"The initializer of the global variable %s has to be constant",data->var_node->var.name);
+    }
+
+    // Little endian, the lowest byte comes first
+    unsigned long long value = value_node->llnum;
+    for (size_t i = 0; i < datatype_size(dtype); i++)
+    {
+        data->bytes[offset + i] = value >> (i * 8);
+    }
+}
+
+// Zeros are written with times so big tables with a few values don't blow up the output
+#define CODEGEN_GLOBAL_DATA_BYTES_PER_LINE 16
+
+static void codegen_generate_global_variable_data(struct node* node)
+{
+    size_t size = variable_size(node);
+    struct codegen_global_data data = {.var_node = node,.bytes = arena_calloc(size ? size : 1,1),.labels = arena_calloc(size ? size : 1,sizeof(const char*))};
+    initializer_for_each_element(current_process,&node->var.type,node->var.val,codegen_global_data_element,&data);
+
+    char tmp_buff[256];
+    asm_push("%s:",node->var.name);
+    size_t offset = 0;
+    while (offset < size)
+    {
+        if (data.labels[offset])
+        {
+            asm_push("%s %s",asm_keyword_for_size(datatype_pointer_size(),tmp_buff),data.labels[offset]);
+            offset += datatype_pointer_size();
+            continue;
+        }
+
+        size_t zeros = 0;
+        while (offset + zeros < size && !data.bytes[offset + zeros] && !data.labels[offset + zeros])
+        {
+            zeros++;
+        }
+        if (zeros >= CODEGEN_GLOBAL_DATA_BYTES_PER_LINE || offset + zeros == size)
+        {
+            asm_push("times %llu db 0",(unsigned long long)zeros);
+            offset += zeros;
+            continue;
+        }
+
+        // db 1,0,0,0,2,0,0,0 until the line is full or a label comes
+        char line[CODEGEN_GLOBAL_DATA_BYTES_PER_LINE * 5 + 8] = "db ";
+        for (int i = 0; i < CODEGEN_GLOBAL_DATA_BYTES_PER_LINE && offset < size && !data.labels[offset]; i++, offset++)
+        {
+            sprintf(line + strlen(line),i ? ",%i" : "%i",data.bytes[offset]);
+        }
+        asm_push("%s",line);
+    }
+
+    arena_free(data.bytes);
+    arena_free(data.labels);
+}
+
 void codegen_generate_global_Variable_for_primitive(struct node* node)
 {
     char tmp_buff[256];
-    if (node->var.val != NULL)
+    if (node->var.val != NULL && node->var.val->type == NODE_TYPE_INITIALIZER_LIST && !codegen_global_variable_is_zero(node))
+    {
+        // int x = {5};
+        codegen_generate_global_variable_data(node);
+        return;
+    }
+    if (node->var.val != NULL && !codegen_global_variable_is_zero(node))
     {
         // Handle the value
         if (node->var.val->type == NODE_TYPE_STRING)
@@ -566,45 +804,45 @@ void codegen_generate_global_Variable_for_primitive(struct node* node)
         }
         return;
     }
-    asm_push("%s: %s 0", node->var.name, asm_keyword_for_size(variable_size((node)),tmp_buff));
+    codegen_generate_global_variable_zero(node);
 }
 
-void codegen_generate_global_variable_for_struct(struct node* node)
+// Structures, unions and arrays can only get their value from a brace initializer (or a string for char arrays)
+static void codegen_generate_global_variable_for_aggregate(struct node* node)
 {
-    if (node->var.val != NULL)
+    if (codegen_global_variable_is_zero(node))
     {
-        compiler_error(current_process,"We don't yet support values for structures!");
+        codegen_generate_global_variable_zero(node);
         return;
     }
-    char tmp_buff[256];
-    asm_push("%s: %s 0",node->var.name, asm_keyword_for_size(variable_size(node),tmp_buff));
+
+    bool is_string_for_char_array = node->var.val->type == NODE_TYPE_STRING && node->var.type.flags & DATATYPE_FLAG_IS_ARRAY;
+    if (node->var.val->type != NODE_TYPE_INITIALIZER_LIST && !is_string_for_char_array)
+    {
+        compiler_error(current_process,"The global variable %s has to be initialized with an initializer list",node->var.name);
+    }
+    codegen_generate_global_variable_data(node);
+}
+
+void codegen_generate_global_variable_for_struct(struct node* node)
+{
+    codegen_generate_global_variable_for_aggregate(node);
 }
 
 void codegen_generate_global_variable_for_union(struct node* node)
 {
-	if (node->var.val != NULL)
-	{
-		compiler_error(current_process,"We don't yet support values for unions!");
-		return;
-	}
-	char tmp_buff[256];
-	asm_push("%s: %s 0",node->var.name, asm_keyword_for_size(variable_size(node),tmp_buff));
+	codegen_generate_global_variable_for_aggregate(node);
 }
 
 void codegen_generate_global_variable_for_array(struct node* node)
 {
-	if (node->var.val != NULL)
-	{
-		compiler_error(current_process,"We don't support values for arrays yet!");
-		return;
-	}
-	char tmp_buff[256];
-	asm_push("%s: %s 0", node->var.name, asm_keyword_for_size(variable_size(node),tmp_buff));
+	codegen_generate_global_variable_for_aggregate(node);
 }
 
 
 void codegen_generate_global_variable(struct node* node )
 {
+    codegen_switch_data_section(codegen_section_for_global_variable(node));
     // ; TYPE_NAME VARIABLE_NAME
     asm_push("; %s %s",node->var.type.type_str, node->var.name);
 	
@@ -636,7 +874,7 @@ void codegen_generate_global_variable(struct node* node )
             compiler_error(current_process,"Doubles and floats are not supported in this compiler!");
             break;
     }
-	assert(node->type == NODE_TYPE_VARIABLE);
+	compiler_assert(node->type == NODE_TYPE_VARIABLE);
 	codegen_new_scope_entity(node,0,0);
 	
 }
@@ -665,7 +903,7 @@ void codegen_generate_union(struct node* node)
 
 void codegen_generate_global_variable_list(struct node* var_list_node)
 {
-	assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
+	compiler_assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
 	vector_set_peek_pointer(var_list_node->var_list.list,0);
 	struct node* var_node = vector_peek_ptr(var_list_node->var_list.list);
 	while (var_node)
@@ -696,7 +934,8 @@ void codegen_generate_data_section_part(struct node* node)
 
 void codegen_generate_data_section()
 {
-    asm_push("section .data");
+    current_process->generator->current_data_section = NULL;
+    codegen_switch_data_section(".data");
     // This loop only processes the root nodes, but leaves the children alone
     struct node* node = codegen_node_next();
     while (node)
@@ -781,7 +1020,13 @@ void codegen_gen_mem_access(struct node* node, int flags, struct resolver_entity
         codegen_gen_mem_access_get_address(node,flags,entity);
         return;
     }
-    if (datatype_is_struct_or_union_non_pointer(&entity->dtype))
+    if (entity->dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        // char abc[50]; char* p = abc; -> the array is used as a pointer to its first element, not its first element
+        asm_push("lea ebx, [%s]", codegen_entity_private(entity)->address);
+        asm_push_ins_push_with_data("ebx",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value",0,&(struct stack_frame_data){.dtype = entity->dtype});
+    }
+    else if (datatype_is_struct_or_union_non_pointer(&entity->dtype))
     {
         codegen_gen_mem_access_get_address(node,0,entity);
         asm_push_ins_pop("ebx",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
@@ -817,7 +1062,7 @@ void codegen_generate_variable_access(struct node* node, struct resolver_entity*
 void codegen_generate_indentifier(struct node *node, struct history *history)
         {
     struct resolver_result* result = resolver_follow(current_process->resolver,node);
-            assert(resolver_result_ok(result));
+            compiler_assert(resolver_result_ok(result));
             struct resolver_entity* entity = resolver_result_entity(result);
             codegen_generate_variable_access(node,entity,history);
             codegen_response_acknowledge(&(struct response){.flags=RESPONSE_FLAG_RESOLVED_ENTITY,.data.resolved_entity=entity});
@@ -837,9 +1082,9 @@ void codegen_generate_unary_indirection(struct node* node, struct history* histo
     codegen_response_expect();
     codegen_generate_expressionable(node->unary.operand, history_down(history,flags | EXPRESSION_GET_ADDRESS | EXPRESSION_INDIRECTION));
     struct response* res = codegen_response_pull();
-    assert(codegen_response_has_entity(res));
+    compiler_assert(codegen_response_has_entity(res));
     struct datatype operand_datatype;
-    assert(asm_datatype_back(&operand_datatype));
+    compiler_assert(asm_datatype_back(&operand_datatype));
     asm_push_ins_pop(reg_to_use,STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
     int depth = node->unary.indirection.depth;
     int real_depth = depth;
@@ -865,7 +1110,7 @@ void codegen_generate_normal_unary(struct node *node, struct history *history)
 {
     codegen_generate_expressionable(node->unary.operand,history);
     struct datatype last_dtype;
-    assert(asm_datatype_back(&last_dtype));
+    compiler_assert(asm_datatype_back(&last_dtype));
     asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
     if (S_EQ(node->unary.op,"-"))
     {
@@ -965,7 +1210,7 @@ void codegen_generate_tenary(struct node* node,struct history*history)
 	int false_label_id = codegen_label_count();
 	int tenary_end_label_id = codegen_label_count();
 	struct datatype last_dtype;
-	assert(asm_datatype_back(&last_dtype));
+	compiler_assert(asm_datatype_back(&last_dtype));
 	
 	// 50 ? 20 : 10; -> 50 already been process so we pop it off
 	asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
@@ -1136,7 +1381,7 @@ const char*codegen_byte_word_or_dword_or_ddword(size_t size, const char** reg_to
 
 void codegen_generate_assignment_instruction_for_operator(const char* mov_type_keyword,const char* address,const char* reg_to_use,const char* op,bool is_signed)
 {
-	assert(reg_to_use != "ecx");
+	compiler_assert(reg_to_use != "ecx");
     if (S_EQ(op,"="))
     {
         asm_push("mov %s [%s], %s",mov_type_keyword,address,reg_to_use);
@@ -1197,9 +1442,64 @@ void codegen_generate_assignment_instruction_for_operator(const char* mov_type_k
 	}
 }
 
+static void codegen_generate_scope_variable_initializer_element(struct node* value_node, struct datatype* dtype, int offset, void* private)
+{
+    const char* address = private;
+    char offset_fmt[16];
+    if (value_node->type == NODE_TYPE_STRING && dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        // char name[8] = "abc" -> every character is stored on its own
+        size_t length = initializer_string_length(value_node,dtype);
+        for (size_t i = 0; i < length; i++)
+        {
+            codegen_plus_or_minus_string_for_value(offset_fmt,offset + i,sizeof(offset_fmt));
+            asm_push("mov byte [%s%s], %i",address,offset_fmt,(unsigned char)value_node->sval[i]);
+        }
+        return;
+    }
+
+    codegen_generate_expressionable(value_node, history_begin(EXPRESSION_IS_ASSIGNMENT | IS_RIGHT_OPERAND_OF_ASSIGNMENT));
+    if (datatype_is_struct_or_union_non_pointer(dtype))
+    {
+        // struct point points[2] = {p1, p2}; -> the structure was pushed
+        codegen_generate_move_struct(dtype,address,offset);
+        return;
+    }
+
+    asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+    const char* reg_to_use = "eax";
+    const char* move_type = codegen_byte_word_or_dword_or_ddword(datatype_element_size(dtype),&reg_to_use);
+    char element_address[64];
+    codegen_plus_or_minus_string_for_value(offset_fmt,offset,sizeof(offset_fmt));
+    sprintf(element_address,"%s%s",address,offset_fmt);
+    codegen_generate_assignment_instruction_for_operator(move_type,element_address,reg_to_use,"=",dtype->flags & DATATYPE_FLAG_IS_SIGNED);
+}
+
+/*
+ * int table[64] = {1, 2, 3};
+ *
+ * The variable is zeroed first unless the initializer gives a value to every byte of it,
+ * then only the elements that have a value are stored
+ */
+static void codegen_generate_scope_variable_initializer(struct node* node, struct resolver_entity* entity)
+{
+    const char* address = codegen_entity_private(entity)->address;
+    if (!initializer_covers_variable(current_process,&node->var.type,node->var.val))
+    {
+        codegen_generate_zero_fill(address,0,variable_size(node));
+    }
+    initializer_for_each_element(current_process,&node->var.type,node->var.val,codegen_generate_scope_variable_initializer_element,(void*)address);
+}
+
 void codegen_generate_scope_variable(struct node* node)
 {
     struct resolver_entity*entity = codegen_new_scope_entity(node,node->var.aoffset,RESOLVER_DEFAULT_ENTITY_FLAG_IS_LOCAL_STACK);
+    if (node->var.val && (node->var.val->type == NODE_TYPE_INITIALIZER_LIST || node->var.type.flags & DATATYPE_FLAG_IS_ARRAY))
+    {
+        codegen_generate_scope_variable_initializer(node,entity);
+        return;
+    }
+
     // a = 50 -> We need to generate the 50
     if (node->var.val)
     {
@@ -1234,7 +1534,8 @@ void codegen_generate_entity_access_start(struct resolver_result* result, struct
     else if (result->flags &RESOLVER_RESULT_FLAG_FIRST_ENTITY_LOAD_TO_EBX)
     {
         // If it's a pointer than we need to load the value at the address ([] -> indirection, pointer dereference)
-        if (root_assignment_entity->next && root_assignment_entity->flags & RESOLVER_ENTITY_FLAG_DO_IS_POINTER_ARRAY_ENTITY)
+        // char* abc; abc[5]; -> the flag is on the bracket entity that follows the variable
+        if (root_assignment_entity->next && root_assignment_entity->next->flags & RESOLVER_ENTITY_FLAG_DO_IS_POINTER_ARRAY_ENTITY)
         {
             asm_push("mov ebx, [%s]",result->base.address);
         }
@@ -1422,9 +1723,117 @@ void codegen_generate_entity_access_for_assignment_left_operand(struct resolver_
     }
 }
 
+// Structures up to this size are still pushed and popped one DWORD at a time
+#define CODEGEN_STRUCT_PUSH_MAX_SIZE 16
+// Copies up to this size are unrolled, bigger ones use rep movsd
+#define CODEGEN_UNROLLED_COPY_MAX_SIZE 64
+
+// The stack pointer moves while esi and edi are saved, addresses relative to it need to follow
+static int codegen_block_copy_offset(const char* base, int offset, int saved)
+{
+    return S_EQ(base,"esp") ? offset + saved : offset;
+}
+
+/*
+ * Copies {size} bytes from [source_base+source_offset] to [destination_base+destination_offset]
+ *
+ * mov eax, [ebx+0]          push esi
+ * mov [esp+0], eax          push edi
+ * mov eax, [ebx+4]    or    lea esi, [ebx+0]
+ * mov [esp+4], eax          lea edi, [esp+8]
+ * ...                       mov ecx, 1024
+ *                           rep movsd
+ *                           pop edi
+ *                           pop esi
+ *
+ * esi and edi belong to whoever called us, so they are saved around rep movsd
+ */
+static void codegen_generate_block_copy(const char* destination_base, int destination_offset, const char* source_base, int source_offset, size_t size)
+{
+    char destination_fmt[16];
+    char source_fmt[16];
+    int dwords = size / DATA_SIZE_DWORD;
+    compile_report_pass_start(current_process);
+    if (size <= CODEGEN_UNROLLED_COPY_MAX_SIZE)
+    {
+        for (int i = 0; i < dwords; i++)
+        {
+            codegen_plus_or_minus_string_for_value(source_fmt,source_offset + i * DATA_SIZE_DWORD,sizeof(source_fmt));
+            codegen_plus_or_minus_string_for_value(destination_fmt,destination_offset + i * DATA_SIZE_DWORD,sizeof(destination_fmt));
+            asm_push("mov eax, [%s%s]",source_base,source_fmt);
+            asm_push("mov [%s%s], eax",destination_base,destination_fmt);
+        }
+        compile_report_pass_end(current_process,COMPILER_PASS_BLOCK_COPY);
+        return;
+    }
+
+    int saved = 2 * DATA_SIZE_DWORD;
+    codegen_plus_or_minus_string_for_value(source_fmt,codegen_block_copy_offset(source_base,source_offset,saved),sizeof(source_fmt));
+    codegen_plus_or_minus_string_for_value(destination_fmt,codegen_block_copy_offset(destination_base,destination_offset,saved),sizeof(destination_fmt));
+    asm_push("push esi");
+    asm_push("push edi");
+    asm_push("lea esi, [%s%s]",source_base,source_fmt);
+    asm_push("lea edi, [%s%s]",destination_base,destination_fmt);
+    asm_push("mov ecx, %i",dwords);
+    asm_push("rep movsd");
+    asm_push("pop edi");
+    asm_push("pop esi");
+    compile_report_pass_end(current_process,COMPILER_PASS_BLOCK_COPY);
+}
+
+// Stores up to this size are unrolled, bigger areas are cleared with rep stosd
+#define CODEGEN_UNROLLED_ZERO_FILL_MAX_SIZE 64
+
+/*
+ * Sets {size} bytes at [base+offset] to zero
+ *
+ * mov dword [ebp-16], 0          push edi
+ * mov dword [ebp-12], 0    or    lea edi, [ebp-4096]
+ * mov dword [ebp-8], 0           xor eax, eax
+ * mov dword [ebp-4], 0           mov ecx, 1024
+ *                                rep stosd
+ *                                pop edi
+ */
+void codegen_generate_zero_fill(const char* base, int offset, size_t size)
+{
+    char offset_fmt[16];
+    size_t filled = 0;
+    if (size > CODEGEN_UNROLLED_ZERO_FILL_MAX_SIZE)
+    {
+        int saved = S_EQ(base,"esp") ? DATA_SIZE_DWORD : 0;
+        codegen_plus_or_minus_string_for_value(offset_fmt,offset + saved,sizeof(offset_fmt));
+        asm_push("push edi");
+        asm_push("lea edi, [%s%s]",base,offset_fmt);
+        asm_push("xor eax, eax");
+        asm_push("mov ecx, %i",(int)(size / DATA_SIZE_DWORD));
+        asm_push("rep stosd");
+        asm_push("pop edi");
+        filled = size / DATA_SIZE_DWORD * DATA_SIZE_DWORD;
+    }
+
+    // What rep stosd didn't cover, or everything for small sizes
+    while (filled < size)
+    {
+        size_t left = size - filled;
+        size_t chunk = left >= DATA_SIZE_DWORD ? DATA_SIZE_DWORD : left >= DATA_SIZE_WORD ? DATA_SIZE_WORD : DATA_SIZE_BYTE;
+        const char* keyword = chunk == DATA_SIZE_DWORD ? "dword" : chunk == DATA_SIZE_WORD ? "word" : "byte";
+        codegen_plus_or_minus_string_for_value(offset_fmt,offset + filled,sizeof(offset_fmt));
+        asm_push("mov %s [%s%s], 0",keyword,base,offset_fmt);
+        filled += chunk;
+    }
+}
+
 void codegen_generate_move_struct(struct datatype* dtype, const char* base_address,int offset)
 {
     size_t structure_size = align_value(datatype_size(dtype),DATA_SIZE_DWORD);
+    if (structure_size > CODEGEN_STRUCT_PUSH_MAX_SIZE && compiler_pass_enabled(current_process,COMPILER_PASS_BLOCK_COPY))
+    {
+        // The structure is on the top of the stack, copy it in one go and throw the stack copy away
+        codegen_generate_block_copy(base_address,offset,"esp",0,structure_size);
+        codegen_stack_add_with_name(structure_size,"result_value");
+        return;
+    }
+
     int pops = structure_size / DATA_SIZE_DWORD;
     for (int i = 0; i < pops; ++i) {
         asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
@@ -1441,7 +1850,7 @@ void codegen_generate_assignment_part(struct node* node, const char* op, struct
     struct datatype right_operand_type;
     // x = 50 -> x will be followed, node will contain the identifier
     struct resolver_result* result = resolver_follow(current_process->resolver,node);
-    assert(resolver_result_ok(result));
+    compiler_assert(resolver_result_ok(result));
     struct resolver_entity* root_assignment_entity = resolver_result_entity_root(result);
     const char* reg_to_use = "eax";
     //a.b.c -> we only care about the datatype of c, that's why we get the last_entity's datatype
@@ -1492,6 +1901,20 @@ void codegen_generate_assignment_expression(struct node* node, struct history*hi
 
 void codegen_generate_structure_push(struct resolver_entity* entity, struct history* history, int start_pos);
 
+// How many arguments of the call go in registers, the function being called has to be known at compile time
+static int codegen_register_argument_count_for_call(struct resolver_entity* call_entity)
+{
+    struct resolver_entity* func_entity = call_entity->prev;
+    if (!func_entity || func_entity->type != RESOLVER_ENTITY_TYPE_FUNCTION)
+    {
+        return 0;
+    }
+
+    int register_arguments = function_node_register_argument_count(func_entity->node);
+    int total_arguments = vector_count(call_entity->func_call_data.arguments);
+    return register_arguments < total_arguments ? register_arguments : total_arguments;
+}
+
 void codegen_generate_entity_access_for_function_call(struct resolver_result *result, struct resolver_entity *entity)
 {
     // Iterate through backwards (the arguments will be backwards) (func(int a, int b) -> int b will be seen first)
@@ -1501,10 +1924,11 @@ void codegen_generate_entity_access_for_function_call(struct resolver_result *re
 	
 	// We will store the function address in a label and call that when we need it
 	// func(special()) -> without this both special's and func's address would be stored in the same register and because special is generated later it would overwrite the address of func
-	int function_call_label_id = codegen_label_count();
-	codegen_data_section_add("function_call_%i: dd 0",function_call_label_id);
+	char function_call_label[50];
+	sprintf(function_call_label,"function_call_%s%i",current_process->generator->label_namespace,codegen_label_count());
+	codegen_data_section_add("%s: dd 0",function_call_label);
 	asm_push_ins_pop("ebx",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
-	asm_push("mov dword [function_call_%i], ebx",function_call_label_id);
+	asm_push("mov dword [%s], ebx",function_call_label);
 
     if (datatype_is_struct_or_union_non_pointer(&entity->dtype))
     {
@@ -1519,10 +1943,18 @@ void codegen_generate_entity_access_for_function_call(struct resolver_result *re
         codegen_generate_expressionable(node, history_begin(EXPRESSION_IN_FUNCTION_CALL_ARGUMENTS));
         node = vector_peek_ptr(entity->func_call_data.arguments);
     }
+
+    // Static functions take their first arguments in registers, the first argument was pushed last so it is on the top
+    int register_arguments = codegen_register_argument_count_for_call(entity);
+    for (int i = 0; i < register_arguments; i++)
+    {
+        asm_push_ins_pop(function_node_argument_register(i),STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+    }
+
     // Call the function
-    asm_push("call [function_call_%i]",function_call_label_id);
+    asm_push("call [%s]",function_call_label);
 
-    size_t stack_size = entity->func_call_data.stack_size;
+    size_t stack_size = entity->func_call_data.stack_size - register_arguments * DATA_SIZE_DWORD;
 
     if (datatype_is_struct_or_union_non_pointer(&entity->dtype))
     {
@@ -1552,7 +1984,7 @@ void codegen_generate_entity_access_for_unary_indirection(struct resolver_result
 {
 	asm_push("; INDIRECTION");
 	struct datatype operand_datatype;
-	assert(asm_datatype_back(&operand_datatype));
+	compiler_assert(asm_datatype_back(&operand_datatype));
 	int flags = asm_push_ins_pop("ebx",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
 	int gen_entity_rules = codegen_entity_rules(result->last_entity,history);
 	int depth = entity->indirection.depth;
@@ -1638,7 +2070,7 @@ bool codegen_resolve_node_for_value(struct node* node, struct history* history)
         return false;
     }
     struct datatype dtype;
-    assert(asm_datatype_back(&dtype));
+    compiler_assert(asm_datatype_back(&dtype));
 	if (result->flags & RESOLVER_RESULT_FLAG_DOES_GET_ADDRESS)
 	{
 		// Do nothing we could just return
@@ -1756,17 +2188,17 @@ int codegen_set_flag_for_operator(const char* op)
 
 struct stack_frame_element* asm_stack_back()
 {
-    return stackframe_back(current_function);
+    return stackframe_back(current_process->generator->current_function);
 }
 
 struct stack_frame_element* asm_stack_peek()
 {
-    return stackframe_peek(current_function);
+    return stackframe_peek(current_process->generator->current_function);
 }
 
 void asm_stack_peek_start()
 {
-    stackframe_peek_start(current_function);
+    stackframe_peek_start(current_process->generator->current_function);
 }
 
 bool asm_datatype_back(struct datatype* dtype_out)
@@ -2001,7 +2433,7 @@ void codegen_generate_exp_node_for_logical_arithmetic(struct node* node, struct
 void codegen_generate_exp_node_for_arithmetic(struct node* node, struct history* history)
 {
 
-    assert(node->type == NODE_TYPE_EXPRESSION);
+    compiler_assert(node->type == NODE_TYPE_EXPRESSION);
     int flags = history->flags;
 
     if (is_logical_operator(node->exp.op))
@@ -2099,7 +2531,7 @@ void codegen_discard_unused_stack()
             break;
         }
 
-        stack_adjustment+= DATA_SIZE_DWORD;
+        stack_adjustment+= stackframe_element_size(element);
         element = asm_stack_peek();
     }
     // Ignore everything
@@ -2123,6 +2555,17 @@ void codegen_generate_structure_push(struct resolver_entity* entity, struct hist
 {
     asm_push("; STRUCTURE PUSH");
     size_t structure_size = align_value(entity->dtype.size, DATA_SIZE_DWORD);
+    size_t copy_size = structure_size - start_pos * DATA_SIZE_DWORD;
+    if (copy_size > CODEGEN_STRUCT_PUSH_MAX_SIZE && compiler_pass_enabled(current_process,COMPILER_PASS_BLOCK_COPY))
+    {
+        // Make room for the whole structure and copy it there, the frame sees it as a single pushed value
+        asm_push("sub esp, %i",(int)copy_size);
+        stackframe_push(current_process->generator->current_function,&(struct stack_frame_element){.type = STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,.name = "result_value",.flags = STACK_FRAME_ELEMENT_FLAG_HAS_DATATYPE,.size = copy_size,.data.dtype = entity->dtype});
+        codegen_generate_block_copy("esp",0,"ebx",start_pos * DATA_SIZE_DWORD,copy_size);
+        asm_push("; END STRUCTURE PUSH");
+        codegen_response_acknowledge(RESPONSE_SET(.flags = RESPONSE_FLAG_PUSHED_STRUCT));
+        return;
+    }
 
     // A stack can only store words so we need multiple pushes to store a struct
     int pushes = structure_size / DATA_SIZE_DWORD;
@@ -2142,7 +2585,7 @@ void codegen_generate_statement_return_exp(struct node* node)
     // Push the return value to the stack
     codegen_generate_expressionable(node->stmt.return_stmt.exp, history_begin(IS_STATEMENT_RETURN));
     struct datatype dtype;
-    assert(asm_datatype_back(&dtype));
+    compiler_assert(asm_datatype_back(&dtype));
     if (datatype_is_struct_or_union_non_pointer(&dtype))
     {
         /*
@@ -2182,8 +2625,148 @@ void asm_pop_ebp_no_stack_frame_restore()
     asm_push("pop ebp");
 }
 
+static bool codegen_node_escapes_frame(struct node* node, void* private)
+{
+    bool* escapes = private;
+    // &abc -> the address of something in our frame could be handed to the callee
+    if (node->type == NODE_TYPE_UNARY && op_is_address(node->unary.op))
+    {
+        *escapes = true;
+    }
+    // Arrays and structures can be turned into pointers without the & operator (int x[5]; abc(x);)
+    if (node->type == NODE_TYPE_VARIABLE && (node->var.type.flags & DATATYPE_FLAG_IS_ARRAY || datatype_is_struct_or_union_non_pointer(&node->var.type)))
+    {
+        *escapes = true;
+    }
+    return !*escapes;
+}
+
+// How many bytes the caller pushed for our arguments, every argument takes up at least a DWORD. Arguments passed in registers aren't pushed
+size_t codegen_function_argument_stack_size(struct node* func_node)
+{
+    size_t stack_size = 0;
+    struct vector* arguments = function_node_argument_vec(func_node);
+    for (int i = function_node_register_argument_count(func_node); i < vector_count(arguments); i++)
+    {
+        struct node* arg_node = vector_peek_ptr_at(arguments,i);
+        size_t size = datatype_size(&variable_node(arg_node)->var.type);
+        if (size < DATA_SIZE_DWORD)
+        {
+            size = DATA_SIZE_DWORD;
+        }
+        stack_size += align_value(size,DATA_SIZE_DWORD);
+    }
+    return stack_size;
+}
+
+// Returns the function call entity if "return abc(x);" can be turned into a jump to abc
+struct resolver_entity* codegen_tail_call_entity(struct node* func_node, struct node* exp_node)
+{
+    if (!compiler_pass_enabled(current_process,COMPILER_PASS_TAIL_CALLS))
+    {
+        return NULL;
+    }
+
+    if (!node_is_expression(exp_node,"()") || exp_node->exp.left->type != NODE_TYPE_IDENTIFIER)
+    {
+        return NULL;
+    }
+
+    // Struct returns use a hidden pointer argument so the argument area of the caller and callee would not line up
+    if (datatype_is_struct_or_union_non_pointer(&func_node->func.rtype))
+    {
+        return NULL;
+    }
+
+    struct resolver_result* result = resolver_follow(current_process->resolver,exp_node);
+    if (!resolver_result_ok(result))
+    {
+        return NULL;
+    }
+
+    struct resolver_entity* func_entity = resolver_result_entity_root(result);
+    struct resolver_entity* call_entity = resolver_result_entity_next(func_entity);
+    if (func_entity->type != RESOLVER_ENTITY_TYPE_FUNCTION || !call_entity || call_entity->type != RESOLVER_ENTITY_TYPE_FUNCTION_CALL || resolver_result_entity_next(call_entity))
+    {
+        return NULL;
+    }
+
+    struct node* callee_node = func_entity->node;
+    if (callee_node->func.flags & (FUNCTION_NODE_FLAG_IS_NATIVE | FUNCTION_NODE_FLAG_REGISTER_ARGUMENTS) || datatype_is_struct_or_union_non_pointer(&callee_node->func.rtype))
+    {
+        return NULL;
+    }
+
+    // The callee's arguments have to fit inside the area our caller pushed for us, the caller will clean up that area after the callee returns to it
+    if (call_entity->func_call_data.stack_size > codegen_function_argument_stack_size(func_node) || function_node_argument_stack_addition(callee_node) != function_node_argument_stack_addition(func_node))
+    {
+        return NULL;
+    }
+
+    // We are about to throw away our frame, nothing is allowed to point into it
+    bool escapes = false;
+    node_walk(func_node,codegen_node_escapes_frame,&escapes);
+    if (escapes)
+    {
+        return NULL;
+    }
+
+    return call_entity;
+}
+
+/*
+ * int abc(int x)
+ * {
+ *  return abc(x-1); -> the arguments are pushed as usual, but then they are moved over our own arguments and we jump to abc after restoring our frame
+ * }
+ * 
+ * abc will return straight to our caller, so recursion like this won't use up any more stack
+ */
+bool codegen_generate_tail_call(struct node* node)
+{
+    struct node* func_node = node->binded.function;
+    struct resolver_entity* entity = codegen_tail_call_entity(func_node,node->stmt.return_stmt.exp);
+    if (!entity)
+    {
+        return false;
+    }
+
+    struct resolver_entity* func_entity = entity->prev;
+    asm_push("; TAIL CALL %s",func_entity->name);
+    vector_set_flag(entity->func_call_data.arguments,VECTOR_FLAG_PEEK_DECREMENT);
+    vector_set_peek_pointer_end(entity->func_call_data.arguments);
+    struct node* arg_node = vector_peek_ptr(entity->func_call_data.arguments);
+    while (arg_node)
+    {
+        codegen_generate_expressionable(arg_node,history_begin(EXPRESSION_IN_FUNCTION_CALL_ARGUMENTS));
+        arg_node = vector_peek_ptr(entity->func_call_data.arguments);
+    }
+
+    // Now every argument is evaluated so it's safe to overwrite ours, the first DWORD that we pop is the first DWORD of the first argument
+    // The arguments may contain block copies, only the part that is the tail call is timed
+    compile_report_pass_start(current_process);
+    size_t stack_addition = function_node_argument_stack_addition(func_node);
+    for (size_t offset = 0; offset < entity->func_call_data.stack_size; offset += DATA_SIZE_DWORD)
+    {
+        asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+        asm_push("mov dword [ebp+%i], eax",(int)(stack_addition + offset));
+    }
+
+    // Leave the frame exactly like a return would but jump instead of ret, the return address of our caller stays on the stack
+    codegen_stack_add_no_compile_time_stack_frame_restore(C_ALIGN(function_node_stack_size(func_node)));
+    asm_pop_ebp_no_stack_frame_restore();
+    asm_push("jmp %s",func_entity->name);
+    compile_report_pass_end(current_process,COMPILER_PASS_TAIL_CALLS);
+    return true;
+}
+
 void codegen_generate_statement_return(struct node* node)
 {
+    if (node->stmt.return_stmt.exp && codegen_generate_tail_call(node))
+    {
+        return;
+    }
+
     if (node->stmt.return_stmt.exp)
     {
         codegen_generate_statement_return_exp(node);
@@ -2219,9 +2802,114 @@ void codegen_generate_else_or_else_if(struct node* node, int end_label_id)
 	}
 }
 
+/*
+ * Profile guided layout, with -fprofile-use
+ *
+ * The body of an if that runs less often than it is skipped is moved after the end of the function, the common case
+ * falls through without a taken branch and the rare code doesn't take up space between the hot instructions
+ *
+ * if (error)           cmp eax, 0
+ * {                    jne .if_cold_5
+ *     rare             ...the else, or the code after the if
+ * }                    .if_end_4:
+ *                      ...
+ *                      ret
+ *                      .if_cold_5:
+ *                      rare
+ *                      jmp .if_end_4
+ *
+ * A loop whose body runs more than once for every time the loop is reached is rotated, the condition is tested at the
+ * bottom and an iteration takes one branch instead of two:
+ *
+ * while (cond)         jmp .entry_point_2
+ * {                    .while_start_1:
+ *     body             body
+ * }                    .entry_point_2:     <- continue
+ *                      cond
+ *                      cmp eax, 0
+ *                      jne .while_start_1
+ *
+ * The compares of a switch are ordered by how many times their cases were hit, the most common case is found first.
+ * Nodes without a profile are generated like before
+ */
+
+// Starts writing the assembly after the function
+static void codegen_begin_cold_block()
+{
+	struct code_generator* generator = current_process->generator;
+	if (!generator->cold_blocks)
+	{
+		generator->cold_blocks = open_memstream(&generator->cold_blocks_text, &generator->cold_blocks_size);
+	}
+	generator->in_cold_block = true;
+}
+
+static void codegen_end_cold_block()
+{
+	current_process->generator->in_cold_block = false;
+}
+
+// After the ret of the function, the labels of the cold blocks are still local to it
+static void codegen_write_cold_blocks()
+{
+	struct code_generator* generator = current_process->generator;
+	if (!generator->cold_blocks)
+	{
+		return;
+	}
+	fclose(generator->cold_blocks);
+	asm_push("; cold blocks of %s", generator->current_function->func.name);
+	asm_push_no_nl("%s", generator->cold_blocks_text);
+	free(generator->cold_blocks_text);
+	generator->cold_blocks = NULL;
+	generator->cold_blocks_text = NULL;
+	generator->cold_blocks_size = 0;
+}
+
+static bool codegen_node_is_label(struct node* node, void* private)
+{
+	if (node->type == NODE_TYPE_LABEL)
+	{
+		*(bool*)private = true;
+	}
+	return true;
+}
+
+static bool codegen_if_body_is_cold(struct node* node)
+{
+	struct node_profile* profile = node->profile;
+	if (!profile || current_process->generator->in_cold_block || profile->body * 2 >= profile->entries)
+	{
+		return false;
+	}
+
+	// The goto labels aren't local, a cold block written after the ret would belong to the last label of the function
+	// and neither its own label nor the .if_end it jumps back to would be found
+	bool has_label = false;
+	node_walk(current_process->generator->current_function->func.body_n, codegen_node_is_label, &has_label);
+	return !has_label;
+}
+
+static bool codegen_loop_is_hot(struct node* node)
+{
+	return node->profile && node->profile->body > node->profile->entries;
+}
+
+static void codegen_generate_cold_if_stmt(struct node* node, int if_label_id, int end_label_id)
+{
+	asm_push("jne .if_cold_%i",if_label_id);
+	codegen_begin_cold_block();
+	asm_push(".if_cold_%i:",if_label_id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
+	codegen_generate_body(node->stmt.if_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
+	asm_push("jmp .if_end_%i",end_label_id);
+	codegen_end_cold_block();
+}
+
 void _codegen_generate_if_stmt(struct node* node, int end_label_id)
 {
 	int if_label_id = codegen_label_count();
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 	
 	/*
 	 * if(a > 0)
@@ -2232,10 +2920,18 @@ void _codegen_generate_if_stmt(struct node* node, int end_label_id)
 	codegen_generate_expressionable(node->stmt.if_stmt.cond_node, history_begin(0));
 	asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
 	asm_push("cmp eax, 0");
-	asm_push("je .if_%i",if_label_id);
-	codegen_generate_body(node->stmt.if_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
-	asm_push("jmp .if_end_%i",end_label_id);
-	asm_push(".if_%i:",if_label_id);
+	if (codegen_if_body_is_cold(node))
+	{
+		codegen_generate_cold_if_stmt(node, if_label_id, end_label_id);
+	}
+	else
+	{
+		asm_push("je .if_%i",if_label_id);
+		profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
+		codegen_generate_body(node->stmt.if_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
+		asm_push("jmp .if_end_%i",end_label_id);
+		asm_push(".if_%i:",if_label_id);
+	}
 	
 	// If there is an else of else if it will be in the next node
 	if (node->stmt.if_stmt.next)
@@ -2252,8 +2948,33 @@ void codegen_generate_if_stmt(struct node* node)
 	
 }
 
+// The condition at the bottom, see the profile guided layout above
+static void codegen_generate_rotated_while_stmt(struct node* node)
+{
+	int while_start_id = codegen_label_count();
+	int entry_point_id = codegen_label_count();
+	codegen_register_entry_point(entry_point_id);
+	codegen_begin_exit_point();
+	asm_push("jmp .entry_point_%i",entry_point_id);
+	asm_push(".while_start_%i:",while_start_id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
+	codegen_generate_body(node->stmt.while_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
+	asm_push(".entry_point_%i:",entry_point_id);
+	codegen_generate_expressionable(node->stmt.while_stmt.exp_node, history_begin(0));
+	asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+	asm_push("cmp eax, 0");
+	asm_push("jne .while_start_%i",while_start_id);
+	codegen_end_entry_exit_point();
+}
+
 void codegen_generate_while_stmt(struct node* node)
 {
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
+	if (codegen_loop_is_hot(node))
+	{
+		codegen_generate_rotated_while_stmt(node);
+		return;
+	}
 	codegen_begin_entry_exit_point();
 	int while_start_id = codegen_label_count();
 	int while_end_id = codegen_label_count();
@@ -2265,18 +2986,21 @@ void codegen_generate_while_stmt(struct node* node)
 	// Check if the value is false
 	asm_push("cmp eax, 0");
 	asm_push("je .while_end_%i",while_end_id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
 	codegen_generate_body(node->stmt.while_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
 	asm_push("jmp .while_start_%i",while_start_id);
-	asm_push(".while_end:%i:",while_end_id);
+	asm_push(".while_end_%i:",while_end_id);
 	// The program can freely run after the while finished
 	codegen_end_entry_exit_point();
 }
 
 void codegen_generate_do_while_stmt(struct node* node)
 {
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 	codegen_begin_entry_exit_point();
 	int do_while_start_id = codegen_label_count();
 	asm_push(".do_while_start_%i:",do_while_start_id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
 	codegen_generate_body(node->stmt.do_while_stmt.body_node, history_begin(IS_ALONE_STATEMENT));
 	codegen_generate_expressionable(node->stmt.do_while_stmt.exp_node, history_begin(0));
 	asm_push_ins_pop("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
@@ -2284,18 +3008,53 @@ void codegen_generate_do_while_stmt(struct node* node)
 	asm_push("jne .do_while_start_%i",do_while_start_id);
 	codegen_end_entry_exit_point();
 }
+// The condition at the bottom, the loop part runs right before it so continue goes to the loop part
+static void codegen_generate_rotated_for_stmt(struct node* node, int for_loop_start_id)
+{
+	struct for_stmt* for_stmt = &node->stmt.for_stmt;
+	int for_loop_body_id = codegen_label_count();
+	int entry_point_id = codegen_label_count();
+	codegen_register_entry_point(entry_point_id);
+	codegen_begin_exit_point();
+
+	asm_push(".for_loop_body_%i:",for_loop_body_id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
+	if (for_stmt->body_node)
+	{
+		codegen_generate_body(for_stmt->body_node, history_begin(IS_ALONE_STATEMENT));
+	}
+	asm_push(".entry_point_%i:",entry_point_id);
+	if (for_stmt->loop_node)
+	{
+		codegen_generate_expressionable(for_stmt->loop_node, history_begin(0));
+		asm_push_ins_pop_or_ignore("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+	}
+	asm_push(".for_loop_%i:",for_loop_start_id);
+	codegen_generate_expressionable(for_stmt->cond_node, history_begin(0));
+	asm_push_ins_pop_or_ignore("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
+	asm_push("cmp eax, 0");
+	asm_push("jne .for_loop_body_%i",for_loop_body_id);
+	codegen_end_entry_exit_point();
+}
+
 void codegen_generate_for_stmt(struct node*node)
 {
 	struct for_stmt* for_stmt = &node->stmt.for_stmt;
 	
 	int for_loop_start_id = codegen_label_count();
 	int for_loop_end_id = codegen_label_count();
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 	if (for_stmt->init_node)
 	{
 		codegen_generate_expressionable(for_stmt->init_node, history_begin(0));
 		asm_push_ins_pop_or_ignore("eax",STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE,"result_value");
 	}
 	asm_push("jmp .for_loop_%i",for_loop_start_id);
+	if (for_stmt->cond_node && codegen_loop_is_hot(node))
+	{
+		codegen_generate_rotated_for_stmt(node, for_loop_start_id);
+		return;
+	}
 	codegen_begin_entry_exit_point();
 	
 	if (for_stmt->loop_node)
@@ -2312,6 +3071,7 @@ void codegen_generate_for_stmt(struct node*node)
 		asm_push("cmp eax, 0");
 		asm_push("je .for_loop_end_%i",for_loop_end_id);
 	}
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_BODY);
 	if (for_stmt->body_node)
 	{
 		codegen_generate_body(for_stmt->body_node, history_begin(IS_ALONE_STATEMENT));
@@ -2332,21 +3092,67 @@ void codegen_generate_switch_default_stmt(struct node* node)
 	struct code_generator* generator = current_process->generator;
 	struct generator_switch_stmt* switch_stmt_data = &generator->_switch;
 	asm_push(".switch_stmt_%i_case_default:",switch_stmt_data->current.id);
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 }
 
 
 
+struct codegen_switch_case_order
+{
+	int index;
+	unsigned long long hits;
+	// Where the case is in the source, equal hits keep this order
+	int position;
+};
+
+static int codegen_compare_switch_cases(const void* a, const void* b)
+{
+	const struct codegen_switch_case_order* case_a = a;
+	const struct codegen_switch_case_order* case_b = b;
+	if (case_a->hits != case_b->hits)
+	{
+		return case_a->hits < case_b->hits ? 1 : -1;
+	}
+	return case_a->position - case_b->position;
+}
+
+// How many times the case was hit according to the profile, 0 if it doesn't know
+static unsigned long long codegen_switch_case_hits(struct node* switch_node, int index)
+{
+	struct vector* statements = switch_node->stmt.switch_stmt.body->body.statements;
+	for (int i = 0; i < vector_count(statements); i++)
+	{
+		struct node* statement = vector_peek_ptr_at(statements, i);
+		if (statement->type == NODE_TYPE_STATEMENT_CASE && statement->stmt._case.exp->llnum == index)
+		{
+			return statement->profile ? statement->profile->entries : 0;
+		}
+	}
+	return 0;
+}
+
 void codegen_generate_switch_stmt_case_jumps(struct node *node)
 {
-	vector_set_peek_pointer(node->stmt.switch_stmt.cases,0);
-	struct parsed_switch_case* switch_case = vector_peek(node->stmt.switch_stmt.cases);
-	while (switch_case)
+	struct vector* cases = node->stmt.switch_stmt.cases;
+	int total_cases = vector_count(cases);
+	struct codegen_switch_case_order* order = arena_calloc(total_cases ? total_cases : 1, sizeof(struct codegen_switch_case_order));
+	for (int i = 0; i < total_cases; i++)
 	{
-		asm_push("cmp eax,%i",switch_case->index);
-		//codegen_switch_id() returns the ID of the current switch case (there can be nested switch cases) and switch_case->index returns the index of the current case inside the switch
-		asm_push("je .switch_stmt_%i_case_%i",codegen_switch_id(),switch_case->index);
-		switch_case = vector_peek(node->stmt.switch_stmt.cases);
+		struct parsed_switch_case* switch_case = vector_at(cases, i);
+		order[i].index = switch_case->index;
+		order[i].position = i;
+		// The cases of a switch the profile doesn't know stay in the source order
+		order[i].hits = node->profile ? codegen_switch_case_hits(node, switch_case->index) : 0;
 	}
+	qsort(order, total_cases, sizeof(struct codegen_switch_case_order), codegen_compare_switch_cases);
+
+	for (int i = 0; i < total_cases; i++)
+	{
+		asm_push("cmp eax,%i",order[i].index);
+		//codegen_switch_id() returns the ID of the current switch case (there can be nested switch cases) and order[i].index returns the index of the current case inside the switch
+		asm_push("je .switch_stmt_%i_case_%i",codegen_switch_id(),order[i].index);
+	}
+	arena_free(order);
 	if (node->stmt.switch_stmt.has_default_case)
 	{
 		asm_push("jmp .switch_stmt_%i_case_default",codegen_switch_id());
@@ -2357,6 +3163,7 @@ void codegen_generate_switch_stmt_case_jumps(struct node *node)
 
 void codegen_generate_switch_stmt(struct node* node)
 {
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 	codegen_begin_entry_exit_point();
 	codegen_begin_switch_statement();
 	
@@ -2383,11 +3190,12 @@ void codegen_generate_continue_stmt(struct node* node)
 void codegen_generate_switch_case_stmt(struct node* node)
 {
 	struct node* case_stmt_exp = node->stmt._case.exp;
-	assert(case_stmt_exp->type== NODE_TYPE_NUMBER);
+	compiler_assert(case_stmt_exp->type== NODE_TYPE_NUMBER);
 	
 	codegen_begin_case_statement(case_stmt_exp->llnum);
 	asm_push("; CASE %i",case_stmt_exp->llnum);
 	codegen_end_case_statement();
+	profile_generate_counter(current_process, node, PROFILE_COUNTER_ENTRIES);
 }
 
 void codegen_generate_goto_stmt(struct node* node)
@@ -2400,7 +3208,7 @@ void codegen_generate_label(struct node* node)
 }
 void codegen_generate_scope_variable_for_list(struct node* var_list_node)
 {
-	assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
+	compiler_assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
 	vector_set_peek_pointer(var_list_node->var_list.list,0);
 	struct node* var_node = vector_peek_ptr(var_list_node->var_list.list);
 	while (var_node)
@@ -2493,8 +3301,150 @@ void codegen_generate_body(struct node* node, struct history* history)
 
 }
 
+struct codegen_function_references
+{
+    const char* name;
+    // Every identifier with the name of the function
+    int references;
+    // The identifiers that are called directly i.e abc(50)
+    int calls;
+};
+
+static bool codegen_count_function_references(struct node* node, void* private)
+{
+    struct codegen_function_references* refs = private;
+    if (node->type == NODE_TYPE_IDENTIFIER && S_EQ(node->sval, refs->name))
+    {
+        refs->references++;
+    }
+    if (node_is_expression(node, "()") && node->exp.left->type == NODE_TYPE_IDENTIFIER && S_EQ(node->exp.left->sval, refs->name))
+    {
+        refs->calls++;
+    }
+    return true;
+}
+
+static bool codegen_function_address_is_taken(struct node* func_node)
+{
+    struct codegen_function_references refs = {.name = func_node->func.name};
+    struct vector* root = current_process->node_tree_vec;
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        node_walk(vector_peek_ptr_at(root, i), codegen_count_function_references, &refs);
+    }
+    return refs.references != refs.calls;
+}
+
+/*
+ * A static function can only be called from this file, if its address is never taken every call site is known
+ * and both sides can agree to pass the first arguments in registers instead of the stack
+ *
+ * The function itself has to be generated by the IR, it is the one that knows how to receive them
+ */
+static bool codegen_function_can_use_register_arguments(struct node* func_node)
+{
+    if (function_node_is_prototype(func_node) || !(func_node->func.rtype.flags & DATATYPE_FLAG_IS_STATIC) || func_node->func.flags & FUNCTION_NODE_FLAG_IS_NATIVE)
+    {
+        return false;
+    }
+
+    if (datatype_is_struct_or_union_non_pointer(&func_node->func.rtype))
+    {
+        return false;
+    }
+
+    // Every argument has to fit in a register
+    struct vector* arguments = function_node_argument_vec(func_node);
+    for (int i = 0; i < vector_count(arguments); i++)
+    {
+        struct datatype* dtype = &variable_node(vector_peek_ptr_at(arguments, i))->var.type;
+        if (datatype_is_struct_or_union_non_pointer(dtype) || datatype_size(dtype) > DATA_SIZE_DWORD)
+        {
+            return false;
+        }
+    }
+
+    if (codegen_function_address_is_taken(func_node))
+    {
+        return false;
+    }
+
+    return !ir_build_function(current_process, func_node)->unsupported_reason;
+}
+
+// Decides which functions use the register calling convention before any call to them is generated
+static void codegen_mark_register_argument_functions()
+{
+    if (!(current_process->flags & COMPILE_PROCESS_USE_IR) || current_process->flags & COMPILE_PROCESS_TARGET_X86_64 || !compiler_pass_enabled(current_process,COMPILER_PASS_REGISTER_ARGUMENTS))
+    {
+        return;
+    }
+
+    compile_report_pass_start(current_process);
+    struct vector* root = current_process->node_tree_vec;
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* func_node = vector_peek_ptr_at(root, i);
+        if (func_node->type != NODE_TYPE_FUNCTION || !codegen_function_can_use_register_arguments(func_node))
+        {
+            continue;
+        }
+
+        // A prototype of the function has to agree with it, calls can be resolved to either of them
+        for (int j = 0; j < vector_count(root); j++)
+        {
+            struct node* node = vector_peek_ptr_at(root, j);
+            if (node->type == NODE_TYPE_FUNCTION && S_EQ(node->func.name, func_node->func.name))
+            {
+                node->func.flags |= FUNCTION_NODE_FLAG_REGISTER_ARGUMENTS;
+            }
+        }
+    }
+    compile_report_pass_end(current_process,COMPILER_PASS_REGISTER_ARGUMENTS);
+}
+
+// Generates the function through the intermediate representation, returns false if the IR can't express the function yet
+bool codegen_generate_function_with_ir(struct node* node)
+{
+    struct ir_function* function = ir_build_function(current_process, node);
+    if (!function->unsupported_reason)
+    {
+        compiler_passes_run_ir(current_process, function);
+    }
+    if (current_process->flags & COMPILE_PROCESS_DUMP_IR)
+    {
+        ir_function_dump(function, stderr);
+    }
+
+    // The AST code generator only knows the 32 bit stack machine, on x86-64 every function goes through the IR
+    if (function->unsupported_reason && current_process->flags & COMPILE_PROCESS_TARGET_X86_64)
+    {
+        compiler_error(current_process, "The x86-64 target can't generate the function %s yet, the IR doesn't support %s", node->func.name, function->unsupported_reason);
+    }
+
+    // -fdump-ir without -fuse-ir only shows the IR, the AST code generator still generates the function
+    if (function->unsupported_reason || !(current_process->flags & (COMPILE_PROCESS_USE_IR | COMPILE_PROCESS_TARGET_X86_64)))
+    {
+        return false;
+    }
+
+    codegen_register_function(node,0);
+    if (current_process->flags & COMPILE_PROCESS_TARGET_X86_64)
+    {
+        ircodegen64_generate_function(current_process, function);
+        return true;
+    }
+    ircodegen_generate_function(current_process, function);
+    return true;
+}
+
 void codegen_generate_function_with_body(struct node* node)
 {
+    if (current_process->flags & (COMPILE_PROCESS_USE_IR | COMPILE_PROCESS_DUMP_IR | COMPILE_PROCESS_TARGET_X86_64) && codegen_generate_function_with_ir(node))
+    {
+        return;
+    }
+
     // Generate assembly for function
     /*
      * global test
@@ -2516,6 +3466,9 @@ void codegen_generate_function_with_body(struct node* node)
     // Subtract from the stack the total size of the function's body size
     codegen_stack_sub(C_ALIGN(function_node_stack_size(node)));
 
+    // -fprofile-generate counts the call
+    profile_generate_function_entry(current_process, node);
+
     // Create new scope
     codegen_new_scope(RESOLVER_DEFAULT_ENTITY_FLAG_IS_LOCAL_STACK);
 
@@ -2533,15 +3486,17 @@ void codegen_generate_function_with_body(struct node* node)
     asm_pop_ebp();
 
     //Make sure the stackframe of the function is empty, if it isn't then we forgot to pop something at the end
-    stackframe_assert_empty(current_function);
+    stackframe_assert_empty(current_process->generator->current_function);
 
     // Generate return instruction
     asm_push("ret");
+
+    codegen_write_cold_blocks();
 }
 
 void codegen_generate_function(struct node* node)
 {
-    current_function = node;
+    current_process->generator->current_function = node;
     if (function_node_is_prototype(node))
     {
         codegen_generate_function_prototype(node);
@@ -2567,6 +3522,11 @@ void codegen_generate_root_node(struct node* node)
 void codegen_generate_root()
 {
     asm_push("section .text");
+    // -fparallel-codegen, when it can't use the workers the functions are generated below
+    if (current_process->flags & COMPILE_PROCESS_PARALLEL_CODEGEN && codegen_parallel_generate_root(current_process))
+    {
+        return;
+    }
     struct node* node = NULL;
     while ((node = codegen_node_next()) != NULL)
     {
@@ -2575,59 +3535,140 @@ void codegen_generate_root()
 }
 
 
-// in assembly str_1: db 'hello world\n',0 -> \n will be interpreted as a string literal and will not create a new line
-// It will be replaced to str_1: db 'hello world', 10, 0 (10 = '\n', 0 = '\0')
-bool codegen_write_string_char_escaped(char c)
+/*
+ * String literals in .rodata
+ *
+ * A string that is the end of another string shares its memory, its label is placed inside the longer string
+ *
+ * str_3:          <- "print the value"
+ * db 'print the '
+ * str_7:          <- "value"
+ * db 'value', 0
+ *
+ * The characters go out as quoted runs, only the ones that can't be inside a quote are numbers: db 'hello', 10, 0
+ */
+
+// Long strings are split into more db lines
+#define CODEGEN_STRING_BYTES_PER_LINE 64
+
+// NASM doesn't have escapes in '' strings, a ' or a new line has to be written as a number
+static bool codegen_string_char_can_be_quoted(char c)
 {
-    const char* c_out = NULL;
-    switch (c) {
-        case '\n':
-            c_out = "10";
-            break;
-        case '\t':
-            c_out = "9";
-            break;
+    return c >= 0x20 && c <= 0x7e && c != '\'';
+}
+
+// Writes length characters of str, a 0 is added after them if terminate is set
+static void codegen_write_string_bytes(const char* str, size_t length, bool terminate)
+{
+    size_t i = 0;
+    while (i < length || terminate)
+    {
+        size_t line_end = length - i > CODEGEN_STRING_BYTES_PER_LINE ? i + CODEGEN_STRING_BYTES_PER_LINE : length;
+        const char* separator = "";
+        asm_push_no_nl("db ");
+        while (i < line_end)
+        {
+            if (!codegen_string_char_can_be_quoted(str[i]))
+            {
+                asm_push_no_nl("%s%i", separator, (unsigned char)str[i]);
+                separator = ", ";
+                i++;
+                continue;
+            }
+
+            size_t run_end = i;
+            while (run_end < line_end && codegen_string_char_can_be_quoted(str[run_end]))
+            {
+                run_end++;
+            }
+            asm_push_no_nl("%s'%.*s'", separator, (int)(run_end - i), str + i);
+            separator = ", ";
+            i = run_end;
+        }
+
+        if (i == length && terminate)
+        {
+            // The ending NULL ('\0')
+            asm_push_no_nl("%s0", separator);
+            terminate = false;
+        }
+        asm_push("");
     }
-    if (c_out)
+}
+
+// Compares the strings from their last character, a string comes right before the strings that end with it
+static int codegen_string_compare_reversed(const void* a, const void* b)
+{
+    const char* str_a = (*(struct string_table_element**)a)->str;
+    const char* str_b = (*(struct string_table_element**)b)->str;
+    size_t len_a = strlen(str_a);
+    size_t len_b = strlen(str_b);
+    while (len_a && len_b)
     {
-        asm_push_no_nl("%s, ",c_out);
+        unsigned char c_a = str_a[--len_a];
+        unsigned char c_b = str_b[--len_b];
+        if (c_a != c_b)
+        {
+            return c_a - c_b;
+        }
     }
-    return c_out != NULL;
+    return len_a ? 1 : (len_b ? -1 : 0);
 }
 
-void codegen_write_string(struct string_table_element* element)
+static bool codegen_string_is_suffix(const char* suffix, const char* str)
 {
-    // str_1: db
-    asm_push_no_nl("%s: db ", element->label);
-    size_t len = strlen(element->str);
-    for (int i = 0; i < len; ++i) {
-        char c = element->str[i];
-        // String can contain special chars (\n,\t etc.) so we need to handle them
-        bool handled = codegen_write_string_char_escaped(c);
-        // If the char was handled by the function then will go to the next line otherwise write that char into the variable
-        if (handled)
+    size_t suffix_len = strlen(suffix);
+    size_t len = strlen(str);
+    return suffix_len <= len && memcmp(str + len - suffix_len, suffix, suffix_len) == 0;
+}
+
+// Writes the host string with the labels of the strings sharing its memory, chain is ordered from the shortest string
+static void codegen_write_string_chain(struct string_table_element** chain, size_t total)
+{
+    struct string_table_element* root = chain[total - 1];
+    size_t root_len = strlen(root->str);
+    for (size_t i = total; i-- > 0;)
+    {
+        if (chain[i] != root)
         {
-            continue;
+            chain[i]->host = root;
         }
-        asm_push_no_nl("'%c',",c);
+        size_t start = root_len - strlen(chain[i]->str);
+        // The next label starts where the next shorter string does
+        size_t end = i ? root_len - strlen(chain[i - 1]->str) : root_len;
+        asm_push("%s:", chain[i]->label);
+        codegen_write_string_bytes(root->str + start, end - start, i == 0);
     }
-    // Write the ending NULL ('\0') to the string
-    asm_push_no_nl("0");
-    // Start a new line
-    asm_push("");
 }
 
 void codegen_write_strings()
 {
-#warning "Loop through the string table and write all the strings"
     struct code_generator* generator = current_process->generator;
-    vector_set_peek_pointer(generator->string_table,0);
-    struct string_table_element* element = vector_peek_ptr(generator->string_table);
-    while (element)
+    size_t total = vector_count(generator->string_table);
+    if (!total)
+    {
+        return;
+    }
+
+    // The strings are already unique, sorted from the end the strings sharing memory are next to each other
+    struct string_table_element** sorted = arena_malloc(total * sizeof(struct string_table_element*));
+    for (size_t i = 0; i < total; i++)
+    {
+        sorted[i] = vector_peek_ptr_at(generator->string_table, i);
+    }
+    qsort(sorted, total, sizeof(struct string_table_element*), codegen_string_compare_reversed);
+
+    size_t chain_start = 0;
+    for (size_t i = 0; i < total; i++)
     {
-        codegen_write_string(element);
-        element = vector_peek_ptr(generator->string_table);
+        if (i + 1 < total && codegen_string_is_suffix(sorted[i]->str, sorted[i + 1]->str))
+        {
+            continue;
+        }
+        codegen_write_string_chain(&sorted[chain_start], i - chain_start + 1);
+        chain_start = i + 1;
     }
+    arena_free(sorted);
 }
 
 void codegen_generate_rod()
@@ -2653,7 +3694,28 @@ void codegen_generate_data_section_add_ons()
 int codegen(struct compiler_process* process)
 {
     current_process = process;
+    if (process->flags & COMPILE_PROCESS_TARGET_X86_64)
+    {
+        // The integrated assembler and exec-jit only know the 32 bit instruction encodings
+        if (process->flags & (COMPILE_PROCESS_INTEGRATED_ASSEMBLER | COMPILE_PROCESS_EXEC_JIT))
+        {
+            compiler_error(process, "-m64 can't be used with the integrated assembler or exec-jit");
+        }
+        if (process->flags & COMPILE_PROCESS_PROFILE_GENERATE)
+        {
+            compiler_error(process, "-fprofile-generate only instruments the 32 bit code generator");
+        }
+        // Memory operands with a symbol are relative to rip, so the output can be linked into a position independent executable
+        asm_push("bits 64");
+        asm_push("default rel");
+    }
+    // The counters are put in by the AST code generator, the IR and the JIT don't have them
+    if (process->flags & COMPILE_PROCESS_PROFILE_GENERATE && process->flags & (COMPILE_PROCESS_USE_IR | COMPILE_PROCESS_EXEC_JIT))
+    {
+        compiler_error(process, "-fprofile-generate can't be used with -fuse-ir or exec-jit");
+    }
     scope_create_root(process);
+    codegen_mark_register_argument_functions();
     vector_set_peek_pointer(process->node_tree_vec,0);
     codegen_new_scope(0);
 
@@ -2664,6 +3726,8 @@ int codegen(struct compiler_process* process)
     // Generate the code section of the assembly
     codegen_generate_root();
     codegen_finish_scope(0);
+    // Its strings go to .rodata with the others
+    profile_generate_data(process);
 	
 	codegen_generate_data_section_add_ons();
     // Generate read only data (strings etc.)
@@ -1,50 +1,153 @@
 #include "compiler.h"
 #include <stdlib.h>
 #include <stdarg.h>
+#include "helpers/vector.h"
 
 struct lex_process_functions compiler_lex_functions = {
     .next_char = compiler_process_next_char,
     .peek_char = compiler_process_peek_char,
     .push_char = compiler_process_push_char};
 
-void compiler_node_error(struct node* node, const char* message, ...)
+// compile_source keeps the message instead of printing it
+static void compiler_add_diagnostic(struct compiler_process* compiler, int type, struct pos* pos, const char* msg, va_list args)
+{
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int length = vsnprintf(NULL, 0, msg, args_copy);
+    va_end(args_copy);
+
+    struct compiler_diagnostic diagnostic = {.type = type, .line = pos->line, .col = pos->col};
+    diagnostic.message = arena_malloc(length + 1);
+    vsnprintf(diagnostic.message, length + 1, msg, args);
+    vector_push(compiler->diagnostics, &diagnostic);
+}
+
+static void compiler_report_error(struct compiler_process* compiler, struct pos* pos, const char* msg, va_list args)
+{
+    if (compiler->flags & COMPILE_PROCESS_LIBRARY)
+    {
+        // Back to compile_source, the compilation is abandoned
+        compiler_add_diagnostic(compiler, COMPILER_DIAGNOSTIC_ERROR, pos, msg, args);
+        longjmp(*compiler->error_jump, 1);
+    }
+
+    vfprintf(stderr, msg, args);
+    fprintf(stderr, " on line %i, col %i in file %s\n", pos->line, pos->col, pos->filename);
+    exit(-1);
+}
+
+void compiler_node_error(struct compiler_process* compiler, struct node* node, const char* message, ...)
 {
 	va_list args;
 	va_start(args,message);
-	vfprintf(stderr,message,args);
+	compiler_report_error(compiler,&node->pos,message,args);
 	va_end(args);
-	
-	fprintf(stderr, " on line %i, col %i in file %s\n",node->pos.line,node->pos.col,node->pos.filename);
-	exit(-1);
 }
 
 void compiler_error(struct compiler_process *compiler, const char *msg, ...)
 {
     va_list args;
     va_start(args, msg);
-    vfprintf(stderr, msg, args);
+    compiler_report_error(compiler, &compiler->pos, msg, args);
     va_end(args);
-    fprintf(stderr, " on line %i, col %i in file %s\n", compiler->pos.line, compiler->pos.col, compiler->pos.filename);
-    exit(-1);
 }
 
 void compiler_warning(struct compiler_process *compiler, const char *msg, ...)
 {
     va_list args;
     va_start(args, msg);
-    vfprintf(stderr, msg, args);
+    if (compiler->flags & COMPILE_PROCESS_LIBRARY)
+    {
+        compiler_add_diagnostic(compiler, COMPILER_DIAGNOSTIC_WARNING, &compiler->pos, msg, args);
+    }
+    else
+    {
+        vfprintf(stderr, msg, args);
+        fprintf(stderr, " on line %i, col %i in file %s\n", compiler->pos.line, compiler->pos.col, compiler->pos.filename);
+    }
     va_end(args);
-    fprintf(stderr, " on line %i, col %i in file %s\n", compiler->pos.line, compiler->pos.col, compiler->pos.filename);
 }
 
-int compile_file(const char *filename, const char *out_filename, int flags)
+// The compile_source call running in this thread, a failed compiler_assert is reported to it
+static _Thread_local struct compiler_process* compile_source_process = NULL;
+
+void compiler_assert_failed(const char* condition, const char* file, int line, const char* function)
 {
-    struct compiler_process *process = compiler_process_create(filename, out_filename, flags);
+    if (compile_source_process)
+    {
+        compiler_error(compile_source_process, "Compiler bug, %s failed in %s at %s:%i", condition, function, file, line);
+    }
 
-    if (!process)
+    // Like assert, ./main ends with the message
+    fprintf(stderr, "%s:%i: %s: Assertion `%s' failed.\n", file, line, function, condition);
+    abort();
+}
+
+// -fuse-ir, -m64 ..., returns false if arg isn't a flag we know
+bool compile_flag_parse(const char* arg, int* flags)
+{
+    // -O2, -fno-cse ...
+    if (compiler_pass_flag_parse(arg, flags))
     {
-        return COMPILER_FAILED_WITH_ERRORS;
+        return true;
+    }
+
+    if (S_EQ(arg,"-fuse-ir"))
+    {
+        *flags |= COMPILE_PROCESS_USE_IR;
+    }
+    else if (S_EQ(arg,"-fdump-ir"))
+    {
+        *flags |= COMPILE_PROCESS_DUMP_IR;
+    }
+    else if (S_EQ(arg,"-fintegrated-as"))
+    {
+        *flags |= COMPILE_PROCESS_INTEGRATED_ASSEMBLER;
+    }
+    else if (S_EQ(arg,"-ftime-report"))
+    {
+        *flags |= COMPILE_PROCESS_TIME_REPORT;
+    }
+    else if (S_EQ(arg,"-ftime-report=json"))
+    {
+        *flags |= COMPILE_PROCESS_TIME_REPORT_JSON;
+    }
+    else if (S_EQ(arg,"-fprofile-generate"))
+    {
+        *flags |= COMPILE_PROCESS_PROFILE_GENERATE;
+    }
+    else if (S_EQ(arg,"-fprofile-use"))
+    {
+        *flags |= COMPILE_PROCESS_PROFILE_USE;
+    }
+    else if (S_EQ(arg,"-flazy-parse"))
+    {
+        *flags |= COMPILE_PROCESS_LAZY_PARSE;
+    }
+    else if (S_EQ(arg,"-fparallel-codegen"))
+    {
+        *flags |= COMPILE_PROCESS_PARALLEL_CODEGEN;
+    }
+    else if (S_EQ(arg,"-m64"))
+    {
+        *flags |= COMPILE_PROCESS_TARGET_X86_64;
     }
+    else if (S_EQ(arg,"-m32"))
+    {
+        *flags &= ~COMPILE_PROCESS_TARGET_X86_64;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+// Lexing, parsing, validation and code generation, the assembly ends up in process->ofile
+static int compile_process(struct compiler_process* process)
+{
+    compile_report_begin(process);
+
     // perfrom lexical analysis
     struct lex_process *lex_process = lex_process_create(process, &compiler_lex_functions, NULL);
     if (!lex_process)
@@ -52,29 +155,216 @@ int compile_file(const char *filename, const char *out_filename, int flags)
         return COMPILER_FAILED_WITH_ERRORS;
     }
 
+    compile_report_phase_start(process);
     if (lex(lex_process) != LEXICAL_ANALYSIS_ALL_OK)
     {
         return COMPILER_FAILED_WITH_ERRORS;
     }
+    compile_report_phase_end(process, COMPILE_PHASE_LEX);
 
     process->token_vec = lex_process->token_vec;
+    if (process->report)
+    {
+        process->report->tokens = vector_count(process->token_vec);
+    }
     // perform parsing
 
+    compile_report_phase_start(process);
     if (parse(process) != PARSE_ALL_OK)
     {
         return COMPILER_FAILED_WITH_ERRORS;
     }
+    compile_report_phase_end(process, COMPILE_PHASE_PARSE);
 	
+    compile_report_phase_start(process);
 	if (validate(process) != VALIDATION_ALL_OK)
 	{
 		return COMPILER_FAILED_WITH_ERRORS;
 	}
+    compile_report_phase_end(process, COMPILE_PHASE_VALIDATE);
+
+    if (process->flags & COMPILE_PROCESS_PROFILE_USE)
+    {
+        profile_load(process);
+    }
 
+    compile_report_phase_start(process);
+    compiler_passes_run_ast(process);
+    compile_report_phase_end(process, COMPILE_PHASE_AST_PASSES);
+
+    compile_report_phase_start(process);
     if (codegen(process) != CODEGEN_ALL_OK)
     {
         return COMPILER_FAILED_WITH_ERRORS;
     }
+    compile_report_phase_end(process, COMPILE_PHASE_CODEGEN);
 
     fclose(process->ofile);
     return COMPILER_FILE_COMPILED_OK;
-}
\ No newline at end of file
+}
+
+int compile_file(const char *filename, const char *out_filename, int flags)
+{
+    struct compiler_process *process = compiler_process_create(filename, out_filename, flags);
+
+    if (!process)
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    if (compile_process(process) != COMPILER_FILE_COMPILED_OK)
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    if (process->flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER)
+    {
+        compile_report_phase_start(process);
+        int res = assembler_assemble(process, process->assembly_text, process->object_file);
+        fclose(process->object_file);
+        free(process->assembly_text);
+        if (res != ASSEMBLER_ALL_OK)
+        {
+            return COMPILER_FAILED_WITH_ERRORS;
+        }
+        compile_report_phase_end(process, COMPILE_PHASE_ASSEMBLE);
+    }
+    compile_report_finish(process);
+    return COMPILER_FILE_COMPILED_OK;
+}
+
+int compile_file_exec_jit(const char* filename, int flags, int* exit_code_out)
+{
+    struct compiler_process *process = compiler_process_create(filename, NULL, flags | COMPILE_PROCESS_EXEC_JIT);
+
+    if (!process)
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    if (compile_process(process) != COMPILER_FILE_COMPILED_OK)
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    // The report is printed before the program runs, its time isn't part of the compilation
+    compile_report_finish(process);
+    int res = jit_execute(process, process->assembly_text, exit_code_out);
+    free(process->assembly_text);
+    if (res != ASSEMBLER_ALL_OK)
+    {
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+    return COMPILER_FILE_COMPILED_OK;
+}
+
+// The output the caller gets, the data and the messages are copied so nothing points into the process
+static void compile_source_output(struct compiler_process* process, int res, struct compiler_output* output)
+{
+    const char* data = process->flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER ? process->object_data : process->assembly_text;
+    size_t size = process->flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER ? process->object_data_size : process->assembly_text_size;
+    if (res == COMPILER_FILE_COMPILED_OK && data)
+    {
+        output->data = malloc(size + 1);
+        memcpy(output->data, data, size);
+        // The assembly can be used as a string
+        output->data[size] = 0;
+        output->size = size;
+    }
+
+    output->total_diagnostics = vector_count(process->diagnostics);
+    output->diagnostics = calloc(output->total_diagnostics, sizeof(struct compiler_diagnostic));
+    for (int i = 0; i < output->total_diagnostics; i++)
+    {
+        output->diagnostics[i] = *(struct compiler_diagnostic*)vector_at(process->diagnostics, i);
+        output->diagnostics[i].message = strdup(output->diagnostics[i].message);
+    }
+
+    if (process->report)
+    {
+        output->report = malloc(sizeof(struct compile_report));
+        memcpy(output->report, process->report, sizeof(struct compile_report));
+    }
+}
+
+// Closes the in memory streams, they may still be open if an error jumped out of the compilation
+static void compile_source_close_streams(struct compiler_process* process)
+{
+    if (process->ofile)
+    {
+        fclose(process->ofile);
+        process->ofile = NULL;
+    }
+    if (process->object_file)
+    {
+        fclose(process->object_file);
+        process->object_file = NULL;
+    }
+    fclose(process->cfile.fp);
+    // The streams allocate with malloc, these don't belong to the arena
+    free(process->assembly_text);
+    free(process->object_data);
+}
+
+int compile_source(const char* source, size_t source_size, int flags, struct compiler_output* output)
+{
+    memset(output, 0, sizeof(struct compiler_output));
+    // Nothing may be run or printed, the time report is given back in output->report
+    flags &= ~(COMPILE_PROCESS_EXEC_JIT | COMPILE_PROCESS_DUMP_IR);
+
+    // The compiler doesn't free its tokens and nodes, everything this compilation allocates is freed at the end together
+    struct arena* arena = arena_create();
+    struct arena* previous_arena = arena_use(arena);
+    struct compiler_process* process = compiler_process_create_from_source(source, source_size, flags);
+    if (!process)
+    {
+        arena_use(previous_arena);
+        arena_destroy(arena);
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    jmp_buf error_jump;
+    process->error_jump = &error_jump;
+    struct compiler_process* previous_process = compile_source_process;
+    compile_source_process = process;
+    // Changed after setjmp, it has to be volatile to keep its value when an error jumps back
+    volatile int res = COMPILER_FAILED_WITH_ERRORS;
+    if (setjmp(error_jump) == 0)
+    {
+        res = compile_process(process);
+        if (res == COMPILER_FILE_COMPILED_OK)
+        {
+            // compile_process closed the assembly stream, assembly_text is complete
+            process->ofile = NULL;
+        }
+        if (res == COMPILER_FILE_COMPILED_OK && process->flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER)
+        {
+            compile_report_phase_start(process);
+            res = assembler_assemble(process, process->assembly_text, process->object_file) == ASSEMBLER_ALL_OK ? COMPILER_FILE_COMPILED_OK : COMPILER_FAILED_WITH_ERRORS;
+            fclose(process->object_file);
+            process->object_file = NULL;
+            compile_report_phase_end(process, COMPILE_PHASE_ASSEMBLE);
+        }
+    }
+    compile_source_process = previous_process;
+    // Stops counting even if an error jumped out of a phase
+    compile_report_finish(process);
+
+    compile_source_output(process, res, output);
+    compile_source_close_streams(process);
+    arena_use(previous_arena);
+    arena_destroy(arena);
+    return res;
+}
+
+void compiler_output_free(struct compiler_output* output)
+{
+    for (int i = 0; i < output->total_diagnostics; i++)
+    {
+        free(output->diagnostics[i].message);
+    }
+    free(output->diagnostics);
+    free(output->data);
+    free(output->report);
+    memset(output, 0, sizeof(struct compiler_output));
+}
@@ -3,6 +3,9 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include "helpers/arena.h"
 
 #define S_EQ(str, str2) \
     (str && str2 && (strcmp(str, str2) == 0))
@@ -140,6 +143,9 @@ struct lex_process
     struct buffer *parenthesis_buffer;
     struct lex_process_functions *function;
     void *private;
+
+    // The token that is being read, it is copied into token_vec when it is finished
+    struct token tmp_token;
 };
 
 enum
@@ -198,8 +204,17 @@ struct string_table_element
     //The assembly label that points to the memory where the string can be found
     const char label[50];
 
+    // The next string with the same hash
+    struct string_table_element* next_in_bucket;
+
+    // A longer string that ends with this one, "abc" can point into "xabc", the label is placed inside the host instead of
+    // writing the string again. NULL when the string is written out
+    struct string_table_element* host;
 };
 
+// Number of hash buckets of the string table, a string is found without comparing it to every other string
+#define CODEGEN_STRING_TABLE_BUCKETS 4096
+
 
 
 struct code_generator
@@ -215,6 +230,8 @@ struct code_generator
 	} _switch;
     // vector of struct string_table_elements*
     struct vector* string_table;
+    // The same strings by their hash, CODEGEN_STRING_TABLE_BUCKETS lists linked with next_in_bucket
+    struct string_table_element** string_buckets;
     // vector of struct codegen_entry_point*
     struct vector* entry_points;
     // vector of struct codegen_exit_point*
@@ -226,6 +243,33 @@ struct code_generator
     // vector of struct response*
     struct vector* responses;
 
+    // The function that is being generated, NULL in the global scope
+    struct node* current_function;
+    // The section the global variables are written into at the moment
+    const char* current_data_section;
+    // The last number given to a label, labels have to be unique in one file
+    int label_count;
+    // Put in the str_ and function_call_ labels after the prefix, "" unless -fparallel-codegen generates the function
+    const char* label_namespace;
+
+    // -fprofile-generate, vector of struct profile_site, the index of a site is the index of its counter
+    struct vector* profile_sites;
+
+    // -fprofile-use, the blocks that rarely run are collected here and written after the end of the function
+    FILE* cold_blocks;
+    char* cold_blocks_text;
+    size_t cold_blocks_size;
+    // The assembly goes to cold_blocks instead of the output
+    bool in_cold_block;
+};
+
+// A counter of -fprofile-generate, the profile file has a line for every site
+struct profile_site
+{
+    const char* function;
+    struct pos pos;
+    // PROFILE_COUNTER_ENTRIES or PROFILE_COUNTER_BODY
+    int counter;
 };
 struct resolver_process;
 
@@ -246,6 +290,22 @@ struct compiler_process
     struct vector* node_tree_vec;
     FILE *ofile;
 
+    // With the integrated assembler ofile collects the assembly in memory and the object is written here
+    FILE* object_file;
+    char* assembly_text;
+    size_t assembly_text_size;
+
+    // compile_source collects the object in memory
+    char* object_data;
+    size_t object_data_size;
+
+    // With COMPILE_PROCESS_LIBRARY errors jump back to compile_source instead of exiting, vector of struct compiler_diagnostic
+    jmp_buf* error_jump;
+    struct vector* diagnostics;
+
+    // NULL without -ftime-report
+    struct compile_report* report;
+
 
     struct
     {
@@ -262,6 +322,20 @@ struct compiler_process
         struct vector* tables;
     } symbols;
 
+    // State of the parser, it belongs to this compilation so more files can be compiled at the same time
+    struct
+    {
+        struct fixup_system* fixup_sys;
+        struct token* last_token;
+        struct node* blank_node;
+        // Anonymous structures get a generated name, customtypename_1
+        int random_type_index;
+
+        // The body and the function new nodes are created in
+        struct node* current_body;
+        struct node* current_function;
+    } parser;
+
     // Pointer to our code generator
     struct code_generator* generator;
     struct resolver_process* resolver;
@@ -318,6 +392,7 @@ enum
     NODE_TYPE_UNION,
     NODE_TYPE_BRACKET,
     NODE_TYPE_CAST,
+    NODE_TYPE_INITIALIZER_LIST,
     NODE_TYPE_BLANK
 
 };
@@ -393,6 +468,9 @@ struct stack_frame_element
     // Offset this element is from the base pointer
     int offset_from_bp;
 
+    // How many bytes the element takes up, 0 for a single push. A structure copied to the stack with one instruction is one element
+    size_t size;
+
     struct stack_frame_data data;
 };
 
@@ -417,6 +495,8 @@ enum
 
 
 void stackframe_pop(struct node* func_node);
+// How many bytes of the stack the element takes up
+size_t stackframe_element_size(struct stack_frame_element* element);
 struct stack_frame_element* stackframe_back(struct node* func_node);
 // Allows user to check if the value on stack is the one they are expecting (that's why it doesn't throw error)
 struct stack_frame_element* stackframe_back_expect(struct node*func_node, int expecting_type, const char*expected_name);
@@ -454,6 +534,21 @@ enum
 	UNARY_FLAG_IS_LEFT_OPERANDED_UNARY = 0b00000001
 };
 
+// -fprofile-use, what the profiled program counted at a node
+struct node_profile
+{
+    // How many times the function was called, the if, loop or switch was reached or the case was jumped to
+    unsigned long long entries;
+    // How many times the body of the if or the loop ran, the else of an if ran entries - body times
+    unsigned long long body;
+};
+
+enum
+{
+    PROFILE_COUNTER_ENTRIES,
+    PROFILE_COUNTER_BODY
+};
+
 struct node;
 struct unary
 {
@@ -487,6 +582,9 @@ struct  node
         struct node* function;
     } binded;
 
+    // -fprofile-use, NULL if the profile has nothing for this node
+    struct node_profile* profile;
+
     union
     {
         struct exp
@@ -529,6 +627,12 @@ struct  node
             struct node* inner;
         }bracket ;
 
+        struct initializer_list
+        {
+            // int x[3] = {1, 2, 3} -> vector of struct node*, an element can be another initializer list
+            struct vector* values;
+        } initializer;
+
         struct _struct
         {
             const char* name;
@@ -598,10 +702,15 @@ struct  node
             // Pointer to the function body node, NULL if this is a function prototype
             struct node* body_n;
 
+            // -flazy-parse, the index of the '{' of a body that wasn't parsed yet in the tokens, 0 if there is none
+            int lazy_body_token;
+
             struct stack_frame
             {
                 // A vector of stack frame elements
                 struct vector* elements;
+                // The size of all the elements in bytes
+                size_t size;
             } frame;
 
             // Stack size for all variables inside this functions
@@ -1110,20 +1219,263 @@ enum
 enum
 {
     // The flag is set for native functions
-    FUNCTION_NODE_FLAG_IS_NATIVE = 0b00000001
-
+    FUNCTION_NODE_FLAG_IS_NATIVE = 0b00000001,
+    // Static function whose first arguments are passed in ecx and edx instead of being pushed
+    FUNCTION_NODE_FLAG_REGISTER_ARGUMENTS = 0b00000010,
 };
 
+// How many arguments the register calling convention passes in registers, the rest are pushed just like cdecl
+#define FUNCTION_REGISTER_ARGUMENTS 2
+
 enum
 {
     COMPILE_PROCESS_EXECUTE_NASM = 0b00000001,
     COMPILE_PROCESS_EXPORT_AS_OBJECT = 0b00000010,
+    // Functions are lowered to the intermediate representation before generating assembly
+    COMPILE_PROCESS_USE_IR = 0b00000100,
+    // The intermediate representation of every function is written to stderr
+    COMPILE_PROCESS_DUMP_IR = 0b00001000,
+    // The output file is an ELF32 object made by the integrated assembler instead of NASM text
+    COMPILE_PROCESS_INTEGRATED_ASSEMBLER = 0b00010000,
+    // The program is run inside the compiler process, nothing is written to a file
+    COMPILE_PROCESS_EXEC_JIT = 0b00100000,
+    // x86-64 System V code instead of 32 bit cdecl code, pointers are 8 bytes
+    COMPILE_PROCESS_TARGET_X86_64 = 0b01000000,
+    // Compiled by compile_source, nothing is printed and errors are returned as diagnostics instead of exiting
+    COMPILE_PROCESS_LIBRARY = 0b10000000,
+    // -ftime-report, the time and memory of every phase is printed to stderr
+    COMPILE_PROCESS_TIME_REPORT = 0b100000000,
+    // -ftime-report=json, the same as one JSON object
+    COMPILE_PROCESS_TIME_REPORT_JSON = 0b1000000000,
+    // -O0, -O1, -O2 are kept in these two bits, see compiler_optimization_level
+    COMPILE_PROCESS_OPTIMIZATION_LEVEL_UNIT = 0b10000000000,
+    COMPILE_PROCESS_OPTIMIZATION_LEVEL_MASK = 0b110000000000,
+};
+
+enum
+{
+    COMPILER_PASS_DEADCODE,
+    COMPILER_PASS_UNREACHABLE,
+    COMPILER_PASS_CSE,
+    COMPILER_PASS_LICM,
+    // Decided by the code generators while they generate a function, see compiler_pass_enabled
+    COMPILER_PASS_TAIL_CALLS,
+    COMPILER_PASS_REGISTER_ARGUMENTS,
+    COMPILER_PASS_BLOCK_COPY,
+    COMPILER_TOTAL_PASSES
+};
+
+// -fno-<pass>, every pass has a bit in the compile flags after the optimization level
+#define COMPILE_PROCESS_PASS_DISABLED(pass) (1 << (12 + (pass)))
+
+// After the -fno- bits, they move when a pass is added
+enum
+{
+    // -fprofile-generate, the program counts its function calls, branches and loops and writes them to a file at exit
+    COMPILE_PROCESS_PROFILE_GENERATE = COMPILE_PROCESS_PASS_DISABLED(COMPILER_TOTAL_PASSES),
+    // -fprofile-use, the counts of a -fprofile-generate run are read into the nodes before code generation
+    COMPILE_PROCESS_PROFILE_USE = COMPILE_PROCESS_PROFILE_GENERATE << 1,
+    // -flazy-parse, the bodies of static functions are only parsed if something in the file refers to them
+    COMPILE_PROCESS_LAZY_PARSE = COMPILE_PROCESS_PROFILE_GENERATE << 2,
+    // -fparallel-codegen, the functions are generated by worker processes at the same time
+    COMPILE_PROCESS_PARALLEL_CODEGEN = COMPILE_PROCESS_PROFILE_GENERATE << 3,
+    // The assembly only goes to the output file, the driver compiles several files at once and stdout would mix them
+    COMPILE_PROCESS_NO_ECHO = COMPILE_PROCESS_PROFILE_GENERATE << 4,
+    // The compiler runs on one of several threads of its process, the driver pool, nothing may fork
+    COMPILE_PROCESS_THREADED = COMPILE_PROCESS_PROFILE_GENERATE << 5,
+};
+
+enum
+{
+    COMPILER_DIAGNOSTIC_ERROR,
+    COMPILER_DIAGNOSTIC_WARNING
+};
+
+struct compiler_diagnostic
+{
+    int type;
+    char* message;
+    int line;
+    int col;
+};
+
+// What compile_source gives back, it belongs to the caller and is freed with compiler_output_free
+struct compiler_output
+{
+    // The assembly text, or the ELF object with COMPILE_PROCESS_INTEGRATED_ASSEMBLER
+    char* data;
+    size_t size;
+
+    struct compiler_diagnostic* diagnostics;
+    int total_diagnostics;
+
+    // With COMPILE_PROCESS_TIME_REPORT the measurements are given back here instead of being printed, NULL without it
+    struct compile_report* report;
 };
 
 
+// Part of the key of the compilation cache, has to change when the generated code changes
+#define COMPILER_VERSION "0.4"
+
+// 256 MB
+#define COMPILER_CACHE_DEFAULT_MAX_SIZE (256 * 1024 * 1024)
+
+struct compiler_cache
+{
+    // Where the entries are stored, it is created if it doesn't exist
+    const char* directory;
+    // Bytes the entries can use together, the least recently used are removed above it. 0 means no limit
+    size_t max_size;
+};
+
 int compile_file(const char *filename, const char *out_filename, int flags);
+// compile_file, the output is taken from the cache if the same source was compiled with the same flags before.
+// cache can be NULL, then it is just compile_file
+int compile_file_cached(struct compiler_cache* cache, const char* filename, const char* out_filename, int flags);
+// $XDG_CACHE_HOME/c_compiler or ~/.cache/c_compiler
+const char* compiler_cache_default_directory();
+// Compiles the file and runs its main function in process, the return value of main is written to exit_code_out
+int compile_file_exec_jit(const char* filename, int flags, int* exit_code_out);
+enum
+{
+    COMPILE_PHASE_LEX,
+    COMPILE_PHASE_PARSE,
+    COMPILE_PHASE_VALIDATE,
+    // The AST pipeline of the pass manager
+    COMPILE_PHASE_AST_PASSES,
+    COMPILE_PHASE_CODEGEN,
+    COMPILE_PHASE_ASSEMBLE,
+    COMPILE_TOTAL_PHASES
+};
+
+struct compile_phase_report
+{
+    bool ran;
+    double wall_ms;
+    // Only the thread that compiles the file
+    double cpu_ms;
+    // How much the peak memory of the process grew
+    long peak_rss_delta_kb;
+    size_t allocations;
+    size_t allocated_bytes;
+};
+
+// The IR passes run inside the codegen phase, their time is part of it too
+struct compile_pass_report
+{
+    int runs;
+    double wall_ms;
+    double cpu_ms;
+};
+
+struct compile_report
+{
+    struct compile_phase_report phases[COMPILE_TOTAL_PHASES];
+    struct compile_pass_report passes[COMPILER_TOTAL_PASSES];
+
+    size_t tokens;
+    size_t nodes;
+    size_t resolver_entities;
+    size_t stack_frame_elements;
+    size_t instructions;
+
+    // Where the phase being measured started
+    struct
+    {
+        double wall_ms;
+        double cpu_ms;
+        long peak_rss_kb;
+        size_t allocations;
+        size_t allocated_bytes;
+    } start;
+
+    // Where the pass being measured started
+    struct
+    {
+        double wall_ms;
+        double cpu_ms;
+    } pass_start;
+};
+
+// The report of the compilation running on this thread, NULL without -ftime-report
+extern _Thread_local struct compile_report* compile_report_current;
+#define COMPILE_REPORT_COUNT(counter) \
+    do { if (compile_report_current) compile_report_current->counter++; } while (0)
+
+void compile_report_begin(struct compiler_process* process);
+void compile_report_phase_start(struct compiler_process* process);
+void compile_report_phase_end(struct compiler_process* process, int phase);
+void compile_report_pass_start(struct compiler_process* process);
+void compile_report_pass_end(struct compiler_process* process, int pass);
+// Prints the report and stops counting
+void compile_report_finish(struct compiler_process* process);
+
+// -O0, -O1 or -O2
+int compiler_optimization_level(int flags);
+const char* compiler_pass_name(int pass);
+// True if a pass the code generators apply themselves is on at this level and not turned off with -fno-<name>
+bool compiler_pass_enabled(struct compiler_process* process, int pass);
+// -O<level> and -fno-<pass>, returns false if arg isn't one of them
+bool compiler_pass_flag_parse(const char* arg, int* flags);
+void compiler_passes_run_ast(struct compiler_process* process);
+
+// -fprofile-generate and -fprofile-use
+#define PROFILE_FILE_ENV "C_COMPILER_PROFILE"
+#define PROFILE_DEFAULT_FILE "compiler.profile"
+// $C_COMPILER_PROFILE, compiler.profile without it
+const char* profile_file_path();
+// Counts the node at the place the code generator is at
+void profile_generate_counter(struct compiler_process* process, struct node* node, int counter);
+// The counter of the function, the first call of any counted function also makes the profile be written at exit
+void profile_generate_function_entry(struct compiler_process* process, struct node* func_node);
+// The counters and the code writing them, after all the functions are generated
+void profile_generate_data(struct compiler_process* process);
+// Reads the profile file into the profile of the nodes
+void profile_load(struct compiler_process* process);
+
+// -fparallel-codegen, generates the functions of the root in worker processes, false if it generated nothing
+bool codegen_parallel_generate_root(struct compiler_process* process);
+
+// -fuse-ir, -m64 ..., returns false if arg isn't a flag we know
+bool compile_flag_parse(const char* arg, int* flags);
+
+// The server listens on $C_COMPILER_SOCKET, /tmp/c_compiler-<uid>.sock without it
+#define COMPILE_SERVER_SOCKET_ENV "C_COMPILER_SOCKET"
+// The working directory and the arguments of a client together
+#define COMPILE_SERVER_MAX_REQUEST_SIZE (1024 * 1024)
+
+// Followed by size bytes: the working directory of the client and its arguments without the program name, each with its terminator
+struct compile_server_request
+{
+    uint32_t argc;
+    uint32_t size;
+};
+
+// Followed by what the client prints to stdout and to stderr
+struct compile_server_response
+{
+    int32_t exit_code;
+    // The server can't do this request the way ./main does, the client has to run ./main
+    uint32_t run_locally;
+    uint32_t stdout_size;
+    uint32_t stderr_size;
+};
+
+const char* compile_server_default_socket();
+// Compiles the requests of clients until the server is killed
+int compile_server_run(const char* socket_path);
+
+// Compiles the files at the same time on jobs workers (0 = one for every core) and links them into out_filename.
+// cache can be NULL
+int compile_files(const char** filenames, int total_files, const char* out_filename, int flags, int jobs, struct compiler_cache* cache);
+// Compiles source_size bytes of source without touching files, stdout or anything shared, it can be called from any thread.
+// Errors don't exit, they are in output->diagnostics and COMPILER_FAILED_WITH_ERRORS is returned
+int compile_source(const char* source, size_t source_size, int flags, struct compiler_output* output);
+void compiler_output_free(struct compiler_output* output);
 
 struct compiler_process *compiler_process_create(const char *filename, const char *file_name_out, int flags);
+// The source is read from memory and the output is collected in memory, see compile_source
+struct compiler_process* compiler_process_create_from_source(const char* source, size_t source_size, int flags);
 
 char compiler_process_next_char(struct lex_process *lex_process);
 
@@ -1142,9 +1494,31 @@ int lex(struct lex_process *process);
 int parse(struct compiler_process* process);
 int codegen(struct compiler_process* process);
 struct code_generator* codegenerator_new(struct compiler_process* process);
+void asm_push(const char* ins, ...);
+void asm_push_no_nl(const char* ins,...);
+void asm_push_ins_push(const char* fmt, int stack_entity_type, const char* stack_entity_name,...);
+int asm_push_ins_pop(const char* fmt, int expecting_stack_entity_type, const char* expecting_stack_entity_name,...);
+void asm_push_ebp();
+void asm_pop_ebp_no_stack_frame_restore();
+void codegen_stack_sub(size_t stack_size);
+void codegen_stack_add(size_t stack_size);
+void codegen_stack_add_no_compile_time_stack_frame_restore(size_t stack_size);
+const char* codegen_register_string(const char* str);
+// A string a -fparallel-codegen worker registered, its label is already in the worker's code
+const char* codegen_register_string_with_label(const char* str, const char* label);
+void codegen_data_section_add(const char* data, ...);
+void codegen_generate_root_node(struct node* node);
+struct resolver_entity* codegen_register_function(struct node* func_node,int flags);
+int codegen_label_count();
+size_t codegen_function_argument_stack_size(struct node* func_node);
+// Sets {size} bytes at [base+offset] to zero
+void codegen_generate_zero_fill(const char* base, int offset, size_t size);
 void compiler_error(struct compiler_process *compiler, const char *msg, ...);
-void compiler_node_error(struct node* node, const char* message, ...);
+void compiler_node_error(struct compiler_process* compiler, struct node* node, const char* message, ...);
 void compiler_warning(struct compiler_process *compiler, const char *msg, ...);
+// assert for the checks a source can reach, under compile_source the failure is an error result instead of an abort
+#define compiler_assert(condition) ((condition) ? (void)0 : compiler_assert_failed(#condition, __FILE__, __LINE__, __func__))
+void compiler_assert_failed(const char* condition, const char* file, int line, const char* function);
 struct symbol* symresolver_register_symbol(struct compiler_process* process, const char* sym_name, int type, void* data);
 //Builds tokens for the input string
 struct lex_process* token_build_for_string(struct compiler_process* compiler,const char*str);
@@ -1196,6 +1570,7 @@ void make_tenary_node(struct node*true_node, struct node* false_node);
 void make_cast_node(struct datatype* dtype, struct node* operand_node);
 void make_union_node(const char* name, struct node* body_node);
 void make_unary_node(const char* op, struct node* operand_node,int flags);
+void make_initializer_list_node(struct vector* values);
 void make_default_node();
 bool keyword_is_datatype(const char *str);
 
@@ -1203,7 +1578,7 @@ struct node* node_pop();
 struct node* node_peek();
 struct node* node_peek_or_null();
 void node_push(struct node* node);
-void node_set_vector(struct vector* vec, struct vector* root_vec);
+void node_set_process(struct compiler_process* process);
 bool node_is_expressionable(struct node* node);
 struct node* node_peek_expressionable_or_null();
 bool node_is_struct_or_union_variable(struct node* node);
@@ -1243,6 +1618,12 @@ struct resolver_entity* resolver_result_entity_next(struct resolver_entity* enti
 struct resolver_entity* resolver_result_entity(struct resolver_result*result);
 bool node_is_expression(struct node* node,const char* op);
 bool node_valid(struct node* node);
+typedef bool(*NODE_WALK_FUNCTION)(struct node* node, void* private);
+void node_walk(struct node* node, NODE_WALK_FUNCTION func, void* private);
+
+// Removes unreachable statements, constant branches, unread locals and unused static functions from the tree
+void deadcode_eliminate(struct compiler_process* process);
+bool deadcode_constant_value(struct node* node, long long* value_out);
 bool is_array_node(struct node* node);
 bool is_node_assignment(struct node* node);
 bool is_unary_operator(const char* op);
@@ -1262,6 +1643,17 @@ size_t array_brackets_calculate_size(struct datatype* dtype, struct array_bracke
 
 int array_total_indexes(struct datatype* dtype);
 
+/*
+ * Called for every element of a brace initializer that gets a value, offset is from the start of the variable.
+ * A string that initializes a char array is one element, dtype is the char array then
+ */
+typedef void (*INITIALIZER_ELEMENT_FUNCTION)(struct node* value_node, struct datatype* dtype, int offset, void* private);
+void initializer_for_each_element(struct compiler_process* process, struct datatype* dtype, struct node* value_node, INITIALIZER_ELEMENT_FUNCTION func, void* private);
+// char name[8] = "abc" -> 4, the terminating zero is copied only if it fits
+size_t initializer_string_length(struct node* string_node, struct datatype* dtype);
+// True if every byte of the variable gets a value from the initializer, otherwise it has to be zeroed first
+bool initializer_covers_variable(struct compiler_process* process, struct datatype* dtype, struct node* value_node);
+
 bool datatype_is_struct_or_union(struct datatype* dtype);
 struct datatype* datatype_thats_a_pointer(struct datatype* d1, struct datatype* d2);
 struct datatype* datatype_pointer_reduce(struct datatype* datatype, int by);
@@ -1285,6 +1677,10 @@ size_t datatype_size_no_ptr(struct datatype* dtype);
 
 size_t datatype_size(struct datatype* dtype);
 
+// The size of a pointer on the target, set when the compile process is created
+void datatype_set_pointer_size(size_t size);
+size_t datatype_pointer_size();
+
 size_t datatype_size_for_array_access(struct datatype* dtype);
 
 struct node* variable_node(struct node* node);
@@ -1309,6 +1705,10 @@ struct symbol* symresolver_get_symbol_for_native_function(struct compiler_proces
 size_t function_node_argument_stack_addition(struct node* node);
 bool function_node_is_prototype(struct node* node);
 struct vector* function_node_argument_vec(struct node* node);
+// How many of the arguments are passed in registers, 0 for cdecl functions
+int function_node_register_argument_count(struct node* node);
+// ecx, edx
+const char* function_node_argument_register(int index);
 size_t function_node_stack_size(struct node* node);
 struct resolver_default_entity_data* resolver_default_entity_private(struct resolver_entity* entity);
 struct resolver_default_scope_data* resolver_default_scope(struct resolver_scope* scope);
@@ -1435,4 +1835,298 @@ bool fixups_resolve(struct fixup_system* system);
 
 bool unary_operand_compatible(struct token* token);
 bool is_parentheses(const char* op);
+/*
+ * Intermediate representation
+ *
+ * Functions are lowered from the AST into basic blocks of three address instructions (dst = a OP b) working on an unlimited number of virtual registers,
+ * those blocks are then lowered into the same NASM output the AST code generator produces. Locals and arguments live in memory and are accessed with load/store instructions
+ */
+enum
+{
+    IR_TYPE_VOID,
+    IR_TYPE_I8,
+    IR_TYPE_U8,
+    IR_TYPE_I16,
+    IR_TYPE_U16,
+    IR_TYPE_I32,
+    IR_TYPE_U32,
+    IR_TYPE_PTR
+};
+
+enum
+{
+    IR_VALUE_NONE,
+    // %5 -> virtual register number 5
+    IR_VALUE_VREG,
+    // 50
+    IR_VALUE_CONSTANT,
+    // The address of a string literal
+    IR_VALUE_STRING,
+    // A global variable or function (+offset), the memory of it when used by load/store/addr, otherwise its address
+    IR_VALUE_SYMBOL,
+    // A local variable or argument (+offset), only valid as the memory operand of load/store/addr
+    IR_VALUE_LOCAL
+};
+
+struct ir_value
+{
+    int type;
+    union
+    {
+        int vreg;
+        long long constant;
+        const char* string;
+        const char* symbol;
+        // Index inside ir_function->locals
+        int local;
+    };
+
+    // Offset added to the symbol or local
+    int offset;
+};
+
+enum
+{
+    // dst = a
+    IR_OP_MOVE,
+    // dst = &a -> a is a symbol or a local
+    IR_OP_ADDRESS,
+    // dst = *a -> a is a symbol, a local or a register holding an address
+    IR_OP_LOAD,
+    // *a = b
+    IR_OP_STORE,
+    // Sets b bytes at a to zero, b is a constant
+    IR_OP_ZERO,
+    // dst = a OP b
+    IR_OP_ADD,
+    IR_OP_SUB,
+    IR_OP_MUL,
+    IR_OP_DIV,
+    IR_OP_MOD,
+    IR_OP_AND,
+    IR_OP_OR,
+    IR_OP_XOR,
+    IR_OP_SHL,
+    IR_OP_SHR,
+    // dst = OP a
+    IR_OP_NEG,
+    IR_OP_NOT,
+    // dst = a OP b ? 1 : 0 -> the type of the instruction is the type of the operands
+    IR_OP_EQ,
+    IR_OP_NE,
+    IR_OP_LT,
+    IR_OP_LE,
+    IR_OP_GT,
+    IR_OP_GE,
+    // dst = (type) a -> a has the type from_type
+    IR_OP_CONVERT,
+    // dst = a(args...)
+    IR_OP_CALL,
+    // goto targets[0]
+    IR_OP_JUMP,
+    // if (a) goto targets[0] else goto targets[1]
+    IR_OP_BRANCH,
+    // return a
+    IR_OP_RETURN
+};
+
+struct ir_block;
+
+struct ir_instruction
+{
+    int op;
+    // The type the instruction works with (the memory type for load/store)
+    int type;
+    // Only used by IR_OP_CONVERT
+    int from_type;
+    int flags;
+
+    struct ir_value dst;
+    struct ir_value a;
+    struct ir_value b;
+
+    // Vector of struct ir_value, only used by IR_OP_CALL
+    struct vector* args;
+
+    // Jump targets for IR_OP_JUMP and IR_OP_BRANCH
+    struct ir_block* targets[2];
+
+    // The node the instruction was created for
+    struct node* node;
+};
+
+struct ir_block
+{
+    int id;
+    // Vector of struct ir_instruction*, the last instruction is always a jump, branch or return
+    struct vector* instructions;
+    // What the block was created for i.e. "for.cond"
+    const char* name;
+};
+
+enum
+{
+    IR_LOCAL_FLAG_ARGUMENT = 0b00000001,
+    // &local was computed so it might be accessed through a pointer
+    IR_LOCAL_FLAG_ADDRESS_TAKEN = 0b00000010
+};
+
+struct ir_local
+{
+    int id;
+    int flags;
+    const char* name;
+    size_t size;
+    size_t align;
+    // Index of the argument for IR_LOCAL_FLAG_ARGUMENT
+    int argument_index;
+    // Offset from the base pointer, set when lowering to assembly
+    int offset;
+    struct node* var_node;
+};
+
+struct ir_function
+{
+    struct node* node;
+    const char* name;
+    int return_type;
+
+    // Vector of struct ir_block*, in the order they will be emitted. The first block is the entry
+    struct vector* blocks;
+    // Vector of struct ir_local*
+    struct vector* locals;
+    int vreg_count;
+    int block_count;
+
+    // Set if the function uses something the IR can't express yet, the AST code generator will generate it instead
+    const char* unsupported_reason;
+};
+
+size_t ir_type_size(int type);
+bool ir_type_is_signed(int type);
+const char* ir_type_name(int type);
+struct ir_value ir_value_none();
+struct ir_value ir_value_vreg(int vreg);
+struct ir_value ir_value_constant(long long constant);
+struct ir_value ir_value_string(const char* str);
+struct ir_value ir_value_symbol(const char* name, int offset);
+struct ir_value ir_value_local(int local, int offset);
+bool ir_value_is_vreg(struct ir_value* value, int vreg);
+bool ir_value_equal(struct ir_value* a, struct ir_value* b);
+typedef void (*IR_OPERAND_FUNCTION)(struct ir_value* value, void* private);
+void ir_instruction_for_each_operand(struct ir_instruction* instruction, IR_OPERAND_FUNCTION func, void* private);
+int* ir_function_definition_counts(struct ir_function* function);
+struct ir_function* ir_function_new(struct node* func_node);
+int ir_function_new_vreg(struct ir_function* function);
+struct ir_local* ir_function_new_local(struct ir_function* function, const char* name, size_t size, size_t align, int flags);
+struct ir_local* ir_function_local(struct ir_function* function, int local);
+struct ir_block* ir_block_new(struct ir_function* function, const char* name);
+struct ir_instruction* ir_instruction_new(int op, int type);
+void ir_block_add_instruction(struct ir_block* block, struct ir_instruction* instruction);
+struct ir_instruction* ir_block_terminator(struct ir_block* block);
+bool ir_instruction_is_terminator(struct ir_instruction* instruction);
+bool ir_op_is_binary(int op);
+bool ir_op_is_comparison(int op);
+int ir_block_successors(struct ir_block* block, struct ir_block** successors_out);
+void ir_function_dump(struct ir_function* function, FILE* out);
+void ir_function_remove_unreachable_blocks(struct ir_function* function);
+
+struct ir_function* ir_build_function(struct compiler_process* process, struct node* func_node);
+void ircodegen_generate_function(struct compiler_process* process, struct ir_function* function);
+// The same for the x86-64 target
+void ircodegen64_generate_function(struct compiler_process* process, struct ir_function* function);
+
+// Computes repeated expressions and loads only once inside every basic block
+void ir_eliminate_common_subexpressions(struct ir_function* function);
+// Moves computations that give the same result on every iteration in front of the loop
+void ir_hoist_loop_invariants(struct ir_function* function);
+// The IR pipeline of the pass manager
+void compiler_passes_run_ir(struct compiler_process* process, struct ir_function* function);
+
+/*
+ * Integrated assembler, encodes the NASM text the code generator writes into machine code
+ * and writes it as an ELF32 relocatable object, so nasm doesn't have to be started for every file
+ */
+enum
+{
+    ASSEMBLER_SECTION_TEXT,
+    ASSEMBLER_SECTION_DATA,
+    ASSEMBLER_SECTION_BSS,
+    ASSEMBLER_SECTION_RODATA,
+    ASSEMBLER_TOTAL_SECTIONS
+};
+
+struct assembler_symbol
+{
+    const char* name;
+    // ASSEMBLER_SECTION_*, only valid if the symbol is defined
+    int section;
+    unsigned int offset;
+    bool is_defined;
+    // global or extern
+    bool is_global;
+
+    // Index inside the symbol table of the object file, set by the ELF writer
+    int elf_index;
+};
+
+enum
+{
+    // The address of the symbol, i.e mov eax, str_1 or dd str_1
+    ASSEMBLER_RELOCATION_ABSOLUTE,
+    // Distance from the end of the field to the symbol, i.e call printf
+    ASSEMBLER_RELOCATION_RELATIVE
+};
+
+struct assembler_relocation
+{
+    int type;
+    // Offset of the 4 byte field inside the section
+    unsigned int offset;
+    struct assembler_symbol* symbol;
+    // Added to the address of the symbol
+    int addend;
+};
+
+struct assembler_section
+{
+    const char* name;
+    // The bytes of the section, .bss only has a size
+    struct buffer* data;
+    unsigned int size;
+    // Vector of struct assembler_relocation
+    struct vector* relocations;
+};
+
+struct assembler
+{
+    struct compiler_process* process;
+    struct assembler_section sections[ASSEMBLER_TOTAL_SECTIONS];
+    int current_section;
+
+    // Vector of struct assembler_symbol*
+    struct vector* symbols;
+
+    // The last label that didn't start with a dot, NASM local labels (.if_end_5) belong to it
+    const char* last_global_label;
+
+    // Line of the assembly text being encoded, for errors
+    int line;
+};
+
+enum
+{
+    ASSEMBLER_ALL_OK,
+    ASSEMBLER_GENERAL_ERROR
+};
+
+int assembler_assemble(struct compiler_process* process, const char* source, FILE* out);
+struct assembler* assembler_new(struct compiler_process* process);
+void assembler_free(struct assembler* assembler);
+int assembler_assemble_text(struct assembler* assembler, const char* source);
+int elf_write_object(struct assembler* assembler, FILE* out);
+
+void jit_register_native_functions(struct compiler_process* process);
+int jit_execute(struct compiler_process* process, const char* assembly, int* exit_code_out);
+
 #endif
\ No newline at end of file
@@ -2,6 +2,27 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "helpers/vector.h"
+// Everything that doesn't depend on where the source comes from and where the output goes
+static struct compiler_process* compiler_process_new(FILE* file, int flags)
+{
+    struct compiler_process* process = arena_calloc(1,sizeof(struct compiler_process));
+    process->node_vec = vector_create(sizeof(struct node*));
+    process->node_tree_vec = vector_create(sizeof(struct node*));
+    process->flags = flags;
+    process->cfile.fp = file;
+    // Struct layouts and sizeof are computed while parsing, the pointer size has to be known before that
+    datatype_set_pointer_size(flags & COMPILE_PROCESS_TARGET_X86_64 ? DATA_SIZE_DDWORD : DATA_SIZE_DWORD);
+    process->generator = codegenerator_new(process);
+    process->resolver = resolver_default_new_process(process);
+    symresolver_initialize(process);
+    symresolver_new_table(process);
+    if (flags & COMPILE_PROCESS_EXEC_JIT)
+    {
+        jit_register_native_functions(process);
+    }
+    return process;
+}
+
 struct compiler_process *compiler_process_create(const char *filename, const char *file_name_out, int flags)
 {
     FILE *file = fopen(filename, "r");
@@ -14,25 +35,45 @@ struct compiler_process *compiler_process_create(const char *filename, const cha
     {
         out_file = fopen(file_name_out, "w");
     }
-    if (!out_file)
+    // exec-jit doesn't write anything, the program is run from memory
+    if (!out_file && !(flags & COMPILE_PROCESS_EXEC_JIT))
     {
         return NULL;
     }
 
-    struct compiler_process* process = calloc(1,sizeof(struct compiler_process));
-    process->node_vec = vector_create(sizeof(struct node*));
-    process->node_tree_vec = vector_create(sizeof(struct node*));
-    process->flags = flags;
-    process->cfile.fp = file;
+    struct compiler_process* process = compiler_process_new(file, flags);
+    // Errors and the time report name the file
+    process->cfile.abs_path = arena_strdup(filename);
     process->ofile = out_file;
-    process->generator = codegenerator_new(process);
-    process->resolver = resolver_default_new_process(process);
-    symresolver_initialize(process);
-    symresolver_new_table(process);
+    if (flags & (COMPILE_PROCESS_INTEGRATED_ASSEMBLER | COMPILE_PROCESS_EXEC_JIT))
+    {
+        // The assembly only has to live until the integrated assembler encodes it
+        process->object_file = out_file;
+        process->ofile = open_memstream(&process->assembly_text, &process->assembly_text_size);
+    }
     return process;
 
 }
 
+struct compiler_process* compiler_process_create_from_source(const char* source, size_t source_size, int flags)
+{
+    // An empty buffer can't be opened, it is the same as a file with a single new line
+    FILE* file = source_size ? fmemopen((void*)source, source_size, "r") : fmemopen("\n", 1, "r");
+    if (!file)
+    {
+        return NULL;
+    }
+
+    struct compiler_process* process = compiler_process_new(file, flags | COMPILE_PROCESS_LIBRARY);
+    process->diagnostics = vector_create(sizeof(struct compiler_diagnostic));
+    process->ofile = open_memstream(&process->assembly_text, &process->assembly_text_size);
+    if (flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER)
+    {
+        process->object_file = open_memstream(&process->object_data, &process->object_data_size);
+    }
+    return process;
+}
+
 
 char compiler_process_next_char(struct lex_process* lex_process){
     struct compiler_process* compiler = lex_process->compiler;
@@ -10,11 +10,24 @@ bool datatype_is_struct_or_union_for_name(const char* name)
     return S_EQ(name,"union") || S_EQ(name,"struct");
 }
 
+// 4 bytes on x86, 8 bytes on x86-64, set for the file this thread compiles
+static _Thread_local size_t datatype_target_pointer_size = DATA_SIZE_DWORD;
+
+void datatype_set_pointer_size(size_t size)
+{
+    datatype_target_pointer_size = size;
+}
+
+size_t datatype_pointer_size()
+{
+    return datatype_target_pointer_size;
+}
+
 size_t datatype_element_size(struct datatype* dtype)
 {
     if(dtype->flags & DATATYPE_FLAG_IS_POINTER)
     {
-        return DATA_SIZE_DWORD;
+        return datatype_pointer_size();
     }
     return dtype->size;
 }
@@ -33,9 +46,14 @@ size_t datatype_size_no_ptr(struct datatype* dtype)
 
 size_t datatype_size(struct datatype* dtype)
 {
+    // char* names[3] -> an array of pointers is as big as all of its pointers, an argument like char* argv[] is only a pointer
+    if (dtype->flags & DATATYPE_FLAG_IS_ARRAY && dtype->flags & DATATYPE_FLAG_IS_POINTER && dtype->array.size)
+    {
+        return dtype->array.size;
+    }
     if (dtype->flags &DATATYPE_FLAG_IS_POINTER && dtype -> pointer_depth > 0)
     {
-        return DATA_SIZE_DWORD;
+        return datatype_pointer_size();
     }
     if (dtype ->flags & DATATYPE_FLAG_IS_ARRAY)
     {
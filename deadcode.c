@@ -0,0 +1,611 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include "helpers/nameset.h"
+#include <stdlib.h>
+
+/*
+ * Removes code that can never run or whose result is never used, before the code generator sees the tree
+ *
+ * return 5;
+ * abc = 10;          <- removed, nothing jumps here
+ *
+ * if (0) { ... }     <- removed
+ *
+ * int unused;        <- removed with every store to it
+ * unused = 20;
+ *
+ * static int helper() { ... } <- removed if nothing calls it
+ */
+
+// Computes the value of an expression made of numbers only i.e (5 * 2) > 3
+bool deadcode_constant_value(struct node* node, long long* value_out)
+{
+    if (!node)
+    {
+        return false;
+    }
+
+    switch (node->type)
+    {
+    case NODE_TYPE_NUMBER:
+        *value_out = node->llnum;
+        return true;
+
+    case NODE_TYPE_EXPRESSION_PARENTHESIS:
+        return deadcode_constant_value(node->parenthesis.exp, value_out);
+
+    case NODE_TYPE_UNARY:
+    {
+        long long operand = 0;
+        if (!deadcode_constant_value(node->unary.operand, &operand))
+        {
+            return false;
+        }
+        if (S_EQ(node->unary.op, "-"))
+        {
+            *value_out = -operand;
+            return true;
+        }
+        if (S_EQ(node->unary.op, "!"))
+        {
+            *value_out = !operand;
+            return true;
+        }
+        if (S_EQ(node->unary.op, "~"))
+        {
+            *value_out = ~operand;
+            return true;
+        }
+        return false;
+    }
+
+    case NODE_TYPE_EXPRESSION:
+    {
+        long long left = 0;
+        long long right = 0;
+        if (!deadcode_constant_value(node->exp.left, &left) || !deadcode_constant_value(node->exp.right, &right))
+        {
+            return false;
+        }
+
+        const char* op = node->exp.op;
+        if (S_EQ(op, "+"))
+            *value_out = left + right;
+        else if (S_EQ(op, "-"))
+            *value_out = left - right;
+        else if (S_EQ(op, "*"))
+            *value_out = left * right;
+        else if (S_EQ(op, "/") && right)
+            *value_out = left / right;
+        else if (S_EQ(op, "%") && right)
+            *value_out = left % right;
+        else if (S_EQ(op, "=="))
+            *value_out = left == right;
+        else if (S_EQ(op, "!="))
+            *value_out = left != right;
+        else if (S_EQ(op, "<"))
+            *value_out = left < right;
+        else if (S_EQ(op, "<="))
+            *value_out = left <= right;
+        else if (S_EQ(op, ">"))
+            *value_out = left > right;
+        else if (S_EQ(op, ">="))
+            *value_out = left >= right;
+        else if (S_EQ(op, "&&"))
+            *value_out = left && right;
+        else if (S_EQ(op, "||"))
+            *value_out = left || right;
+        else if (S_EQ(op, "&"))
+            *value_out = left & right;
+        else if (S_EQ(op, "|"))
+            *value_out = left | right;
+        else if (S_EQ(op, "^"))
+            *value_out = left ^ right;
+        else
+            return false;
+        return true;
+    }
+    }
+    return false;
+}
+
+static bool deadcode_find_jump_target(struct node* node, void* private)
+{
+    bool* found = private;
+    if (node->type == NODE_TYPE_LABEL || node->type == NODE_TYPE_STATEMENT_CASE || node->type == NODE_TYPE_STATEMENT_DEFAULT)
+    {
+        *found = true;
+    }
+    return !*found;
+}
+
+// Labels and cases can be jumped to from somewhere else, so code containing them is never unreachable
+static bool deadcode_has_jump_target(struct node* node)
+{
+    bool found = false;
+    node_walk(node, deadcode_find_jump_target, &found);
+    return found;
+}
+
+static bool deadcode_find_side_effect(struct node* node, void* private)
+{
+    bool* found = private;
+    if (node->type == NODE_TYPE_EXPRESSION && (is_node_assignment(node) || S_EQ(node->exp.op, "()")))
+    {
+        *found = true;
+    }
+    if (node->type == NODE_TYPE_UNARY && (S_EQ(node->unary.op, "++") || S_EQ(node->unary.op, "--")))
+    {
+        *found = true;
+    }
+    return !*found;
+}
+
+// True if computing the expression changes nothing, so it can be skipped if the result isn't needed
+static bool deadcode_is_pure(struct node* node)
+{
+    bool found = false;
+    node_walk(node, deadcode_find_side_effect, &found);
+    return !found;
+}
+
+static bool deadcode_is_declaration(struct node* node)
+{
+    return node->type == NODE_TYPE_VARIABLE || node->type == NODE_TYPE_VARIABLE_LIST || (node_is_struct_or_union(node) && variable_node(node));
+}
+
+static bool deadcode_body_has_declarations(struct node* body_node)
+{
+    struct vector* statements = body_node->body.statements;
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        if (deadcode_is_declaration(vector_peek_ptr_at(statements, i)))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Control never continues to the statement after these
+static bool deadcode_is_terminator(struct node* node)
+{
+    return node->type == NODE_TYPE_STATEMENT_RETURN || node->type == NODE_TYPE_STATEMENT_BREAK || node->type == NODE_TYPE_STATEMENT_CONTINUE || node->type == NODE_TYPE_STATEMENT_GOTO;
+}
+
+static void deadcode_simplify_body(struct node* body_node);
+
+static void deadcode_simplify_nested_body(struct node* node)
+{
+    if (node && node->type == NODE_TYPE_BODY)
+    {
+        deadcode_simplify_body(node);
+    }
+}
+
+static struct node* deadcode_new_number_node(struct node* at_node, long long value)
+{
+    // Not node_create, that would push the node onto the parser's node stack
+    struct node* node = arena_calloc(1, sizeof(struct node));
+    node->type = NODE_TYPE_NUMBER;
+    node->pos = at_node->pos;
+    node->llnum = value;
+    node->binded = at_node->binded;
+    return node;
+}
+
+// Adds the statements of the branch that will run to out
+static void deadcode_push_live_body(struct vector* out, struct node* if_node, struct node* body_node)
+{
+    if (!body_node)
+    {
+        return;
+    }
+
+    if (!deadcode_body_has_declarations(body_node))
+    {
+        // if (1) { abc(); } -> abc();
+        struct vector* statements = body_node->body.statements;
+        for (int i = 0; i < vector_count(statements); i++)
+        {
+            struct node* statement = vector_peek_ptr_at(statements, i);
+            vector_push(out, &statement);
+        }
+        return;
+    }
+
+    // The body needs its own scope for its variables, keep it behind an if that is always true
+    if_node->stmt.if_stmt.cond_node = deadcode_new_number_node(if_node, 1);
+    if_node->stmt.if_stmt.body_node = body_node;
+    if_node->stmt.if_stmt.next = NULL;
+    vector_push(out, &if_node);
+}
+
+// else if (0) {} else if (1) { abc(); } else {} -> else { abc(); }
+static void deadcode_simplify_else(struct node* if_node)
+{
+    struct node* next = if_node->stmt.if_stmt.next;
+    while (next && next->type == NODE_TYPE_STATEMENT_IF)
+    {
+        long long cond = 0;
+        if (!deadcode_constant_value(next->stmt.if_stmt.cond_node, &cond) || deadcode_has_jump_target(next))
+        {
+            deadcode_simplify_nested_body(next->stmt.if_stmt.body_node);
+            if_node = next;
+            next = if_node->stmt.if_stmt.next;
+            continue;
+        }
+
+        if (cond)
+        {
+            // The rest of the chain can never run
+            next->type = NODE_TYPE_STATEMENT_ELSE;
+            next->stmt.else_stmt.body_node = next->stmt.if_stmt.body_node;
+            break;
+        }
+
+        if_node->stmt.if_stmt.next = next->stmt.if_stmt.next;
+        next = if_node->stmt.if_stmt.next;
+    }
+
+    if (next)
+    {
+        deadcode_simplify_nested_body(next->stmt.else_stmt.body_node);
+    }
+}
+
+// if (0) {} else if (abc) {} else {} -> if (abc) {} else {}
+static void deadcode_simplify_if(struct vector* out, struct node* node)
+{
+    long long cond = 0;
+    if (!deadcode_constant_value(node->stmt.if_stmt.cond_node, &cond) || deadcode_has_jump_target(node))
+    {
+        deadcode_simplify_nested_body(node->stmt.if_stmt.body_node);
+        deadcode_simplify_else(node);
+        vector_push(out, &node);
+        return;
+    }
+
+    if (cond)
+    {
+        deadcode_simplify_nested_body(node->stmt.if_stmt.body_node);
+        deadcode_push_live_body(out, node, node->stmt.if_stmt.body_node);
+        return;
+    }
+
+    struct node* next = node->stmt.if_stmt.next;
+    if (!next)
+    {
+        return;
+    }
+
+    if (next->type == NODE_TYPE_STATEMENT_IF)
+    {
+        deadcode_simplify_if(out, next);
+        return;
+    }
+
+    deadcode_simplify_nested_body(next->stmt.else_stmt.body_node);
+    deadcode_push_live_body(out, node, next->stmt.else_stmt.body_node);
+}
+
+// Adds the simplified statement to out, nothing is added if the statement can never run
+static void deadcode_simplify_statement(struct vector* out, struct node* node)
+{
+    long long cond = 0;
+    switch (node->type)
+    {
+    case NODE_TYPE_STATEMENT_IF:
+        deadcode_simplify_if(out, node);
+        return;
+
+    case NODE_TYPE_STATEMENT_WHILE:
+        // while (0) {}
+        if (deadcode_constant_value(node->stmt.while_stmt.exp_node, &cond) && !cond && !deadcode_has_jump_target(node))
+        {
+            return;
+        }
+        deadcode_simplify_nested_body(node->stmt.while_stmt.body_node);
+        break;
+
+    case NODE_TYPE_STATEMENT_FOR:
+        // for (i = 0; 0; i++) {} -> i = 0;
+        if (deadcode_constant_value(node->stmt.for_stmt.cond_node, &cond) && !cond && !deadcode_has_jump_target(node))
+        {
+            if (node->stmt.for_stmt.init_node)
+            {
+                vector_push(out, &node->stmt.for_stmt.init_node);
+            }
+            return;
+        }
+        deadcode_simplify_nested_body(node->stmt.for_stmt.body_node);
+        break;
+
+    case NODE_TYPE_STATEMENT_DO_WHILE:
+        deadcode_simplify_nested_body(node->stmt.do_while_stmt.body_node);
+        break;
+
+    case NODE_TYPE_STATEMENT_SWITCH:
+        deadcode_simplify_nested_body(node->stmt.switch_stmt.body);
+        break;
+    }
+    vector_push(out, &node);
+}
+
+static void deadcode_simplify_body(struct node* body_node)
+{
+    struct vector* statements = body_node->body.statements;
+    struct vector* out = vector_create(sizeof(struct node*));
+    bool unreachable = false;
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        struct node* statement = vector_peek_ptr_at(statements, i);
+        if (unreachable && deadcode_has_jump_target(statement))
+        {
+            // abc: can be reached from a goto
+            unreachable = false;
+        }
+
+        if (unreachable)
+        {
+            if (deadcode_is_declaration(statement))
+            {
+                // Code after a label might still use the variable, but it is never initialized
+                if (statement->type == NODE_TYPE_VARIABLE && !datatype_is_struct_or_union_non_pointer(&statement->var.type))
+                {
+                    statement->var.val = NULL;
+                }
+                vector_push(out, &statement);
+            }
+            continue;
+        }
+
+        deadcode_simplify_statement(out, statement);
+        struct node* last = vector_back_ptr_or_null(out);
+        if (last && deadcode_is_terminator(last))
+        {
+            unreachable = true;
+        }
+    }
+
+    vector_free(statements);
+    body_node->body.statements = out;
+}
+
+static bool deadcode_collect_read(struct node* node, void* private)
+{
+    // Every identifier whose value is used
+    struct name_set* read_names = private;
+    if (node->type == NODE_TYPE_IDENTIFIER)
+    {
+        name_set_add(read_names, node->sval);
+        return true;
+    }
+
+    if (node_is_expression(node, "=") && node->exp.left->type == NODE_TYPE_IDENTIFIER)
+    {
+        // abc = 50 writes abc, it doesn't read it
+        node_walk(node->exp.right, deadcode_collect_read, private);
+        return false;
+    }
+
+    if (node_is_expression(node, ".") || node_is_expression(node, "->"))
+    {
+        // abc.x -> x is the name of a member, not a variable
+        node_walk(node->exp.left, deadcode_collect_read, private);
+        return false;
+    }
+    return true;
+}
+
+static bool deadcode_collect_any_reference(struct node* node, void* private)
+{
+    if (node->type == NODE_TYPE_IDENTIFIER)
+    {
+        name_set_add(private, node->sval);
+    }
+    return true;
+}
+
+struct deadcode_locals
+{
+    // Names of the locals and arguments of the function
+    struct name_set* names;
+    // Names that are also static locals, stores to them are never removed
+    struct name_set* excluded_names;
+    // The global variables of the file, made once for all the functions, the same as excluded_names
+    struct name_set* global_names;
+    struct name_set* read_names;
+};
+
+static bool deadcode_collect_locals(struct node* node, void* private)
+{
+    struct deadcode_locals* locals = private;
+    if (node->type == NODE_TYPE_VARIABLE)
+    {
+        if (node->var.type.flags & (DATATYPE_FLAG_IS_STATIC | DATATYPE_FLAG_IS_EXTERN))
+        {
+            name_set_add(locals->excluded_names, node->var.name);
+        }
+        name_set_add(locals->names, node->var.name);
+    }
+    return true;
+}
+
+static bool deadcode_is_unread_local(struct deadcode_locals* locals, const char* name)
+{
+    return name_set_contains(locals->names, name) && !name_set_contains(locals->excluded_names, name) && !name_set_contains(locals->global_names, name) && !name_set_contains(locals->read_names, name);
+}
+
+// abc = 50; where abc is a local that is never read and 50 can be skipped
+static bool deadcode_is_removable_store(struct node* node, struct deadcode_locals* locals)
+{
+    return node_is_expression(node, "=") && node->exp.left->type == NODE_TYPE_IDENTIFIER && deadcode_is_unread_local(locals, node->exp.left->sval) && deadcode_is_pure(node->exp.right);
+}
+
+static void deadcode_remove_stores(struct node* node, struct deadcode_locals* locals);
+
+static bool deadcode_remove_stores_in_node(struct node* node, void* private)
+{
+    if (node->type == NODE_TYPE_BODY)
+    {
+        deadcode_remove_stores(node, private);
+        return false;
+    }
+    return true;
+}
+
+static void deadcode_remove_stores(struct node* body_node, struct deadcode_locals* locals)
+{
+    struct vector* statements = body_node->body.statements;
+    struct vector* out = vector_create(sizeof(struct node*));
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        struct node* statement = vector_peek_ptr_at(statements, i);
+        if (deadcode_is_removable_store(statement, locals))
+        {
+            continue;
+        }
+        node_walk(statement, deadcode_remove_stores_in_node, locals);
+        vector_push(out, &statement);
+    }
+    vector_free(statements);
+    body_node->body.statements = out;
+}
+
+static void deadcode_remove_declarations(struct node* body_node, struct name_set* referenced_names);
+
+static bool deadcode_remove_declarations_in_node(struct node* node, void* private)
+{
+    if (node->type == NODE_TYPE_BODY)
+    {
+        deadcode_remove_declarations(node, private);
+        return false;
+    }
+    return true;
+}
+
+static void deadcode_remove_declarations(struct node* body_node, struct name_set* referenced_names)
+{
+    struct vector* statements = body_node->body.statements;
+    struct vector* out = vector_create(sizeof(struct node*));
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        struct node* statement = vector_peek_ptr_at(statements, i);
+        bool is_local = statement->type == NODE_TYPE_VARIABLE && !(statement->var.type.flags & (DATATYPE_FLAG_IS_STATIC | DATATYPE_FLAG_IS_EXTERN));
+        if (is_local && !name_set_contains(referenced_names, statement->var.name) && (!statement->var.val || deadcode_is_pure(statement->var.val)))
+        {
+            continue;
+        }
+        node_walk(statement, deadcode_remove_declarations_in_node, referenced_names);
+        vector_push(out, &statement);
+    }
+    vector_free(statements);
+    body_node->body.statements = out;
+}
+
+// Locals that are only ever written to, the writes and the variable are removed
+static void deadcode_remove_unused_locals(struct node* func_node, struct name_set* global_names)
+{
+    struct deadcode_locals locals = {.global_names = global_names};
+    locals.names = name_set_create();
+    locals.excluded_names = name_set_create();
+    locals.read_names = name_set_create();
+    node_walk(func_node, deadcode_collect_locals, &locals);
+    node_walk(func_node->func.body_n, deadcode_collect_read, locals.read_names);
+    deadcode_remove_stores(func_node->func.body_n, &locals);
+
+    // A variable can only go if nothing mentions it anymore, abc = call(); still needs abc
+    struct name_set* referenced_names = name_set_create();
+    node_walk(func_node->func.body_n, deadcode_collect_any_reference, referenced_names);
+    deadcode_remove_declarations(func_node->func.body_n, referenced_names);
+
+    name_set_free(locals.names);
+    name_set_free(locals.excluded_names);
+    name_set_free(locals.read_names);
+    name_set_free(referenced_names);
+}
+
+static bool deadcode_is_static_function(struct node* node)
+{
+    return node->type == NODE_TYPE_FUNCTION && !function_node_is_prototype(node) && node->func.rtype.flags & DATATYPE_FLAG_IS_STATIC;
+}
+
+// Static functions can only be called from this file, if nothing here calls them they are removed from .text
+static void deadcode_remove_unused_static_functions(struct compiler_process* process)
+{
+    struct vector* root = process->node_tree_vec;
+    struct name_set* live_names = name_set_create();
+    // Names of the static functions whose body was already walked
+    struct name_set* walked = name_set_create();
+
+    // Everything that isn't a static function is used
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (!deadcode_is_static_function(node))
+        {
+            node_walk(node, deadcode_collect_any_reference, live_names);
+        }
+    }
+
+    // Static functions called from used code are used too, and so is everything they call
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < vector_count(root); i++)
+        {
+            struct node* node = vector_peek_ptr_at(root, i);
+            if (!deadcode_is_static_function(node) || !name_set_contains(live_names, node->func.name) || name_set_contains(walked, node->func.name))
+            {
+                continue;
+            }
+            name_set_add(walked, node->func.name);
+            node_walk(node->func.body_n, deadcode_collect_any_reference, live_names);
+            changed = true;
+        }
+    }
+
+    for (int i = vector_count(root) - 1; i >= 0; i--)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (deadcode_is_static_function(node) && !name_set_contains(live_names, node->func.name))
+        {
+            vector_pop_at(root, i);
+        }
+    }
+
+    name_set_free(live_names);
+    name_set_free(walked);
+}
+
+void deadcode_eliminate(struct compiler_process* process)
+{
+    struct vector* root = process->node_tree_vec;
+    // A local with the same name as a global variable might be shadowing it in one scope only
+    struct name_set* global_names = name_set_create();
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* var_node = variable_node(vector_peek_ptr_at(root, i));
+        if (var_node)
+        {
+            name_set_add(global_names, var_node->var.name);
+        }
+    }
+
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (node->type != NODE_TYPE_FUNCTION || function_node_is_prototype(node))
+        {
+            continue;
+        }
+        deadcode_simplify_body(node->func.body_n);
+        deadcode_remove_unused_locals(node, global_names);
+    }
+    name_set_free(global_names);
+
+    deadcode_remove_unused_static_functions(process);
+    vector_set_peek_pointer(root, 0);
+}
@@ -0,0 +1,173 @@
+#include "compiler.h"
+#include "helpers/buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/*
+ * Compiling more files into one program
+ *
+ * ./main -o program a.c b.c c.c
+ *
+ *  worker 1: a.c -> a.o, c.o      |
+ *  worker 2: b.c -> b.o           | -> link a.o b.o c.o -> program
+ *
+ * Every file is its own compiler_process, a worker takes the next file that nobody compiles yet until there are none left.
+ * The objects are linked once when every worker finished
+ */
+
+struct driver_file
+{
+    const char* filename;
+    // a.c -> a.asm and a.o
+    char* assembly_filename;
+    char* object_filename;
+    int result;
+};
+
+struct driver
+{
+    struct driver_file* files;
+    int total_files;
+    int flags;
+    // NULL if the outputs aren't cached
+    struct compiler_cache* cache;
+
+    pthread_mutex_t lock;
+    // The next file a worker should take
+    int next_file;
+};
+
+// a.c -> a<extension>
+static char* driver_output_filename(const char* filename, const char* extension)
+{
+    const char* dot = strrchr(filename, '.');
+    const char* slash = strrchr(filename, '/');
+    size_t length = dot && (!slash || dot > slash) ? (size_t)(dot - filename) : strlen(filename);
+    char* out = malloc(length + strlen(extension) + 1);
+    memcpy(out, filename, length);
+    strcpy(out + length, extension);
+    return out;
+}
+
+// Without the integrated assembler the assembly is turned into an object by NASM
+static int driver_assemble(struct driver* driver, struct driver_file* file)
+{
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "nasm -f %s %s -o %s", driver->flags & COMPILE_PROCESS_TARGET_X86_64 ? "elf64" : "elf32", file->assembly_filename, file->object_filename);
+    return system(cmd) == 0 ? COMPILER_FILE_COMPILED_OK : COMPILER_FAILED_WITH_ERRORS;
+}
+
+static void driver_compile_file(struct driver* driver, struct driver_file* file)
+{
+    if (driver->flags & COMPILE_PROCESS_INTEGRATED_ASSEMBLER)
+    {
+        file->result = compile_file_cached(driver->cache, file->filename, file->object_filename, driver->flags | COMPILE_PROCESS_EXPORT_AS_OBJECT);
+        return;
+    }
+
+    file->result = compile_file_cached(driver->cache, file->filename, file->assembly_filename, driver->flags | COMPILE_PROCESS_EXPORT_AS_OBJECT);
+    if (file->result == COMPILER_FILE_COMPILED_OK)
+    {
+        file->result = driver_assemble(driver, file);
+    }
+}
+
+static void* driver_worker(void* private)
+{
+    struct driver* driver = private;
+    while (true)
+    {
+        pthread_mutex_lock(&driver->lock);
+        int index = driver->next_file++;
+        pthread_mutex_unlock(&driver->lock);
+        if (index >= driver->total_files)
+        {
+            break;
+        }
+        driver_compile_file(driver, &driver->files[index]);
+    }
+    return NULL;
+}
+
+// One worker for every core unless -j says otherwise, never more workers than files
+static int driver_total_workers(int jobs, int total_files)
+{
+    if (jobs <= 0)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        jobs = cores > 0 ? (int)cores : 1;
+    }
+    return jobs < total_files ? jobs : total_files;
+}
+
+// $CC is used to link, gcc if it isn't set
+static int driver_link(struct driver* driver, const char* out_filename)
+{
+    const char* cc = getenv("CC");
+    struct buffer* cmd = buffer_create();
+    buffer_printf(cmd, "%s %s", cc && *cc ? cc : "gcc", driver->flags & COMPILE_PROCESS_TARGET_X86_64 ? "-m64" : "-m32 -no-pie");
+    for (int i = 0; i < driver->total_files; i++)
+    {
+        buffer_printf(cmd, " %s", driver->files[i].object_filename);
+    }
+    buffer_printf(cmd, " -o %s", out_filename);
+    buffer_write(cmd, 0);
+
+    int res = system(buffer_ptr(cmd));
+    buffer_free(cmd);
+    return res == 0 ? COMPILER_FILE_COMPILED_OK : COMPILER_FAILED_WITH_ERRORS;
+}
+
+int compile_files(const char** filenames, int total_files, const char* out_filename, int flags, int jobs, struct compiler_cache* cache)
+{
+    // The workers compile at the same time, the assembly of one file must not be echoed between the lines of another
+    // and a compilation must not fork the other threads
+    struct driver driver = {.total_files = total_files, .flags = flags | COMPILE_PROCESS_NO_ECHO | COMPILE_PROCESS_THREADED, .cache = cache};
+    driver.files = calloc(total_files, sizeof(struct driver_file));
+    pthread_mutex_init(&driver.lock, NULL);
+    for (int i = 0; i < total_files; i++)
+    {
+        driver.files[i].filename = filenames[i];
+        driver.files[i].assembly_filename = driver_output_filename(filenames[i], ".asm");
+        driver.files[i].object_filename = driver_output_filename(filenames[i], ".o");
+    }
+
+    int total_workers = driver_total_workers(jobs, total_files);
+    pthread_t* workers = calloc(total_workers, sizeof(pthread_t));
+    for (int i = 0; i < total_workers; i++)
+    {
+        pthread_create(&workers[i], NULL, driver_worker, &driver);
+    }
+    for (int i = 0; i < total_workers; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+
+    int res = COMPILER_FILE_COMPILED_OK;
+    for (int i = 0; i < total_files; i++)
+    {
+        if (driver.files[i].result != COMPILER_FILE_COMPILED_OK)
+        {
+            fprintf(stderr, "Failed to compile %s\n", driver.files[i].filename);
+            res = COMPILER_FAILED_WITH_ERRORS;
+        }
+    }
+
+    if (res == COMPILER_FILE_COMPILED_OK)
+    {
+        res = driver_link(&driver, out_filename);
+    }
+
+    for (int i = 0; i < total_files; i++)
+    {
+        free(driver.files[i].assembly_filename);
+        free(driver.files[i].object_filename);
+    }
+    free(workers);
+    free(driver.files);
+    pthread_mutex_destroy(&driver.lock);
+    return res;
+}
@@ -0,0 +1,258 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include "helpers/buffer.h"
+#include <stdlib.h>
+#include <elf.h>
+
+/*
+ * Writes what the integrated assembler made as an ELF32 relocatable object (what nasm -f elf32 writes)
+ *
+ * ELF header
+ * .text .data .rodata contents
+ * .rel.text .rel.data .rel.rodata
+ * .symtab .strtab .shstrtab
+ * section headers
+ */
+
+enum
+{
+    ELF_SECTION_NULL,
+    ELF_SECTION_TEXT,
+    ELF_SECTION_DATA,
+    ELF_SECTION_BSS,
+    ELF_SECTION_RODATA,
+    ELF_SECTION_REL_TEXT,
+    ELF_SECTION_REL_DATA,
+    ELF_SECTION_REL_RODATA,
+    ELF_SECTION_SYMTAB,
+    ELF_SECTION_STRTAB,
+    ELF_SECTION_SHSTRTAB,
+    ELF_TOTAL_SECTIONS
+};
+
+struct elf_writer
+{
+    struct assembler* assembler;
+    Elf32_Shdr headers[ELF_TOTAL_SECTIONS];
+
+    // The contents of every section that has any
+    struct buffer* contents[ELF_TOTAL_SECTIONS];
+};
+
+static int elf_section_index(int assembler_section)
+{
+    static const int indexes[] = {
+        [ASSEMBLER_SECTION_TEXT] = ELF_SECTION_TEXT,
+        [ASSEMBLER_SECTION_DATA] = ELF_SECTION_DATA,
+        [ASSEMBLER_SECTION_BSS] = ELF_SECTION_BSS,
+        [ASSEMBLER_SECTION_RODATA] = ELF_SECTION_RODATA
+    };
+    return indexes[assembler_section];
+}
+
+static void elf_buffer_write_bytes(struct buffer* buffer, const void* data, size_t size)
+{
+    const char* bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        buffer_write(buffer, bytes[i]);
+    }
+}
+
+// Adds a name to a string table and returns its offset
+static int elf_add_string(struct buffer* table, const char* str)
+{
+    int offset = table->len;
+    elf_buffer_write_bytes(table, str, strlen(str) + 1);
+    return offset;
+}
+
+static void elf_add_symbol(struct buffer* symtab, int name, int value, int size, int info, int section)
+{
+    Elf32_Sym symbol = {};
+    symbol.st_name = name;
+    symbol.st_value = value;
+    symbol.st_size = size;
+    symbol.st_info = info;
+    symbol.st_shndx = section;
+    elf_buffer_write_bytes(symtab, &symbol, sizeof(symbol));
+}
+
+// Local symbols have to come before the global ones, returns the index of the first global symbol
+static int elf_write_symbols(struct elf_writer* writer)
+{
+    struct assembler* assembler = writer->assembler;
+    struct buffer* symtab = buffer_create();
+    struct buffer* strtab = buffer_create();
+    elf_add_string(strtab, "");
+
+    // Symbol 0 is always empty, then a symbol for every section that relocations can point to
+    elf_add_symbol(symtab, 0, 0, 0, 0, SHN_UNDEF);
+    int total_symbols = 1;
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        elf_add_symbol(symtab, 0, 0, 0, ELF32_ST_INFO(STB_LOCAL, STT_SECTION), elf_section_index(i));
+        total_symbols++;
+    }
+
+    // Labels that aren't global, local labels with a dot (main.if_end_5) are left out just like NASM does with ..@ labels
+    for (int i = 0; i < vector_count(assembler->symbols); i++)
+    {
+        struct assembler_symbol* symbol = vector_peek_ptr_at(assembler->symbols, i);
+        if (symbol->is_global || !symbol->is_defined || strchr(symbol->name, '.'))
+        {
+            continue;
+        }
+        symbol->elf_index = total_symbols++;
+        elf_add_symbol(symtab, elf_add_string(strtab, symbol->name), symbol->offset, 0, ELF32_ST_INFO(STB_LOCAL, STT_NOTYPE), elf_section_index(symbol->section));
+    }
+
+    int first_global = total_symbols;
+    for (int i = 0; i < vector_count(assembler->symbols); i++)
+    {
+        struct assembler_symbol* symbol = vector_peek_ptr_at(assembler->symbols, i);
+        if (!symbol->is_global)
+        {
+            continue;
+        }
+        symbol->elf_index = total_symbols++;
+        int section = symbol->is_defined ? elf_section_index(symbol->section) : SHN_UNDEF;
+        int type = symbol->is_defined && symbol->section == ASSEMBLER_SECTION_TEXT ? STT_FUNC : STT_NOTYPE;
+        elf_add_symbol(symtab, elf_add_string(strtab, symbol->name), symbol->is_defined ? symbol->offset : 0, 0, ELF32_ST_INFO(STB_GLOBAL, type), section);
+    }
+
+    writer->contents[ELF_SECTION_SYMTAB] = symtab;
+    writer->contents[ELF_SECTION_STRTAB] = strtab;
+    return first_global;
+}
+
+/*
+ * ELF32 i386 uses REL relocations, the addend is stored inside the section where the address goes
+ * Relocations to defined labels point to the symbol of their section, the offset of the label is added to the addend
+ */
+static struct buffer* elf_write_relocations(struct elf_writer* writer, int assembler_section)
+{
+    struct assembler_section* section = &writer->assembler->sections[assembler_section];
+    struct buffer* relocations = buffer_create();
+    for (int i = 0; i < vector_count(section->relocations); i++)
+    {
+        struct assembler_relocation* relocation = vector_at(section->relocations, i);
+        struct assembler_symbol* symbol = relocation->symbol;
+        int addend = relocation->addend;
+        int symbol_index = symbol->elf_index;
+        if (symbol->is_defined && !symbol->is_global)
+        {
+            // 1 + section, see elf_write_symbols
+            symbol_index = 1 + symbol->section;
+            addend += symbol->offset;
+        }
+
+        int type = R_386_32;
+        if (relocation->type == ASSEMBLER_RELOCATION_RELATIVE)
+        {
+            // The CPU adds the distance to the address after the 4 byte field
+            type = R_386_PC32;
+            addend -= 4;
+        }
+        memcpy((char*)buffer_ptr(section->data) + relocation->offset, &addend, 4);
+
+        Elf32_Rel rel = {};
+        rel.r_offset = relocation->offset;
+        rel.r_info = ELF32_R_INFO(symbol_index, type);
+        elf_buffer_write_bytes(relocations, &rel, sizeof(rel));
+    }
+    return relocations;
+}
+
+static void elf_set_header(struct elf_writer* writer, int index, int name, int type, int flags, int link, int info, int align, int entsize)
+{
+    Elf32_Shdr* header = &writer->headers[index];
+    header->sh_name = name;
+    header->sh_type = type;
+    header->sh_flags = flags;
+    header->sh_link = link;
+    header->sh_info = info;
+    header->sh_addralign = align;
+    header->sh_entsize = entsize;
+}
+
+int elf_write_object(struct assembler* assembler, FILE* out)
+{
+    struct elf_writer writer = {};
+    writer.assembler = assembler;
+
+    int first_global = elf_write_symbols(&writer);
+    writer.contents[ELF_SECTION_TEXT] = assembler->sections[ASSEMBLER_SECTION_TEXT].data;
+    writer.contents[ELF_SECTION_DATA] = assembler->sections[ASSEMBLER_SECTION_DATA].data;
+    writer.contents[ELF_SECTION_RODATA] = assembler->sections[ASSEMBLER_SECTION_RODATA].data;
+    writer.contents[ELF_SECTION_REL_TEXT] = elf_write_relocations(&writer, ASSEMBLER_SECTION_TEXT);
+    writer.contents[ELF_SECTION_REL_DATA] = elf_write_relocations(&writer, ASSEMBLER_SECTION_DATA);
+    writer.contents[ELF_SECTION_REL_RODATA] = elf_write_relocations(&writer, ASSEMBLER_SECTION_RODATA);
+
+    struct buffer* shstrtab = buffer_create();
+    writer.contents[ELF_SECTION_SHSTRTAB] = shstrtab;
+    elf_add_string(shstrtab, "");
+    elf_set_header(&writer, ELF_SECTION_TEXT, elf_add_string(shstrtab, ".text"), SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 16, 0);
+    elf_set_header(&writer, ELF_SECTION_DATA, elf_add_string(shstrtab, ".data"), SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, 0, 4, 0);
+    elf_set_header(&writer, ELF_SECTION_BSS, elf_add_string(shstrtab, ".bss"), SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 0, 0, 4, 0);
+    elf_set_header(&writer, ELF_SECTION_RODATA, elf_add_string(shstrtab, ".rodata"), SHT_PROGBITS, SHF_ALLOC, 0, 0, 4, 0);
+    elf_set_header(&writer, ELF_SECTION_REL_TEXT, elf_add_string(shstrtab, ".rel.text"), SHT_REL, 0, ELF_SECTION_SYMTAB, ELF_SECTION_TEXT, 4, sizeof(Elf32_Rel));
+    elf_set_header(&writer, ELF_SECTION_REL_DATA, elf_add_string(shstrtab, ".rel.data"), SHT_REL, 0, ELF_SECTION_SYMTAB, ELF_SECTION_DATA, 4, sizeof(Elf32_Rel));
+    elf_set_header(&writer, ELF_SECTION_REL_RODATA, elf_add_string(shstrtab, ".rel.rodata"), SHT_REL, 0, ELF_SECTION_SYMTAB, ELF_SECTION_RODATA, 4, sizeof(Elf32_Rel));
+    elf_set_header(&writer, ELF_SECTION_SYMTAB, elf_add_string(shstrtab, ".symtab"), SHT_SYMTAB, 0, ELF_SECTION_STRTAB, first_global, 4, sizeof(Elf32_Sym));
+    elf_set_header(&writer, ELF_SECTION_STRTAB, elf_add_string(shstrtab, ".strtab"), SHT_STRTAB, 0, 0, 0, 1, 0);
+    elf_set_header(&writer, ELF_SECTION_SHSTRTAB, elf_add_string(shstrtab, ".shstrtab"), SHT_STRTAB, 0, 0, 0, 1, 0);
+
+    // The contents come right after the ELF header, every section aligned to 16 bytes
+    unsigned int offset = sizeof(Elf32_Ehdr);
+    for (int i = 1; i < ELF_TOTAL_SECTIONS; i++)
+    {
+        offset = (offset + 15) & ~15;
+        writer.headers[i].sh_offset = offset;
+        if (i == ELF_SECTION_BSS)
+        {
+            writer.headers[i].sh_size = assembler->sections[ASSEMBLER_SECTION_BSS].size;
+            continue;
+        }
+        writer.headers[i].sh_size = writer.contents[i]->len;
+        offset += writer.contents[i]->len;
+    }
+    unsigned int section_headers_offset = (offset + 15) & ~15;
+
+    Elf32_Ehdr header = {};
+    memcpy(header.e_ident, ELFMAG, SELFMAG);
+    header.e_ident[EI_CLASS] = ELFCLASS32;
+    header.e_ident[EI_DATA] = ELFDATA2LSB;
+    header.e_ident[EI_VERSION] = EV_CURRENT;
+    header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    header.e_type = ET_REL;
+    header.e_machine = EM_386;
+    header.e_version = EV_CURRENT;
+    header.e_shoff = section_headers_offset;
+    header.e_ehsize = sizeof(Elf32_Ehdr);
+    header.e_shentsize = sizeof(Elf32_Shdr);
+    header.e_shnum = ELF_TOTAL_SECTIONS;
+    header.e_shstrndx = ELF_SECTION_SHSTRTAB;
+    fwrite(&header, sizeof(header), 1, out);
+
+    unsigned int written = sizeof(Elf32_Ehdr);
+    static const char zeros[16] = {};
+    for (int i = 1; i < ELF_TOTAL_SECTIONS; i++)
+    {
+        if (i == ELF_SECTION_BSS)
+        {
+            continue;
+        }
+        fwrite(zeros, 1, writer.headers[i].sh_offset - written, out);
+        fwrite(buffer_ptr(writer.contents[i]), 1, writer.contents[i]->len, out);
+        written = writer.headers[i].sh_offset + writer.contents[i]->len;
+    }
+    fwrite(zeros, 1, section_headers_offset - written, out);
+    fwrite(writer.headers, sizeof(Elf32_Shdr), ELF_TOTAL_SECTIONS, out);
+
+    for (int i = ELF_SECTION_REL_TEXT; i < ELF_TOTAL_SECTIONS; i++)
+    {
+        buffer_free(writer.contents[i]);
+    }
+    return ASSEMBLER_ALL_OK;
+}
@@ -15,7 +15,7 @@ typedef void(*FIXUP_END)(struct fixup*);
 
 struct fixup_system* fixup_sys_new()
 {
-    struct fixup_system* system = calloc(1,sizeof(struct fixup_system));
+    struct fixup_system* system = arena_calloc(1,sizeof(struct fixup_system));
     system->fixups = vector_create(sizeof(struct fixup));
     return system;
 }
@@ -29,7 +29,7 @@ struct fixup_config* fixup_config(struct fixup* fixup)
 void fixup_free(struct fixup* fixup)
 {
     fixup->config.end(fixup);
-    free(fixup);
+    arena_free(fixup);
 }
 
 void fixup_start_iteration(struct fixup_system* system)
@@ -58,7 +58,7 @@ void fixup_sys_free(struct fixup_system* system)
 {
     fixup_sys_fixups_free(system);
     vector_free(system->fixups);
-    free(system);
+    arena_free(system);
 }
 
 int fixup_unresolved_fixups_count(struct fixup_system* system)
@@ -81,7 +81,7 @@ int fixup_unresolved_fixups_count(struct fixup_system* system)
 
 struct fixup* fixup_register(struct fixup_system*system, struct fixup_config* config)
 {
-    struct fixup* fixup = calloc(1, sizeof(struct fixup));
+    struct fixup* fixup = arena_calloc(1, sizeof(struct fixup));
     memcpy(&fixup->config,config, sizeof(struct fixup_config));
 
     fixup->system = system;
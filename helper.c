@@ -1,9 +1,8 @@
 #include "compiler.h"
 #include "helpers/vector.h"
-#include <assert.h>
 size_t variable_size(struct node* var_node)
 {
-    assert(var_node->type == NODE_TYPE_VARIABLE);
+    compiler_assert(var_node->type == NODE_TYPE_VARIABLE);
     return datatype_size(&var_node->var.type);
 }
 
@@ -20,7 +19,7 @@ bool is_logical_operator(const char*op)
 struct datatype* datatype_pointer_reduce(struct datatype* datatype, int by)
 {
     // Reduces the pointer depth of a datatype -> int** becomes int*
-    struct datatype* new_datatype = calloc(1,sizeof(struct datatype));
+    struct datatype* new_datatype = arena_calloc(1,sizeof(struct datatype));
     memcpy(new_datatype,datatype, sizeof(struct datatype));
     new_datatype->pointer_depth -= by;
     if (new_datatype->pointer_depth <= 0)
@@ -47,7 +46,7 @@ struct datatype* datatype_thats_a_pointer(struct datatype* d1, struct datatype*
 
 size_t variable_size_for_list(struct node*var_list_node)
 {
-    assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
+    compiler_assert(var_list_node->type == NODE_TYPE_VARIABLE_LIST);
     size_t size = 0;
     vector_set_peek_pointer(var_list_node->var_list.list,0);
     struct node* var_node = vector_peek_ptr(var_list_node->var_list.list);
@@ -91,7 +90,7 @@ int align_value(int val, int to)
 // For negative needed bytes (used mainly at stack)
 int align_value_treat_positive(int val, int to)
 {
-    assert(to >= 0);
+    compiler_assert(to >= 0);
     if (val < 0)
     {
         to = -to;
@@ -153,7 +152,7 @@ int array_multiplier(struct datatype*dtype, int index, int index_value)
     struct node* bracket_node = vector_peek_ptr(dtype->array.brackets->n_brackets);
     while (bracket_node)
     {
-        assert(bracket_node->bracket.inner->type == NODE_TYPE_NUMBER);
+        compiler_assert(bracket_node->bracket.inner->type == NODE_TYPE_NUMBER);
         int declared_index = bracket_node->bracket.inner->llnum;
         int size_value = declared_index;
         size_sum *= size_value;
@@ -203,9 +202,9 @@ struct node* variable_struct_or_union_largest_variable_node(struct node* var_nod
 int struct_offset(struct compiler_process*compile_proc, const char*struct_name,  const char*var_name ,struct node**var_node_out, int last_pos, int flags)
 {
     struct symbol* struct_sym = symresolver_get_symbol(compile_proc,struct_name);
-    assert(struct_sym && struct_sym->type == SYMBOL_TYPE_NODE);
+    compiler_assert(struct_sym && struct_sym->type == SYMBOL_TYPE_NODE);
     struct node* node = struct_sym->data;
-    assert(node_is_struct_or_union(node));
+    compiler_assert(node_is_struct_or_union(node));
 
     // We are getting the variables inside the struct body struct abc {VARIABLES}.
     struct vector* struct_vars_vec = node->_struct.body_n->body.statements;
@@ -314,7 +313,8 @@ bool is_left_operanded_unary_operator(const char* op)
 
 bool unary_operand_compatible(struct token* token)
 {
-	return is_access_operator(token->sval) || is_array_operator(token->sval) || is_parentheses(token->sval);
+	// &abc[5] -> the operand is abc[5], the token is only "[" here (the "[]" operator is made by parse_for_array)
+	return is_access_operator(token->sval) || is_array_operator(token->sval) || S_EQ(token->sval,"[") || is_parentheses(token->sval);
 }
 
 struct datatype datatype_for_numeric()
@@ -0,0 +1,160 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+union arena_header
+{
+    struct
+    {
+        // NULL if the memory doesn't belong to an arena
+        struct arena* arena;
+        union arena_header* prev;
+        union arena_header* next;
+    } block;
+
+    // The memory after the header has to be aligned just like the memory of malloc
+    max_align_t align;
+};
+
+struct arena
+{
+    union arena_header* first;
+};
+
+static _Thread_local struct arena* arena_current = NULL;
+static _Thread_local struct arena_statistics arena_thread_statistics;
+
+struct arena* arena_create()
+{
+    return calloc(1, sizeof(struct arena));
+}
+
+struct arena* arena_use(struct arena* arena)
+{
+    struct arena* previous = arena_current;
+    arena_current = arena;
+    return previous;
+}
+
+static void arena_link(struct arena* arena, union arena_header* header)
+{
+    header->block.arena = arena;
+    header->block.prev = NULL;
+    header->block.next = NULL;
+    if (!arena)
+    {
+        return;
+    }
+
+    header->block.next = arena->first;
+    if (arena->first)
+    {
+        arena->first->block.prev = header;
+    }
+    arena->first = header;
+}
+
+static void arena_unlink(union arena_header* header)
+{
+    struct arena* arena = header->block.arena;
+    if (!arena)
+    {
+        return;
+    }
+
+    if (header->block.prev)
+    {
+        header->block.prev->block.next = header->block.next;
+    }
+    else
+    {
+        arena->first = header->block.next;
+    }
+    if (header->block.next)
+    {
+        header->block.next->block.prev = header->block.prev;
+    }
+}
+
+void arena_destroy(struct arena* arena)
+{
+    union arena_header* header = arena->first;
+    while (header)
+    {
+        union arena_header* next = header->block.next;
+        free(header);
+        header = next;
+    }
+    free(arena);
+}
+
+void arena_statistics(struct arena_statistics* out)
+{
+    *out = arena_thread_statistics;
+}
+
+void* arena_malloc(size_t size)
+{
+    arena_thread_statistics.allocations++;
+    arena_thread_statistics.bytes += size;
+    union arena_header* header = malloc(sizeof(union arena_header) + size);
+    if (!header)
+    {
+        return NULL;
+    }
+    arena_link(arena_current, header);
+    return header + 1;
+}
+
+void* arena_calloc(size_t count, size_t size)
+{
+    void* ptr = arena_malloc(count * size);
+    if (ptr)
+    {
+        memset(ptr, 0, count * size);
+    }
+    return ptr;
+}
+
+void* arena_realloc(void* ptr, size_t size)
+{
+    if (!ptr)
+    {
+        return arena_malloc(size);
+    }
+
+    arena_thread_statistics.allocations++;
+    arena_thread_statistics.bytes += size;
+    // The block can move, the arena has to point to its new address
+    union arena_header* header = (union arena_header*)ptr - 1;
+    struct arena* arena = header->block.arena;
+    arena_unlink(header);
+    union arena_header* new_header = realloc(header, sizeof(union arena_header) + size);
+    if (!new_header)
+    {
+        arena_link(arena, header);
+        return NULL;
+    }
+    arena_link(arena, new_header);
+    return new_header + 1;
+}
+
+char* arena_strdup(const char* str)
+{
+    size_t size = strlen(str) + 1;
+    char* copy = arena_malloc(size);
+    memcpy(copy, str, size);
+    return copy;
+}
+
+void arena_free(void* ptr)
+{
+    if (!ptr)
+    {
+        return;
+    }
+
+    union arena_header* header = (union arena_header*)ptr - 1;
+    arena_unlink(header);
+    free(header);
+}
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * Every allocation of the compiler goes through these functions. When the thread uses an arena the memory is
+ * remembered by it and arena_destroy frees all of it at once, the compiler never has to free its nodes and tokens
+ * one by one. Without an arena they work just like malloc and free
+ *
+ * | arena_header | memory the caller gets |
+ *
+ * Memory from these functions must only be freed with arena_free, never with free
+ */
+
+struct arena;
+
+struct arena* arena_create();
+// The thread allocates from arena (NULL for none), the arena used before is returned
+struct arena* arena_use(struct arena* arena);
+// Frees everything that was allocated from the arena and was not freed yet
+void arena_destroy(struct arena* arena);
+
+// What this thread allocated since it started, arena or not
+struct arena_statistics
+{
+    size_t allocations;
+    size_t bytes;
+};
+
+void arena_statistics(struct arena_statistics* out);
+
+void* arena_malloc(size_t size);
+void* arena_calloc(size_t count, size_t size);
+void* arena_realloc(void* ptr, size_t size);
+char* arena_strdup(const char* str);
+void arena_free(void* ptr);
+
+#endif
@@ -1,12 +1,13 @@
 #include "buffer.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
 
 struct buffer* buffer_create()
 {
-    struct buffer* buf = calloc(sizeof(struct buffer), 1);
-    buf->data = calloc(BUFFER_REALLOC_AMOUNT, 1);
+    struct buffer* buf = arena_calloc(sizeof(struct buffer), 1);
+    buf->data = arena_calloc(BUFFER_REALLOC_AMOUNT, 1);
     buf->len = 0;
     buf->msize = BUFFER_REALLOC_AMOUNT;
     return buf;
@@ -14,7 +15,7 @@ struct buffer* buffer_create()
 
 void buffer_extend(struct buffer* buffer, size_t size)
 {
-    buffer->data = realloc(buffer->data, buffer->msize+size);
+    buffer->data = arena_realloc(buffer->data, buffer->msize+size);
     buffer->msize+=size;
 }
 
@@ -90,7 +91,7 @@ char buffer_peek(struct buffer* buffer)
 
 void buffer_free(struct buffer* buffer)
 {
-    free(buffer->data);
-    free(buffer);
+    arena_free(buffer->data);
+    arena_free(buffer);
 }
 
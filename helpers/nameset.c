@@ -0,0 +1,71 @@
+#include "nameset.h"
+#include "arena.h"
+#include <string.h>
+
+struct name_set* name_set_create()
+{
+    struct name_set* set = arena_calloc(1, sizeof(struct name_set));
+    set->capacity = NAME_SET_INITIAL_CAPACITY;
+    set->names = arena_calloc(set->capacity, sizeof(const char*));
+    return set;
+}
+
+// FNV-1a
+static size_t name_set_hash(const char* name)
+{
+    size_t hash = 2166136261u;
+    for (const char* c = name; *c; c++)
+    {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static const char** name_set_slot(struct name_set* set, const char* name)
+{
+    size_t index = name_set_hash(name) & (set->capacity - 1);
+    while (set->names[index] && strcmp(set->names[index], name) != 0)
+    {
+        index = (index + 1) & (set->capacity - 1);
+    }
+    return &set->names[index];
+}
+
+bool name_set_contains(struct name_set* set, const char* name)
+{
+    return *name_set_slot(set, name) != NULL;
+}
+
+void name_set_add(struct name_set* set, const char* name)
+{
+    // At most half full
+    if ((set->count + 1) * 2 > set->capacity)
+    {
+        struct name_set bigger = {.capacity = set->capacity * 2};
+        bigger.names = arena_calloc(bigger.capacity, sizeof(const char*));
+        for (size_t i = 0; i < set->capacity; i++)
+        {
+            if (set->names[i])
+            {
+                *name_set_slot(&bigger, set->names[i]) = set->names[i];
+            }
+        }
+        bigger.count = set->count;
+        arena_free(set->names);
+        *set = bigger;
+    }
+
+    const char** slot = name_set_slot(set, name);
+    if (!*slot)
+    {
+        *slot = name;
+        set->count++;
+    }
+}
+
+void name_set_free(struct name_set* set)
+{
+    arena_free(set->names);
+    arena_free(set);
+}
@@ -0,0 +1,23 @@
+#ifndef NAMESET_H
+#define NAMESET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NAME_SET_INITIAL_CAPACITY 256
+
+// A set of strings, open addressing, the names themselves aren't copied
+struct name_set
+{
+    const char** names;
+    size_t capacity;
+    size_t count;
+};
+
+struct name_set* name_set_create();
+
+bool name_set_contains(struct name_set* set, const char* name);
+void name_set_add(struct name_set* set, const char* name);
+void name_set_free(struct name_set* set);
+
+#endif
@@ -1,5 +1,6 @@
 
 #include "vector.h"
+#include "arena.h"
 #include <memory.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -23,8 +24,8 @@ static void vector_assert_bounds_for_pop(struct vector *vector, int index)
 
 struct vector *vector_create_no_saves(size_t esize)
 {
-    struct vector *vector = calloc(sizeof(struct vector), 1);
-    vector->data = malloc(esize * VECTOR_ELEMENT_INCREMENT);
+    struct vector *vector = arena_calloc(sizeof(struct vector), 1);
+    vector->data = arena_malloc(esize * VECTOR_ELEMENT_INCREMENT);
     vector->mindex = VECTOR_ELEMENT_INCREMENT;
     vector->rindex = 0;
     vector->pindex = 0;
@@ -45,9 +46,9 @@ size_t vector_element_size(struct vector *vector)
 
 struct vector *vector_clone(struct vector *vector)
 {
-    void *new_data_address = calloc(vector->esize, vector->count + VECTOR_ELEMENT_INCREMENT);
+    void *new_data_address = arena_calloc(vector->esize, vector->count + VECTOR_ELEMENT_INCREMENT);
     memcpy(new_data_address, vector->data, vector_total_size(vector));
-    struct vector *new_vec = calloc(sizeof(struct vector), 1);
+    struct vector *new_vec = arena_calloc(sizeof(struct vector), 1);
     memcpy(new_vec, vector, sizeof(struct vector));
     new_vec->data = new_data_address;
 
@@ -65,8 +66,8 @@ struct vector *vector_create(size_t esize)
 
 void vector_free(struct vector *vector)
 {
-    free(vector->data);
-    free(vector);
+    arena_free(vector->data);
+    arena_free(vector);
 }
 
 int vector_current_index(struct vector *vector)
@@ -82,7 +83,7 @@ void vector_resize_for_index(struct vector *vector, int start_index, int total_e
         return;
     }
 
-    vector->data = realloc(vector->data, ((start_index + total_elements + VECTOR_ELEMENT_INCREMENT) * vector->esize));
+    vector->data = arena_realloc(vector->data, ((start_index + total_elements + VECTOR_ELEMENT_INCREMENT) * vector->esize));
     assert(vector->data);
     vector->mindex = start_index + total_elements;
 }
@@ -108,6 +109,11 @@ void vector_set_peek_pointer(struct vector *vector, int index)
     vector->pindex = index;
 }
 
+int vector_peek_pointer(struct vector *vector)
+{
+    return vector->pindex;
+}
+
 void vector_set_peek_pointer_end(struct vector *vector)
 {
     vector_set_peek_pointer(vector, vector->rindex - 1);
@@ -352,7 +358,8 @@ void vector_pop_at(struct vector *vector, int index)
     void *next_element_pos = dst_pos + vector->esize;
     void *end_pos = vector_data_end(vector);
     size_t total = (size_t)end_pos - (size_t)next_element_pos;
-    memcpy(dst_pos, next_element_pos, total);
+    // The ranges overlap, memcpy can't be used
+    memmove(dst_pos, next_element_pos, total);
     vector->count -= 1;
     vector->rindex -= 1;
 }
@@ -60,6 +60,8 @@ void vector_pop_last_peek(struct vector* vector);
  */
 void* vector_peek_ptr(struct vector* vector);
 void vector_set_peek_pointer(struct vector* vector, int index);
+// The index vector_peek reads next
+int vector_peek_pointer(struct vector* vector);
 void vector_set_peek_pointer_end(struct vector* vector);
 void vector_push(struct vector* vector, void* elem);
 void vector_push_at(struct vector *vector, int index, void *ptr);
@@ -0,0 +1,180 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <string.h>
+
+/*
+ * Brace initializers
+ *
+ * int table[2][3] = {{1, 2, 3}, {4, 5, 6}};
+ * struct point p = {10, 20};
+ *
+ * The list is walked against the type of the variable and every element that gets a value is reported with its offset
+ * from the start of the variable, the code generators only have to store those values. Everything else is zero.
+ * The inner braces can be left out, the values are used for the elements in order: int table[2][3] = {1, 2, 3, 4, 5, 6};
+ */
+
+struct initializer_walk
+{
+    struct compiler_process* process;
+    INITIALIZER_ELEMENT_FUNCTION func;
+    void* private;
+};
+
+static void initializer_element(struct initializer_walk* walk, struct datatype* dtype, int bracket, struct vector* values, int* index, int offset);
+
+// bracket is the index of the array dimension we are at, when it equals the total dimensions we are at a single element
+static bool initializer_is_array_dimension(struct datatype* dtype, int bracket)
+{
+    return dtype->flags & DATATYPE_FLAG_IS_ARRAY && bracket < array_brackets_count(dtype);
+}
+
+static bool initializer_is_aggregate(struct datatype* dtype, int bracket)
+{
+    return initializer_is_array_dimension(dtype, bracket) || datatype_is_struct_or_union_non_pointer(dtype);
+}
+
+static size_t initializer_dimension_length(struct datatype* dtype, int bracket)
+{
+    struct node* bracket_node = vector_peek_ptr_at(array_brackets_node_vector(dtype->array.brackets), bracket);
+    return bracket_node->bracket.inner->llnum;
+}
+
+// The type of one element of the array, int x[4][5] -> int
+static struct datatype initializer_array_element_type(struct datatype* dtype)
+{
+    struct datatype element = *dtype;
+    element.flags &= ~DATATYPE_FLAG_IS_ARRAY;
+    return element;
+}
+
+// char name[8] = "abc" -> the last dimension is an array of chars
+static bool initializer_is_char_array(struct datatype* dtype, int bracket)
+{
+    return initializer_is_array_dimension(dtype, bracket) && bracket == array_brackets_count(dtype) - 1 && dtype->type == DATA_TYPE_CHAR && !(dtype->flags & DATATYPE_FLAG_IS_POINTER);
+}
+
+static struct node* initializer_body(struct datatype* dtype)
+{
+    return dtype->type == DATA_TYPE_UNION ? dtype->union_node->_union.body_n : dtype->struct_node->_struct.body_n;
+}
+
+// Fills the array dimension or structure from values, starting at *index
+static void initializer_fill(struct initializer_walk* walk, struct datatype* dtype, int bracket, struct vector* values, int* index, int offset)
+{
+    if (initializer_is_array_dimension(dtype, bracket))
+    {
+        size_t length = initializer_dimension_length(dtype, bracket);
+        size_t element_size = array_brackets_calculate_size_from_index(dtype, dtype->array.brackets, bracket + 1);
+        for (size_t i = 0; i < length && *index < vector_count(values); i++)
+        {
+            initializer_element(walk, dtype, bracket + 1, values, index, offset + i * element_size);
+        }
+        return;
+    }
+
+    struct vector* members = initializer_body(dtype)->body.statements;
+    for (int i = 0; i < vector_count(members) && *index < vector_count(values); i++)
+    {
+        struct node* member = variable_node(vector_peek_ptr_at(members, i));
+        if (!member)
+        {
+            continue;
+        }
+
+        if (dtype->type == DATA_TYPE_UNION)
+        {
+            // Only the first member of a union can be initialized, it starts at the beginning of the union
+            initializer_element(walk, &member->var.type, 0, values, index, offset);
+            break;
+        }
+
+        // The same offset member access uses
+        struct node* member_out = NULL;
+        int member_offset = struct_offset(walk->process, dtype->type_str, member->var.name, &member_out, 0, 0);
+        initializer_element(walk, &member->var.type, 0, values, index, offset + member_offset);
+    }
+}
+
+// Gives a value to the element at offset from values[*index]
+static void initializer_element(struct initializer_walk* walk, struct datatype* dtype, int bracket, struct vector* values, int* index, int offset)
+{
+    struct node* value_node = vector_peek_ptr_at(values, *index);
+    if (value_node->type == NODE_TYPE_STRING && initializer_is_char_array(dtype, bracket))
+    {
+        // The whole string goes into the char array
+        struct datatype char_array = *dtype;
+        char_array.array.size = initializer_dimension_length(dtype, bracket);
+        walk->func(value_node, &char_array, offset, walk->private);
+        (*index)++;
+        return;
+    }
+
+    if (value_node->type == NODE_TYPE_INITIALIZER_LIST)
+    {
+        struct vector* inner_values = value_node->initializer.values;
+        int inner_index = 0;
+        if (initializer_is_aggregate(dtype, bracket))
+        {
+            initializer_fill(walk, dtype, bracket, inner_values, &inner_index, offset);
+        }
+        else if (vector_count(inner_values))
+        {
+            // int x = {5};
+            initializer_element(walk, dtype, bracket, inner_values, &inner_index, offset);
+        }
+
+        if (inner_index < vector_count(inner_values))
+        {
+            compiler_error(walk->process, "Too many values in the initializer list");
+        }
+        (*index)++;
+        return;
+    }
+
+    // An expression can give the value of a whole structure, only numbers and strings are taken as the values of its members
+    bool elided_braces = initializer_is_array_dimension(dtype, bracket) || (datatype_is_struct_or_union_non_pointer(dtype) && (value_node->type == NODE_TYPE_NUMBER || value_node->type == NODE_TYPE_STRING));
+    if (elided_braces)
+    {
+        initializer_fill(walk, dtype, bracket, values, index, offset);
+        return;
+    }
+
+    struct datatype element = bracket ? initializer_array_element_type(dtype) : *dtype;
+    walk->func(value_node, &element, offset, walk->private);
+    (*index)++;
+}
+
+void initializer_for_each_element(struct compiler_process* process, struct datatype* dtype, struct node* value_node, INITIALIZER_ELEMENT_FUNCTION func, void* private)
+{
+    struct initializer_walk walk = {.process = process, .func = func, .private = private};
+    struct vector* values = vector_create(sizeof(struct node*));
+    vector_push(values, &value_node);
+    int index = 0;
+    initializer_element(&walk, dtype, 0, values, &index, 0);
+    vector_free(values);
+}
+
+size_t initializer_string_length(struct node* string_node, struct datatype* dtype)
+{
+    size_t length = strlen(string_node->sval) + 1;
+    size_t array_size = datatype_size(dtype);
+    return length < array_size ? length : array_size;
+}
+
+static void initializer_count_bytes(struct node* value_node, struct datatype* dtype, int offset, void* private)
+{
+    size_t* bytes = private;
+    if (value_node->type == NODE_TYPE_STRING && dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        *bytes += initializer_string_length(value_node, dtype);
+        return;
+    }
+    *bytes += datatype_size(dtype);
+}
+
+bool initializer_covers_variable(struct compiler_process* process, struct datatype* dtype, struct node* value_node)
+{
+    size_t bytes = 0;
+    initializer_for_each_element(process, dtype, value_node, initializer_count_bytes, &bytes);
+    return bytes == datatype_size(dtype);
+}
@@ -0,0 +1,453 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <assert.h>
+#include <stdlib.h>
+
+size_t ir_type_size(int type)
+{
+    size_t size = 0;
+    switch (type)
+    {
+    case IR_TYPE_I8:
+    case IR_TYPE_U8:
+        size = DATA_SIZE_BYTE;
+        break;
+    case IR_TYPE_I16:
+    case IR_TYPE_U16:
+        size = DATA_SIZE_WORD;
+        break;
+    case IR_TYPE_I32:
+    case IR_TYPE_U32:
+        size = DATA_SIZE_DWORD;
+        break;
+    case IR_TYPE_PTR:
+        size = datatype_pointer_size();
+        break;
+    }
+    return size;
+}
+
+bool ir_type_is_signed(int type)
+{
+    return type == IR_TYPE_I8 || type == IR_TYPE_I16 || type == IR_TYPE_I32;
+}
+
+const char* ir_type_name(int type)
+{
+    const char* name = "void";
+    switch (type)
+    {
+    case IR_TYPE_I8:
+        name = "i8";
+        break;
+    case IR_TYPE_U8:
+        name = "u8";
+        break;
+    case IR_TYPE_I16:
+        name = "i16";
+        break;
+    case IR_TYPE_U16:
+        name = "u16";
+        break;
+    case IR_TYPE_I32:
+        name = "i32";
+        break;
+    case IR_TYPE_U32:
+        name = "u32";
+        break;
+    case IR_TYPE_PTR:
+        name = "ptr";
+        break;
+    }
+    return name;
+}
+
+struct ir_value ir_value_none()
+{
+    return (struct ir_value){.type = IR_VALUE_NONE};
+}
+
+struct ir_value ir_value_vreg(int vreg)
+{
+    return (struct ir_value){.type = IR_VALUE_VREG, .vreg = vreg};
+}
+
+struct ir_value ir_value_constant(long long constant)
+{
+    return (struct ir_value){.type = IR_VALUE_CONSTANT, .constant = constant};
+}
+
+struct ir_value ir_value_string(const char* str)
+{
+    return (struct ir_value){.type = IR_VALUE_STRING, .string = str};
+}
+
+struct ir_value ir_value_symbol(const char* name, int offset)
+{
+    return (struct ir_value){.type = IR_VALUE_SYMBOL, .symbol = name, .offset = offset};
+}
+
+struct ir_value ir_value_local(int local, int offset)
+{
+    return (struct ir_value){.type = IR_VALUE_LOCAL, .local = local, .offset = offset};
+}
+
+bool ir_value_is_vreg(struct ir_value* value, int vreg)
+{
+    return value->type == IR_VALUE_VREG && value->vreg == vreg;
+}
+
+bool ir_value_equal(struct ir_value* a, struct ir_value* b)
+{
+    if (a->type != b->type || a->offset != b->offset)
+    {
+        return false;
+    }
+
+    bool equal = true;
+    switch (a->type)
+    {
+    case IR_VALUE_VREG:
+        equal = a->vreg == b->vreg;
+        break;
+    case IR_VALUE_CONSTANT:
+        equal = a->constant == b->constant;
+        break;
+    case IR_VALUE_STRING:
+        equal = S_EQ(a->string, b->string);
+        break;
+    case IR_VALUE_SYMBOL:
+        equal = S_EQ(a->symbol, b->symbol);
+        break;
+    case IR_VALUE_LOCAL:
+        equal = a->local == b->local;
+        break;
+    }
+    return equal;
+}
+
+// Calls func for every value the instruction reads
+void ir_instruction_for_each_operand(struct ir_instruction* instruction, IR_OPERAND_FUNCTION func, void* private)
+{
+    func(&instruction->a, private);
+    func(&instruction->b, private);
+    if (instruction->op == IR_OP_CALL)
+    {
+        for (int i = 0; i < vector_count(instruction->args); i++)
+        {
+            func(vector_at(instruction->args, i), private);
+        }
+    }
+}
+
+static void ir_count_definition(struct ir_instruction* instruction, int* counts)
+{
+    if (instruction->dst.type == IR_VALUE_VREG)
+    {
+        counts[instruction->dst.vreg]++;
+    }
+}
+
+// How many instructions write every virtual register, most are written once, the result of && || and ?: is written in more blocks
+int* ir_function_definition_counts(struct ir_function* function)
+{
+    int* counts = arena_calloc(function->vreg_count + 1, sizeof(int));
+    for (int i = 0; i < vector_count(function->blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(function->blocks, i);
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            ir_count_definition(vector_peek_ptr_at(block->instructions, j), counts);
+        }
+    }
+    return counts;
+}
+
+struct ir_function* ir_function_new(struct node* func_node)
+{
+    struct ir_function* function = arena_calloc(1, sizeof(struct ir_function));
+    function->node = func_node;
+    function->name = func_node->func.name;
+    function->blocks = vector_create(sizeof(struct ir_block*));
+    function->locals = vector_create(sizeof(struct ir_local*));
+    return function;
+}
+
+int ir_function_new_vreg(struct ir_function* function)
+{
+    return function->vreg_count++;
+}
+
+struct ir_local* ir_function_new_local(struct ir_function* function, const char* name, size_t size, size_t align, int flags)
+{
+    struct ir_local* local = arena_calloc(1, sizeof(struct ir_local));
+    local->id = vector_count(function->locals);
+    local->name = name;
+    local->size = size;
+    local->align = align;
+    local->flags = flags;
+    vector_push(function->locals, &local);
+    return local;
+}
+
+struct ir_local* ir_function_local(struct ir_function* function, int local)
+{
+    return vector_peek_ptr_at(function->locals, local);
+}
+
+struct ir_block* ir_block_new(struct ir_function* function, const char* name)
+{
+    struct ir_block* block = arena_calloc(1, sizeof(struct ir_block));
+    block->id = function->block_count++;
+    block->name = name;
+    block->instructions = vector_create(sizeof(struct ir_instruction*));
+    vector_push(function->blocks, &block);
+    return block;
+}
+
+struct ir_instruction* ir_instruction_new(int op, int type)
+{
+    struct ir_instruction* instruction = arena_calloc(1, sizeof(struct ir_instruction));
+    instruction->op = op;
+    instruction->type = type;
+    return instruction;
+}
+
+void ir_block_add_instruction(struct ir_block* block, struct ir_instruction* instruction)
+{
+    vector_push(block->instructions, &instruction);
+}
+
+bool ir_instruction_is_terminator(struct ir_instruction* instruction)
+{
+    return instruction->op == IR_OP_JUMP || instruction->op == IR_OP_BRANCH || instruction->op == IR_OP_RETURN;
+}
+
+struct ir_instruction* ir_block_terminator(struct ir_block* block)
+{
+    struct ir_instruction* instruction = vector_back_ptr_or_null(block->instructions);
+    if (!instruction || !ir_instruction_is_terminator(instruction))
+    {
+        return NULL;
+    }
+    return instruction;
+}
+
+bool ir_op_is_binary(int op)
+{
+    return op >= IR_OP_ADD && op <= IR_OP_SHR;
+}
+
+bool ir_op_is_comparison(int op)
+{
+    return op >= IR_OP_EQ && op <= IR_OP_GE;
+}
+
+// Fills successors_out (room for 2) with the blocks the block can continue in, returns how many there are
+int ir_block_successors(struct ir_block* block, struct ir_block** successors_out)
+{
+    struct ir_instruction* terminator = ir_block_terminator(block);
+    if (!terminator || terminator->op == IR_OP_RETURN)
+    {
+        return 0;
+    }
+
+    if (terminator->op == IR_OP_JUMP || terminator->targets[0] == terminator->targets[1])
+    {
+        successors_out[0] = terminator->targets[0];
+        return 1;
+    }
+
+    successors_out[0] = terminator->targets[0];
+    successors_out[1] = terminator->targets[1];
+    return 2;
+}
+
+// Blocks nothing jumps to (code after return, break etc.) are removed, the order of the others is kept
+void ir_function_remove_unreachable_blocks(struct ir_function* function)
+{
+    bool* reachable = arena_calloc(function->block_count, sizeof(bool));
+    struct vector* worklist = vector_create(sizeof(struct ir_block*));
+    struct ir_block* entry = vector_peek_ptr_at(function->blocks, 0);
+    reachable[entry->id] = true;
+    vector_push(worklist, &entry);
+    while (!vector_empty(worklist))
+    {
+        struct ir_block* block = vector_back_ptr(worklist);
+        vector_pop(worklist);
+
+        struct ir_block* successors[2];
+        int total_successors = ir_block_successors(block, successors);
+        for (int i = 0; i < total_successors; i++)
+        {
+            if (!reachable[successors[i]->id])
+            {
+                reachable[successors[i]->id] = true;
+                vector_push(worklist, &successors[i]);
+            }
+        }
+    }
+
+    struct vector* blocks = vector_create(sizeof(struct ir_block*));
+    for (int i = 0; i < vector_count(function->blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(function->blocks, i);
+        if (reachable[block->id])
+        {
+            vector_push(blocks, &block);
+        }
+    }
+    vector_free(function->blocks);
+    function->blocks = blocks;
+    vector_free(worklist);
+    arena_free(reachable);
+}
+
+static const char* ir_op_name(int op)
+{
+    static const char* names[] = {
+        [IR_OP_MOVE] = "move",
+        [IR_OP_ADDRESS] = "addr",
+        [IR_OP_LOAD] = "load",
+        [IR_OP_STORE] = "store",
+        [IR_OP_ZERO] = "zero",
+        [IR_OP_ADD] = "add",
+        [IR_OP_SUB] = "sub",
+        [IR_OP_MUL] = "mul",
+        [IR_OP_DIV] = "div",
+        [IR_OP_MOD] = "mod",
+        [IR_OP_AND] = "and",
+        [IR_OP_OR] = "or",
+        [IR_OP_XOR] = "xor",
+        [IR_OP_SHL] = "shl",
+        [IR_OP_SHR] = "shr",
+        [IR_OP_NEG] = "neg",
+        [IR_OP_NOT] = "not",
+        [IR_OP_EQ] = "eq",
+        [IR_OP_NE] = "ne",
+        [IR_OP_LT] = "lt",
+        [IR_OP_LE] = "le",
+        [IR_OP_GT] = "gt",
+        [IR_OP_GE] = "ge",
+        [IR_OP_CONVERT] = "convert",
+        [IR_OP_CALL] = "call",
+        [IR_OP_JUMP] = "jump",
+        [IR_OP_BRANCH] = "branch",
+        [IR_OP_RETURN] = "return"
+    };
+    return names[op];
+}
+
+static void ir_value_dump(struct ir_function* function, struct ir_value* value, FILE* out)
+{
+    switch (value->type)
+    {
+    case IR_VALUE_VREG:
+        fprintf(out, "%%%i", value->vreg);
+        break;
+    case IR_VALUE_CONSTANT:
+        fprintf(out, "%lld", value->constant);
+        break;
+    case IR_VALUE_STRING:
+        fprintf(out, "\"%s\"", value->string);
+        break;
+    case IR_VALUE_SYMBOL:
+        fprintf(out, "@%s", value->symbol);
+        break;
+    case IR_VALUE_LOCAL:
+        fprintf(out, "$%s.%i", ir_function_local(function, value->local)->name, value->local);
+        break;
+    default:
+        fprintf(out, "_");
+        break;
+    }
+
+    if (value->type != IR_VALUE_CONSTANT && value->offset)
+    {
+        fprintf(out, "%+i", value->offset);
+    }
+}
+
+static void ir_instruction_dump(struct ir_function* function, struct ir_instruction* instruction, FILE* out)
+{
+    fprintf(out, "    ");
+    if (instruction->dst.type != IR_VALUE_NONE)
+    {
+        ir_value_dump(function, &instruction->dst, out);
+        fprintf(out, " = ");
+    }
+
+    fprintf(out, "%s", ir_op_name(instruction->op));
+    if (instruction->op == IR_OP_CONVERT)
+    {
+        fprintf(out, ".%s", ir_type_name(instruction->from_type));
+    }
+    if (instruction->type != IR_TYPE_VOID)
+    {
+        fprintf(out, ".%s", ir_type_name(instruction->type));
+    }
+
+    if (instruction->a.type != IR_VALUE_NONE)
+    {
+        fprintf(out, " ");
+        ir_value_dump(function, &instruction->a, out);
+    }
+    if (instruction->b.type != IR_VALUE_NONE)
+    {
+        fprintf(out, ", ");
+        ir_value_dump(function, &instruction->b, out);
+    }
+
+    if (instruction->op == IR_OP_CALL)
+    {
+        fprintf(out, "(");
+        for (int i = 0; i < vector_count(instruction->args); i++)
+        {
+            fprintf(out, i ? ", " : "");
+            ir_value_dump(function, vector_at(instruction->args, i), out);
+        }
+        fprintf(out, ")");
+    }
+    else if (instruction->op == IR_OP_JUMP)
+    {
+        fprintf(out, " bb%i", instruction->targets[0]->id);
+    }
+    else if (instruction->op == IR_OP_BRANCH)
+    {
+        fprintf(out, ", bb%i, bb%i", instruction->targets[0]->id, instruction->targets[1]->id);
+    }
+    fprintf(out, "\n");
+}
+
+void ir_function_dump(struct ir_function* function, FILE* out)
+{
+    fprintf(out, "function %s -> %s", function->name, ir_type_name(function->return_type));
+    if (function->unsupported_reason)
+    {
+        fprintf(out, " ; not lowered: %s\n\n", function->unsupported_reason);
+        return;
+    }
+    fprintf(out, "\n");
+
+    for (int i = 0; i < vector_count(function->locals); i++)
+    {
+        struct ir_local* local = ir_function_local(function, i);
+        fprintf(out, "  $%s.%i size %zu%s%s\n", local->name, local->id, local->size, local->flags & IR_LOCAL_FLAG_ARGUMENT ? " argument" : "", local->flags & IR_LOCAL_FLAG_ADDRESS_TAKEN ? " address-taken" : "");
+    }
+
+    for (int i = 0; i < vector_count(function->blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(function->blocks, i);
+        fprintf(out, "bb%i:", block->id);
+        if (block->name)
+        {
+            fprintf(out, " ; %s", block->name);
+        }
+        fprintf(out, "\n");
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            ir_instruction_dump(function, vector_peek_ptr_at(block->instructions, j), out);
+        }
+    }
+    fprintf(out, "\n");
+}
@@ -0,0 +1,1798 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Lowers a function from the AST into the intermediate representation
+ *
+ * int abc(int a)
+ * {
+ *  return a + 5;
+ * }
+ *
+ * becomes
+ *
+ * bb0:
+ *     %0 = load.i32 $a.0
+ *     %1 = add.i32 %0, 5
+ *     return.i32 %1
+ */
+
+struct ir_scope_variable
+{
+    const char* name;
+    int local;
+    struct datatype dtype;
+};
+
+struct ir_label
+{
+    const char* name;
+    struct ir_block* block;
+};
+
+struct ir_case
+{
+    // The case or default node inside of the switch body
+    struct node* node;
+    struct ir_block* block;
+};
+
+struct ir_builder
+{
+    struct compiler_process* process;
+    struct ir_function* function;
+
+    // The block that new instructions are added to
+    struct ir_block* block;
+
+    // The node that is currently being lowered, new instructions point to it
+    struct node* node;
+
+    // Vector of struct vector* holding struct ir_scope_variable*, the innermost scope is the last one
+    struct vector* scopes;
+
+    // Vector of struct ir_block*, the last one is where break/continue jumps to
+    struct vector* break_blocks;
+    struct vector* continue_blocks;
+
+    // Vector of struct ir_label*
+    struct vector* labels;
+
+    // Vector of struct ir_case*
+    struct vector* cases;
+
+    // Vector of struct ir_block* in the order code was first added to them, this is the order they are emitted in
+    struct vector* block_order;
+};
+
+// An expression while it's being lowered
+struct ir_expression
+{
+    struct datatype dtype;
+
+    // True if the expression names memory (abc, abc[5], *abc, abc.x), value is the memory operand then, otherwise value is the result of the expression
+    bool is_location;
+    struct ir_value value;
+};
+
+static struct ir_expression ir_build_expression(struct ir_builder* builder, struct node* node);
+static void ir_build_statement(struct ir_builder* builder, struct node* node);
+static void ir_build_condition(struct ir_builder* builder, struct node* node, struct ir_block* true_block, struct ir_block* false_block);
+
+static void ir_builder_unsupported(struct ir_builder* builder, const char* reason)
+{
+    // Only the first reason is interesting
+    if (!builder->function->unsupported_reason)
+    {
+        builder->function->unsupported_reason = reason;
+    }
+}
+
+static bool ir_builder_failed(struct ir_builder* builder)
+{
+    return builder->function->unsupported_reason != NULL;
+}
+
+static struct ir_instruction* ir_builder_emit(struct ir_builder* builder, int op, int type)
+{
+    struct ir_instruction* instruction = ir_instruction_new(op, type);
+    instruction->node = builder->node;
+    ir_block_add_instruction(builder->block, instruction);
+    return instruction;
+}
+
+static bool ir_block_vector_contains(struct vector* blocks, struct ir_block* block)
+{
+    for (int i = vector_count(blocks) - 1; i >= 0; i--)
+    {
+        if (vector_peek_ptr_at(blocks, i) == block)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void ir_builder_set_block(struct ir_builder* builder, struct ir_block* block)
+{
+    builder->block = block;
+    if (!ir_block_vector_contains(builder->block_order, block))
+    {
+        vector_push(builder->block_order, &block);
+    }
+}
+
+// Blocks are created before they are filled (the end of an if statement exists before its body), put them in the order they were filled in so most jumps become fall throughs
+static void ir_builder_order_blocks(struct ir_builder* builder)
+{
+    struct vector* blocks = builder->function->blocks;
+    for (int i = 0; i < vector_count(blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(blocks, i);
+        if (!ir_block_vector_contains(builder->block_order, block))
+        {
+            vector_push(builder->block_order, &block);
+        }
+    }
+    vector_free(blocks);
+    builder->function->blocks = builder->block_order;
+}
+
+static bool ir_builder_block_terminated(struct ir_builder* builder)
+{
+    return ir_block_terminator(builder->block) != NULL;
+}
+
+static void ir_builder_jump(struct ir_builder* builder, struct ir_block* target)
+{
+    if (ir_builder_block_terminated(builder))
+    {
+        return;
+    }
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_JUMP, IR_TYPE_VOID);
+    instruction->targets[0] = target;
+}
+
+// Code after return, break etc. still needs a block to go in, nothing jumps to it so it can be removed later
+static void ir_builder_start_unreachable_block(struct ir_builder* builder)
+{
+    ir_builder_set_block(builder, ir_block_new(builder->function, "unreachable"));
+}
+
+static void ir_builder_branch(struct ir_builder* builder, struct ir_value cond, struct ir_block* true_block, struct ir_block* false_block)
+{
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_BRANCH, IR_TYPE_VOID);
+    instruction->a = cond;
+    instruction->targets[0] = true_block;
+    instruction->targets[1] = false_block;
+}
+
+static struct ir_value ir_builder_new_vreg(struct ir_builder* builder)
+{
+    return ir_value_vreg(ir_function_new_vreg(builder->function));
+}
+
+static struct ir_value ir_builder_binary(struct ir_builder* builder, int op, int type, struct ir_value a, struct ir_value b)
+{
+    struct ir_instruction* instruction = ir_builder_emit(builder, op, type);
+    instruction->dst = ir_builder_new_vreg(builder);
+    instruction->a = a;
+    instruction->b = b;
+    return instruction->dst;
+}
+
+static struct ir_value ir_builder_unary(struct ir_builder* builder, int op, int type, struct ir_value a)
+{
+    return ir_builder_binary(builder, op, type, a, ir_value_none());
+}
+
+static void ir_builder_store(struct ir_builder* builder, int type, struct ir_value location, struct ir_value value)
+{
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_STORE, type);
+    instruction->a = location;
+    instruction->b = value;
+}
+
+static struct ir_value ir_builder_load(struct ir_builder* builder, int type, struct ir_value location)
+{
+    return ir_builder_unary(builder, IR_OP_LOAD, type, location);
+}
+
+// Registers always hold the full width value, so only narrowing needs an instruction (and widening to a bigger pointer)
+static struct ir_value ir_builder_convert(struct ir_builder* builder, struct ir_value value, int from_type, int to_type)
+{
+    if (from_type == to_type || to_type == IR_TYPE_VOID || from_type == IR_TYPE_VOID)
+    {
+        return value;
+    }
+
+    if (ir_type_size(to_type) >= ir_type_size(IR_TYPE_I32) && ir_type_size(to_type) <= ir_type_size(from_type < IR_TYPE_I32 ? IR_TYPE_I32 : from_type))
+    {
+        return value;
+    }
+
+    if (value.type == IR_VALUE_CONSTANT)
+    {
+        long long constant = value.constant;
+        switch (to_type)
+        {
+        case IR_TYPE_I8:
+            constant = (signed char)constant;
+            break;
+        case IR_TYPE_U8:
+            constant = (unsigned char)constant;
+            break;
+        case IR_TYPE_I16:
+            constant = (short)constant;
+            break;
+        case IR_TYPE_U16:
+            constant = (unsigned short)constant;
+            break;
+        }
+        return ir_value_constant(constant);
+    }
+
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_CONVERT, to_type);
+    instruction->from_type = from_type;
+    instruction->dst = ir_builder_new_vreg(builder);
+    instruction->a = value;
+    return instruction->dst;
+}
+
+static void ir_builder_new_scope(struct ir_builder* builder)
+{
+    struct vector* scope = vector_create(sizeof(struct ir_scope_variable*));
+    vector_push(builder->scopes, &scope);
+}
+
+static void ir_builder_finish_scope(struct ir_builder* builder)
+{
+    vector_pop(builder->scopes);
+}
+
+static struct ir_scope_variable* ir_builder_get_variable(struct ir_builder* builder, const char* name)
+{
+    for (int i = vector_count(builder->scopes) - 1; i >= 0; i--)
+    {
+        struct vector* scope = vector_peek_ptr_at(builder->scopes, i);
+        for (int j = vector_count(scope) - 1; j >= 0; j--)
+        {
+            struct ir_scope_variable* variable = vector_peek_ptr_at(scope, j);
+            if (S_EQ(variable->name, name))
+            {
+                return variable;
+            }
+        }
+    }
+    return NULL;
+}
+
+static struct datatype ir_datatype_int()
+{
+    struct datatype dtype = datatype_for_numeric();
+    dtype.flags = DATATYPE_FLAG_IS_SIGNED;
+    return dtype;
+}
+
+static bool ir_datatype_is_aggregate(struct datatype* dtype)
+{
+    return datatype_is_struct_or_union_non_pointer(dtype) && !(dtype->flags & DATATYPE_FLAG_IS_ARRAY);
+}
+
+static bool ir_datatype_is_pointer(struct datatype* dtype)
+{
+    return dtype->flags & (DATATYPE_FLAG_IS_POINTER | DATATYPE_FLAG_IS_ARRAY);
+}
+
+// The size of the variable in memory
+static size_t ir_datatype_size(struct datatype* dtype)
+{
+    size_t element_size = dtype->flags & DATATYPE_FLAG_IS_POINTER ? ir_type_size(IR_TYPE_PTR) : dtype->size;
+    if (!(dtype->flags & DATATYPE_FLAG_IS_ARRAY))
+    {
+        return element_size;
+    }
+
+    size_t size = element_size;
+    struct vector* brackets = array_brackets_node_vector(dtype->array.brackets);
+    for (int i = 0; i < vector_count(brackets); i++)
+    {
+        struct node* bracket_node = vector_peek_ptr_at(brackets, i);
+        if (!bracket_node->bracket.inner || bracket_node->bracket.inner->type != NODE_TYPE_NUMBER)
+        {
+            return 0;
+        }
+        size *= bracket_node->bracket.inner->llnum;
+    }
+    return size;
+}
+
+static size_t ir_datatype_align(struct datatype* dtype)
+{
+    if (ir_datatype_is_pointer(dtype) && !(dtype->flags & DATATYPE_FLAG_IS_ARRAY))
+    {
+        return ir_type_size(IR_TYPE_PTR);
+    }
+    if (datatype_is_struct_or_union(dtype) || dtype->size > DATA_SIZE_DWORD)
+    {
+        return DATA_SIZE_DWORD;
+    }
+    return dtype->size ? dtype->size : 1;
+}
+
+// int x[5][6] -> int [6], int* -> int
+static struct datatype ir_datatype_element(struct datatype* dtype)
+{
+    struct datatype element = *dtype;
+    if (dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        struct vector* brackets = array_brackets_node_vector(dtype->array.brackets);
+        if (vector_count(brackets) <= 1)
+        {
+            element.flags &= ~DATATYPE_FLAG_IS_ARRAY;
+            element.array.brackets = NULL;
+            element.array.size = 0;
+            return element;
+        }
+
+        element.array.brackets = array_brackets_new();
+        for (int i = 1; i < vector_count(brackets); i++)
+        {
+            array_brackets_add(element.array.brackets, vector_peek_ptr_at(brackets, i));
+        }
+        element.array.size = ir_datatype_size(&element);
+        return element;
+    }
+
+    element.pointer_depth--;
+    if (element.pointer_depth <= 0)
+    {
+        element.pointer_depth = 0;
+        element.flags &= ~DATATYPE_FLAG_IS_POINTER;
+    }
+    return element;
+}
+
+static struct datatype ir_datatype_pointer_to(struct datatype* dtype)
+{
+    struct datatype pointer = *dtype;
+    pointer.flags |= DATATYPE_FLAG_IS_POINTER;
+    pointer.flags &= ~(DATATYPE_FLAG_IS_ARRAY | DATATYPE_FLAG_IS_LITERAL);
+    pointer.pointer_depth++;
+    return pointer;
+}
+
+static int ir_builder_type(struct ir_builder* builder, struct datatype* dtype)
+{
+    if (ir_datatype_is_pointer(dtype))
+    {
+        return IR_TYPE_PTR;
+    }
+
+    bool is_signed = dtype->flags & (DATATYPE_FLAG_IS_SIGNED | DATATYPE_FLAG_IS_LITERAL);
+    int type = IR_TYPE_VOID;
+    switch (dtype->type)
+    {
+    case DATA_TYPE_VOID:
+        type = IR_TYPE_VOID;
+        break;
+    case DATA_TYPE_CHAR:
+        type = is_signed ? IR_TYPE_I8 : IR_TYPE_U8;
+        break;
+    case DATA_TYPE_SHORT:
+        type = is_signed ? IR_TYPE_I16 : IR_TYPE_U16;
+        break;
+    case DATA_TYPE_INTEGER:
+    case DATA_TYPE_LONG:
+        type = is_signed ? IR_TYPE_I32 : IR_TYPE_U32;
+        break;
+    case DATA_TYPE_FLOAT:
+    case DATA_TYPE_DOUBLE:
+        ir_builder_unsupported(builder, "floating point");
+        break;
+    default:
+        ir_builder_unsupported(builder, "structure or union value");
+        break;
+    }
+    return type;
+}
+
+static struct ir_expression ir_expression_value(struct ir_value value, struct datatype dtype)
+{
+    return (struct ir_expression){.dtype = dtype, .is_location = false, .value = value};
+}
+
+static struct ir_expression ir_expression_location(struct ir_value location, struct datatype dtype)
+{
+    return (struct ir_expression){.dtype = dtype, .is_location = true, .value = location};
+}
+
+// A dummy result so lowering can continue after something unsupported was found
+static struct ir_expression ir_expression_failed(struct ir_builder* builder, const char* reason)
+{
+    ir_builder_unsupported(builder, reason);
+    return ir_expression_value(ir_value_constant(0), ir_datatype_int());
+}
+
+static void ir_builder_mark_address_taken(struct ir_builder* builder, struct ir_value* location)
+{
+    if (location->type == IR_VALUE_LOCAL)
+    {
+        ir_function_local(builder->function, location->local)->flags |= IR_LOCAL_FLAG_ADDRESS_TAKEN;
+    }
+}
+
+// Turns a memory location into a register holding its address
+static struct ir_value ir_builder_location_address(struct ir_builder* builder, struct ir_value location)
+{
+    struct ir_value address = location;
+    switch (location.type)
+    {
+    case IR_VALUE_LOCAL:
+    {
+        ir_builder_mark_address_taken(builder, &location);
+        struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_ADDRESS, IR_TYPE_PTR);
+        instruction->dst = ir_builder_new_vreg(builder);
+        instruction->a = location;
+        address = instruction->dst;
+    }
+    break;
+
+    case IR_VALUE_VREG:
+        if (location.offset)
+        {
+            address = ir_builder_binary(builder, IR_OP_ADD, IR_TYPE_PTR, ir_value_vreg(location.vreg), ir_value_constant(location.offset));
+        }
+        break;
+    }
+    return address;
+}
+
+// Moves a memory location by offset bytes, it is just folded into the location so no instruction is needed
+static struct ir_value ir_location_add_offset(struct ir_value location, int offset)
+{
+    location.offset += offset;
+    return location;
+}
+
+// A value holding an address can be used as a memory location directly (@abc+4 is both the address and the location abc+4)
+static struct ir_value ir_location_for_address(struct ir_value address)
+{
+    return address;
+}
+
+// The value of the expression, memory is loaded, arrays decay into the address of their first element
+static struct ir_value ir_expression_rvalue(struct ir_builder* builder, struct ir_expression* exp)
+{
+    if (!exp->is_location)
+    {
+        return exp->value;
+    }
+
+    if (exp->dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        return ir_builder_location_address(builder, exp->value);
+    }
+
+    if (ir_datatype_is_aggregate(&exp->dtype))
+    {
+        ir_builder_unsupported(builder, "structure or union value");
+        return ir_value_constant(0);
+    }
+
+    return ir_builder_load(builder, ir_builder_type(builder, &exp->dtype), exp->value);
+}
+
+static struct ir_value ir_build_value(struct ir_builder* builder, struct node* node, struct datatype* dtype_out)
+{
+    struct ir_expression exp = ir_build_expression(builder, node);
+    struct ir_value value = ir_expression_rvalue(builder, &exp);
+    if (dtype_out)
+    {
+        *dtype_out = exp.dtype;
+        if (exp.dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+        {
+            // The array decayed into a pointer
+            struct datatype element = ir_datatype_element(&exp.dtype);
+            *dtype_out = ir_datatype_pointer_to(&element);
+        }
+    }
+    return value;
+}
+
+// How many bytes "pointer + 1" moves
+static size_t ir_datatype_pointer_step(struct datatype* dtype)
+{
+    struct datatype element = ir_datatype_element(dtype);
+    return ir_datatype_size(&element);
+}
+
+// abc + 5 where abc is a pointer -> abc + 5 * sizeof(*abc)
+static struct ir_value ir_builder_scale_index(struct ir_builder* builder, struct ir_value index, struct datatype* index_dtype, size_t scale)
+{
+    index = ir_builder_convert(builder, index, ir_builder_type(builder, index_dtype), IR_TYPE_PTR);
+    if (index.type == IR_VALUE_CONSTANT)
+    {
+        return ir_value_constant(index.constant * (long long)scale);
+    }
+    if (scale == 1)
+    {
+        return index;
+    }
+    return ir_builder_binary(builder, IR_OP_MUL, IR_TYPE_PTR, index, ir_value_constant(scale));
+}
+
+static int ir_op_for_arithmetic_operator(const char* op)
+{
+    int ir_op = -1;
+    if (S_EQ(op, "+"))
+        ir_op = IR_OP_ADD;
+    else if (S_EQ(op, "-"))
+        ir_op = IR_OP_SUB;
+    else if (S_EQ(op, "*"))
+        ir_op = IR_OP_MUL;
+    else if (S_EQ(op, "/"))
+        ir_op = IR_OP_DIV;
+    else if (S_EQ(op, "%"))
+        ir_op = IR_OP_MOD;
+    else if (S_EQ(op, "&"))
+        ir_op = IR_OP_AND;
+    else if (S_EQ(op, "|"))
+        ir_op = IR_OP_OR;
+    else if (S_EQ(op, "^"))
+        ir_op = IR_OP_XOR;
+    else if (S_EQ(op, "<<"))
+        ir_op = IR_OP_SHL;
+    else if (S_EQ(op, ">>"))
+        ir_op = IR_OP_SHR;
+    return ir_op;
+}
+
+static int ir_op_for_comparison_operator(const char* op)
+{
+    int ir_op = -1;
+    if (S_EQ(op, "=="))
+        ir_op = IR_OP_EQ;
+    else if (S_EQ(op, "!="))
+        ir_op = IR_OP_NE;
+    else if (S_EQ(op, "<"))
+        ir_op = IR_OP_LT;
+    else if (S_EQ(op, "<="))
+        ir_op = IR_OP_LE;
+    else if (S_EQ(op, ">"))
+        ir_op = IR_OP_GT;
+    else if (S_EQ(op, ">="))
+        ir_op = IR_OP_GE;
+    return ir_op;
+}
+
+// += -> +
+static const char* ir_compound_assignment_operator(const char* op)
+{
+    static const char* operators[][2] = {{"+=", "+"}, {"-=", "-"}, {"*=", "*"}, {"/=", "/"}, {"%=", "%"}, {"&=", "&"}, {"|=", "|"}, {"^=", "^"}, {"<<=", "<<"}, {">>=", ">>"}};
+    for (int i = 0; i < sizeof(operators) / sizeof(operators[0]); i++)
+    {
+        if (S_EQ(op, operators[i][0]))
+        {
+            return operators[i][1];
+        }
+    }
+    return NULL;
+}
+
+// The type both sides are converted to, int unless one of them is an unsigned int
+static int ir_builder_arithmetic_type(struct ir_builder* builder, struct datatype* left_dtype, struct datatype* right_dtype)
+{
+    int left_type = ir_builder_type(builder, left_dtype);
+    int right_type = ir_builder_type(builder, right_dtype);
+    if (left_type == IR_TYPE_PTR || right_type == IR_TYPE_PTR)
+    {
+        return IR_TYPE_PTR;
+    }
+    if (left_type == IR_TYPE_U32 || right_type == IR_TYPE_U32)
+    {
+        return IR_TYPE_U32;
+    }
+    return IR_TYPE_I32;
+}
+
+static struct datatype ir_datatype_for_arithmetic_type(int type)
+{
+    struct datatype dtype = ir_datatype_int();
+    if (type == IR_TYPE_U32)
+    {
+        dtype.flags &= ~DATATYPE_FLAG_IS_SIGNED;
+    }
+    return dtype;
+}
+
+// Applies op to two values that are already computed, takes care of pointer arithmetic
+static struct ir_expression ir_build_arithmetic(struct ir_builder* builder, const char* op, struct ir_value left, struct datatype* left_dtype, struct ir_value right, struct datatype* right_dtype)
+{
+    int ir_op = ir_op_for_arithmetic_operator(op);
+    if (ir_op == -1)
+    {
+        return ir_expression_failed(builder, "operator");
+    }
+
+    bool left_pointer = ir_datatype_is_pointer(left_dtype);
+    bool right_pointer = ir_datatype_is_pointer(right_dtype);
+    if (left_pointer && right_pointer && ir_op == IR_OP_SUB)
+    {
+        // The number of elements between the two pointers
+        struct ir_value difference = ir_builder_binary(builder, IR_OP_SUB, IR_TYPE_PTR, left, right);
+        size_t step = ir_datatype_pointer_step(left_dtype);
+        if (step > 1)
+        {
+            difference = ir_builder_binary(builder, IR_OP_DIV, IR_TYPE_PTR, difference, ir_value_constant(step));
+        }
+        return ir_expression_value(ir_builder_convert(builder, difference, IR_TYPE_PTR, IR_TYPE_I32), ir_datatype_int());
+    }
+
+    if ((left_pointer || right_pointer) && (ir_op == IR_OP_ADD || ir_op == IR_OP_SUB))
+    {
+        // 5 + abc is the same as abc + 5
+        if (right_pointer)
+        {
+            struct ir_value tmp_value = left;
+            left = right;
+            right = tmp_value;
+            struct datatype* tmp_dtype = left_dtype;
+            left_dtype = right_dtype;
+            right_dtype = tmp_dtype;
+        }
+
+        struct datatype result_dtype = *left_dtype;
+        if (left_dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+        {
+            struct datatype element = ir_datatype_element(left_dtype);
+            result_dtype = ir_datatype_pointer_to(&element);
+        }
+        struct ir_value offset = ir_builder_scale_index(builder, right, right_dtype, ir_datatype_pointer_step(left_dtype));
+        return ir_expression_value(ir_builder_binary(builder, ir_op, IR_TYPE_PTR, left, offset), result_dtype);
+    }
+
+    int type = ir_builder_arithmetic_type(builder, left_dtype, right_dtype);
+    if (type == IR_TYPE_PTR)
+    {
+        // Something like pointer & 3, just treat the pointer as a number
+        type = IR_TYPE_U32;
+    }
+    return ir_expression_value(ir_builder_binary(builder, ir_op, type, left, right), ir_datatype_for_arithmetic_type(type));
+}
+
+static struct ir_expression ir_build_comparison(struct ir_builder* builder, struct node* node, int ir_op)
+{
+    struct datatype left_dtype;
+    struct datatype right_dtype;
+    struct ir_value left = ir_build_value(builder, node->exp.left, &left_dtype);
+    struct ir_value right = ir_build_value(builder, node->exp.right, &right_dtype);
+    int type = ir_builder_arithmetic_type(builder, &left_dtype, &right_dtype);
+    return ir_expression_value(ir_builder_binary(builder, ir_op, type, left, right), ir_datatype_int());
+}
+
+// a && b, a || b, !a used as a value -> 1 or 0
+static struct ir_expression ir_build_logical_value(struct ir_builder* builder, struct node* node)
+{
+    struct ir_value result = ir_builder_new_vreg(builder);
+    struct ir_block* true_block = ir_block_new(builder->function, "logical.true");
+    struct ir_block* false_block = ir_block_new(builder->function, "logical.false");
+    struct ir_block* end_block = ir_block_new(builder->function, "logical.end");
+    ir_build_condition(builder, node, true_block, false_block);
+
+    ir_builder_set_block(builder, true_block);
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_MOVE, IR_TYPE_I32);
+    instruction->dst = result;
+    instruction->a = ir_value_constant(1);
+    ir_builder_jump(builder, end_block);
+
+    ir_builder_set_block(builder, false_block);
+    instruction = ir_builder_emit(builder, IR_OP_MOVE, IR_TYPE_I32);
+    instruction->dst = result;
+    instruction->a = ir_value_constant(0);
+    ir_builder_jump(builder, end_block);
+
+    ir_builder_set_block(builder, end_block);
+    return ir_expression_value(result, ir_datatype_int());
+}
+
+// a ? b : c
+static struct ir_expression ir_build_tenary(struct ir_builder* builder, struct node* node)
+{
+    struct node* tenary_node = node->exp.right;
+    struct ir_value result = ir_builder_new_vreg(builder);
+    struct ir_block* true_block = ir_block_new(builder->function, "tenary.true");
+    struct ir_block* false_block = ir_block_new(builder->function, "tenary.false");
+    struct ir_block* end_block = ir_block_new(builder->function, "tenary.end");
+    ir_build_condition(builder, node->exp.left, true_block, false_block);
+
+    ir_builder_set_block(builder, true_block);
+    struct datatype true_dtype;
+    struct ir_value true_value = ir_build_value(builder, tenary_node->tenary.true_node, &true_dtype);
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_MOVE, ir_builder_type(builder, &true_dtype));
+    instruction->dst = result;
+    instruction->a = true_value;
+    ir_builder_jump(builder, end_block);
+
+    ir_builder_set_block(builder, false_block);
+    struct datatype false_dtype;
+    struct ir_value false_value = ir_build_value(builder, tenary_node->tenary.false_node, &false_dtype);
+    instruction = ir_builder_emit(builder, IR_OP_MOVE, ir_builder_type(builder, &false_dtype));
+    instruction->dst = result;
+    instruction->a = false_value;
+    ir_builder_jump(builder, end_block);
+
+    ir_builder_set_block(builder, end_block);
+    return ir_expression_value(result, ir_datatype_is_pointer(&true_dtype) ? true_dtype : false_dtype);
+}
+
+// Stores value into the location converting it to the type of the location, returns the stored value
+static struct ir_value ir_builder_store_converted(struct ir_builder* builder, struct ir_expression* location, struct ir_value value, struct datatype* value_dtype)
+{
+    int type = ir_builder_type(builder, &location->dtype);
+    value = ir_builder_convert(builder, value, ir_builder_type(builder, value_dtype), type);
+    ir_builder_store(builder, type, location->value, value);
+    return value;
+}
+
+static struct ir_expression ir_build_assignment(struct ir_builder* builder, struct node* node)
+{
+    // Just like the AST code generator the right operand is computed first
+    struct datatype right_dtype;
+    struct ir_value right = ir_build_value(builder, node->exp.right, &right_dtype);
+    struct ir_expression left = ir_build_expression(builder, node->exp.left);
+    if (!left.is_location)
+    {
+        return ir_expression_failed(builder, "assignment to a value");
+    }
+    if (ir_datatype_is_aggregate(&left.dtype) || left.dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        return ir_expression_failed(builder, "structure assignment");
+    }
+
+    const char* op = ir_compound_assignment_operator(node->exp.op);
+    if (op)
+    {
+        // a += 5 -> a = a + 5, but the location of a is only computed once
+        struct ir_value old_value = ir_expression_rvalue(builder, &left);
+        struct ir_expression result = ir_build_arithmetic(builder, op, old_value, &left.dtype, right, &right_dtype);
+        right = result.value;
+        right_dtype = result.dtype;
+    }
+
+    struct ir_value stored = ir_builder_store_converted(builder, &left, right, &right_dtype);
+    return ir_expression_value(stored, left.dtype);
+}
+
+static struct node* ir_struct_member(struct datatype* dtype, const char* name, int* offset_out, struct compiler_process* process)
+{
+    struct node* struct_node = dtype->struct_node;
+    if (!struct_node || !struct_node->_struct.body_n)
+    {
+        return NULL;
+    }
+
+    struct node* member_node = NULL;
+    if (dtype->type == DATA_TYPE_STRUCT)
+    {
+        *offset_out = struct_offset(process, dtype->type_str, name, &member_node, 0, 0);
+        if (member_node && !S_EQ(member_node->var.name, name))
+        {
+            member_node = NULL;
+        }
+        return member_node;
+    }
+
+    // Every member of a union starts at the beginning of the union
+    struct vector* statements = struct_node->_union.body_n->body.statements;
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        struct node* var_node = variable_node(vector_peek_ptr_at(statements, i));
+        if (var_node && S_EQ(var_node->var.name, name))
+        {
+            member_node = var_node;
+            break;
+        }
+    }
+    *offset_out = 0;
+    return member_node;
+}
+
+static bool ir_node_is_access(struct node* node)
+{
+    return node_is_expression(node, "[]") || node_is_expression(node, ".") || node_is_expression(node, "->");
+}
+
+static struct ir_expression ir_build_access(struct ir_builder* builder, struct node* node, bool* take_address);
+
+// The parser binds & tighter than [], . and -> so &abc[5] becomes (&abc)[5], the address is taken of the whole access instead
+static struct ir_expression ir_build_access_operand(struct ir_builder* builder, struct node* node, bool* take_address)
+{
+    if (node->type == NODE_TYPE_UNARY && op_is_address(node->unary.op))
+    {
+        *take_address = true;
+        return ir_build_expression(builder, node->unary.operand);
+    }
+
+    if (ir_node_is_access(node))
+    {
+        return ir_build_access(builder, node, take_address);
+    }
+    return ir_build_expression(builder, node);
+}
+
+// abc.x or abc->x
+static struct ir_expression ir_build_member_access(struct ir_builder* builder, struct node* node, bool* take_address)
+{
+    struct ir_expression left = ir_build_access_operand(builder, node->exp.left, take_address);
+    struct datatype struct_dtype = left.dtype;
+    struct ir_value location = left.value;
+    if (S_EQ(node->exp.op, "->"))
+    {
+        location = ir_location_for_address(ir_expression_rvalue(builder, &left));
+        struct_dtype = ir_datatype_element(&left.dtype);
+    }
+    else if (!left.is_location)
+    {
+        return ir_expression_failed(builder, "member of a structure value");
+    }
+
+    if (node->exp.right->type != NODE_TYPE_IDENTIFIER || !datatype_is_struct_or_union(&struct_dtype))
+    {
+        return ir_expression_failed(builder, "member access");
+    }
+
+    int offset = 0;
+    struct node* member_node = ir_struct_member(&struct_dtype, node->exp.right->sval, &offset, builder->process);
+    if (!member_node)
+    {
+        return ir_expression_failed(builder, "unknown structure member");
+    }
+    return ir_expression_location(ir_location_add_offset(location, offset), member_node->var.type);
+}
+
+// abc[5]
+static struct ir_expression ir_build_array_access(struct ir_builder* builder, struct node* node, bool* take_address)
+{
+    struct ir_expression left = ir_build_access_operand(builder, node->exp.left, take_address);
+    struct datatype element = ir_datatype_element(&left.dtype);
+    struct ir_value location;
+    if (left.dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        if (!left.is_location)
+        {
+            return ir_expression_failed(builder, "array value");
+        }
+        location = left.value;
+    }
+    else if (left.dtype.flags & DATATYPE_FLAG_IS_POINTER)
+    {
+        location = ir_location_for_address(ir_expression_rvalue(builder, &left));
+    }
+    else
+    {
+        return ir_expression_failed(builder, "subscript of a non pointer");
+    }
+
+    struct datatype index_dtype;
+    struct ir_value index = ir_build_value(builder, node->exp.right->bracket.inner, &index_dtype);
+    struct ir_value offset = ir_builder_scale_index(builder, index, &index_dtype, ir_datatype_size(&element));
+    if (offset.type == IR_VALUE_CONSTANT)
+    {
+        // abc[5] -> the offset is known so no instructions are needed
+        if (location.type == IR_VALUE_CONSTANT || location.type == IR_VALUE_STRING)
+        {
+            location = ir_builder_binary(builder, IR_OP_ADD, IR_TYPE_PTR, location, offset);
+            return ir_expression_location(location, element);
+        }
+        return ir_expression_location(ir_location_add_offset(location, offset.constant), element);
+    }
+
+    struct ir_value address = ir_builder_location_address(builder, location);
+    return ir_expression_location(ir_builder_binary(builder, IR_OP_ADD, IR_TYPE_PTR, address, offset), element);
+}
+
+static struct ir_expression ir_build_access(struct ir_builder* builder, struct node* node, bool* take_address)
+{
+    if (S_EQ(node->exp.op, "[]"))
+    {
+        return ir_build_array_access(builder, node, take_address);
+    }
+    return ir_build_member_access(builder, node, take_address);
+}
+
+// abc[5], abc.x, abc->x and &abc[5]
+static struct ir_expression ir_build_access_expression(struct ir_builder* builder, struct node* node)
+{
+    bool take_address = false;
+    struct ir_expression exp = ir_build_access(builder, node, &take_address);
+    if (!take_address)
+    {
+        return exp;
+    }
+
+    if (!exp.is_location)
+    {
+        return ir_expression_failed(builder, "address of a value");
+    }
+    struct datatype dtype = exp.dtype;
+    if (dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        dtype = ir_datatype_element(&dtype);
+    }
+    return ir_expression_value(ir_builder_location_address(builder, exp.value), ir_datatype_pointer_to(&dtype));
+}
+
+static void ir_build_function_call_arguments(struct node* node, struct vector* arguments)
+{
+    if (!node || node->type == NODE_TYPE_BLANK)
+    {
+        return;
+    }
+
+    if (is_argument_node(node))
+    {
+        ir_build_function_call_arguments(node->exp.left, arguments);
+        ir_build_function_call_arguments(node->exp.right, arguments);
+        return;
+    }
+
+    if (node->type == NODE_TYPE_EXPRESSION_PARENTHESIS)
+    {
+        ir_build_function_call_arguments(node->parenthesis.exp, arguments);
+        return;
+    }
+    vector_push(arguments, &node);
+}
+
+// abc(50, 20)
+static struct ir_expression ir_build_function_call(struct ir_builder* builder, struct node* node)
+{
+    if (node->exp.left->type != NODE_TYPE_IDENTIFIER || ir_builder_get_variable(builder, node->exp.left->sval))
+    {
+        return ir_expression_failed(builder, "call through a pointer");
+    }
+
+    struct symbol* sym = symresolver_get_symbol(builder->process, node->exp.left->sval);
+    if (!sym || sym->type != SYMBOL_TYPE_NODE || ((struct node*)sym->data)->type != NODE_TYPE_FUNCTION)
+    {
+        return ir_expression_failed(builder, "call to an unknown or native function");
+    }
+
+    struct node* func_node = sym->data;
+    if (ir_datatype_is_aggregate(&func_node->func.rtype))
+    {
+        return ir_expression_failed(builder, "call to a function returning a structure");
+    }
+
+    struct vector* argument_nodes = vector_create(sizeof(struct node*));
+    ir_build_function_call_arguments(node->exp.right, argument_nodes);
+
+    // The arguments are computed backwards, just like they are pushed
+    int total_arguments = vector_count(argument_nodes);
+    struct vector* arguments = vector_create(sizeof(struct ir_value));
+    struct ir_value* values = arena_calloc(total_arguments + 1, sizeof(struct ir_value));
+    for (int i = total_arguments - 1; i >= 0; i--)
+    {
+        struct ir_expression argument = ir_build_expression(builder, vector_peek_ptr_at(argument_nodes, i));
+        if (argument.is_location && ir_datatype_is_aggregate(&argument.dtype))
+        {
+            ir_builder_unsupported(builder, "structure passed by value");
+        }
+        values[i] = ir_expression_rvalue(builder, &argument);
+    }
+    for (int i = 0; i < total_arguments; i++)
+    {
+        vector_push(arguments, &values[i]);
+    }
+    arena_free(values);
+    vector_free(argument_nodes);
+
+    int return_type = ir_builder_type(builder, &func_node->func.rtype);
+    struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_CALL, return_type);
+    instruction->a = ir_value_symbol(func_node->func.name, 0);
+    instruction->args = arguments;
+    if (return_type != IR_TYPE_VOID)
+    {
+        instruction->dst = ir_builder_new_vreg(builder);
+    }
+    return ir_expression_value(instruction->dst, func_node->func.rtype);
+}
+
+// a++, --a
+static struct ir_expression ir_build_increment(struct ir_builder* builder, struct node* node)
+{
+    struct ir_expression operand = ir_build_expression(builder, node->unary.operand);
+    if (!operand.is_location)
+    {
+        return ir_expression_failed(builder, "increment of a value");
+    }
+
+    struct ir_value old_value = ir_expression_rvalue(builder, &operand);
+    struct datatype one_dtype = ir_datatype_int();
+    struct ir_expression new_value = ir_build_arithmetic(builder, S_EQ(node->unary.op, "++") ? "+" : "-", old_value, &operand.dtype, ir_value_constant(1), &one_dtype);
+    struct ir_value stored = ir_builder_store_converted(builder, &operand, new_value.value, &new_value.dtype);
+
+    // x++ -> the value before the increment is the result
+    if (node->unary.flags & UNARY_FLAG_IS_LEFT_OPERANDED_UNARY)
+    {
+        return ir_expression_value(old_value, operand.dtype);
+    }
+    return ir_expression_value(stored, operand.dtype);
+}
+
+static struct ir_expression ir_build_unary(struct ir_builder* builder, struct node* node)
+{
+    const char* op = node->unary.op;
+    if (op_is_indirection(op))
+    {
+        // **abc -> the first levels are loads, the last one is the location
+        struct datatype dtype;
+        struct ir_value address = ir_build_value(builder, node->unary.operand, &dtype);
+        int depth = node->unary.indirection.depth ? node->unary.indirection.depth : 1;
+        for (int i = 0; i < depth; i++)
+        {
+            if (!ir_datatype_is_pointer(&dtype))
+            {
+                return ir_expression_failed(builder, "indirection of a non pointer");
+            }
+            dtype = ir_datatype_element(&dtype);
+            if (i != depth - 1)
+            {
+                address = ir_builder_load(builder, ir_builder_type(builder, &dtype), ir_location_for_address(address));
+            }
+        }
+        return ir_expression_location(ir_location_for_address(address), dtype);
+    }
+
+    if (op_is_address(op))
+    {
+        struct ir_expression operand = ir_build_expression(builder, node->unary.operand);
+        if (!operand.is_location)
+        {
+            return ir_expression_failed(builder, "address of a value");
+        }
+        struct datatype dtype = operand.dtype;
+        if (dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+        {
+            // &abc where abc is an array is the address of its first element
+            dtype = ir_datatype_element(&dtype);
+        }
+        return ir_expression_value(ir_builder_location_address(builder, operand.value), ir_datatype_pointer_to(&dtype));
+    }
+
+    if (S_EQ(op, "++") || S_EQ(op, "--"))
+    {
+        return ir_build_increment(builder, node);
+    }
+
+    if (S_EQ(op, "!"))
+    {
+        return ir_build_logical_value(builder, node);
+    }
+
+    struct datatype dtype;
+    struct ir_value operand = ir_build_value(builder, node->unary.operand, &dtype);
+    int type = ir_builder_arithmetic_type(builder, &dtype, &dtype);
+    if (S_EQ(op, "-"))
+    {
+        if (operand.type == IR_VALUE_CONSTANT)
+        {
+            return ir_expression_value(ir_value_constant(-operand.constant), dtype);
+        }
+        return ir_expression_value(ir_builder_unary(builder, IR_OP_NEG, type, operand), ir_datatype_for_arithmetic_type(type));
+    }
+    if (S_EQ(op, "~"))
+    {
+        return ir_expression_value(ir_builder_unary(builder, IR_OP_NOT, type, operand), ir_datatype_for_arithmetic_type(type));
+    }
+    if (S_EQ(op, "+"))
+    {
+        return ir_expression_value(operand, dtype);
+    }
+    return ir_expression_failed(builder, "unary operator");
+}
+
+static struct ir_expression ir_build_identifier(struct ir_builder* builder, struct node* node)
+{
+    struct ir_scope_variable* variable = ir_builder_get_variable(builder, node->sval);
+    if (variable)
+    {
+        return ir_expression_location(ir_value_local(variable->local, 0), variable->dtype);
+    }
+
+    struct symbol* sym = symresolver_get_symbol(builder->process, node->sval);
+    if (sym && sym->type == SYMBOL_TYPE_NODE)
+    {
+        struct node* var_node = variable_node(sym->data);
+        if (var_node)
+        {
+            return ir_expression_location(ir_value_symbol(var_node->var.name, 0), var_node->var.type);
+        }
+    }
+    return ir_expression_failed(builder, "identifier that isn't a variable");
+}
+
+static struct ir_expression ir_build_expression_node(struct ir_builder* builder, struct node* node)
+{
+    const char* op = node->exp.op;
+    if (is_node_assignment(node) || ir_compound_assignment_operator(op))
+    {
+        return ir_build_assignment(builder, node);
+    }
+
+    if (ir_node_is_access(node))
+    {
+        return ir_build_access_expression(builder, node);
+    }
+
+    if (S_EQ(op, "()"))
+    {
+        return ir_build_function_call(builder, node);
+    }
+
+    if (S_EQ(op, "?"))
+    {
+        return ir_build_tenary(builder, node);
+    }
+
+    if (S_EQ(op, ","))
+    {
+        ir_build_expression(builder, node->exp.left);
+        return ir_build_expression(builder, node->exp.right);
+    }
+
+    if (S_EQ(op, "&&") || S_EQ(op, "||"))
+    {
+        return ir_build_logical_value(builder, node);
+    }
+
+    int comparison_op = ir_op_for_comparison_operator(op);
+    if (comparison_op != -1)
+    {
+        return ir_build_comparison(builder, node, comparison_op);
+    }
+
+    struct datatype left_dtype;
+    struct datatype right_dtype;
+    struct ir_value left = ir_build_value(builder, node->exp.left, &left_dtype);
+    struct ir_value right = ir_build_value(builder, node->exp.right, &right_dtype);
+    return ir_build_arithmetic(builder, op, left, &left_dtype, right, &right_dtype);
+}
+
+static struct ir_expression ir_build_expression(struct ir_builder* builder, struct node* node)
+{
+    if (ir_builder_failed(builder))
+    {
+        return ir_expression_value(ir_value_constant(0), ir_datatype_int());
+    }
+
+    struct ir_expression result;
+    switch (node->type)
+    {
+    case NODE_TYPE_NUMBER:
+        result = ir_expression_value(ir_value_constant(node->llnum), datatype_for_numeric());
+        break;
+
+    case NODE_TYPE_STRING:
+        result = ir_expression_value(ir_value_string(node->sval), datatype_for_string());
+        break;
+
+    case NODE_TYPE_IDENTIFIER:
+        result = ir_build_identifier(builder, node);
+        break;
+
+    case NODE_TYPE_EXPRESSION_PARENTHESIS:
+        result = ir_build_expression(builder, node->parenthesis.exp);
+        break;
+
+    case NODE_TYPE_EXPRESSION:
+        result = ir_build_expression_node(builder, node);
+        break;
+
+    case NODE_TYPE_UNARY:
+        result = ir_build_unary(builder, node);
+        break;
+
+    case NODE_TYPE_CAST:
+    {
+        struct datatype dtype;
+        struct ir_value value = ir_build_value(builder, node->cast.operand, &dtype);
+        if (ir_datatype_is_aggregate(&node->cast.dtype))
+        {
+            return ir_expression_failed(builder, "cast to a structure");
+        }
+        value = ir_builder_convert(builder, value, ir_builder_type(builder, &dtype), ir_builder_type(builder, &node->cast.dtype));
+        result = ir_expression_value(value, node->cast.dtype);
+    }
+    break;
+
+    default:
+        result = ir_expression_failed(builder, "expression");
+        break;
+    }
+    return result;
+}
+
+// Jumps to true_block if the expression is true, otherwise to false_block. Logical operators don't need their 1 or 0 value this way
+static void ir_build_condition(struct ir_builder* builder, struct node* node, struct ir_block* true_block, struct ir_block* false_block)
+{
+    if (node->type == NODE_TYPE_EXPRESSION_PARENTHESIS)
+    {
+        ir_build_condition(builder, node->parenthesis.exp, true_block, false_block);
+        return;
+    }
+
+    if (node_is_expression(node, "&&") || node_is_expression(node, "||"))
+    {
+        struct ir_block* right_block = ir_block_new(builder->function, "logical.right");
+        if (S_EQ(node->exp.op, "&&"))
+        {
+            ir_build_condition(builder, node->exp.left, right_block, false_block);
+        }
+        else
+        {
+            ir_build_condition(builder, node->exp.left, true_block, right_block);
+        }
+        ir_builder_set_block(builder, right_block);
+        ir_build_condition(builder, node->exp.right, true_block, false_block);
+        return;
+    }
+
+    if (node->type == NODE_TYPE_UNARY && S_EQ(node->unary.op, "!"))
+    {
+        ir_build_condition(builder, node->unary.operand, false_block, true_block);
+        return;
+    }
+
+    struct ir_value cond = ir_build_value(builder, node, NULL);
+    ir_builder_branch(builder, cond, true_block, false_block);
+}
+
+static void ir_build_body(struct ir_builder* builder, struct node* node);
+
+struct ir_initializer
+{
+    struct ir_builder* builder;
+    struct ir_local* local;
+};
+
+static void ir_build_initializer_element(struct node* value_node, struct datatype* dtype, int offset, void* private)
+{
+    struct ir_initializer* initializer = private;
+    struct ir_builder* builder = initializer->builder;
+    if (value_node->type == NODE_TYPE_STRING && dtype->flags & DATATYPE_FLAG_IS_ARRAY)
+    {
+        // char name[8] = "abc" -> one store for every character
+        size_t length = initializer_string_length(value_node, dtype);
+        for (size_t i = 0; i < length; i++)
+        {
+            ir_builder_store(builder, IR_TYPE_I8, ir_value_local(initializer->local->id, offset + i), ir_value_constant(value_node->sval[i]));
+        }
+        return;
+    }
+
+    if (ir_datatype_is_aggregate(dtype))
+    {
+        ir_builder_unsupported(builder, "structure value inside an initializer list");
+        return;
+    }
+
+    struct datatype value_dtype;
+    struct ir_value value = ir_build_value(builder, value_node, &value_dtype);
+    struct ir_expression location = ir_expression_location(ir_value_local(initializer->local->id, offset), *dtype);
+    ir_builder_store_converted(builder, &location, value, &value_dtype);
+}
+
+// int table[64] = {1, 2, 3}; -> the local is zeroed unless every byte gets a value, then the given elements are stored
+static void ir_build_initializer(struct ir_builder* builder, struct ir_local* local, struct node* var_node)
+{
+    if (!initializer_covers_variable(builder->process, &var_node->var.type, var_node->var.val))
+    {
+        struct ir_instruction* instruction = ir_builder_emit(builder, IR_OP_ZERO, IR_TYPE_VOID);
+        instruction->a = ir_value_local(local->id, 0);
+        instruction->b = ir_value_constant(local->size);
+    }
+
+    struct ir_initializer initializer = {.builder = builder, .local = local};
+    initializer_for_each_element(builder->process, &var_node->var.type, var_node->var.val, ir_build_initializer_element, &initializer);
+}
+
+static void ir_build_variable(struct ir_builder* builder, struct node* var_node)
+{
+    if (var_node->var.type.flags & (DATATYPE_FLAG_IS_STATIC | DATATYPE_FLAG_IS_EXTERN))
+    {
+        ir_builder_unsupported(builder, "static local variable");
+        return;
+    }
+
+    struct ir_local* local = ir_function_new_local(builder->function, var_node->var.name, ir_datatype_size(&var_node->var.type), ir_datatype_align(&var_node->var.type), 0);
+    local->var_node = var_node;
+    if (!local->size)
+    {
+        ir_builder_unsupported(builder, "variable sized array");
+        return;
+    }
+
+    if (var_node->var.val && (var_node->var.val->type == NODE_TYPE_INITIALIZER_LIST || var_node->var.type.flags & DATATYPE_FLAG_IS_ARRAY))
+    {
+        ir_build_initializer(builder, local, var_node);
+    }
+    else if (var_node->var.val)
+    {
+        if (ir_datatype_is_aggregate(&var_node->var.type))
+        {
+            ir_builder_unsupported(builder, "structure initialized from an expression");
+            return;
+        }
+        struct datatype dtype;
+        struct ir_value value = ir_build_value(builder, var_node->var.val, &dtype);
+        struct ir_expression location = ir_expression_location(ir_value_local(local->id, 0), var_node->var.type);
+        ir_builder_store_converted(builder, &location, value, &dtype);
+    }
+
+    // The variable is only visible after its declaration
+    struct ir_scope_variable* variable = arena_calloc(1, sizeof(struct ir_scope_variable));
+    variable->name = var_node->var.name;
+    variable->local = local->id;
+    variable->dtype = var_node->var.type;
+    vector_push(vector_back_ptr(builder->scopes), &variable);
+}
+
+static void ir_build_return(struct ir_builder* builder, struct node* node)
+{
+    struct ir_instruction* instruction = NULL;
+    if (node->stmt.return_stmt.exp)
+    {
+        struct datatype dtype;
+        struct ir_value value = ir_build_value(builder, node->stmt.return_stmt.exp, &dtype);
+        value = ir_builder_convert(builder, value, ir_builder_type(builder, &dtype), builder->function->return_type);
+        instruction = ir_builder_emit(builder, IR_OP_RETURN, builder->function->return_type);
+        instruction->a = value;
+    }
+    else
+    {
+        instruction = ir_builder_emit(builder, IR_OP_RETURN, IR_TYPE_VOID);
+    }
+    ir_builder_start_unreachable_block(builder);
+}
+
+static void ir_build_if(struct ir_builder* builder, struct node* node, struct ir_block* end_block)
+{
+    struct ir_block* then_block = ir_block_new(builder->function, "if.then");
+    struct ir_block* else_block = node->stmt.if_stmt.next ? ir_block_new(builder->function, "if.else") : end_block;
+    ir_build_condition(builder, node->stmt.if_stmt.cond_node, then_block, else_block);
+
+    ir_builder_set_block(builder, then_block);
+    ir_build_body(builder, node->stmt.if_stmt.body_node);
+    ir_builder_jump(builder, end_block);
+
+    struct node* next = node->stmt.if_stmt.next;
+    if (!next)
+    {
+        return;
+    }
+
+    ir_builder_set_block(builder, else_block);
+    if (next->type == NODE_TYPE_STATEMENT_IF)
+    {
+        ir_build_if(builder, next, end_block);
+        return;
+    }
+    ir_build_body(builder, next->stmt.else_stmt.body_node);
+    ir_builder_jump(builder, end_block);
+}
+
+static void ir_builder_push_loop(struct ir_builder* builder, struct ir_block* break_block, struct ir_block* continue_block)
+{
+    vector_push(builder->break_blocks, &break_block);
+    vector_push(builder->continue_blocks, &continue_block);
+}
+
+static void ir_builder_pop_loop(struct ir_builder* builder)
+{
+    vector_pop(builder->break_blocks);
+    vector_pop(builder->continue_blocks);
+}
+
+static void ir_build_while(struct ir_builder* builder, struct node* node)
+{
+    struct ir_block* cond_block = ir_block_new(builder->function, "while.cond");
+    struct ir_block* body_block = ir_block_new(builder->function, "while.body");
+    struct ir_block* end_block = ir_block_new(builder->function, "while.end");
+    ir_builder_jump(builder, cond_block);
+
+    ir_builder_set_block(builder, cond_block);
+    ir_build_condition(builder, node->stmt.while_stmt.exp_node, body_block, end_block);
+
+    ir_builder_set_block(builder, body_block);
+    ir_builder_push_loop(builder, end_block, cond_block);
+    ir_build_body(builder, node->stmt.while_stmt.body_node);
+    ir_builder_pop_loop(builder);
+    ir_builder_jump(builder, cond_block);
+
+    ir_builder_set_block(builder, end_block);
+}
+
+static void ir_build_do_while(struct ir_builder* builder, struct node* node)
+{
+    struct ir_block* body_block = ir_block_new(builder->function, "do.body");
+    struct ir_block* cond_block = ir_block_new(builder->function, "do.cond");
+    struct ir_block* end_block = ir_block_new(builder->function, "do.end");
+    ir_builder_jump(builder, body_block);
+
+    ir_builder_set_block(builder, body_block);
+    ir_builder_push_loop(builder, end_block, cond_block);
+    ir_build_body(builder, node->stmt.do_while_stmt.body_node);
+    ir_builder_pop_loop(builder);
+    ir_builder_jump(builder, cond_block);
+
+    ir_builder_set_block(builder, cond_block);
+    ir_build_condition(builder, node->stmt.do_while_stmt.exp_node, body_block, end_block);
+
+    ir_builder_set_block(builder, end_block);
+}
+
+static void ir_build_for(struct ir_builder* builder, struct node* node)
+{
+    struct for_stmt* for_stmt = &node->stmt.for_stmt;
+    struct ir_block* cond_block = ir_block_new(builder->function, "for.cond");
+    struct ir_block* body_block = ir_block_new(builder->function, "for.body");
+    struct ir_block* step_block = ir_block_new(builder->function, "for.step");
+    struct ir_block* end_block = ir_block_new(builder->function, "for.end");
+
+    if (for_stmt->init_node)
+    {
+        ir_build_statement(builder, for_stmt->init_node);
+    }
+    ir_builder_jump(builder, cond_block);
+
+    ir_builder_set_block(builder, cond_block);
+    if (for_stmt->cond_node)
+    {
+        ir_build_condition(builder, for_stmt->cond_node, body_block, end_block);
+    }
+    else
+    {
+        ir_builder_jump(builder, body_block);
+    }
+
+    ir_builder_set_block(builder, body_block);
+    ir_builder_push_loop(builder, end_block, step_block);
+    if (for_stmt->body_node)
+    {
+        ir_build_body(builder, for_stmt->body_node);
+    }
+    ir_builder_pop_loop(builder);
+    ir_builder_jump(builder, step_block);
+
+    ir_builder_set_block(builder, step_block);
+    if (for_stmt->loop_node)
+    {
+        ir_build_expression(builder, for_stmt->loop_node);
+    }
+    ir_builder_jump(builder, cond_block);
+
+    ir_builder_set_block(builder, end_block);
+}
+
+static bool ir_builder_case_value(struct node* exp_node, long long* value_out)
+{
+    if (exp_node->type == NODE_TYPE_NUMBER)
+    {
+        *value_out = exp_node->llnum;
+        return true;
+    }
+    if (exp_node->type == NODE_TYPE_UNARY && S_EQ(exp_node->unary.op, "-") && exp_node->unary.operand->type == NODE_TYPE_NUMBER)
+    {
+        *value_out = -(long long)exp_node->unary.operand->llnum;
+        return true;
+    }
+    return false;
+}
+
+static bool ir_builder_collect_cases(struct node* node, void* private)
+{
+    struct vector* cases = private;
+    if (node->type == NODE_TYPE_STATEMENT_CASE || node->type == NODE_TYPE_STATEMENT_DEFAULT)
+    {
+        struct ir_case* switch_case = arena_calloc(1, sizeof(struct ir_case));
+        switch_case->node = node;
+        vector_push(cases, &switch_case);
+    }
+    // Cases of nested switches belong to them
+    return node->type != NODE_TYPE_STATEMENT_SWITCH;
+}
+
+static struct ir_case* ir_builder_get_case(struct ir_builder* builder, struct node* node)
+{
+    for (int i = vector_count(builder->cases) - 1; i >= 0; i--)
+    {
+        struct ir_case* switch_case = vector_peek_ptr_at(builder->cases, i);
+        if (switch_case->node == node)
+        {
+            return switch_case;
+        }
+    }
+    return NULL;
+}
+
+static void ir_build_switch(struct ir_builder* builder, struct node* node)
+{
+    struct datatype dtype;
+    struct ir_value value = ir_build_value(builder, node->stmt.switch_stmt.exp, &dtype);
+    int type = ir_builder_arithmetic_type(builder, &dtype, &dtype);
+    struct ir_block* end_block = ir_block_new(builder->function, "switch.end");
+    struct ir_block* default_block = end_block;
+
+    struct vector* cases = vector_create(sizeof(struct ir_case*));
+    struct vector* statements = node->stmt.switch_stmt.body->body.statements;
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        node_walk(vector_peek_ptr_at(statements, i), ir_builder_collect_cases, cases);
+    }
+
+    // Compare the value against every case, one after the other
+    for (int i = 0; i < vector_count(cases); i++)
+    {
+        struct ir_case* switch_case = vector_peek_ptr_at(cases, i);
+        switch_case->block = ir_block_new(builder->function, "switch.case");
+        vector_push(builder->cases, &switch_case);
+        if (switch_case->node->type == NODE_TYPE_STATEMENT_DEFAULT)
+        {
+            default_block = switch_case->block;
+            continue;
+        }
+
+        long long case_value = 0;
+        if (!ir_builder_case_value(switch_case->node->stmt._case.exp, &case_value))
+        {
+            ir_builder_unsupported(builder, "non numeric switch case");
+            return;
+        }
+        struct ir_block* next_block = ir_block_new(builder->function, "switch.next");
+        struct ir_value cond = ir_builder_binary(builder, IR_OP_EQ, type, value, ir_value_constant(case_value));
+        ir_builder_branch(builder, cond, switch_case->block, next_block);
+        ir_builder_set_block(builder, next_block);
+    }
+    ir_builder_jump(builder, default_block);
+
+    // Code before the first case can't be reached
+    ir_builder_start_unreachable_block(builder);
+    struct ir_block* continue_block = vector_back_ptr_or_null(builder->continue_blocks);
+    ir_builder_push_loop(builder, end_block, continue_block);
+    ir_build_body(builder, node->stmt.switch_stmt.body);
+    ir_builder_pop_loop(builder);
+    ir_builder_jump(builder, end_block);
+
+    ir_builder_set_block(builder, end_block);
+    vector_free(cases);
+}
+
+static void ir_build_switch_case(struct ir_builder* builder, struct node* node)
+{
+    struct ir_case* switch_case = ir_builder_get_case(builder, node);
+    if (!switch_case)
+    {
+        ir_builder_unsupported(builder, "case outside of a switch");
+        return;
+    }
+    // The previous case falls through into this one
+    ir_builder_jump(builder, switch_case->block);
+    ir_builder_set_block(builder, switch_case->block);
+}
+
+static struct ir_block* ir_builder_label_block(struct ir_builder* builder, const char* name)
+{
+    for (int i = 0; i < vector_count(builder->labels); i++)
+    {
+        struct ir_label* label = vector_peek_ptr_at(builder->labels, i);
+        if (S_EQ(label->name, name))
+        {
+            return label->block;
+        }
+    }
+
+    struct ir_label* label = arena_calloc(1, sizeof(struct ir_label));
+    label->name = name;
+    label->block = ir_block_new(builder->function, name);
+    vector_push(builder->labels, &label);
+    return label->block;
+}
+
+static void ir_build_jump_statement(struct ir_builder* builder, struct vector* targets)
+{
+    struct ir_block* target = vector_back_ptr_or_null(targets);
+    if (!target)
+    {
+        ir_builder_unsupported(builder, "break or continue outside of a loop");
+        return;
+    }
+    ir_builder_jump(builder, target);
+    ir_builder_start_unreachable_block(builder);
+}
+
+static void ir_build_statement(struct ir_builder* builder, struct node* node)
+{
+    if (ir_builder_failed(builder))
+    {
+        return;
+    }
+
+    builder->node = node;
+    switch (node->type)
+    {
+    case NODE_TYPE_VARIABLE:
+        ir_build_variable(builder, node);
+        break;
+
+    case NODE_TYPE_VARIABLE_LIST:
+        for (int i = 0; i < vector_count(node->var_list.list); i++)
+        {
+            ir_build_variable(builder, vector_peek_ptr_at(node->var_list.list, i));
+        }
+        break;
+
+    case NODE_TYPE_STRUCT:
+    case NODE_TYPE_UNION:
+        // struct abc {} var; -> only the variable needs memory
+        if (variable_node(node))
+        {
+            ir_build_variable(builder, variable_node(node));
+        }
+        break;
+
+    case NODE_TYPE_STATEMENT_RETURN:
+        ir_build_return(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_IF:
+    {
+        struct ir_block* end_block = ir_block_new(builder->function, "if.end");
+        ir_build_if(builder, node, end_block);
+        ir_builder_set_block(builder, end_block);
+    }
+    break;
+
+    case NODE_TYPE_STATEMENT_WHILE:
+        ir_build_while(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_DO_WHILE:
+        ir_build_do_while(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_FOR:
+        ir_build_for(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_BREAK:
+        ir_build_jump_statement(builder, builder->break_blocks);
+        break;
+
+    case NODE_TYPE_STATEMENT_CONTINUE:
+        ir_build_jump_statement(builder, builder->continue_blocks);
+        break;
+
+    case NODE_TYPE_STATEMENT_SWITCH:
+        ir_build_switch(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_CASE:
+    case NODE_TYPE_STATEMENT_DEFAULT:
+        ir_build_switch_case(builder, node);
+        break;
+
+    case NODE_TYPE_STATEMENT_GOTO:
+        ir_builder_jump(builder, ir_builder_label_block(builder, node->stmt._goto.label->sval));
+        ir_builder_start_unreachable_block(builder);
+        break;
+
+    case NODE_TYPE_LABEL:
+    {
+        struct ir_block* label_block = ir_builder_label_block(builder, node->label.name->sval);
+        ir_builder_jump(builder, label_block);
+        ir_builder_set_block(builder, label_block);
+    }
+    break;
+
+    case NODE_TYPE_BODY:
+        ir_build_body(builder, node);
+        break;
+
+    case NODE_TYPE_BLANK:
+        break;
+
+    default:
+        // Expression statements, the result isn't needed
+        ir_build_expression(builder, node);
+        break;
+    }
+}
+
+static void ir_build_body(struct ir_builder* builder, struct node* node)
+{
+    if (node->type != NODE_TYPE_BODY)
+    {
+        ir_build_statement(builder, node);
+        return;
+    }
+
+    ir_builder_new_scope(builder);
+    struct vector* statements = node->body.statements;
+    for (int i = 0; i < vector_count(statements); i++)
+    {
+        ir_build_statement(builder, vector_peek_ptr_at(statements, i));
+    }
+    ir_builder_finish_scope(builder);
+}
+
+static void ir_build_function_arguments(struct ir_builder* builder, struct node* func_node)
+{
+    struct vector* arguments = function_node_argument_vec(func_node);
+    for (int i = 0; i < vector_count(arguments); i++)
+    {
+        struct node* var_node = variable_node(vector_peek_ptr_at(arguments, i));
+        struct ir_local* local = ir_function_new_local(builder->function, var_node->var.name, ir_datatype_size(&var_node->var.type), ir_datatype_align(&var_node->var.type), IR_LOCAL_FLAG_ARGUMENT);
+        local->argument_index = i;
+        local->var_node = var_node;
+
+        struct ir_scope_variable* variable = arena_calloc(1, sizeof(struct ir_scope_variable));
+        variable->name = var_node->var.name;
+        variable->local = local->id;
+        variable->dtype = var_node->var.type;
+        // Arrays as arguments are pointers
+        if (variable->dtype.flags & DATATYPE_FLAG_IS_ARRAY)
+        {
+            ir_builder_unsupported(builder, "array argument");
+        }
+        // The caller pushes the whole structure, it doesn't fit in an argument register
+        if (ir_datatype_is_aggregate(&variable->dtype))
+        {
+            ir_builder_unsupported(builder, "structure parameter passed by value");
+        }
+        vector_push(vector_back_ptr(builder->scopes), &variable);
+    }
+}
+
+// Lowers the function into IR, if something isn't supported yet unsupported_reason is set on the returned function
+struct ir_function* ir_build_function(struct compiler_process* process, struct node* func_node)
+{
+    struct ir_builder builder = {};
+    builder.process = process;
+    builder.function = ir_function_new(func_node);
+    builder.scopes = vector_create(sizeof(struct vector*));
+    builder.break_blocks = vector_create(sizeof(struct ir_block*));
+    builder.continue_blocks = vector_create(sizeof(struct ir_block*));
+    builder.labels = vector_create(sizeof(struct ir_label*));
+    builder.cases = vector_create(sizeof(struct ir_case*));
+    builder.block_order = vector_create(sizeof(struct ir_block*));
+    builder.node = func_node;
+
+    if (ir_datatype_is_aggregate(&func_node->func.rtype))
+    {
+        ir_builder_unsupported(&builder, "structure return value");
+        return builder.function;
+    }
+    builder.function->return_type = ir_builder_type(&builder, &func_node->func.rtype);
+
+    ir_builder_new_scope(&builder);
+    ir_build_function_arguments(&builder, func_node);
+    ir_builder_set_block(&builder, ir_block_new(builder.function, "entry"));
+    ir_build_body(&builder, func_node->func.body_n);
+
+    // Falling off the end of the function
+    if (!ir_builder_block_terminated(&builder))
+    {
+        builder.node = func_node;
+        ir_builder_emit(&builder, IR_OP_RETURN, IR_TYPE_VOID);
+    }
+    ir_builder_finish_scope(&builder);
+    ir_builder_order_blocks(&builder);
+
+    vector_free(builder.break_blocks);
+    vector_free(builder.continue_blocks);
+    return builder.function;
+}
@@ -0,0 +1,759 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/*
+ * Lowers the intermediate representation into NASM assembly
+ *
+ * Every local and every virtual register gets its own place in the stack frame below the base pointer
+ * ebp+8...     arguments
+ * ebp-...      locals
+ * ebp-...      virtual registers (4 bytes each)
+ *
+ * Instructions are computed in eax/ecx, edx is used for addresses and division
+ */
+
+struct ircodegen
+{
+    struct compiler_process* process;
+    struct ir_function* function;
+
+    // The label id of every block, indexed by the block id
+    int* block_labels;
+
+    // How many times every virtual register is read, indexed by the vreg
+    int* vreg_uses;
+
+    // Where the virtual registers start below the base pointer
+    int vreg_base;
+    size_t frame_size;
+};
+
+static int ircodegen_vreg_offset(struct ircodegen* gen, int vreg)
+{
+    return -(gen->vreg_base + (vreg + 1) * DATA_SIZE_DWORD);
+}
+
+static const char* ircodegen_size_keyword(size_t size)
+{
+    const char* keyword = "dword";
+    switch (size)
+    {
+    case DATA_SIZE_BYTE:
+        keyword = "byte";
+        break;
+    case DATA_SIZE_WORD:
+        keyword = "word";
+        break;
+    }
+    return keyword;
+}
+
+// eax -> al, ax or eax depending on the size
+static const char* ircodegen_sub_register(const char* reg, size_t size)
+{
+    static const char* registers[][3] = {{"eax", "al", "ax"}, {"ecx", "cl", "cx"}, {"edx", "dl", "dx"}};
+    for (int i = 0; i < sizeof(registers) / sizeof(registers[0]); i++)
+    {
+        if (!S_EQ(registers[i][0], reg))
+        {
+            continue;
+        }
+        if (size == DATA_SIZE_BYTE)
+        {
+            return registers[i][1];
+        }
+        if (size == DATA_SIZE_WORD)
+        {
+            return registers[i][2];
+        }
+    }
+    return reg;
+}
+
+// abc, abc+4, abc-4
+static void ircodegen_address_with_offset(const char* base, int offset, char* out)
+{
+    if (offset)
+    {
+        sprintf(out, "%s%+i", base, offset);
+        return;
+    }
+    sprintf(out, "%s", base);
+}
+
+// Moves a value into a register
+static void ircodegen_load_value(struct ircodegen* gen, const char* reg, struct ir_value* value)
+{
+    switch (value->type)
+    {
+    case IR_VALUE_VREG:
+        asm_push("mov %s, [ebp%+i]", reg, ircodegen_vreg_offset(gen, value->vreg));
+        break;
+
+    case IR_VALUE_CONSTANT:
+        asm_push("mov %s, %lld", reg, value->constant);
+        break;
+
+    case IR_VALUE_STRING:
+        asm_push("mov %s, %s", reg, codegen_register_string(value->string));
+        break;
+
+    case IR_VALUE_SYMBOL:
+    {
+        // The value of a symbol is its address
+        char address[128];
+        ircodegen_address_with_offset(value->symbol, value->offset, address);
+        asm_push("mov %s, %s", reg, address);
+    }
+    break;
+
+    case IR_VALUE_LOCAL:
+        asm_push("lea %s, [ebp%+i]", reg, ir_function_local(gen->function, value->local)->offset + value->offset);
+        break;
+
+    default:
+        asm_push("xor %s, %s", reg, reg);
+        break;
+    }
+}
+
+// An operand that can be used directly in an instruction, for constants and virtual registers there is no need to load them into a register first
+static void ircodegen_operand(struct ircodegen* gen, struct ir_value* value, const char* reg, char* out)
+{
+    if (value->type == IR_VALUE_CONSTANT)
+    {
+        sprintf(out, "%lld", value->constant);
+        return;
+    }
+
+    if (value->type == IR_VALUE_VREG)
+    {
+        sprintf(out, "dword [ebp%+i]", ircodegen_vreg_offset(gen, value->vreg));
+        return;
+    }
+
+    ircodegen_load_value(gen, reg, value);
+    sprintf(out, "%s", reg);
+}
+
+// Writes the memory operand for a location i.e [ebp-4], [abc+8], [edx+4]
+static void ircodegen_location(struct ircodegen* gen, struct ir_value* location, const char* address_reg, char* out)
+{
+    switch (location->type)
+    {
+    case IR_VALUE_LOCAL:
+        sprintf(out, "[ebp%+i]", ir_function_local(gen->function, location->local)->offset + location->offset);
+        break;
+
+    case IR_VALUE_SYMBOL:
+    {
+        char address[128];
+        ircodegen_address_with_offset(location->symbol, location->offset, address);
+        sprintf(out, "[%s]", address);
+    }
+    break;
+
+    default:
+    {
+        // The location is an address computed at runtime or a constant address i.e. a string, names[2][1]
+        int offset = location->offset;
+        struct ir_value address = *location;
+        address.offset = 0;
+        ircodegen_load_value(gen, address_reg, &address);
+        char register_address[32];
+        ircodegen_address_with_offset(address_reg, offset, register_address);
+        sprintf(out, "[%s]", register_address);
+    }
+    break;
+    }
+}
+
+static void ircodegen_store_result(struct ircodegen* gen, struct ir_instruction* instruction, const char* reg)
+{
+    if (instruction->dst.type == IR_VALUE_VREG)
+    {
+        asm_push("mov [ebp%+i], %s", ircodegen_vreg_offset(gen, instruction->dst.vreg), reg);
+    }
+}
+
+// Extends the part of the register that belongs to the type so the whole register holds the value
+static void ircodegen_extend(const char* reg, int type)
+{
+    size_t size = ir_type_size(type);
+    if (size >= DATA_SIZE_DWORD || size == 0)
+    {
+        return;
+    }
+    asm_push("%s %s, %s", ir_type_is_signed(type) ? "movsx" : "movzx", reg, ircodegen_sub_register(reg, size));
+}
+
+static const char* ircodegen_block_label_format()
+{
+    return ".ir_block_%i";
+}
+
+static void ircodegen_jump(struct ircodegen* gen, const char* jump_ins, struct ir_block* target)
+{
+    char label[64];
+    sprintf(label, ircodegen_block_label_format(), gen->block_labels[target->id]);
+    asm_push("%s %s", jump_ins, label);
+}
+
+// The condition code used by setcc and jcc i.e setl, jl
+static const char* ircodegen_condition_code(int op, int type)
+{
+    bool is_signed = ir_type_is_signed(type);
+    const char* code = "e";
+    switch (op)
+    {
+    case IR_OP_EQ:
+        code = "e";
+        break;
+    case IR_OP_NE:
+        code = "ne";
+        break;
+    case IR_OP_LT:
+        code = is_signed ? "l" : "b";
+        break;
+    case IR_OP_LE:
+        code = is_signed ? "le" : "be";
+        break;
+    case IR_OP_GT:
+        code = is_signed ? "g" : "a";
+        break;
+    case IR_OP_GE:
+        code = is_signed ? "ge" : "ae";
+        break;
+    }
+    return code;
+}
+
+static int ircodegen_negate_comparison(int op)
+{
+    int negated = op;
+    switch (op)
+    {
+    case IR_OP_EQ:
+        negated = IR_OP_NE;
+        break;
+    case IR_OP_NE:
+        negated = IR_OP_EQ;
+        break;
+    case IR_OP_LT:
+        negated = IR_OP_GE;
+        break;
+    case IR_OP_LE:
+        negated = IR_OP_GT;
+        break;
+    case IR_OP_GT:
+        negated = IR_OP_LE;
+        break;
+    case IR_OP_GE:
+        negated = IR_OP_LT;
+        break;
+    }
+    return negated;
+}
+
+static void ircodegen_generate_compare(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    char operand[128];
+    ircodegen_load_value(gen, "eax", &instruction->a);
+    ircodegen_operand(gen, &instruction->b, "ecx", operand);
+    asm_push("cmp eax, %s", operand);
+}
+
+static void ircodegen_generate_binary(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    char operand[128];
+    bool is_signed = ir_type_is_signed(instruction->type);
+    ircodegen_load_value(gen, "eax", &instruction->a);
+    switch (instruction->op)
+    {
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+    {
+        static const char* instructions[] = {[IR_OP_ADD] = "add", [IR_OP_SUB] = "sub", [IR_OP_AND] = "and", [IR_OP_OR] = "or", [IR_OP_XOR] = "xor"};
+        ircodegen_operand(gen, &instruction->b, "ecx", operand);
+        asm_push("%s eax, %s", instructions[instruction->op], operand);
+    }
+    break;
+
+    case IR_OP_MUL:
+        ircodegen_operand(gen, &instruction->b, "ecx", operand);
+        if (instruction->b.type == IR_VALUE_CONSTANT)
+        {
+            asm_push("imul eax, eax, %s", operand);
+        }
+        else
+        {
+            asm_push("imul eax, %s", operand);
+        }
+        break;
+
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        ircodegen_load_value(gen, "ecx", &instruction->b);
+        if (is_signed)
+        {
+            asm_push("cdq");
+            asm_push("idiv ecx");
+        }
+        else
+        {
+            asm_push("xor edx, edx");
+            asm_push("div ecx");
+        }
+        if (instruction->op == IR_OP_MOD)
+        {
+            asm_push("mov eax, edx");
+        }
+        break;
+
+    case IR_OP_SHL:
+    case IR_OP_SHR:
+    {
+        const char* shift_ins = instruction->op == IR_OP_SHL ? "shl" : (is_signed ? "sar" : "shr");
+        if (instruction->b.type == IR_VALUE_CONSTANT)
+        {
+            asm_push("%s eax, %lld", shift_ins, instruction->b.constant);
+        }
+        else
+        {
+            ircodegen_load_value(gen, "ecx", &instruction->b);
+            asm_push("%s eax, cl", shift_ins);
+        }
+    }
+    break;
+    }
+    ircodegen_store_result(gen, instruction, "eax");
+}
+
+static void ircodegen_generate_load(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    char location[128];
+    size_t size = ir_type_size(instruction->type);
+    ircodegen_location(gen, &instruction->a, "edx", location);
+    if (size < DATA_SIZE_DWORD)
+    {
+        asm_push("%s eax, %s %s", ir_type_is_signed(instruction->type) ? "movsx" : "movzx", ircodegen_size_keyword(size), location);
+    }
+    else
+    {
+        asm_push("mov eax, %s", location);
+    }
+    ircodegen_store_result(gen, instruction, "eax");
+}
+
+static void ircodegen_generate_store(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    char location[128];
+    size_t size = ir_type_size(instruction->type);
+    if (instruction->b.type == IR_VALUE_CONSTANT)
+    {
+        ircodegen_location(gen, &instruction->a, "edx", location);
+        asm_push("mov %s %s, %lld", ircodegen_size_keyword(size), location, instruction->b.constant);
+        return;
+    }
+
+    ircodegen_load_value(gen, "eax", &instruction->b);
+    ircodegen_location(gen, &instruction->a, "edx", location);
+    asm_push("mov %s %s, %s", ircodegen_size_keyword(size), location, ircodegen_sub_register("eax", size));
+}
+
+static int ircodegen_generate_call_arguments(struct ircodegen* gen, struct ir_instruction* instruction);
+
+// How many arguments of the call go in ecx and edx
+static int ircodegen_register_argument_count(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    struct symbol* sym = symresolver_get_symbol(gen->process, instruction->a.symbol);
+    if (!sym || sym->type != SYMBOL_TYPE_NODE)
+    {
+        return 0;
+    }
+
+    int register_arguments = function_node_register_argument_count(sym->data);
+    int total_arguments = vector_count(instruction->args);
+    return register_arguments < total_arguments ? register_arguments : total_arguments;
+}
+
+// The arguments passed in registers are loaded after the pushes, computing the pushed ones would overwrite them
+static void ircodegen_load_register_arguments(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    int register_arguments = ircodegen_register_argument_count(gen, instruction);
+    for (int i = 0; i < register_arguments; i++)
+    {
+        ircodegen_load_value(gen, function_node_argument_register(i), vector_at(instruction->args, i));
+    }
+}
+
+static void ircodegen_generate_call(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    int pushed_arguments = ircodegen_generate_call_arguments(gen, instruction);
+    ircodegen_load_register_arguments(gen, instruction);
+    asm_push("call %s", instruction->a.symbol);
+    codegen_stack_add(pushed_arguments * DATA_SIZE_DWORD);
+    if (instruction->dst.type == IR_VALUE_VREG)
+    {
+        ircodegen_extend("eax", instruction->type);
+        ircodegen_store_result(gen, instruction, "eax");
+    }
+}
+
+// call abc followed by returning its result can reuse our argument area and jump to abc, just like the AST code generator does for "return abc(x);"
+static struct node* ircodegen_tail_call_function(struct ircodegen* gen, struct ir_instruction* instruction, struct ir_instruction* next)
+{
+    if (instruction->op != IR_OP_CALL || !next || next->op != IR_OP_RETURN || instruction->type != next->type || !compiler_pass_enabled(gen->process, COMPILER_PASS_TAIL_CALLS))
+    {
+        return NULL;
+    }
+
+    bool returns_result = instruction->dst.type == IR_VALUE_VREG ? ir_value_is_vreg(&next->a, instruction->dst.vreg) : next->a.type == IR_VALUE_NONE;
+    if (!returns_result)
+    {
+        return NULL;
+    }
+
+    // A pointer to one of our locals could be passed to the called function, but our stack frame is gone after the jump
+    struct vector* locals = gen->function->locals;
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (local->flags & IR_LOCAL_FLAG_ADDRESS_TAKEN)
+        {
+            return NULL;
+        }
+    }
+
+    struct symbol* sym = symresolver_get_symbol(gen->process, instruction->a.symbol);
+    if (!sym || sym->type != SYMBOL_TYPE_NODE)
+    {
+        return NULL;
+    }
+
+    struct node* callee_node = sym->data;
+    size_t stack_size = (vector_count(instruction->args) - ircodegen_register_argument_count(gen, instruction)) * DATA_SIZE_DWORD;
+    if (stack_size > codegen_function_argument_stack_size(gen->function->node) || function_node_argument_stack_addition(callee_node) != function_node_argument_stack_addition(gen->function->node))
+    {
+        return NULL;
+    }
+    return callee_node;
+}
+
+// Pushes the arguments that don't go in registers, returns how many were pushed
+static int ircodegen_generate_call_arguments(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    // Arguments are pushed backwards so the first argument ends up at ebp+8 of the called function
+    int total_arguments = vector_count(instruction->args);
+    int register_arguments = ircodegen_register_argument_count(gen, instruction);
+    for (int i = total_arguments - 1; i >= register_arguments; i--)
+    {
+        struct ir_value* argument = vector_at(instruction->args, i);
+        if (argument->type == IR_VALUE_CONSTANT)
+        {
+            asm_push_ins_push("dword %lld", STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE, "result_value", argument->constant);
+            continue;
+        }
+        if (argument->type == IR_VALUE_VREG)
+        {
+            asm_push_ins_push("dword [ebp%+i]", STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE, "result_value", ircodegen_vreg_offset(gen, argument->vreg));
+            continue;
+        }
+        ircodegen_load_value(gen, "eax", argument);
+        asm_push_ins_push("eax", STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE, "result_value");
+    }
+    return total_arguments - register_arguments;
+}
+
+static void ircodegen_generate_tail_call(struct ircodegen* gen, struct ir_instruction* instruction, struct node* callee_node)
+{
+    compile_report_pass_start(gen->process);
+    // All arguments are computed before any of ours are overwritten, they might be computed from our arguments
+    int pushed_arguments = ircodegen_generate_call_arguments(gen, instruction);
+    size_t stack_addition = function_node_argument_stack_addition(gen->function->node);
+    for (int i = 0; i < pushed_arguments; i++)
+    {
+        asm_push_ins_pop("eax", STACK_FRAME_ELEMENT_TYPE_PUSHED_VALUE, "result_value");
+        asm_push("mov dword [ebp+%i], eax", (int)(stack_addition + i * DATA_SIZE_DWORD));
+    }
+    ircodegen_load_register_arguments(gen, instruction);
+
+    codegen_stack_add_no_compile_time_stack_frame_restore(gen->frame_size);
+    asm_pop_ebp_no_stack_frame_restore();
+    asm_push("jmp %s", callee_node->func.name);
+    compile_report_pass_end(gen->process, COMPILER_PASS_TAIL_CALLS);
+}
+
+static void ircodegen_generate_return(struct ircodegen* gen, struct ir_instruction* instruction)
+{
+    if (instruction->a.type != IR_VALUE_NONE)
+    {
+        ircodegen_load_value(gen, "eax", &instruction->a);
+    }
+
+    // Every return leaves the function, the stack frame is only restored once at the end of the function
+    codegen_stack_add_no_compile_time_stack_frame_restore(gen->frame_size);
+    asm_pop_ebp_no_stack_frame_restore();
+    asm_push("ret");
+}
+
+static void ircodegen_generate_branch_targets(struct ircodegen* gen, int op, int type, struct ir_instruction* branch, struct ir_block* next_block)
+{
+    // Jump to the true block if the condition holds, otherwise fall through or jump to the false block
+    if (branch->targets[0] == next_block)
+    {
+        char jump_ins[16];
+        sprintf(jump_ins, "j%s", ircodegen_condition_code(ircodegen_negate_comparison(op), type));
+        ircodegen_jump(gen, jump_ins, branch->targets[1]);
+        return;
+    }
+
+    char jump_ins[16];
+    sprintf(jump_ins, "j%s", ircodegen_condition_code(op, type));
+    ircodegen_jump(gen, jump_ins, branch->targets[0]);
+    if (branch->targets[1] != next_block)
+    {
+        ircodegen_jump(gen, "jmp", branch->targets[1]);
+    }
+}
+
+// A comparison that is only used by the following branch doesn't need to be turned into 1 or 0
+static bool ircodegen_is_fusable_compare(struct ircodegen* gen, struct ir_instruction* instruction, struct ir_instruction* next)
+{
+    return ir_op_is_comparison(instruction->op) && next && next->op == IR_OP_BRANCH && instruction->dst.type == IR_VALUE_VREG && ir_value_is_vreg(&next->a, instruction->dst.vreg) && gen->vreg_uses[instruction->dst.vreg] == 1;
+}
+
+static void ircodegen_generate_instruction(struct ircodegen* gen, struct ir_instruction* instruction, struct ir_block* next_block)
+{
+    switch (instruction->op)
+    {
+    case IR_OP_MOVE:
+        ircodegen_load_value(gen, "eax", &instruction->a);
+        ircodegen_store_result(gen, instruction, "eax");
+        break;
+
+    case IR_OP_ADDRESS:
+        ircodegen_load_value(gen, "eax", &instruction->a);
+        ircodegen_store_result(gen, instruction, "eax");
+        break;
+
+    case IR_OP_LOAD:
+        ircodegen_generate_load(gen, instruction);
+        break;
+
+    case IR_OP_STORE:
+        ircodegen_generate_store(gen, instruction);
+        break;
+
+    case IR_OP_ZERO:
+        // Only locals are zeroed, they are always at a known offset from ebp
+        codegen_generate_zero_fill("ebp", ir_function_local(gen->function, instruction->a.local)->offset + instruction->a.offset, instruction->b.constant);
+        break;
+
+    case IR_OP_NEG:
+    case IR_OP_NOT:
+        ircodegen_load_value(gen, "eax", &instruction->a);
+        asm_push("%s eax", instruction->op == IR_OP_NEG ? "neg" : "not");
+        ircodegen_store_result(gen, instruction, "eax");
+        break;
+
+    case IR_OP_CONVERT:
+        ircodegen_load_value(gen, "eax", &instruction->a);
+        ircodegen_extend("eax", instruction->type);
+        ircodegen_store_result(gen, instruction, "eax");
+        break;
+
+    case IR_OP_CALL:
+        ircodegen_generate_call(gen, instruction);
+        break;
+
+    case IR_OP_JUMP:
+        if (instruction->targets[0] != next_block)
+        {
+            ircodegen_jump(gen, "jmp", instruction->targets[0]);
+        }
+        break;
+
+    case IR_OP_BRANCH:
+        ircodegen_load_value(gen, "eax", &instruction->a);
+        asm_push("test eax, eax");
+        ircodegen_generate_branch_targets(gen, IR_OP_NE, IR_TYPE_I32, instruction, next_block);
+        break;
+
+    case IR_OP_RETURN:
+        ircodegen_generate_return(gen, instruction);
+        break;
+
+    default:
+        if (ir_op_is_binary(instruction->op))
+        {
+            ircodegen_generate_binary(gen, instruction);
+            break;
+        }
+        if (ir_op_is_comparison(instruction->op))
+        {
+            ircodegen_generate_compare(gen, instruction);
+            asm_push("set%s al", ircodegen_condition_code(instruction->op, instruction->type));
+            asm_push("movzx eax, al");
+            ircodegen_store_result(gen, instruction, "eax");
+            break;
+        }
+        compiler_error(gen->process, "Unknown IR instruction %i\n", instruction->op);
+    }
+}
+
+static void ircodegen_generate_block(struct ircodegen* gen, struct ir_block* block, struct ir_block* next_block)
+{
+    asm_push(".ir_block_%i:", gen->block_labels[block->id]);
+    struct vector* instructions = block->instructions;
+    for (int i = 0; i < vector_count(instructions); i++)
+    {
+        struct ir_instruction* instruction = vector_peek_ptr_at(instructions, i);
+        struct ir_instruction* next = i + 1 < vector_count(instructions) ? vector_peek_ptr_at(instructions, i + 1) : NULL;
+        if (ircodegen_is_fusable_compare(gen, instruction, next))
+        {
+            // cmp eax, ecx / jl .ir_block_5
+            ircodegen_generate_compare(gen, instruction);
+            ircodegen_generate_branch_targets(gen, instruction->op, instruction->type, next, next_block);
+            i++;
+            continue;
+        }
+
+        struct node* callee_node = ircodegen_tail_call_function(gen, instruction, next);
+        if (callee_node)
+        {
+            ircodegen_generate_tail_call(gen, instruction, callee_node);
+            i++;
+            continue;
+        }
+        ircodegen_generate_instruction(gen, instruction, next_block);
+    }
+}
+
+static void ircodegen_count_use(struct ircodegen* gen, struct ir_value* value)
+{
+    if (value->type == IR_VALUE_VREG)
+    {
+        gen->vreg_uses[value->vreg]++;
+    }
+}
+
+static void ircodegen_count_uses(struct ircodegen* gen)
+{
+    struct vector* blocks = gen->function->blocks;
+    for (int i = 0; i < vector_count(blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(blocks, i);
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, j);
+            ircodegen_count_use(gen, &instruction->a);
+            ircodegen_count_use(gen, &instruction->b);
+            if (instruction->op == IR_OP_CALL)
+            {
+                for (int k = 0; k < vector_count(instruction->args); k++)
+                {
+                    ircodegen_count_use(gen, vector_at(instruction->args, k));
+                }
+            }
+        }
+    }
+}
+
+// Gives every local its offset from the base pointer, returns the total size of the locals
+static size_t ircodegen_layout_locals(struct ircodegen* gen)
+{
+    size_t size = 0;
+    struct vector* locals = gen->function->locals;
+    struct node* func_node = gen->function->node;
+    int register_arguments = function_node_register_argument_count(func_node);
+    // How far the first pushed argument moved down compared to cdecl
+    int register_stack_size = 0;
+    if (register_arguments)
+    {
+        struct vector* arguments = function_node_argument_vec(func_node);
+        struct node* first_argument = vector_peek_ptr_at(arguments, 0);
+        struct node* first_pushed_argument = register_arguments < vector_count(arguments) ? vector_peek_ptr_at(arguments, register_arguments) : NULL;
+        register_stack_size = first_pushed_argument ? variable_node(first_pushed_argument)->var.aoffset - variable_node(first_argument)->var.aoffset : 0;
+    }
+
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (local->flags & IR_LOCAL_FLAG_ARGUMENT && local->argument_index >= register_arguments)
+        {
+            // Arguments were pushed by the caller, the ones passed in registers don't take up space there
+            local->offset = local->var_node->var.aoffset - register_stack_size;
+            continue;
+        }
+        size = align_value(size + local->size, local->align);
+        local->offset = -(int)size;
+    }
+    return align_value(size, DATA_SIZE_DWORD);
+}
+
+// The arguments passed in ecx and edx get a place in the frame like any other local
+static void ircodegen_store_register_arguments(struct ircodegen* gen)
+{
+    int register_arguments = function_node_register_argument_count(gen->function->node);
+    struct vector* locals = gen->function->locals;
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (local->flags & IR_LOCAL_FLAG_ARGUMENT && local->argument_index < register_arguments)
+        {
+            const char* reg = function_node_argument_register(local->argument_index);
+            asm_push("mov %s [ebp%+i], %s", ircodegen_size_keyword(local->size), local->offset, ircodegen_sub_register(reg, local->size));
+        }
+    }
+}
+
+void ircodegen_generate_function(struct compiler_process* process, struct ir_function* function)
+{
+    struct ircodegen gen = {};
+    gen.process = process;
+    gen.function = function;
+    gen.block_labels = arena_calloc(function->block_count, sizeof(int));
+    gen.vreg_uses = arena_calloc(function->vreg_count + 1, sizeof(int));
+    for (int i = 0; i < function->block_count; i++)
+    {
+        gen.block_labels[i] = codegen_label_count();
+    }
+    ircodegen_count_uses(&gen);
+    gen.vreg_base = ircodegen_layout_locals(&gen);
+    size_t frame_size = gen.vreg_base + function->vreg_count * DATA_SIZE_DWORD;
+    gen.frame_size = C_ALIGN(frame_size);
+
+    struct node* func_node = function->node;
+    asm_push("global %s", function->name);
+    asm_push("; %s function", function->name);
+    asm_push("%s:", function->name);
+    asm_push_ebp();
+    asm_push("mov ebp, esp");
+    codegen_stack_sub(gen.frame_size);
+    ircodegen_store_register_arguments(&gen);
+
+    struct vector* blocks = function->blocks;
+    for (int i = 0; i < vector_count(blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(blocks, i);
+        struct ir_block* next_block = i + 1 < vector_count(blocks) ? vector_peek_ptr_at(blocks, i + 1) : NULL;
+        ircodegen_generate_block(&gen, block, next_block);
+    }
+
+    // Every path ends in a return which already left the function, restore the stack frame we track at compile time
+    if (gen.frame_size)
+    {
+        stackframe_add(func_node, STACK_FRAME_ELEMENT_TYPE_UNKNOWN, "literal_stack_change", gen.frame_size);
+    }
+    stackframe_pop_expecting(func_node, STACK_FRAME_ELEMENT_TYPE_SAVED_BP, "function_entry_saved_ebp");
+    stackframe_assert_empty(func_node);
+
+    arena_free(gen.block_labels);
+    arena_free(gen.vreg_uses);
+}
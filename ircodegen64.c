@@ -0,0 +1,795 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ * Lowers the intermediate representation into x86-64 NASM assembly using the System V calling convention
+ *
+ * rbp+16...    arguments after the sixth, pushed by the caller
+ * rbp-...      locals, the arguments passed in registers are stored here by the prologue
+ * rbp-...      virtual registers (8 bytes each)
+ *
+ * A virtual register always holds its value extended to 64 bits (sign extended if the type is signed),
+ * so a 32 bit index can be added to a pointer without converting it again
+ *
+ * Instructions are computed in rax/rcx, rdx is used for addresses and division
+ */
+
+// The first six integer arguments are passed in registers
+#define IRCODEGEN64_REGISTER_ARGUMENTS 6
+
+// qword, dword, word and byte part of every register we use
+static const char* ircodegen64_registers[][4] = {
+    {"rax", "eax", "ax", "al"},
+    {"rcx", "ecx", "cx", "cl"},
+    {"rdx", "edx", "dx", "dl"},
+    {"rdi", "edi", "di", "dil"},
+    {"rsi", "esi", "si", "sil"},
+    {"r8", "r8d", "r8w", "r8b"},
+    {"r9", "r9d", "r9w", "r9b"},
+};
+
+static const char* ircodegen64_argument_registers[IRCODEGEN64_REGISTER_ARGUMENTS] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+
+struct ircodegen64
+{
+    struct compiler_process* process;
+    struct ir_function* function;
+
+    // The label id of every block, indexed by the block id
+    int* block_labels;
+
+    // How many times every virtual register is read, indexed by the vreg
+    int* vreg_uses;
+
+    // Where the virtual registers start below the base pointer
+    int vreg_base;
+    size_t frame_size;
+};
+
+static int ircodegen64_vreg_offset(struct ircodegen64* gen, int vreg)
+{
+    return -(gen->vreg_base + (vreg + 1) * DATA_SIZE_DDWORD);
+}
+
+static const char* ircodegen64_size_keyword(size_t size)
+{
+    const char* keyword = "qword";
+    switch (size)
+    {
+    case DATA_SIZE_BYTE:
+        keyword = "byte";
+        break;
+    case DATA_SIZE_WORD:
+        keyword = "word";
+        break;
+    case DATA_SIZE_DWORD:
+        keyword = "dword";
+        break;
+    }
+    return keyword;
+}
+
+// rax -> al, ax, eax or rax depending on the size
+static const char* ircodegen64_sub_register(const char* reg, size_t size)
+{
+    int part = 0;
+    switch (size)
+    {
+    case DATA_SIZE_DWORD:
+        part = 1;
+        break;
+    case DATA_SIZE_WORD:
+        part = 2;
+        break;
+    case DATA_SIZE_BYTE:
+        part = 3;
+        break;
+    }
+
+    for (int i = 0; i < sizeof(ircodegen64_registers) / sizeof(ircodegen64_registers[0]); i++)
+    {
+        if (S_EQ(ircodegen64_registers[i][0], reg))
+        {
+            return ircodegen64_registers[i][part];
+        }
+    }
+    return reg;
+}
+
+// Anything smaller than a pointer is computed with the 32 bit registers
+static size_t ircodegen64_operation_size(int type)
+{
+    return ir_type_size(type) == DATA_SIZE_DDWORD ? DATA_SIZE_DDWORD : DATA_SIZE_DWORD;
+}
+
+// Immediates of most instructions are 32 bits, bigger constants have to be loaded into a register first
+static bool ircodegen64_fits_immediate(long long constant)
+{
+    return constant >= INT32_MIN && constant <= INT32_MAX;
+}
+
+// Rounds the value up to the alignment
+static size_t ircodegen64_align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// abc, abc+4, abc-4
+static void ircodegen64_address_with_offset(const char* base, int offset, char* out)
+{
+    if (offset)
+    {
+        sprintf(out, "%s%+i", base, offset);
+        return;
+    }
+    sprintf(out, "%s", base);
+}
+
+// Moves a value into a 64 bit register
+static void ircodegen64_load_value(struct ircodegen64* gen, const char* reg, struct ir_value* value)
+{
+    switch (value->type)
+    {
+    case IR_VALUE_VREG:
+        asm_push("mov %s, [rbp%+i]", reg, ircodegen64_vreg_offset(gen, value->vreg));
+        break;
+
+    case IR_VALUE_CONSTANT:
+        asm_push("mov %s, %lld", reg, value->constant);
+        break;
+
+    case IR_VALUE_STRING:
+        asm_push("lea %s, [%s]", reg, codegen_register_string(value->string));
+        break;
+
+    case IR_VALUE_SYMBOL:
+    {
+        // The value of a symbol is its address
+        char address[128];
+        ircodegen64_address_with_offset(value->symbol, value->offset, address);
+        asm_push("lea %s, [%s]", reg, address);
+    }
+    break;
+
+    case IR_VALUE_LOCAL:
+        asm_push("lea %s, [rbp%+i]", reg, ir_function_local(gen->function, value->local)->offset + value->offset);
+        break;
+
+    default:
+        asm_push("xor %s, %s", ircodegen64_sub_register(reg, DATA_SIZE_DWORD), ircodegen64_sub_register(reg, DATA_SIZE_DWORD));
+        break;
+    }
+}
+
+// An operand of the given size that can be used directly in an instruction, constants and virtual registers don't have to be loaded first
+static void ircodegen64_operand(struct ircodegen64* gen, struct ir_value* value, const char* reg, size_t size, char* out)
+{
+    if (value->type == IR_VALUE_CONSTANT && ircodegen64_fits_immediate(value->constant))
+    {
+        sprintf(out, "%lld", value->constant);
+        return;
+    }
+
+    if (value->type == IR_VALUE_VREG)
+    {
+        // The low part of the virtual register is at its lowest address
+        sprintf(out, "%s [rbp%+i]", ircodegen64_size_keyword(size), ircodegen64_vreg_offset(gen, value->vreg));
+        return;
+    }
+
+    ircodegen64_load_value(gen, reg, value);
+    sprintf(out, "%s", ircodegen64_sub_register(reg, size));
+}
+
+// Writes the memory operand for a location i.e [rbp-4], [abc+8], [rdx+4]
+static void ircodegen64_location(struct ircodegen64* gen, struct ir_value* location, const char* address_reg, char* out)
+{
+    switch (location->type)
+    {
+    case IR_VALUE_LOCAL:
+        sprintf(out, "[rbp%+i]", ir_function_local(gen->function, location->local)->offset + location->offset);
+        break;
+
+    case IR_VALUE_SYMBOL:
+    {
+        char address[128];
+        ircodegen64_address_with_offset(location->symbol, location->offset, address);
+        sprintf(out, "[%s]", address);
+    }
+    break;
+
+    default:
+    {
+        // The location is an address computed at runtime
+        int offset = location->offset;
+        struct ir_value address = *location;
+        address.offset = 0;
+        ircodegen64_load_value(gen, address_reg, &address);
+        char register_address[32];
+        ircodegen64_address_with_offset(address_reg, offset, register_address);
+        sprintf(out, "[%s]", register_address);
+    }
+    break;
+    }
+}
+
+// Extends the part of the register that belongs to the type to the whole 64 bit register
+static void ircodegen64_extend(const char* reg, int type)
+{
+    size_t size = ir_type_size(type);
+    bool is_signed = ir_type_is_signed(type);
+    switch (size)
+    {
+    case DATA_SIZE_BYTE:
+    case DATA_SIZE_WORD:
+        // movzx into the 32 bit register clears the upper half as well
+        asm_push("%s %s, %s", is_signed ? "movsx" : "movzx", is_signed ? reg : ircodegen64_sub_register(reg, DATA_SIZE_DWORD), ircodegen64_sub_register(reg, size));
+        break;
+
+    case DATA_SIZE_DWORD:
+        if (is_signed)
+        {
+            asm_push("movsxd %s, %s", reg, ircodegen64_sub_register(reg, DATA_SIZE_DWORD));
+            break;
+        }
+        asm_push("mov %s, %s", ircodegen64_sub_register(reg, DATA_SIZE_DWORD), ircodegen64_sub_register(reg, DATA_SIZE_DWORD));
+        break;
+    }
+}
+
+static void ircodegen64_store_result(struct ircodegen64* gen, struct ir_instruction* instruction, const char* reg)
+{
+    if (instruction->dst.type == IR_VALUE_VREG)
+    {
+        asm_push("mov [rbp%+i], %s", ircodegen64_vreg_offset(gen, instruction->dst.vreg), reg);
+    }
+}
+
+static void ircodegen64_jump(struct ircodegen64* gen, const char* jump_ins, struct ir_block* target)
+{
+    asm_push("%s .ir_block_%i", jump_ins, gen->block_labels[target->id]);
+}
+
+// The condition code used by setcc and jcc i.e setl, jl
+static const char* ircodegen64_condition_code(int op, int type)
+{
+    bool is_signed = ir_type_is_signed(type);
+    const char* code = "e";
+    switch (op)
+    {
+    case IR_OP_EQ:
+        code = "e";
+        break;
+    case IR_OP_NE:
+        code = "ne";
+        break;
+    case IR_OP_LT:
+        code = is_signed ? "l" : "b";
+        break;
+    case IR_OP_LE:
+        code = is_signed ? "le" : "be";
+        break;
+    case IR_OP_GT:
+        code = is_signed ? "g" : "a";
+        break;
+    case IR_OP_GE:
+        code = is_signed ? "ge" : "ae";
+        break;
+    }
+    return code;
+}
+
+static int ircodegen64_negate_comparison(int op)
+{
+    int negated = op;
+    switch (op)
+    {
+    case IR_OP_EQ:
+        negated = IR_OP_NE;
+        break;
+    case IR_OP_NE:
+        negated = IR_OP_EQ;
+        break;
+    case IR_OP_LT:
+        negated = IR_OP_GE;
+        break;
+    case IR_OP_LE:
+        negated = IR_OP_GT;
+        break;
+    case IR_OP_GT:
+        negated = IR_OP_LE;
+        break;
+    case IR_OP_GE:
+        negated = IR_OP_LT;
+        break;
+    }
+    return negated;
+}
+
+static void ircodegen64_generate_compare(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    // The type of a comparison is the type of its operands
+    char operand[128];
+    size_t size = ircodegen64_operation_size(instruction->type);
+    ircodegen64_load_value(gen, "rax", &instruction->a);
+    ircodegen64_operand(gen, &instruction->b, "rcx", size, operand);
+    asm_push("cmp %s, %s", ircodegen64_sub_register("rax", size), operand);
+}
+
+static void ircodegen64_generate_binary(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    char operand[128];
+    bool is_signed = ir_type_is_signed(instruction->type);
+    size_t size = ircodegen64_operation_size(instruction->type);
+    const char* rax = ircodegen64_sub_register("rax", size);
+    const char* rcx = ircodegen64_sub_register("rcx", size);
+    ircodegen64_load_value(gen, "rax", &instruction->a);
+    switch (instruction->op)
+    {
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+    {
+        static const char* instructions[] = {[IR_OP_ADD] = "add", [IR_OP_SUB] = "sub", [IR_OP_AND] = "and", [IR_OP_OR] = "or", [IR_OP_XOR] = "xor"};
+        ircodegen64_operand(gen, &instruction->b, "rcx", size, operand);
+        asm_push("%s %s, %s", instructions[instruction->op], rax, operand);
+    }
+    break;
+
+    case IR_OP_MUL:
+        ircodegen64_operand(gen, &instruction->b, "rcx", size, operand);
+        if (instruction->b.type == IR_VALUE_CONSTANT && ircodegen64_fits_immediate(instruction->b.constant))
+        {
+            asm_push("imul %s, %s, %s", rax, rax, operand);
+        }
+        else
+        {
+            asm_push("imul %s, %s", rax, operand);
+        }
+        break;
+
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        ircodegen64_load_value(gen, "rcx", &instruction->b);
+        if (is_signed)
+        {
+            asm_push(size == DATA_SIZE_DDWORD ? "cqo" : "cdq");
+            asm_push("idiv %s", rcx);
+        }
+        else
+        {
+            asm_push("xor edx, edx");
+            asm_push("div %s", rcx);
+        }
+        if (instruction->op == IR_OP_MOD)
+        {
+            asm_push("mov %s, %s", rax, ircodegen64_sub_register("rdx", size));
+        }
+        break;
+
+    case IR_OP_SHL:
+    case IR_OP_SHR:
+    {
+        const char* shift_ins = instruction->op == IR_OP_SHL ? "shl" : (is_signed ? "sar" : "shr");
+        if (instruction->b.type == IR_VALUE_CONSTANT)
+        {
+            asm_push("%s %s, %lld", shift_ins, rax, instruction->b.constant);
+        }
+        else
+        {
+            ircodegen64_load_value(gen, "rcx", &instruction->b);
+            asm_push("%s %s, cl", shift_ins, rax);
+        }
+    }
+    break;
+    }
+    ircodegen64_extend("rax", instruction->type);
+    ircodegen64_store_result(gen, instruction, "rax");
+}
+
+static void ircodegen64_generate_load(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    char location[128];
+    size_t size = ir_type_size(instruction->type);
+    bool is_signed = ir_type_is_signed(instruction->type);
+    ircodegen64_location(gen, &instruction->a, "rdx", location);
+    switch (size)
+    {
+    case DATA_SIZE_BYTE:
+    case DATA_SIZE_WORD:
+        asm_push("%s %s, %s %s", is_signed ? "movsx" : "movzx", is_signed ? "rax" : "eax", ircodegen64_size_keyword(size), location);
+        break;
+
+    case DATA_SIZE_DWORD:
+        // Writing eax clears the upper half of rax
+        asm_push("%s %s, dword %s", is_signed ? "movsxd" : "mov", is_signed ? "rax" : "eax", location);
+        break;
+
+    default:
+        asm_push("mov rax, qword %s", location);
+        break;
+    }
+    ircodegen64_store_result(gen, instruction, "rax");
+}
+
+static void ircodegen64_generate_store(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    char location[128];
+    size_t size = ir_type_size(instruction->type);
+    if (instruction->b.type == IR_VALUE_CONSTANT && ircodegen64_fits_immediate(instruction->b.constant))
+    {
+        ircodegen64_location(gen, &instruction->a, "rdx", location);
+        asm_push("mov %s %s, %lld", ircodegen64_size_keyword(size), location, instruction->b.constant);
+        return;
+    }
+
+    ircodegen64_load_value(gen, "rax", &instruction->b);
+    ircodegen64_location(gen, &instruction->a, "rdx", location);
+    asm_push("mov %s %s, %s", ircodegen64_size_keyword(size), location, ircodegen64_sub_register("rax", size));
+}
+
+// Locals up to this size are cleared with single stores, bigger ones with rep stosq
+#define IRCODEGEN64_UNROLLED_ZERO_MAX_SIZE 64
+
+static void ircodegen64_generate_zero(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    int offset = ir_function_local(gen->function, instruction->a.local)->offset + instruction->a.offset;
+    size_t size = instruction->b.constant;
+    size_t filled = 0;
+    if (size > IRCODEGEN64_UNROLLED_ZERO_MAX_SIZE)
+    {
+        // rdi and rcx are never preserved across our instructions, the arguments were already spilled
+        asm_push("lea rdi, [rbp%+i]", offset);
+        asm_push("xor eax, eax");
+        asm_push("mov ecx, %i", (int)(size / 8));
+        asm_push("rep stosq");
+        filled = size / 8 * 8;
+    }
+
+    while (filled < size)
+    {
+        size_t left = size - filled;
+        size_t chunk = left >= 8 ? 8 : left >= 4 ? 4 : left >= 2 ? 2 : 1;
+        asm_push("mov %s [rbp%+i], 0", ircodegen64_size_keyword(chunk), (int)(offset + filled));
+        filled += chunk;
+    }
+}
+
+/*
+ * The first six arguments go in rdi, rsi, rdx, rcx, r8 and r9, the rest are pushed backwards
+ * The stack has to be aligned to 16 bytes at the call, our frame already is so only an odd number of pushes needs padding
+ */
+static void ircodegen64_generate_call(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    int total_arguments = vector_count(instruction->args);
+    int stack_arguments = total_arguments > IRCODEGEN64_REGISTER_ARGUMENTS ? total_arguments - IRCODEGEN64_REGISTER_ARGUMENTS : 0;
+    size_t stack_size = (stack_arguments + stack_arguments % 2) * DATA_SIZE_DDWORD;
+    if (stack_arguments % 2)
+    {
+        asm_push("sub rsp, %i", DATA_SIZE_DDWORD);
+    }
+
+    for (int i = total_arguments - 1; i >= IRCODEGEN64_REGISTER_ARGUMENTS; i--)
+    {
+        struct ir_value* argument = vector_at(instruction->args, i);
+        if (argument->type == IR_VALUE_CONSTANT && ircodegen64_fits_immediate(argument->constant))
+        {
+            asm_push("push qword %lld", argument->constant);
+            continue;
+        }
+        if (argument->type == IR_VALUE_VREG)
+        {
+            asm_push("push qword [rbp%+i]", ircodegen64_vreg_offset(gen, argument->vreg));
+            continue;
+        }
+        ircodegen64_load_value(gen, "rax", argument);
+        asm_push("push rax");
+    }
+
+    // Loading an argument only touches its own register, the others are safe
+    for (int i = 0; i < total_arguments && i < IRCODEGEN64_REGISTER_ARGUMENTS; i++)
+    {
+        ircodegen64_load_value(gen, ircodegen64_argument_registers[i], vector_at(instruction->args, i));
+    }
+
+    // Variadic functions like printf read the number of vector registers used from al
+    asm_push("xor eax, eax");
+    asm_push("call %s", instruction->a.symbol);
+    if (stack_size)
+    {
+        asm_push("add rsp, %i", (int)stack_size);
+    }
+
+    if (instruction->dst.type == IR_VALUE_VREG)
+    {
+        // Only the part of rax that belongs to the return type is set by the called function
+        ircodegen64_extend("rax", instruction->type);
+        ircodegen64_store_result(gen, instruction, "rax");
+    }
+}
+
+// call abc followed by returning its result can jump to abc instead, the arguments are all in registers so our stack frame isn't needed anymore
+static bool ircodegen64_is_tail_call(struct ircodegen64* gen, struct ir_instruction* instruction, struct ir_instruction* next)
+{
+    if (instruction->op != IR_OP_CALL || !next || next->op != IR_OP_RETURN || instruction->type != next->type || !compiler_pass_enabled(gen->process, COMPILER_PASS_TAIL_CALLS))
+    {
+        return false;
+    }
+
+    bool returns_result = instruction->dst.type == IR_VALUE_VREG ? ir_value_is_vreg(&next->a, instruction->dst.vreg) : next->a.type == IR_VALUE_NONE;
+    if (!returns_result || vector_count(instruction->args) > IRCODEGEN64_REGISTER_ARGUMENTS)
+    {
+        return false;
+    }
+
+    // A pointer to one of our locals could be passed to the called function, but our stack frame is gone after the jump
+    struct vector* locals = gen->function->locals;
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (local->flags & IR_LOCAL_FLAG_ADDRESS_TAKEN)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void ircodegen64_generate_tail_call(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    compile_report_pass_start(gen->process);
+    for (int i = 0; i < vector_count(instruction->args); i++)
+    {
+        ircodegen64_load_value(gen, ircodegen64_argument_registers[i], vector_at(instruction->args, i));
+    }
+    asm_push("xor eax, eax");
+    asm_push("leave");
+    asm_push("jmp %s", instruction->a.symbol);
+    compile_report_pass_end(gen->process, COMPILER_PASS_TAIL_CALLS);
+}
+
+static void ircodegen64_generate_return(struct ircodegen64* gen, struct ir_instruction* instruction)
+{
+    if (instruction->a.type != IR_VALUE_NONE)
+    {
+        ircodegen64_load_value(gen, "rax", &instruction->a);
+    }
+    asm_push("leave");
+    asm_push("ret");
+}
+
+static void ircodegen64_generate_branch_targets(struct ircodegen64* gen, int op, int type, struct ir_instruction* branch, struct ir_block* next_block)
+{
+    // Jump to the true block if the condition holds, otherwise fall through or jump to the false block
+    char jump_ins[16];
+    if (branch->targets[0] == next_block)
+    {
+        sprintf(jump_ins, "j%s", ircodegen64_condition_code(ircodegen64_negate_comparison(op), type));
+        ircodegen64_jump(gen, jump_ins, branch->targets[1]);
+        return;
+    }
+
+    sprintf(jump_ins, "j%s", ircodegen64_condition_code(op, type));
+    ircodegen64_jump(gen, jump_ins, branch->targets[0]);
+    if (branch->targets[1] != next_block)
+    {
+        ircodegen64_jump(gen, "jmp", branch->targets[1]);
+    }
+}
+
+// A comparison that is only used by the following branch doesn't need to be turned into 1 or 0
+static bool ircodegen64_is_fusable_compare(struct ircodegen64* gen, struct ir_instruction* instruction, struct ir_instruction* next)
+{
+    return ir_op_is_comparison(instruction->op) && next && next->op == IR_OP_BRANCH && instruction->dst.type == IR_VALUE_VREG && ir_value_is_vreg(&next->a, instruction->dst.vreg) && gen->vreg_uses[instruction->dst.vreg] == 1;
+}
+
+static void ircodegen64_generate_instruction(struct ircodegen64* gen, struct ir_instruction* instruction, struct ir_block* next_block)
+{
+    switch (instruction->op)
+    {
+    case IR_OP_MOVE:
+    case IR_OP_ADDRESS:
+        ircodegen64_load_value(gen, "rax", &instruction->a);
+        ircodegen64_store_result(gen, instruction, "rax");
+        break;
+
+    case IR_OP_LOAD:
+        ircodegen64_generate_load(gen, instruction);
+        break;
+
+    case IR_OP_STORE:
+        ircodegen64_generate_store(gen, instruction);
+        break;
+
+    case IR_OP_ZERO:
+        ircodegen64_generate_zero(gen, instruction);
+        break;
+
+    case IR_OP_NEG:
+    case IR_OP_NOT:
+        ircodegen64_load_value(gen, "rax", &instruction->a);
+        asm_push("%s rax", instruction->op == IR_OP_NEG ? "neg" : "not");
+        ircodegen64_extend("rax", instruction->type);
+        ircodegen64_store_result(gen, instruction, "rax");
+        break;
+
+    case IR_OP_CONVERT:
+        ircodegen64_load_value(gen, "rax", &instruction->a);
+        ircodegen64_extend("rax", instruction->type);
+        ircodegen64_store_result(gen, instruction, "rax");
+        break;
+
+    case IR_OP_CALL:
+        ircodegen64_generate_call(gen, instruction);
+        break;
+
+    case IR_OP_JUMP:
+        if (instruction->targets[0] != next_block)
+        {
+            ircodegen64_jump(gen, "jmp", instruction->targets[0]);
+        }
+        break;
+
+    case IR_OP_BRANCH:
+        ircodegen64_load_value(gen, "rax", &instruction->a);
+        asm_push("test rax, rax");
+        ircodegen64_generate_branch_targets(gen, IR_OP_NE, IR_TYPE_PTR, instruction, next_block);
+        break;
+
+    case IR_OP_RETURN:
+        ircodegen64_generate_return(gen, instruction);
+        break;
+
+    default:
+        if (ir_op_is_binary(instruction->op))
+        {
+            ircodegen64_generate_binary(gen, instruction);
+            break;
+        }
+        if (ir_op_is_comparison(instruction->op))
+        {
+            ircodegen64_generate_compare(gen, instruction);
+            asm_push("set%s al", ircodegen64_condition_code(instruction->op, instruction->type));
+            asm_push("movzx eax, al");
+            ircodegen64_store_result(gen, instruction, "rax");
+            break;
+        }
+        compiler_error(gen->process, "Unknown IR instruction %i\n", instruction->op);
+    }
+}
+
+static void ircodegen64_generate_block(struct ircodegen64* gen, struct ir_block* block, struct ir_block* next_block)
+{
+    asm_push(".ir_block_%i:", gen->block_labels[block->id]);
+    struct vector* instructions = block->instructions;
+    for (int i = 0; i < vector_count(instructions); i++)
+    {
+        struct ir_instruction* instruction = vector_peek_ptr_at(instructions, i);
+        struct ir_instruction* next = i + 1 < vector_count(instructions) ? vector_peek_ptr_at(instructions, i + 1) : NULL;
+        if (ircodegen64_is_fusable_compare(gen, instruction, next))
+        {
+            // cmp eax, ecx / jl .ir_block_5
+            ircodegen64_generate_compare(gen, instruction);
+            ircodegen64_generate_branch_targets(gen, instruction->op, instruction->type, next, next_block);
+            i++;
+            continue;
+        }
+
+        if (ircodegen64_is_tail_call(gen, instruction, next))
+        {
+            ircodegen64_generate_tail_call(gen, instruction);
+            i++;
+            continue;
+        }
+        ircodegen64_generate_instruction(gen, instruction, next_block);
+    }
+}
+
+static void ircodegen64_count_use(struct ircodegen64* gen, struct ir_value* value)
+{
+    if (value->type == IR_VALUE_VREG)
+    {
+        gen->vreg_uses[value->vreg]++;
+    }
+}
+
+static void ircodegen64_count_uses(struct ircodegen64* gen)
+{
+    struct vector* blocks = gen->function->blocks;
+    for (int i = 0; i < vector_count(blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(blocks, i);
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, j);
+            ircodegen64_count_use(gen, &instruction->a);
+            ircodegen64_count_use(gen, &instruction->b);
+            if (instruction->op == IR_OP_CALL)
+            {
+                for (int k = 0; k < vector_count(instruction->args); k++)
+                {
+                    ircodegen64_count_use(gen, vector_at(instruction->args, k));
+                }
+            }
+        }
+    }
+}
+
+// Gives every local its offset from the base pointer, returns the total size of the locals
+static size_t ircodegen64_layout_locals(struct ircodegen64* gen)
+{
+    size_t size = 0;
+    struct vector* locals = gen->function->locals;
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (local->flags & IR_LOCAL_FLAG_ARGUMENT && local->argument_index >= IRCODEGEN64_REGISTER_ARGUMENTS)
+        {
+            // Above the return address and the saved base pointer, every pushed argument takes 8 bytes
+            local->offset = 2 * DATA_SIZE_DDWORD + (local->argument_index - IRCODEGEN64_REGISTER_ARGUMENTS) * DATA_SIZE_DDWORD;
+            continue;
+        }
+        size = ircodegen64_align(size + local->size, local->align ? local->align : 1);
+        local->offset = -(int)size;
+    }
+    return ircodegen64_align(size, DATA_SIZE_DDWORD);
+}
+
+// Register arguments are stored into their locals so they can be loaded and have their address taken like any other local
+static void ircodegen64_store_register_arguments(struct ircodegen64* gen)
+{
+    struct vector* locals = gen->function->locals;
+    for (int i = 0; i < vector_count(locals); i++)
+    {
+        struct ir_local* local = vector_peek_ptr_at(locals, i);
+        if (!(local->flags & IR_LOCAL_FLAG_ARGUMENT) || local->argument_index >= IRCODEGEN64_REGISTER_ARGUMENTS)
+        {
+            continue;
+        }
+        compiler_assert(local->size <= DATA_SIZE_DDWORD);
+        asm_push("mov %s [rbp%+i], %s", ircodegen64_size_keyword(local->size), local->offset, ircodegen64_sub_register(ircodegen64_argument_registers[local->argument_index], local->size));
+    }
+}
+
+void ircodegen64_generate_function(struct compiler_process* process, struct ir_function* function)
+{
+    struct ircodegen64 gen = {};
+    gen.process = process;
+    gen.function = function;
+    gen.block_labels = arena_calloc(function->block_count, sizeof(int));
+    gen.vreg_uses = arena_calloc(function->vreg_count + 1, sizeof(int));
+    for (int i = 0; i < function->block_count; i++)
+    {
+        gen.block_labels[i] = codegen_label_count();
+    }
+    ircodegen64_count_uses(&gen);
+    gen.vreg_base = ircodegen64_layout_locals(&gen);
+    size_t frame_size = gen.vreg_base + function->vreg_count * DATA_SIZE_DDWORD;
+    gen.frame_size = C_ALIGN(frame_size);
+
+    asm_push("global %s", function->name);
+    asm_push("; %s function", function->name);
+    asm_push("%s:", function->name);
+    asm_push("push rbp");
+    asm_push("mov rbp, rsp");
+    if (gen.frame_size)
+    {
+        asm_push("sub rsp, %i", (int)gen.frame_size);
+    }
+    ircodegen64_store_register_arguments(&gen);
+
+    struct vector* blocks = function->blocks;
+    for (int i = 0; i < vector_count(blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(blocks, i);
+        struct ir_block* next_block = i + 1 < vector_count(blocks) ? vector_peek_ptr_at(blocks, i + 1) : NULL;
+        ircodegen64_generate_block(&gen, block, next_block);
+    }
+
+    arena_free(gen.block_labels);
+    arena_free(gen.vreg_uses);
+}
@@ -0,0 +1,372 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <stdlib.h>
+
+/*
+ * Local value numbering, every basic block is walked once remembering what was already computed
+ *
+ * %1 = load.i32 $i.0
+ * %2 = mul.ptr %1, 8
+ * %3 = add.ptr %0, %2
+ * %4 = load.i32 %3
+ * %5 = load.i32 $i.0      <- same as %1, removed, uses of %5 become %1
+ * %6 = mul.ptr %5, 8      <- same as %2, removed
+ * ...
+ *
+ * Loads are only reused until a store or call could have changed the memory they read
+ */
+
+struct ircse_available
+{
+    struct ir_instruction* instruction;
+
+    // The value that holds the result of the instruction
+    struct ir_value value;
+
+    // The instruction is a load made up from a store, it isn't inside any block
+    bool from_store;
+};
+
+struct ircse
+{
+    struct ir_function* function;
+
+    // How many times every virtual register is written, only registers written once can be reused
+    int* definition_counts;
+
+    // What every virtual register was replaced with, indexed by the vreg. IR_VALUE_NONE if it wasn't replaced
+    struct ir_value* replacements;
+
+    // Vector of struct ircse_available* for the current block
+    struct vector* available;
+};
+
+static bool ircse_is_local_private(struct ircse* cse, struct ir_value* location)
+{
+    return location->type == IR_VALUE_LOCAL && !(ir_function_local(cse->function, location->local)->flags & IR_LOCAL_FLAG_ADDRESS_TAKEN);
+}
+
+static void ircse_replace_operand(struct ir_value* value, void* private)
+{
+    struct ircse* cse = private;
+    // A replacement can be replaced too, follow the chain. Offsets of locations stay, the instruction defining the register is already gone
+    while (value->type == IR_VALUE_VREG && cse->replacements[value->vreg].type != IR_VALUE_NONE)
+    {
+        int offset = value->offset;
+        struct ir_value replacement = cse->replacements[value->vreg];
+        *value = replacement;
+        value->offset += offset;
+    }
+}
+
+static bool ircse_operand_is_stable(struct ircse* cse, struct ir_value* value)
+{
+    return value->type != IR_VALUE_VREG || cse->definition_counts[value->vreg] <= 1;
+}
+
+static bool ircse_is_commutative(int op)
+{
+    return op == IR_OP_ADD || op == IR_OP_MUL || op == IR_OP_AND || op == IR_OP_OR || op == IR_OP_XOR || op == IR_OP_EQ || op == IR_OP_NE;
+}
+
+static bool ircse_same_expression(struct ir_instruction* a, struct ir_instruction* b)
+{
+    if (a->op != b->op || a->type != b->type || a->from_type != b->from_type)
+    {
+        return false;
+    }
+
+    if (ir_value_equal(&a->a, &b->a) && ir_value_equal(&a->b, &b->b))
+    {
+        return true;
+    }
+    return ircse_is_commutative(a->op) && ir_value_equal(&a->a, &b->b) && ir_value_equal(&a->b, &b->a);
+}
+
+// Instructions that only depend on their operands (and loads, until the memory changes)
+static bool ircse_can_number(int op)
+{
+    return ir_op_is_binary(op) || ir_op_is_comparison(op) || op == IR_OP_NEG || op == IR_OP_NOT || op == IR_OP_CONVERT || op == IR_OP_ADDRESS || op == IR_OP_LOAD;
+}
+
+static struct ircse_available* ircse_find(struct ircse* cse, struct ir_instruction* instruction)
+{
+    for (int i = 0; i < vector_count(cse->available); i++)
+    {
+        struct ircse_available* available = vector_peek_ptr_at(cse->available, i);
+        if (ircse_same_expression(available->instruction, instruction))
+        {
+            return available;
+        }
+    }
+    return NULL;
+}
+
+static void ircse_add_available(struct ircse* cse, struct ir_instruction* instruction, struct ir_value value, bool from_store)
+{
+    struct ircse_available* available = arena_calloc(1, sizeof(struct ircse_available));
+    available->instruction = instruction;
+    available->value = value;
+    available->from_store = from_store;
+    vector_push(cse->available, &available);
+}
+
+static void ircse_available_free(struct ircse_available* available)
+{
+    if (available->from_store)
+    {
+        arena_free(available->instruction);
+    }
+    arena_free(available);
+}
+
+static void ircse_clear(struct ircse* cse)
+{
+    for (int i = 0; i < vector_count(cse->available); i++)
+    {
+        ircse_available_free(vector_peek_ptr_at(cse->available, i));
+    }
+    vector_clear(cse->available);
+}
+
+// Could a store to store_location change what is loaded from load_location
+static bool ircse_may_alias(struct ircse* cse, struct ir_value* store_location, struct ir_value* load_location)
+{
+    bool store_private = ircse_is_local_private(cse, store_location);
+    bool load_private = ircse_is_local_private(cse, load_location);
+    if (store_private || load_private)
+    {
+        // Nobody has a pointer to these locals, only a store to the same local changes them
+        return store_location->type == load_location->type && store_location->local == load_location->local;
+    }
+
+    if (store_location->type == IR_VALUE_SYMBOL && load_location->type == IR_VALUE_SYMBOL)
+    {
+        return S_EQ(store_location->symbol, load_location->symbol);
+    }
+
+    if (store_location->type == IR_VALUE_LOCAL && load_location->type == IR_VALUE_LOCAL)
+    {
+        return store_location->local == load_location->local;
+    }
+
+    // Global variables and locals are different objects, a store to one never changes the other
+    if ((store_location->type == IR_VALUE_SYMBOL && load_location->type == IR_VALUE_LOCAL) || (store_location->type == IR_VALUE_LOCAL && load_location->type == IR_VALUE_SYMBOL))
+    {
+        return false;
+    }
+
+    // One of them goes through a pointer
+    return true;
+}
+
+// Forgets the loads the memory change could affect, location NULL means any memory other than private locals (a call)
+static void ircse_invalidate_loads(struct ircse* cse, struct ir_value* location)
+{
+    struct vector* still_available = vector_create(sizeof(struct ircse_available*));
+    for (int i = 0; i < vector_count(cse->available); i++)
+    {
+        struct ircse_available* available = vector_peek_ptr_at(cse->available, i);
+        struct ir_value* load_location = &available->instruction->a;
+        bool invalidate = available->instruction->op == IR_OP_LOAD && (location ? ircse_may_alias(cse, location, load_location) : !ircse_is_local_private(cse, load_location));
+        if (invalidate)
+        {
+            ircse_available_free(available);
+            continue;
+        }
+        vector_push(still_available, &available);
+    }
+    vector_free(cse->available);
+    cse->available = still_available;
+}
+
+static long long ircse_truncate(long long value, int type)
+{
+    if (ir_type_is_signed(type))
+    {
+        return (int)value;
+    }
+    return (unsigned int)value;
+}
+
+// 5 * 4 -> 20, the result is wrapped just like the 32 bit register would wrap it
+static bool ircse_fold_constant(struct ir_instruction* instruction, long long* value_out)
+{
+    if (instruction->a.type != IR_VALUE_CONSTANT || ((ir_op_is_binary(instruction->op) || ir_op_is_comparison(instruction->op)) && instruction->b.type != IR_VALUE_CONSTANT))
+    {
+        return false;
+    }
+
+    int type = instruction->type;
+    long long a = ircse_truncate(instruction->a.constant, type);
+    long long b = ircse_truncate(instruction->b.constant, type);
+    long long result = 0;
+    switch (instruction->op)
+    {
+    case IR_OP_ADD:
+        result = a + b;
+        break;
+    case IR_OP_SUB:
+        result = a - b;
+        break;
+    case IR_OP_MUL:
+        result = a * b;
+        break;
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        if (b == 0)
+        {
+            return false;
+        }
+        result = instruction->op == IR_OP_DIV ? a / b : a % b;
+        break;
+    case IR_OP_AND:
+        result = a & b;
+        break;
+    case IR_OP_OR:
+        result = a | b;
+        break;
+    case IR_OP_XOR:
+        result = a ^ b;
+        break;
+    case IR_OP_SHL:
+        result = a << (b & 31);
+        break;
+    case IR_OP_SHR:
+        result = a >> (b & 31);
+        break;
+    case IR_OP_NEG:
+        result = -a;
+        break;
+    case IR_OP_NOT:
+        result = ~a;
+        break;
+    case IR_OP_EQ:
+        *value_out = a == b;
+        return true;
+    case IR_OP_NE:
+        *value_out = a != b;
+        return true;
+    case IR_OP_LT:
+        *value_out = a < b;
+        return true;
+    case IR_OP_LE:
+        *value_out = a <= b;
+        return true;
+    case IR_OP_GT:
+        *value_out = a > b;
+        return true;
+    case IR_OP_GE:
+        *value_out = a >= b;
+        return true;
+    default:
+        return false;
+    }
+    *value_out = ircse_truncate(result, type == IR_TYPE_PTR ? IR_TYPE_U32 : type);
+    return true;
+}
+
+// Returns true if the instruction is redundant and can be removed
+static bool ircse_number_instruction(struct ircse* cse, struct ir_instruction* instruction)
+{
+    ir_instruction_for_each_operand(instruction, ircse_replace_operand, cse);
+
+    if (instruction->op == IR_OP_STORE)
+    {
+        ircse_invalidate_loads(cse, &instruction->a);
+        // Smaller stores truncate the value, the load would have to extend it again
+        bool full_register = ir_type_size(instruction->type) == ir_type_size(IR_TYPE_I32);
+        if (full_register && ircse_operand_is_stable(cse, &instruction->b) && ircse_operand_is_stable(cse, &instruction->a))
+        {
+            // The stored value can be used by the next load of the same location
+            struct ir_instruction* load = ir_instruction_new(IR_OP_LOAD, instruction->type);
+            load->a = instruction->a;
+            ircse_add_available(cse, load, instruction->b, true);
+        }
+        return false;
+    }
+
+    if (instruction->op == IR_OP_ZERO)
+    {
+        ircse_invalidate_loads(cse, &instruction->a);
+        return false;
+    }
+
+    if (instruction->op == IR_OP_CALL)
+    {
+        ircse_invalidate_loads(cse, NULL);
+        return false;
+    }
+
+    if (!ircse_can_number(instruction->op) || instruction->dst.type != IR_VALUE_VREG || cse->definition_counts[instruction->dst.vreg] != 1)
+    {
+        return false;
+    }
+
+    long long constant = 0;
+    if (ircse_fold_constant(instruction, &constant))
+    {
+        cse->replacements[instruction->dst.vreg] = ir_value_constant(constant);
+        return true;
+    }
+
+    if (!ircse_operand_is_stable(cse, &instruction->a) || !ircse_operand_is_stable(cse, &instruction->b))
+    {
+        return false;
+    }
+
+    struct ircse_available* available = ircse_find(cse, instruction);
+    if (available)
+    {
+        cse->replacements[instruction->dst.vreg] = available->value;
+        return true;
+    }
+
+    ircse_add_available(cse, instruction, instruction->dst, false);
+    return false;
+}
+
+static void ircse_block(struct ircse* cse, struct ir_block* block)
+{
+    ircse_clear(cse);
+    struct vector* instructions = vector_create(sizeof(struct ir_instruction*));
+    for (int i = 0; i < vector_count(block->instructions); i++)
+    {
+        struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, i);
+        if (!ircse_number_instruction(cse, instruction))
+        {
+            vector_push(instructions, &instruction);
+        }
+    }
+    vector_free(block->instructions);
+    block->instructions = instructions;
+}
+
+void ir_eliminate_common_subexpressions(struct ir_function* function)
+{
+    struct ircse cse = {};
+    cse.function = function;
+    cse.definition_counts = ir_function_definition_counts(function);
+    cse.replacements = arena_calloc(function->vreg_count + 1, sizeof(struct ir_value));
+    cse.available = vector_create(sizeof(struct ircse_available*));
+
+    for (int i = 0; i < vector_count(function->blocks); i++)
+    {
+        ircse_block(&cse, vector_peek_ptr_at(function->blocks, i));
+    }
+
+    // Registers defined in one block can be used in the blocks after it
+    for (int i = 0; i < vector_count(function->blocks); i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(function->blocks, i);
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            ir_instruction_for_each_operand(vector_peek_ptr_at(block->instructions, j), ircse_replace_operand, &cse);
+        }
+    }
+
+    ircse_clear(&cse);
+    vector_free(cse.available);
+    arena_free(cse.replacements);
+    arena_free(cse.definition_counts);
+}
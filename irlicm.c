@@ -0,0 +1,531 @@
+#include "compiler.h"
+#include "helpers/vector.h"
+#include <stdlib.h>
+
+/*
+ * Loop invariant code motion, computations inside a loop that give the same result on every iteration
+ * are moved into a new block that runs once before the loop
+ *
+ * for (i = 0; i < n * 4; i++)              loop.preheader:
+ * {                                            %1 = load.i32 $n
+ *     a[i] = ...                               %2 = mul.i32 %1, 4
+ * }                                            %3 = addr.ptr $a
+ *                                          for.cond:
+ *                                              %4 = load.i32 $i
+ *                                              %5 = lt.i32 %4, %2
+ *                                              ...
+ *
+ * Loops are found from the back edges of the control flow graph, so while, do while, for and goto loops are all handled
+ */
+
+struct irlicm
+{
+    struct ir_function* function;
+
+    // Vector of struct ir_block* for every block id, the blocks that jump to it
+    struct vector** predecessors;
+
+    // dominators[block->id][other->id] is true when every path from the entry to block goes through other
+    bool** dominators;
+
+    // The block every single defined virtual register is defined in, NULL for registers defined more than once
+    struct ir_block** definition_blocks;
+    int* definition_counts;
+
+    // How many block ids the analysis was made for, the preheaders get new ids
+    int analyzed_block_count;
+
+    // Block ids of the loops that already got a preheader
+    bool* processed_headers;
+    int processed_headers_count;
+};
+
+struct irlicm_loop
+{
+    struct ir_block* header;
+
+    // in_loop[block->id] is true for every block of the loop
+    bool* in_loop;
+    int size;
+};
+
+static struct ir_block* irlicm_block_by_index(struct irlicm* licm, int index)
+{
+    return vector_peek_ptr_at(licm->function->blocks, index);
+}
+
+static int irlicm_block_count(struct irlicm* licm)
+{
+    return vector_count(licm->function->blocks);
+}
+
+static void irlicm_free_analysis(struct irlicm* licm)
+{
+    for (int i = 0; i < licm->analyzed_block_count; i++)
+    {
+        if (licm->predecessors && licm->predecessors[i])
+        {
+            vector_free(licm->predecessors[i]);
+        }
+        if (licm->dominators)
+        {
+            arena_free(licm->dominators[i]);
+        }
+    }
+    arena_free(licm->predecessors);
+    arena_free(licm->dominators);
+    arena_free(licm->definition_blocks);
+    arena_free(licm->definition_counts);
+    licm->predecessors = NULL;
+    licm->dominators = NULL;
+    licm->definition_blocks = NULL;
+    licm->definition_counts = NULL;
+}
+
+static void irlicm_compute_predecessors(struct irlicm* licm)
+{
+    int total_ids = licm->function->block_count;
+    licm->predecessors = arena_calloc(total_ids, sizeof(struct vector*));
+    for (int i = 0; i < total_ids; i++)
+    {
+        licm->predecessors[i] = vector_create(sizeof(struct ir_block*));
+    }
+
+    for (int i = 0; i < irlicm_block_count(licm); i++)
+    {
+        struct ir_block* block = irlicm_block_by_index(licm, i);
+        struct ir_block* successors[2];
+        int total_successors = ir_block_successors(block, successors);
+        for (int j = 0; j < total_successors; j++)
+        {
+            vector_push(licm->predecessors[successors[j]->id], &block);
+        }
+    }
+}
+
+// The simple iterative algorithm, functions are small enough that it settles after a few rounds
+static void irlicm_compute_dominators(struct irlicm* licm)
+{
+    int total_ids = licm->function->block_count;
+    struct ir_block* entry = irlicm_block_by_index(licm, 0);
+    licm->dominators = arena_calloc(total_ids, sizeof(bool*));
+    for (int i = 0; i < total_ids; i++)
+    {
+        licm->dominators[i] = arena_calloc(total_ids, sizeof(bool));
+    }
+
+    for (int i = 0; i < irlicm_block_count(licm); i++)
+    {
+        struct ir_block* block = irlicm_block_by_index(licm, i);
+        for (int j = 0; j < irlicm_block_count(licm); j++)
+        {
+            struct ir_block* other = irlicm_block_by_index(licm, j);
+            licm->dominators[block->id][other->id] = block != entry || other == entry;
+        }
+    }
+
+    bool* new_dominators = arena_calloc(total_ids, sizeof(bool));
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 1; i < irlicm_block_count(licm); i++)
+        {
+            struct ir_block* block = irlicm_block_by_index(licm, i);
+            struct vector* predecessors = licm->predecessors[block->id];
+            for (int j = 0; j < irlicm_block_count(licm); j++)
+            {
+                struct ir_block* other = irlicm_block_by_index(licm, j);
+                bool dominates = vector_count(predecessors) > 0;
+                for (int k = 0; k < vector_count(predecessors) && dominates; k++)
+                {
+                    struct ir_block* predecessor = vector_peek_ptr_at(predecessors, k);
+                    dominates = licm->dominators[predecessor->id][other->id];
+                }
+                new_dominators[other->id] = dominates || other == block;
+            }
+
+            for (int j = 0; j < irlicm_block_count(licm); j++)
+            {
+                int id = irlicm_block_by_index(licm, j)->id;
+                if (licm->dominators[block->id][id] != new_dominators[id])
+                {
+                    licm->dominators[block->id][id] = new_dominators[id];
+                    changed = true;
+                }
+            }
+        }
+    }
+    arena_free(new_dominators);
+}
+
+static void irlicm_compute_definitions(struct irlicm* licm)
+{
+    licm->definition_counts = ir_function_definition_counts(licm->function);
+    licm->definition_blocks = arena_calloc(licm->function->vreg_count + 1, sizeof(struct ir_block*));
+    for (int i = 0; i < irlicm_block_count(licm); i++)
+    {
+        struct ir_block* block = irlicm_block_by_index(licm, i);
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, j);
+            if (instruction->dst.type == IR_VALUE_VREG && licm->definition_counts[instruction->dst.vreg] == 1)
+            {
+                licm->definition_blocks[instruction->dst.vreg] = block;
+            }
+        }
+    }
+}
+
+static void irlicm_analyze(struct irlicm* licm)
+{
+    licm->analyzed_block_count = licm->function->block_count;
+    licm->processed_headers = arena_realloc(licm->processed_headers, licm->analyzed_block_count * sizeof(bool));
+    for (int i = licm->processed_headers_count; i < licm->analyzed_block_count; i++)
+    {
+        licm->processed_headers[i] = false;
+    }
+    licm->processed_headers_count = licm->analyzed_block_count;
+
+    irlicm_compute_predecessors(licm);
+    irlicm_compute_dominators(licm);
+    irlicm_compute_definitions(licm);
+}
+
+// The natural loop of the back edge tail -> header, everything that reaches the tail without going through the header
+static void irlicm_add_natural_loop(struct irlicm* licm, struct irlicm_loop* loop, struct ir_block* tail)
+{
+    struct vector* worklist = vector_create(sizeof(struct ir_block*));
+    if (!loop->in_loop[tail->id])
+    {
+        loop->in_loop[tail->id] = true;
+        loop->size++;
+        vector_push(worklist, &tail);
+    }
+
+    while (!vector_empty(worklist))
+    {
+        struct ir_block* block = vector_back_ptr(worklist);
+        vector_pop(worklist);
+        struct vector* predecessors = licm->predecessors[block->id];
+        for (int i = 0; i < vector_count(predecessors); i++)
+        {
+            struct ir_block* predecessor = vector_peek_ptr_at(predecessors, i);
+            if (!loop->in_loop[predecessor->id])
+            {
+                loop->in_loop[predecessor->id] = true;
+                loop->size++;
+                vector_push(worklist, &predecessor);
+            }
+        }
+    }
+    vector_free(worklist);
+}
+
+// Builds the loop with the given header, returns false if no back edge goes to the block
+static bool irlicm_loop_for_header(struct irlicm* licm, struct ir_block* header, struct irlicm_loop* loop_out)
+{
+    loop_out->header = header;
+    // One more for the preheader, it is never part of the loop
+    loop_out->in_loop = arena_calloc(licm->function->block_count + 1, sizeof(bool));
+    loop_out->in_loop[header->id] = true;
+    loop_out->size = 1;
+
+    bool has_back_edge = false;
+    struct vector* predecessors = licm->predecessors[header->id];
+    for (int i = 0; i < vector_count(predecessors); i++)
+    {
+        struct ir_block* predecessor = vector_peek_ptr_at(predecessors, i);
+        if (licm->dominators[predecessor->id][header->id])
+        {
+            has_back_edge = true;
+            irlicm_add_natural_loop(licm, loop_out, predecessor);
+        }
+    }
+
+    if (!has_back_edge)
+    {
+        arena_free(loop_out->in_loop);
+    }
+    return has_back_edge;
+}
+
+// The innermost loop that doesn't have a preheader yet, inner loops come first so their invariants can move out of the outer loop too
+static bool irlicm_next_loop(struct irlicm* licm, struct irlicm_loop* loop_out)
+{
+    bool found = false;
+    for (int i = 0; i < irlicm_block_count(licm); i++)
+    {
+        struct ir_block* block = irlicm_block_by_index(licm, i);
+        struct irlicm_loop loop;
+        if (licm->processed_headers[block->id] || !irlicm_loop_for_header(licm, block, &loop))
+        {
+            continue;
+        }
+
+        if (found && loop.size >= loop_out->size)
+        {
+            arena_free(loop.in_loop);
+            continue;
+        }
+
+        if (found)
+        {
+            arena_free(loop_out->in_loop);
+        }
+        *loop_out = loop;
+        found = true;
+    }
+    return found;
+}
+
+static void irlicm_redirect(struct ir_instruction* terminator, struct ir_block* from, struct ir_block* to)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (terminator->targets[i] == from)
+        {
+            terminator->targets[i] = to;
+        }
+    }
+}
+
+// Creates the block that runs once before the loop, every jump into the loop from outside goes through it
+static struct ir_block* irlicm_create_preheader(struct irlicm* licm, struct irlicm_loop* loop)
+{
+    struct ir_function* function = licm->function;
+    struct vector* predecessors = licm->predecessors[loop->header->id];
+    struct vector* outside_predecessors = vector_create(sizeof(struct ir_block*));
+    for (int i = 0; i < vector_count(predecessors); i++)
+    {
+        struct ir_block* predecessor = vector_peek_ptr_at(predecessors, i);
+        if (!loop->in_loop[predecessor->id])
+        {
+            vector_push(outside_predecessors, &predecessor);
+        }
+    }
+
+    // ir_block_new adds the block to the end, it is placed right before the header so it just falls into it
+    struct ir_block* preheader = ir_block_new(function, "loop.preheader");
+    struct vector* blocks = vector_create(sizeof(struct ir_block*));
+    for (int i = 0; i < vector_count(function->blocks) - 1; i++)
+    {
+        struct ir_block* block = vector_peek_ptr_at(function->blocks, i);
+        if (block == loop->header)
+        {
+            vector_push(blocks, &preheader);
+        }
+        vector_push(blocks, &block);
+    }
+    vector_free(function->blocks);
+    function->blocks = blocks;
+
+    struct ir_instruction* jump = ir_instruction_new(IR_OP_JUMP, IR_TYPE_VOID);
+    jump->targets[0] = loop->header;
+    ir_block_add_instruction(preheader, jump);
+
+    for (int i = 0; i < vector_count(outside_predecessors); i++)
+    {
+        struct ir_block* predecessor = vector_peek_ptr_at(outside_predecessors, i);
+        irlicm_redirect(ir_block_terminator(predecessor), loop->header, preheader);
+    }
+    vector_free(outside_predecessors);
+    return preheader;
+}
+
+// What the loop does to memory, decides which loads can be moved out of it
+struct irlicm_memory
+{
+    // A call or a store through a pointer, any global or address taken variable could change
+    bool writes_unknown_memory;
+
+    // Vector of struct ir_value* that are stored to inside the loop
+    struct vector* stored_locations;
+};
+
+static void irlicm_collect_memory(struct irlicm* licm, struct irlicm_loop* loop, struct irlicm_memory* memory)
+{
+    memory->writes_unknown_memory = false;
+    memory->stored_locations = vector_create(sizeof(struct ir_value*));
+    for (int i = 0; i < irlicm_block_count(licm); i++)
+    {
+        struct ir_block* block = irlicm_block_by_index(licm, i);
+        if (!loop->in_loop[block->id])
+        {
+            continue;
+        }
+
+        for (int j = 0; j < vector_count(block->instructions); j++)
+        {
+            struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, j);
+            if (instruction->op == IR_OP_CALL)
+            {
+                memory->writes_unknown_memory = true;
+            }
+            else if (instruction->op == IR_OP_STORE || instruction->op == IR_OP_ZERO)
+            {
+                struct ir_value* location = &instruction->a;
+                if (location->type != IR_VALUE_LOCAL && location->type != IR_VALUE_SYMBOL)
+                {
+                    memory->writes_unknown_memory = true;
+                }
+                vector_push(memory->stored_locations, &location);
+            }
+        }
+    }
+}
+
+static bool irlicm_is_local_private(struct irlicm* licm, struct ir_value* location)
+{
+    return location->type == IR_VALUE_LOCAL && !(ir_function_local(licm->function, location->local)->flags & IR_LOCAL_FLAG_ADDRESS_TAKEN);
+}
+
+// Only loads of variables are moved, a load through a pointer could fault if the loop never runs
+static bool irlicm_is_load_invariant(struct irlicm* licm, struct irlicm_memory* memory, struct ir_value* location)
+{
+    bool is_private = irlicm_is_local_private(licm, location);
+    if (!is_private && ((location->type != IR_VALUE_LOCAL && location->type != IR_VALUE_SYMBOL) || memory->writes_unknown_memory))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < vector_count(memory->stored_locations); i++)
+    {
+        struct ir_value* stored = vector_peek_ptr_at(memory->stored_locations, i);
+        if (stored->type != location->type)
+        {
+            continue;
+        }
+
+        bool same_variable = location->type == IR_VALUE_LOCAL ? stored->local == location->local : S_EQ(stored->symbol, location->symbol);
+        if (same_variable)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool irlicm_is_operand_invariant(struct irlicm* licm, struct irlicm_loop* loop, struct ir_value* value)
+{
+    if (value->type != IR_VALUE_VREG)
+    {
+        return true;
+    }
+
+    struct ir_block* definition_block = licm->definition_blocks[value->vreg];
+    return definition_block && !loop->in_loop[definition_block->id];
+}
+
+// Comparisons are left alone, they are fused with the branch that uses them
+static bool irlicm_can_move(struct irlicm* licm, struct irlicm_loop* loop, struct irlicm_memory* memory, struct ir_instruction* instruction)
+{
+    if (instruction->dst.type != IR_VALUE_VREG || licm->definition_counts[instruction->dst.vreg] != 1)
+    {
+        return false;
+    }
+
+    if (!irlicm_is_operand_invariant(licm, loop, &instruction->a) || !irlicm_is_operand_invariant(licm, loop, &instruction->b))
+    {
+        return false;
+    }
+
+    bool can_move = false;
+    switch (instruction->op)
+    {
+    case IR_OP_ADDRESS:
+    case IR_OP_ADD:
+    case IR_OP_SUB:
+    case IR_OP_MUL:
+    case IR_OP_AND:
+    case IR_OP_OR:
+    case IR_OP_XOR:
+    case IR_OP_SHL:
+    case IR_OP_SHR:
+    case IR_OP_NEG:
+    case IR_OP_NOT:
+    case IR_OP_CONVERT:
+        can_move = true;
+        break;
+
+    case IR_OP_DIV:
+    case IR_OP_MOD:
+        // Dividing by zero or -1 can trap, the loop might not have done it at all
+        can_move = instruction->b.type == IR_VALUE_CONSTANT && instruction->b.constant != 0 && instruction->b.constant != -1;
+        break;
+
+    case IR_OP_LOAD:
+        can_move = irlicm_is_load_invariant(licm, memory, &instruction->a);
+        break;
+    }
+    return can_move;
+}
+
+static void irlicm_hoist_loop(struct irlicm* licm, struct irlicm_loop* loop)
+{
+    struct ir_block* preheader = irlicm_create_preheader(licm, loop);
+    struct ir_instruction* jump = vector_back_ptr(preheader->instructions);
+    vector_pop(preheader->instructions);
+
+    struct irlicm_memory memory;
+    irlicm_collect_memory(licm, loop, &memory);
+
+    // Moving one instruction can make the ones using it invariant, repeat until nothing moves
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < irlicm_block_count(licm); i++)
+        {
+            struct ir_block* block = irlicm_block_by_index(licm, i);
+            if (block == preheader || !loop->in_loop[block->id])
+            {
+                continue;
+            }
+
+            struct vector* instructions = vector_create(sizeof(struct ir_instruction*));
+            for (int j = 0; j < vector_count(block->instructions); j++)
+            {
+                struct ir_instruction* instruction = vector_peek_ptr_at(block->instructions, j);
+                if (irlicm_can_move(licm, loop, &memory, instruction))
+                {
+                    ir_block_add_instruction(preheader, instruction);
+                    licm->definition_blocks[instruction->dst.vreg] = preheader;
+                    changed = true;
+                    continue;
+                }
+                vector_push(instructions, &instruction);
+            }
+            vector_free(block->instructions);
+            block->instructions = instructions;
+        }
+    }
+
+    ir_block_add_instruction(preheader, jump);
+    vector_free(memory.stored_locations);
+}
+
+void ir_hoist_loop_invariants(struct ir_function* function)
+{
+    struct irlicm licm = {};
+    licm.function = function;
+
+    // Every preheader changes the control flow graph, the analysis is redone for the next loop
+    while (true)
+    {
+        irlicm_analyze(&licm);
+        struct irlicm_loop loop;
+        if (!irlicm_next_loop(&licm, &loop))
+        {
+            break;
+        }
+
+        licm.processed_headers[loop.header->id] = true;
+
+        irlicm_hoist_loop(&licm, &loop);
+        arena_free(loop.in_loop);
+        irlicm_free_analysis(&licm);
+    }
+    irlicm_free_analysis(&licm);
+    arena_free(licm.processed_headers);
+}
@@ -0,0 +1,746 @@
+#define _GNU_SOURCE
+#include "compiler.h"
+#include "helpers/vector.h"
+#include "helpers/buffer.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+/*
+ * exec-jit, the program is run inside the compiler instead of being written to a file
+ *
+ * The integrated assembler encodes the generated assembly, the sections are copied into memory we map ourselves,
+ * relocations are applied with the real addresses and main is called like any other C function
+ *
+ * | .text (read + execute) | .rodata .data .bss (read + write) |
+ *
+ * Only the native functions below can be called from the program, a 32 bit compiler looks them up with dlsym,
+ * a 64 bit compiler runs the program in compatibility mode and answers the calls itself (see the compat part below)
+ */
+
+enum
+{
+    JIT_NATIVE_PRINTF,
+    JIT_NATIVE_PUTS,
+    JIT_NATIVE_PUTCHAR,
+    JIT_NATIVE_MALLOC,
+    JIT_NATIVE_CALLOC,
+    JIT_NATIVE_REALLOC,
+    JIT_NATIVE_FREE,
+    JIT_NATIVE_MEMCPY,
+    JIT_NATIVE_MEMSET,
+    JIT_NATIVE_MEMCMP,
+    JIT_NATIVE_STRLEN,
+    JIT_NATIVE_STRCMP,
+    JIT_NATIVE_STRCPY,
+    JIT_NATIVE_STRNCMP,
+    JIT_NATIVE_ABS,
+    JIT_NATIVE_ATOI,
+    JIT_NATIVE_EXIT,
+    JIT_NATIVE_ABORT,
+    JIT_TOTAL_NATIVE_FUNCTIONS
+};
+
+static const char* jit_native_functions[] = {
+    [JIT_NATIVE_PRINTF] = "printf",
+    [JIT_NATIVE_PUTS] = "puts",
+    [JIT_NATIVE_PUTCHAR] = "putchar",
+    [JIT_NATIVE_MALLOC] = "malloc",
+    [JIT_NATIVE_CALLOC] = "calloc",
+    [JIT_NATIVE_REALLOC] = "realloc",
+    [JIT_NATIVE_FREE] = "free",
+    [JIT_NATIVE_MEMCPY] = "memcpy",
+    [JIT_NATIVE_MEMSET] = "memset",
+    [JIT_NATIVE_MEMCMP] = "memcmp",
+    [JIT_NATIVE_STRLEN] = "strlen",
+    [JIT_NATIVE_STRCMP] = "strcmp",
+    [JIT_NATIVE_STRCPY] = "strcpy",
+    [JIT_NATIVE_STRNCMP] = "strncmp",
+    [JIT_NATIVE_ABS] = "abs",
+    [JIT_NATIVE_ATOI] = "atoi",
+    [JIT_NATIVE_EXIT] = "exit",
+    [JIT_NATIVE_ABORT] = "abort",
+    [JIT_TOTAL_NATIVE_FUNCTIONS] = NULL
+};
+
+// Registers the whitelisted functions as SYMBOL_TYPE_NATIVE_FUNCTION, the parser marks their prototypes as native
+void jit_register_native_functions(struct compiler_process* process)
+{
+    for (int i = 0; jit_native_functions[i]; i++)
+    {
+        symresolver_register_symbol(process, jit_native_functions[i], SYMBOL_TYPE_NATIVE_FUNCTION, NULL);
+    }
+}
+
+static size_t jit_align(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct jit_image
+{
+    char* memory;
+    size_t size;
+    // Size of the executable part at the start of the memory
+    size_t text_size;
+
+    // Where every section of the assembler was placed
+    char* sections[ASSEMBLER_TOTAL_SECTIONS];
+
+    // Compatibility mode only, the switch code and a 32 bit stub for every native function
+    char* compat_code;
+    size_t compat_size;
+};
+
+#if defined(__x86_64__)
+/*
+ * Running the 32 bit program from the 64 bit compiler
+ *
+ * Linux gives every 64 bit process a 32 bit code segment (selector 0x23) next to the 64 bit one (0x33),
+ * a far jump to 0x23 puts the CPU into compatibility mode and the generated code runs as it would in a 32 bit process
+ *
+ *  jit_execute --> entry64 --retfq 0x23--> enter32: call main --ljmp 0x33--> leave64 --> back in C
+ *
+ * Everything the program can see has to be below 4GB, the image, the stack and the heap are mapped with MAP_32BIT
+ *
+ * A native call can't go to libc directly, libc is 64 bit code and expects its arguments in registers,
+ * every native function gets a 32 bit stub instead, the stub pushes the index of the function and jumps back to 64 bit mode
+ *
+ *  call printf --> stub: push index, ljmp 0x33 --> native64 --> jit_compat_dispatch(frame) --retfq 0x23--> after the call
+ *
+ *  frame: | index | return address | argument 1 | argument 2 | ...
+ *
+ * jit_compat_dispatch reads the 32 bit arguments from the frame and calls the real function,
+ * malloc and friends are served from a heap below 4GB so the program can use the pointers
+ */
+
+#define JIT_COMPAT_STACK_SIZE (8 * 1024 * 1024)
+#define JIT_COMPAT_HEAP_SIZE (256 * 1024 * 1024)
+#define JIT_COMPAT_NATIVE_STUB_SIZE 12
+
+// Offsets into jit_compat_template
+#define JIT_COMPAT_ENTRY64 0x00
+#define JIT_COMPAT_SAVE_RSP_DISPLACEMENT 0x0d
+#define JIT_COMPAT_SAVE_RSP_END 0x11
+#define JIT_COMPAT_LEAVE64_ADDRESS 0x2b
+#define JIT_COMPAT_LEAVE64 0x31
+#define JIT_COMPAT_LOAD_RSP_DISPLACEMENT 0x34
+#define JIT_COMPAT_LOAD_RSP_END 0x38
+#define JIT_COMPAT_NATIVE64 0x43
+#define JIT_COMPAT_DISPATCH_ADDRESS 0x55
+#define JIT_COMPAT_NATIVE_STUBS 0x80
+
+static const unsigned char jit_compat_template[] = {
+    // entry64(main_address=edi, stack_top=esi), 64 bit
+    0x53,                                       // push rbx
+    0x55,                                       // push rbp
+    0x41, 0x54,                                 // push r12
+    0x41, 0x55,                                 // push r13
+    0x41, 0x56,                                 // push r14
+    0x41, 0x57,                                 // push r15
+    0x48, 0x89, 0x25, 0x00, 0x00, 0x00, 0x00,   // mov [rip+saved_rsp], rsp
+    0xb8, 0x2b, 0x00, 0x00, 0x00,               // mov eax, 0x2b
+    0x8e, 0xd8,                                 // mov ds, eax          the null selector of 64 bit mode faults in 32 bit mode
+    0x8e, 0xc0,                                 // mov es, eax
+    0x89, 0xf4,                                 // mov esp, esi         the stack below 4GB
+    0x6a, 0x23,                                 // push 0x23
+    0x48, 0x8d, 0x05, 0x03, 0x00, 0x00, 0x00,   // lea rax, [rip+enter32]
+    0x50,                                       // push rax
+    0x48, 0xcb,                                 // retfq
+    // enter32, 32 bit
+    0xff, 0xd7,                                 // call edi
+    0xea, 0x00, 0x00, 0x00, 0x00, 0x33, 0x00,   // ljmp 0x33:leave64    eax still holds the result of main
+    // leave64, 64 bit
+    0x48, 0x8b, 0x25, 0x00, 0x00, 0x00, 0x00,   // mov rsp, [rip+saved_rsp]
+    0x41, 0x5f,                                 // pop r15
+    0x41, 0x5e,                                 // pop r14
+    0x41, 0x5d,                                 // pop r13
+    0x41, 0x5c,                                 // pop r12
+    0x5d,                                       // pop rbp
+    0x5b,                                       // pop rbx
+    0xc3,                                       // ret
+    // native64, 64 bit, the stub left the index on the stack
+    0x89, 0xe4,                                 // mov esp, esp         the upper half isn't defined after the switch
+    0x56,                                       // push rsi             esi and edi belong to the 32 bit caller
+    0x57,                                       // push rdi
+    0x48, 0x8d, 0x7c, 0x24, 0x10,               // lea rdi, [rsp+16]    the frame
+    0x49, 0x89, 0xe4,                           // mov r12, rsp
+    0x48, 0x83, 0xe4, 0xf0,                     // and rsp, -16
+    0x48, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0,         // movabs rax, jit_compat_dispatch
+    0xff, 0xd0,                                 // call rax
+    0x4c, 0x89, 0xe4,                           // mov rsp, r12
+    0x5f,                                       // pop rdi
+    0x5e,                                       // pop rsi
+    0x44, 0x8b, 0x5c, 0x24, 0x04,               // mov r11d, [rsp+4]    the return address
+    0x48, 0x83, 0xc4, 0x08,                     // add rsp, 8           drop the index and the return address like ret would
+    0x6a, 0x23,                                 // push 0x23
+    0x41, 0x53,                                 // push r11
+    0x48, 0xcb,                                 // retfq
+};
+
+// Simple heap below 4GB, blocks are powers of two and a freed block goes to the free list of its size
+struct jit_compat_heap
+{
+    char* memory;
+    size_t used;
+    // Offset + 1 of the first free block of every size, 0 means empty
+    uint32_t free_lists[32];
+};
+
+struct jit_compat_block
+{
+    uint32_t size_class;
+    // Offset + 1 of the next free block while the block is free
+    uint32_t next_free;
+};
+
+// The dispatcher is called from machine code, it finds the heap of the program running on this thread here
+static _Thread_local struct jit_compat_heap* jit_compat_current_heap;
+
+#define JIT_POINTER(value) ((void*)(uintptr_t)(value))
+#define JIT_ADDRESS(pointer) ((uint32_t)(uintptr_t)(pointer))
+
+static void* jit_map_low(size_t size, int prot)
+{
+    void* memory = mmap(NULL, size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+static void* jit_compat_malloc(size_t size)
+{
+    struct jit_compat_heap* heap = jit_compat_current_heap;
+    uint32_t size_class = 4;
+    while (((size_t)1 << size_class) < size + sizeof(struct jit_compat_block))
+    {
+        size_class++;
+        if (size_class >= 31)
+        {
+            return NULL;
+        }
+    }
+
+    struct jit_compat_block* block = NULL;
+    if (heap->free_lists[size_class])
+    {
+        block = (struct jit_compat_block*)(heap->memory + heap->free_lists[size_class] - 1);
+        heap->free_lists[size_class] = block->next_free;
+    }
+    else
+    {
+        size_t block_size = (size_t)1 << size_class;
+        if (heap->used + block_size > JIT_COMPAT_HEAP_SIZE)
+        {
+            return NULL;
+        }
+        block = (struct jit_compat_block*)(heap->memory + heap->used);
+        heap->used += block_size;
+    }
+
+    block->size_class = size_class;
+    block->next_free = 0;
+    return block + 1;
+}
+
+static void jit_compat_free(void* pointer)
+{
+    if (!pointer)
+    {
+        return;
+    }
+
+    struct jit_compat_heap* heap = jit_compat_current_heap;
+    struct jit_compat_block* block = (struct jit_compat_block*)pointer - 1;
+    block->next_free = heap->free_lists[block->size_class];
+    heap->free_lists[block->size_class] = (uint32_t)((char*)block - heap->memory) + 1;
+}
+
+static void* jit_compat_realloc(void* pointer, size_t size)
+{
+    if (!pointer)
+    {
+        return jit_compat_malloc(size);
+    }
+
+    struct jit_compat_block* block = (struct jit_compat_block*)pointer - 1;
+    size_t old_size = ((size_t)1 << block->size_class) - sizeof(struct jit_compat_block);
+    if (size <= old_size)
+    {
+        return pointer;
+    }
+
+    void* new_pointer = jit_compat_malloc(size);
+    if (new_pointer)
+    {
+        memcpy(new_pointer, pointer, old_size);
+        jit_compat_free(pointer);
+    }
+    return new_pointer;
+}
+
+// Reads the next argument of a 32 bit variadic call, every argument takes at least 4 bytes
+static uint32_t* jit_compat_next_argument(uint32_t** args, size_t bytes, void* out)
+{
+    uint32_t* argument = *args;
+    memcpy(out, argument, bytes);
+    *args += (bytes + 3) / 4;
+    return argument;
+}
+
+/*
+ * printf with the arguments of a 32 bit caller
+ *
+ * The format is walked one conversion at a time, every argument is read with its 32 bit size
+ * and the conversion is printed with the 64 bit printf, e.g. %ld is a 4 byte long on the program side
+ */
+static int jit_compat_printf(const char* format, uint32_t* args)
+{
+    int total = 0;
+    const char* p = format;
+    while (*p)
+    {
+        if (*p != '%' || p[1] == '%')
+        {
+            putchar(*p);
+            total++;
+            p += *p == '%' ? 2 : 1;
+            continue;
+        }
+
+        // Flags, width and precision are copied, "*" is replaced by the value of its argument
+        char spec[64];
+        size_t length = 0;
+        spec[length++] = *p++;
+        while (*p && strchr("-+ #0123456789.*", *p) && length < sizeof(spec) - 24)
+        {
+            if (*p == '*')
+            {
+                int value = 0;
+                jit_compat_next_argument(&args, sizeof(value), &value);
+                length += snprintf(spec + length, sizeof(spec) - length, "%d", value);
+            }
+            else
+            {
+                spec[length++] = *p;
+            }
+            p++;
+        }
+
+        // Length modifiers, only long long and long double are wider than 4 bytes in a 32 bit program
+        int longs = 0;
+        const char* short_modifier = "";
+        bool long_double = false;
+        while (*p && strchr("hlLqjzt", *p))
+        {
+            if (*p == 'l' || *p == 'q')
+            {
+                longs += *p == 'q' ? 2 : 1;
+            }
+            else if (*p == 'h')
+            {
+                short_modifier = p[1] == 'h' ? "hh" : "h";
+            }
+            else if (*p == 'L')
+            {
+                long_double = true;
+            }
+            p++;
+        }
+
+        char conversion = *p;
+        if (!conversion)
+        {
+            break;
+        }
+        p++;
+
+        int written = 0;
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+        {
+            long long value = 0;
+            if (longs >= 2)
+            {
+                jit_compat_next_argument(&args, 8, &value);
+            }
+            else
+            {
+                int32_t small = 0;
+                jit_compat_next_argument(&args, 4, &small);
+                value = small;
+            }
+            snprintf(spec + length, sizeof(spec) - length, "%sll%c", longs >= 2 ? "" : short_modifier, conversion);
+            written = printf(spec, value);
+        }
+        break;
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        {
+            unsigned long long value = 0;
+            if (longs >= 2)
+            {
+                jit_compat_next_argument(&args, 8, &value);
+            }
+            else
+            {
+                uint32_t small = 0;
+                jit_compat_next_argument(&args, 4, &small);
+                value = small;
+            }
+            snprintf(spec + length, sizeof(spec) - length, "%sll%c", longs >= 2 ? "" : short_modifier, conversion);
+            written = printf(spec, value);
+        }
+        break;
+
+        case 'c':
+        {
+            int value = 0;
+            jit_compat_next_argument(&args, 4, &value);
+            snprintf(spec + length, sizeof(spec) - length, "c");
+            written = printf(spec, value);
+        }
+        break;
+
+        case 's':
+        case 'p':
+        {
+            uint32_t value = 0;
+            jit_compat_next_argument(&args, 4, &value);
+            snprintf(spec + length, sizeof(spec) - length, "%c", conversion);
+            written = printf(spec, JIT_POINTER(value));
+        }
+        break;
+
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if (long_double)
+            {
+                // Both sides use the 80 bit x87 format, the 32 bit one is only stored in 12 bytes
+                long double value = 0;
+                jit_compat_next_argument(&args, 12, &value);
+                snprintf(spec + length, sizeof(spec) - length, "L%c", conversion);
+                written = printf(spec, value);
+            }
+            else
+            {
+                double value = 0;
+                jit_compat_next_argument(&args, 8, &value);
+                snprintf(spec + length, sizeof(spec) - length, "%c", conversion);
+                written = printf(spec, value);
+            }
+            break;
+
+        case 'n':
+        {
+            uint32_t value = 0;
+            jit_compat_next_argument(&args, 4, &value);
+            *(int*)JIT_POINTER(value) = total;
+        }
+        break;
+
+        default:
+            // Unknown conversion, printed as it was written
+            spec[length] = 0;
+            written = printf("%s%c", spec, conversion);
+            break;
+        }
+
+        if (written < 0)
+        {
+            return written;
+        }
+        total += written;
+    }
+    return total;
+}
+
+// Called by native64 for every native call of the program, frame: | index | return address | arguments ...
+static uint32_t jit_compat_dispatch(uint32_t* frame)
+{
+    uint32_t* args = frame + 2;
+    switch (frame[0])
+    {
+    case JIT_NATIVE_PRINTF:
+        return jit_compat_printf(JIT_POINTER(args[0]), args + 1);
+    case JIT_NATIVE_PUTS:
+        return puts(JIT_POINTER(args[0]));
+    case JIT_NATIVE_PUTCHAR:
+        return putchar((int)args[0]);
+    case JIT_NATIVE_MALLOC:
+        return JIT_ADDRESS(jit_compat_malloc(args[0]));
+    case JIT_NATIVE_CALLOC:
+    {
+        size_t size = (size_t)args[0] * args[1];
+        void* pointer = jit_compat_malloc(size);
+        if (pointer)
+        {
+            memset(pointer, 0, size);
+        }
+        return JIT_ADDRESS(pointer);
+    }
+    case JIT_NATIVE_REALLOC:
+        return JIT_ADDRESS(jit_compat_realloc(JIT_POINTER(args[0]), args[1]));
+    case JIT_NATIVE_FREE:
+        jit_compat_free(JIT_POINTER(args[0]));
+        return 0;
+    case JIT_NATIVE_MEMCPY:
+        memcpy(JIT_POINTER(args[0]), JIT_POINTER(args[1]), args[2]);
+        return args[0];
+    case JIT_NATIVE_MEMSET:
+        memset(JIT_POINTER(args[0]), (int)args[1], args[2]);
+        return args[0];
+    case JIT_NATIVE_MEMCMP:
+        return memcmp(JIT_POINTER(args[0]), JIT_POINTER(args[1]), args[2]);
+    case JIT_NATIVE_STRLEN:
+        return strlen(JIT_POINTER(args[0]));
+    case JIT_NATIVE_STRCMP:
+        return strcmp(JIT_POINTER(args[0]), JIT_POINTER(args[1]));
+    case JIT_NATIVE_STRCPY:
+        strcpy(JIT_POINTER(args[0]), JIT_POINTER(args[1]));
+        return args[0];
+    case JIT_NATIVE_STRNCMP:
+        return strncmp(JIT_POINTER(args[0]), JIT_POINTER(args[1]), args[2]);
+    case JIT_NATIVE_ABS:
+        return abs((int)args[0]);
+    case JIT_NATIVE_ATOI:
+        return atoi(JIT_POINTER(args[0]));
+    case JIT_NATIVE_EXIT:
+        fflush(stdout);
+        exit((int)args[0]);
+    case JIT_NATIVE_ABORT:
+        abort();
+    }
+    return 0;
+}
+
+static void jit_patch32(char* at, uint32_t value)
+{
+    memcpy(at, &value, sizeof(value));
+}
+
+// Maps the switch code and the native stubs below 4GB, one page of code followed by one page for the saved stack pointer
+static void jit_compat_load(struct compiler_process* process, struct jit_image* image)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t code_size = jit_align(JIT_COMPAT_NATIVE_STUBS + JIT_TOTAL_NATIVE_FUNCTIONS * JIT_COMPAT_NATIVE_STUB_SIZE, page_size);
+    image->compat_size = code_size + page_size;
+    image->compat_code = jit_map_low(image->compat_size, PROT_READ | PROT_WRITE);
+    if (!image->compat_code)
+    {
+        compiler_error(process, "exec-jit: could not map the compatibility mode code below 4GB");
+    }
+
+    char* code = image->compat_code;
+    char* saved_rsp = code + code_size;
+    memcpy(code, jit_compat_template, sizeof(jit_compat_template));
+    jit_patch32(code + JIT_COMPAT_SAVE_RSP_DISPLACEMENT, (uint32_t)(saved_rsp - (code + JIT_COMPAT_SAVE_RSP_END)));
+    jit_patch32(code + JIT_COMPAT_LEAVE64_ADDRESS, JIT_ADDRESS(code + JIT_COMPAT_LEAVE64));
+    jit_patch32(code + JIT_COMPAT_LOAD_RSP_DISPLACEMENT, (uint32_t)(saved_rsp - (code + JIT_COMPAT_LOAD_RSP_END)));
+    uint64_t dispatch = (uint64_t)(uintptr_t)jit_compat_dispatch;
+    memcpy(code + JIT_COMPAT_DISPATCH_ADDRESS, &dispatch, sizeof(dispatch));
+
+    // push index, ljmp 0x33:native64
+    for (int i = 0; i < JIT_TOTAL_NATIVE_FUNCTIONS; i++)
+    {
+        char* stub = code + JIT_COMPAT_NATIVE_STUBS + i * JIT_COMPAT_NATIVE_STUB_SIZE;
+        stub[0] = 0x68;
+        jit_patch32(stub + 1, i);
+        stub[5] = 0xea;
+        jit_patch32(stub + 6, JIT_ADDRESS(code + JIT_COMPAT_NATIVE64));
+        stub[10] = 0x33;
+        stub[11] = 0x00;
+    }
+
+    if (mprotect(code, code_size, PROT_READ | PROT_EXEC) != 0)
+    {
+        compiler_error(process, "exec-jit: could not make the compatibility mode code executable");
+    }
+}
+
+// Calls main in compatibility mode on its own stack and heap below 4GB
+static int jit_compat_call_main(struct compiler_process* process, struct jit_image* image, char* main_address)
+{
+    struct jit_compat_heap heap = {};
+    char* stack = jit_map_low(JIT_COMPAT_STACK_SIZE, PROT_READ | PROT_WRITE);
+    heap.memory = jit_map_low(JIT_COMPAT_HEAP_SIZE, PROT_READ | PROT_WRITE);
+    if (!stack || !heap.memory)
+    {
+        compiler_error(process, "exec-jit: could not map the stack and the heap of the program below 4GB");
+    }
+
+    struct jit_compat_heap* previous_heap = jit_compat_current_heap;
+    jit_compat_current_heap = &heap;
+    int (*entry64)(uint32_t main_address, uint32_t stack_top) = (int (*)(uint32_t, uint32_t))(image->compat_code + JIT_COMPAT_ENTRY64);
+    int result = entry64(JIT_ADDRESS(main_address), JIT_ADDRESS(stack + JIT_COMPAT_STACK_SIZE - 16));
+    jit_compat_current_heap = previous_heap;
+
+    munmap(stack, JIT_COMPAT_STACK_SIZE);
+    munmap(heap.memory, JIT_COMPAT_HEAP_SIZE);
+    return result;
+}
+#endif
+
+static void* jit_native_address(struct compiler_process* process, struct jit_image* image, const char* name)
+{
+    if (!symresolver_get_symbol_for_native_function(process, name))
+    {
+        compiler_error(process, "exec-jit: \"%s\" is not defined and it isn't one of the allowed native functions", name);
+    }
+
+#if defined(__x86_64__)
+    // The program calls the 32 bit stub of the function
+    for (int i = 0; i < JIT_TOTAL_NATIVE_FUNCTIONS; i++)
+    {
+        if (S_EQ(jit_native_functions[i], name))
+        {
+            return image->compat_code + JIT_COMPAT_NATIVE_STUBS + i * JIT_COMPAT_NATIVE_STUB_SIZE;
+        }
+    }
+#endif
+
+    void* address = dlsym(RTLD_DEFAULT, name);
+    if (!address)
+    {
+        compiler_error(process, "exec-jit: native function \"%s\" not found: %s", name, dlerror());
+    }
+    return address;
+}
+
+static void jit_apply_relocations(struct compiler_process* process, struct jit_image* image, struct assembler* assembler, int section_index)
+{
+    struct assembler_section* section = &assembler->sections[section_index];
+    for (int i = 0; i < vector_count(section->relocations); i++)
+    {
+        struct assembler_relocation* relocation = vector_at(section->relocations, i);
+        struct assembler_symbol* symbol = relocation->symbol;
+        uintptr_t target = symbol->is_defined ? (uintptr_t)image->sections[symbol->section] + symbol->offset : (uintptr_t)jit_native_address(process, image, symbol->name);
+        target += relocation->addend;
+
+        char* field = image->sections[section_index] + relocation->offset;
+        if (relocation->type == ASSEMBLER_RELOCATION_RELATIVE)
+        {
+            // Distance from the end of the 4 byte field
+            target -= (uintptr_t)field + 4;
+        }
+
+        uint32_t value = (uint32_t)target;
+        memcpy(field, &value, sizeof(value));
+    }
+}
+
+static void jit_load(struct compiler_process* process, struct jit_image* image, struct assembler* assembler)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t offsets[ASSEMBLER_TOTAL_SECTIONS] = {};
+    image->text_size = jit_align(assembler->sections[ASSEMBLER_SECTION_TEXT].size, page_size);
+
+    // The writable sections start on their own page so the code can be made read only
+    size_t offset = image->text_size;
+    int data_sections[] = {ASSEMBLER_SECTION_RODATA, ASSEMBLER_SECTION_DATA, ASSEMBLER_SECTION_BSS};
+    for (int i = 0; i < 3; i++)
+    {
+        offset = jit_align(offset, 16);
+        offsets[data_sections[i]] = offset;
+        offset += assembler->sections[data_sections[i]].size;
+    }
+    image->size = jit_align(offset ? offset : 1, page_size);
+
+#if defined(__x86_64__)
+    // The program uses 32 bit addresses, the image has to be below 4GB
+    jit_compat_load(process, image);
+    image->memory = jit_map_low(image->size, PROT_READ | PROT_WRITE);
+#else
+    image->memory = mmap(NULL, image->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    image->memory = image->memory == MAP_FAILED ? NULL : image->memory;
+#endif
+    if (!image->memory)
+    {
+        compiler_error(process, "exec-jit: could not map %zu bytes for the program", image->size);
+    }
+
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        struct assembler_section* section = &assembler->sections[i];
+        image->sections[i] = image->memory + offsets[i];
+        // .bss is already zero, the mapping is anonymous
+        if (section->data)
+        {
+            memcpy(image->sections[i], buffer_ptr(section->data), section->size);
+        }
+    }
+
+    for (int i = 0; i < ASSEMBLER_TOTAL_SECTIONS; i++)
+    {
+        jit_apply_relocations(process, image, assembler, i);
+    }
+
+    if (image->text_size && mprotect(image->memory, image->text_size, PROT_READ | PROT_EXEC) != 0)
+    {
+        compiler_error(process, "exec-jit: could not make the code executable");
+    }
+}
+
+static struct assembler_symbol* jit_find_main(struct assembler* assembler)
+{
+    for (int i = 0; i < vector_count(assembler->symbols); i++)
+    {
+        struct assembler_symbol* symbol = vector_peek_ptr_at(assembler->symbols, i);
+        if (S_EQ(symbol->name, "main") && symbol->is_defined && symbol->section == ASSEMBLER_SECTION_TEXT)
+        {
+            return symbol;
+        }
+    }
+    return NULL;
+}
+
+// Encodes the assembly, loads it and calls main, the return value of main is written to exit_code_out
+int jit_execute(struct compiler_process* process, const char* assembly, int* exit_code_out)
+{
+#if !defined(__i386__) && !defined(__x86_64__)
+    // The generated code is 32 bit x86, it can only run on an x86 processor
+    compiler_error(process, "exec-jit runs 32 bit x86 code in the compiler process, the compiler has to run on x86");
+#endif
+
+    struct assembler* assembler = assembler_new(process);
+    int res = assembler_assemble_text(assembler, assembly);
+    if (res != ASSEMBLER_ALL_OK)
+    {
+        assembler_free(assembler);
+        return res;
+    }
+
+    struct assembler_symbol* main_symbol = jit_find_main(assembler);
+    if (!main_symbol)
+    {
+        compiler_error(process, "exec-jit: the program has no main function");
+    }
+
+    struct jit_image image = {};
+    jit_load(process, &image, assembler);
+    char* main_address = image.sections[ASSEMBLER_SECTION_TEXT] + main_symbol->offset;
+    assembler_free(assembler);
+
+#if defined(__x86_64__)
+    *exit_code_out = jit_compat_call_main(process, &image, main_address);
+    munmap(image.compat_code, image.compat_size);
+#else
+    int (*main_function)() = (int (*)())main_address;
+    *exit_code_out = main_function();
+#endif
+    // The program may have used printf, its output has to come out before anything the compiler writes
+    fflush(stdout);
+    munmap(image.memory, image.size);
+    return ASSEMBLER_ALL_OK;
+}
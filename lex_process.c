@@ -5,7 +5,7 @@
 
 struct lex_process* lex_process_create(struct compiler_process* compiler, struct lex_process_functions* functions, void* private)
 {
-    struct lex_process* process = calloc(1,sizeof(struct lex_process));
+    struct lex_process* process = arena_calloc(1,sizeof(struct lex_process));
     process->function = functions;
     process->token_vec = vector_create(sizeof(struct token));
     process->compiler = compiler;
@@ -20,7 +20,7 @@ struct lex_process* lex_process_create(struct compiler_process* compiler, struct
 void lex_process_free(struct lex_process* process)
 {
     vector_free(process->token_vec);
-    free(process);
+    arena_free(process);
 }
 
 void* lex_process_private(struct lex_process* process)
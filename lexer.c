@@ -3,7 +3,6 @@
 
 #include "helpers/buffer.h"
 #include <string.h>
-#include <assert.h>
 #include <ctype.h>
 
 // check the expression for every character than adds to buffer
@@ -16,8 +15,8 @@
     }
 char lex_get_escaped_char(char c);
 struct token *read_next_token();
-static struct lex_process *lex_process;
-static struct token tmp_token;
+// The file this thread is reading
+static _Thread_local struct lex_process *lex_process;
 bool lex_is_in_expression();
 static char peekc()
 {
@@ -50,7 +49,7 @@ static void pushc(char c)
 static char assert_next_char(char c)
 {
     char next_c = nextc();
-    assert(next_c == c);
+    compiler_assert(next_c == c);
     return next_c;
 }
 
@@ -61,14 +60,14 @@ static struct pos lex_file_position()
 
 struct token *token_create(struct token *_token)
 {
-    memcpy(&tmp_token, _token, sizeof(struct token));
-    tmp_token.pos = lex_file_position();
+    memcpy(&lex_process->tmp_token, _token, sizeof(struct token));
+    lex_process->tmp_token.pos = lex_file_position();
     if (lex_is_in_expression())
     {
-        tmp_token.between_brackets = buffer_ptr(lex_process->parenthesis_buffer);
+        lex_process->tmp_token.between_brackets = buffer_ptr(lex_process->parenthesis_buffer);
     }
 
-    return &tmp_token;
+    return &lex_process->tmp_token;
 }
 int lexer_number_type(char c)
 {
@@ -159,7 +158,7 @@ static void lex_handle_escape(struct buffer* buf)
 static struct token *token_make_string(char start_delim, char end_delim)
 {
     struct buffer *buf = buffer_create();
-    assert(nextc() == start_delim);
+    compiler_assert(nextc() == start_delim);
     char c = nextc();
     for (; c != end_delim && c != EOF; c = nextc())
     {
@@ -368,6 +367,7 @@ static struct token *token_make_symbol()
         lex_finish_expression();
     }
     struct token *token = token_create(&(struct token){.type = TOKEN_TYPE_SYMBOL, .cval = c});
+    return token;
 }
 
 static struct token *token_make_identifier_or_keyword()
@@ -1,8 +1,86 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include "helpers/vector.h"
 #include "compiler.h"
+
+// -fcache, -fcache-dir=DIR, -fcache-max-size=MB, *use_cache is set when any of them is given
+static bool main_parse_cache_flag(const char* arg, struct compiler_cache* cache, bool* use_cache)
+{
+    if (S_EQ(arg,"-fcache"))
+    {
+        // The default directory and size
+    }
+    else if (strncmp(arg,"-fcache-dir=",12) == 0)
+    {
+        cache->directory = arg + 12;
+    }
+    else if (strncmp(arg,"-fcache-max-size=",17) == 0)
+    {
+        cache->max_size = strtoull(arg + 17,NULL,10) * 1024 * 1024;
+    }
+    else
+    {
+        return false;
+    }
+    *use_cache = true;
+    return true;
+}
+
+// ./main -o program a.c b.c c.c [-j4] [flags], the files are compiled at the same time and linked into one program
+static int main_compile_files(int argc, char** argv)
+{
+    const char* output_file = argv[2];
+    const char** input_files = calloc(argc, sizeof(const char*));
+    int total_input_files = 0;
+    int compile_flags = COMPILE_PROCESS_EXECUTE_NASM;
+    int jobs = 0;
+    struct compiler_cache cache = {.directory = compiler_cache_default_directory(), .max_size = COMPILER_CACHE_DEFAULT_MAX_SIZE};
+    bool use_cache = false;
+    for (int i = 3; i < argc; i++)
+    {
+        if (compile_flag_parse(argv[i],&compile_flags) || main_parse_cache_flag(argv[i],&cache,&use_cache))
+        {
+            continue;
+        }
+        if (strncmp(argv[i],"-j",2) == 0)
+        {
+            jobs = atoi(argv[i] + 2);
+        }
+        else if (argv[i][0] == '-')
+        {
+            printf("Unknown flag %s\n", argv[i]);
+            return -1;
+        }
+        else
+        {
+            input_files[total_input_files++] = argv[i];
+        }
+    }
+
+    if (!total_input_files)
+    {
+        printf("No input files\n");
+        return -1;
+    }
+
+    int res = compile_files(input_files,total_input_files,output_file,compile_flags,jobs,use_cache ? &cache : NULL);
+    free(input_files);
+    printf(res == COMPILER_FILE_COMPILED_OK ? "FINE\n" : "ERRORS\n");
+    return res == COMPILER_FILE_COMPILED_OK ? 0 : -1;
+}
+
 int main(int argc, char** argv)
 {
+    // ./main -fserver [socket], ./client sends its compilations to it
+    if (argc > 1 && S_EQ(argv[1],"-fserver"))
+    {
+        return compile_server_run(argc > 2 ? argv[2] : compile_server_default_socket());
+    }
+    if (argc > 2 && S_EQ(argv[1],"-o"))
+    {
+        return main_compile_files(argc,argv);
+    }
+
     const char* input_file = "./test.c";
     const char* output_file = "./test1";
     const char* option = "exec";
@@ -14,16 +92,44 @@ int main(int argc, char** argv)
     {
         output_file = argv[2];
     }
-    if (argc > 3)
+    // ./main script.c exec-jit, there is no output file to name
+    if (argc > 2 && S_EQ(argv[2],"exec-jit"))
     {
-        option = argv[3];
+        option = argv[2];
     }
     int compile_flags = COMPILE_PROCESS_EXECUTE_NASM;
+    struct compiler_cache cache = {.directory = compiler_cache_default_directory(), .max_size = COMPILER_CACHE_DEFAULT_MAX_SIZE};
+    bool use_cache = false;
+    for (int i = 3; i < argc; i++)
+    {
+        // Flags start with a dash, anything else is the option
+        if (compile_flag_parse(argv[i],&compile_flags) || main_parse_cache_flag(argv[i],&cache,&use_cache))
+        {
+            continue;
+        }
+        if (argv[i][0] == '-')
+        {
+            printf("Unknown flag %s\n", argv[i]);
+            return -1;
+        }
+        option = argv[i];
+    }
     if (S_EQ(option,"object"))
     {
         compile_flags |= COMPILE_PROCESS_EXPORT_AS_OBJECT;
     }
-    int res = compile_file(input_file,output_file,compile_flags);
+    if (S_EQ(option,"exec-jit"))
+    {
+        // The program runs inside the compiler, its main decides the exit code
+        int exit_code = 0;
+        if (compile_file_exec_jit(input_file,compile_flags,&exit_code) != COMPILER_FILE_COMPILED_OK)
+        {
+            printf("ERRORS\n");
+            return -1;
+        }
+        return exit_code;
+    }
+    int res = compile_file_cached(use_cache ? &cache : NULL,input_file,output_file,compile_flags);
 
     if (res == COMPILER_FILE_COMPILED_OK)
     {
@@ -1,43 +1,38 @@
 #include "compiler.h"
-#include <assert.h>
 #include "helpers/vector.h"
 
-struct vector* node_vector = NULL;
-struct vector* node_vector_root = NULL;
+// The compilation the nodes are created for, every thread compiles its own file
+static _Thread_local struct compiler_process* node_process = NULL;
 
-struct node* parser_current_body = NULL;
-struct node* parser_current_function = NULL ;
-
-void node_set_vector(struct vector* vec, struct vector* root_vec)
+void node_set_process(struct compiler_process* process)
 {
-    node_vector = vec;
-    node_vector_root = root_vec;
+    node_process = process;
 }
 
 void node_push(struct node* node)
 {
-    vector_push(node_vector,&node);
+    vector_push(node_process->node_vec,&node);
 }
 
 struct node* node_peek_or_null()
 {
-    return vector_back_ptr_or_null(node_vector);
+    return vector_back_ptr_or_null(node_process->node_vec);
 }
 
 struct node* node_peek()
 {
-    return *(struct node**)(vector_back(node_vector));
+    return *(struct node**)(vector_back(node_process->node_vec));
 }
 
 
 struct node* node_pop()
 {
-    struct node* last_node = vector_back_ptr(node_vector);
-    struct node* last_node_root = vector_empty(node_vector) ? NULL : vector_back_ptr_or_null(node_vector_root);
-    vector_pop(node_vector);
+    struct node* last_node = vector_back_ptr(node_process->node_vec);
+    struct node* last_node_root = vector_empty(node_process->node_vec) ? NULL : vector_back_ptr_or_null(node_process->node_tree_vec);
+    vector_pop(node_process->node_vec);
     if (last_node == last_node_root)
     {
-        vector_pop(node_vector_root);
+        vector_pop(node_process->node_tree_vec);
     }
 
     return last_node;
@@ -57,8 +52,8 @@ struct node* node_peek_expressionable_or_null()
 
 void make_exp_node(struct node* left_node, struct node* right_node, const char* op)
 {
-    assert(left_node);
-    assert(right_node);
+    compiler_assert(left_node);
+    compiler_assert(right_node);
     node_create(&(struct node){.type=NODE_TYPE_EXPRESSION,.exp.left = left_node,.exp.right=right_node,.exp.op=op});
 }
 void make_exp_parentheses_node(struct node* exp_node)
@@ -71,6 +66,11 @@ void make_bracket_node(struct node* node)
     node_create(&(struct node){.type = NODE_TYPE_BRACKET,.bracket.inner = node});
 }
 
+void make_initializer_list_node(struct vector* values)
+{
+    node_create(&(struct node){.type = NODE_TYPE_INITIALIZER_LIST,.initializer.values = values});
+}
+
 void make_body_node(struct vector* body_vec,size_t size, bool padded, struct node* largest_var_node)
 {
     node_create(&(struct node){.type = NODE_TYPE_BODY,.body.statements = body_vec,.body.size =size,.body.padded = padded,.body.largest_var_node = largest_var_node});
@@ -231,10 +231,11 @@ struct node* struct_node_for_name(struct compiler_process* current_process,const
 
 struct node* node_create(struct node* _node)
 {
-    struct node* node = malloc(sizeof(struct node));
+    struct node* node = arena_malloc(sizeof(struct node));
     memcpy(node,_node,sizeof(struct node));
-    node->binded.owner = parser_current_body;
-    node->binded.function = parser_current_function;
+    COMPILE_REPORT_COUNT(nodes);
+    node->binded.owner = node_process->parser.current_body;
+    node->binded.function = node_process->parser.current_function;
     node_push(node);
     return node;
 }
@@ -273,7 +274,7 @@ struct node* variable_node(struct node* node)
 
 bool variable_node_is_primitive(struct node* node)
 {
-    assert(node->type == NODE_TYPE_VARIABLE);
+    compiler_assert(node->type == NODE_TYPE_VARIABLE);
     return datatype_is_primitive(&node->var.type);
 }
 
@@ -288,19 +289,37 @@ struct node* variable_node_or_list(struct node* node)
 
 size_t function_node_argument_stack_addition(struct node* node)
 {
-    assert(node->type == NODE_TYPE_FUNCTION);
+    compiler_assert(node->type == NODE_TYPE_FUNCTION);
     return node->func.args.stack_addition;
 }
 
 struct vector* function_node_argument_vec(struct node* node)
 {
-    assert(node->type == NODE_TYPE_FUNCTION);
+    compiler_assert(node->type == NODE_TYPE_FUNCTION);
     return node->func.args.vector;
 }
 
+int function_node_register_argument_count(struct node* node)
+{
+    compiler_assert(node->type == NODE_TYPE_FUNCTION);
+    if (!(node->func.flags & FUNCTION_NODE_FLAG_REGISTER_ARGUMENTS))
+    {
+        return 0;
+    }
+    int total_arguments = vector_count(function_node_argument_vec(node));
+    return total_arguments < FUNCTION_REGISTER_ARGUMENTS ? total_arguments : FUNCTION_REGISTER_ARGUMENTS;
+}
+
+const char* function_node_argument_register(int index)
+{
+    static const char* registers[FUNCTION_REGISTER_ARGUMENTS] = {"ecx", "edx"};
+    compiler_assert(index >= 0 && index < FUNCTION_REGISTER_ARGUMENTS);
+    return registers[index];
+}
+
 size_t function_node_stack_size(struct node* node)
 {
-    assert(node->type == NODE_TYPE_FUNCTION);
+    compiler_assert(node->type == NODE_TYPE_FUNCTION);
     return node->func.stack_size;
 }
 
@@ -338,4 +357,111 @@ bool is_node_assignment(struct node* node)
 bool node_valid(struct node* node)
 {
     return node && node->type != NODE_TYPE_BLANK;
-}
\ No newline at end of file
+}
+static void node_walk_vector(struct vector* vec, NODE_WALK_FUNCTION func, void* private)
+{
+    if (!vec)
+    {
+        return;
+    }
+    // Index based so we don't disturb the peek pointer of a vector that is being iterated somewhere else
+    for (int i = 0; i < vector_count(vec); i++)
+    {
+        node_walk(vector_peek_ptr_at(vec,i),func,private);
+    }
+}
+
+// Calls func for the node and for every node below it (expressions, statements, bodies), if func returns false the children of that node are skipped
+void node_walk(struct node* node, NODE_WALK_FUNCTION func, void* private)
+{
+    if (!node || !func(node,private))
+    {
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NODE_TYPE_EXPRESSION:
+        node_walk(node->exp.left,func,private);
+        node_walk(node->exp.right,func,private);
+        break;
+    case NODE_TYPE_EXPRESSION_PARENTHESIS:
+        node_walk(node->parenthesis.exp,func,private);
+        break;
+    case NODE_TYPE_VARIABLE:
+        node_walk(node->var.val,func,private);
+        break;
+    case NODE_TYPE_VARIABLE_LIST:
+        node_walk_vector(node->var_list.list,func,private);
+        break;
+    case NODE_TYPE_INITIALIZER_LIST:
+        node_walk_vector(node->initializer.values,func,private);
+        break;
+    case NODE_TYPE_FUNCTION:
+        node_walk_vector(node->func.args.vector,func,private);
+        node_walk(node->func.body_n,func,private);
+        break;
+    case NODE_TYPE_BODY:
+        node_walk_vector(node->body.statements,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_RETURN:
+        node_walk(node->stmt.return_stmt.exp,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_IF:
+        node_walk(node->stmt.if_stmt.cond_node,func,private);
+        node_walk(node->stmt.if_stmt.body_node,func,private);
+        node_walk(node->stmt.if_stmt.next,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_ELSE:
+        node_walk(node->stmt.else_stmt.body_node,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_WHILE:
+        node_walk(node->stmt.while_stmt.exp_node,func,private);
+        node_walk(node->stmt.while_stmt.body_node,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_DO_WHILE:
+        node_walk(node->stmt.do_while_stmt.body_node,func,private);
+        node_walk(node->stmt.do_while_stmt.exp_node,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_FOR:
+        node_walk(node->stmt.for_stmt.init_node,func,private);
+        node_walk(node->stmt.for_stmt.cond_node,func,private);
+        node_walk(node->stmt.for_stmt.loop_node,func,private);
+        node_walk(node->stmt.for_stmt.body_node,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_SWITCH:
+        node_walk(node->stmt.switch_stmt.exp,func,private);
+        node_walk(node->stmt.switch_stmt.body,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_CASE:
+        node_walk(node->stmt._case.exp,func,private);
+        break;
+    case NODE_TYPE_STATEMENT_GOTO:
+        node_walk(node->stmt._goto.label,func,private);
+        break;
+    case NODE_TYPE_UNARY:
+        node_walk(node->unary.operand,func,private);
+        break;
+    case NODE_TYPE_TENARY:
+        node_walk(node->tenary.true_node,func,private);
+        node_walk(node->tenary.false_node,func,private);
+        break;
+    case NODE_TYPE_LABEL:
+        node_walk(node->label.name,func,private);
+        break;
+    case NODE_TYPE_STRUCT:
+        node_walk(node->_struct.body_n,func,private);
+        node_walk(node->_struct.var,func,private);
+        break;
+    case NODE_TYPE_UNION:
+        node_walk(node->_union.body_n,func,private);
+        node_walk(node->_union.var,func,private);
+        break;
+    case NODE_TYPE_BRACKET:
+        node_walk(node->bracket.inner,func,private);
+        break;
+    case NODE_TYPE_CAST:
+        node_walk(node->cast.operand,func,private);
+        break;
+    }
+}
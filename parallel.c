@@ -0,0 +1,382 @@
+#include "compiler.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "helpers/vector.h"
+
+/*
+ * -fparallel-codegen
+ *
+ * After the data section is generated the functions of the root don't need each other, every worker generates every
+ * n-th function into its own buffer and the .text is put together in the order of the source:
+ *
+ *  worker 0: f0 f2 f4 ...    |
+ *  worker 1: f1 f3 f5 ...    | -> f0 f1 f2 f3 f4 f5 ..., the strings and .data lines of the functions in the same order
+ *
+ * The workers are forked processes and not threads. The tree, the resolver and the symbol tables keep the position of
+ * a loop in the vector it goes over (vector_set_peek_pointer), the structs and the global scope are walked by every
+ * function, two threads would move each other's peek pointer. A forked worker has its own copy of the tree, the
+ * resolver scopes, the arena and the generator, nothing has to be locked
+ *
+ * The str_ and function_call_ labels aren't local, every function has its own namespace, the index of the function
+ * in the root: str_f12_3, function_call_f12_4. The label numbers start from 1 again in every function, the local labels
+ * are scoped to the function label, and a function only reuses the strings registered before the workers started, so
+ * the output doesn't depend on how many workers there are. A worker registers the functions it doesn't generate in the
+ * resolver, a call finds the same functions as without -fparallel-codegen
+ *
+ * A worker writes into a temporary file:
+ *
+ *   index text strings data lines    for every function it generated, -1 after the last one
+ *   counts                           what -ftime-report counted
+ *
+ * Nothing is taken from the workers unless all of them finished, with an error in a function the functions are
+ * generated again in this process so the error is reported like it always is. -fprofile-generate numbers its counters
+ * in the order of the whole file and -fdump-ir prints the IR while generating, they are generated in this process
+ *
+ * Only a single threaded ./main forks. Under the driver's thread pool (COMPILE_PROCESS_THREADED) and through
+ * compile_source (COMPILE_PROCESS_LIBRARY, the server too) the functions are generated in order by the calling thread
+ */
+
+// Forking isn't worth it for fewer functions than this in a worker
+#define CODEGEN_PARALLEL_MIN_FUNCTIONS_PER_WORKER 16
+
+// The counters of -ftime-report that grow while the functions are generated
+struct codegen_parallel_counts
+{
+    size_t resolver_entities;
+    size_t stack_frame_elements;
+    size_t instructions;
+};
+
+struct codegen_parallel_string
+{
+    char* label;
+    char* str;
+};
+
+// What a worker generated for a function
+struct codegen_parallel_function
+{
+    char* text;
+    // Vector of struct codegen_parallel_string
+    struct vector* strings;
+    // Vector of char*, the lines it added to .data
+    struct vector* data_lines;
+};
+
+struct codegen_parallel_result
+{
+    // For every root node, the text is NULL if it isn't a function
+    struct codegen_parallel_function* functions;
+    struct codegen_parallel_counts counts;
+};
+
+static int codegen_parallel_total_workers(int total_functions)
+{
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int total_workers = total_functions / CODEGEN_PARALLEL_MIN_FUNCTIONS_PER_WORKER;
+    return cores > 0 && cores < total_workers ? (int)cores : total_workers;
+}
+
+static struct codegen_parallel_counts codegen_parallel_current_counts()
+{
+    struct codegen_parallel_counts counts = {};
+    if (compile_report_current)
+    {
+        counts.resolver_entities = compile_report_current->resolver_entities;
+        counts.stack_frame_elements = compile_report_current->stack_frame_elements;
+        counts.instructions = compile_report_current->instructions;
+    }
+    return counts;
+}
+
+static void codegen_parallel_write_text(FILE* out, const char* text, size_t length)
+{
+    fwrite(&length, sizeof(size_t), 1, out);
+    fwrite(text, 1, length, out);
+}
+
+static char* codegen_parallel_read_text(FILE* in)
+{
+    size_t length = 0;
+    if (fread(&length, sizeof(size_t), 1, in) != 1)
+    {
+        return NULL;
+    }
+    char* text = arena_malloc(length + 1);
+    if (fread(text, 1, length, in) != length)
+    {
+        arena_free(text);
+        return NULL;
+    }
+    text[length] = 0;
+    return text;
+}
+
+// Runs in the forked process, never returns
+static void codegen_parallel_worker(struct compiler_process* process, int worker, int total_workers, FILE* out)
+{
+    // Nothing is printed to stdout and an error comes back here instead of ending the compiler. The error or a failed
+    // assert is printed by this process again when it generates the functions itself
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0)
+    {
+        dup2(null_fd, STDERR_FILENO);
+    }
+    jmp_buf error_jump;
+    process->flags |= COMPILE_PROCESS_LIBRARY;
+    process->error_jump = &error_jump;
+    if (setjmp(error_jump))
+    {
+        _exit(1);
+    }
+
+    struct code_generator* generator = process->generator;
+    struct codegen_parallel_counts counts_before = codegen_parallel_current_counts();
+    // A string an earlier function of this worker registered isn't reused, the label of a string can't depend on which
+    // worker generated the function
+    size_t buckets_size = CODEGEN_STRING_TABLE_BUCKETS * sizeof(struct string_table_element*);
+    struct string_table_element** buckets_before = arena_malloc(buckets_size);
+    memcpy(buckets_before, generator->string_buckets, buckets_size);
+    char* text = NULL;
+    size_t text_size = 0;
+    process->ofile = open_memstream(&text, &text_size);
+    if (!process->ofile)
+    {
+        _exit(1);
+    }
+
+    struct vector* root = process->node_tree_vec;
+    int function_index = 0;
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (node->type != NODE_TYPE_FUNCTION)
+        {
+            continue;
+        }
+        if (function_index++ % total_workers != worker)
+        {
+            // Another worker generates it, the calls after it still have to find it
+            codegen_register_function(node, 0);
+            continue;
+        }
+
+        char label_namespace[32];
+        sprintf(label_namespace, "f%i_", i);
+        generator->label_namespace = label_namespace;
+        generator->label_count = 0;
+        memcpy(generator->string_buckets, buckets_before, buckets_size);
+        int strings_before = vector_count(generator->string_table);
+        int data_lines_before = vector_count(generator->custom_data_sections);
+        fflush(process->ofile);
+        size_t start = text_size;
+        codegen_generate_root_node(node);
+        fflush(process->ofile);
+
+        fwrite(&i, sizeof(int), 1, out);
+        codegen_parallel_write_text(out, text + start, text_size - start);
+        size_t total_strings = (size_t)(vector_count(generator->string_table) - strings_before);
+        fwrite(&total_strings, sizeof(size_t), 1, out);
+        for (int j = strings_before; j < vector_count(generator->string_table); j++)
+        {
+            struct string_table_element* element = vector_peek_ptr_at(generator->string_table, j);
+            codegen_parallel_write_text(out, element->label, strlen(element->label));
+            codegen_parallel_write_text(out, element->str, strlen(element->str));
+        }
+        size_t total_data_lines = (size_t)(vector_count(generator->custom_data_sections) - data_lines_before);
+        fwrite(&total_data_lines, sizeof(size_t), 1, out);
+        for (int j = data_lines_before; j < vector_count(generator->custom_data_sections); j++)
+        {
+            const char* line = vector_peek_ptr_at(generator->custom_data_sections, j);
+            codegen_parallel_write_text(out, line, strlen(line));
+        }
+    }
+    int end = -1;
+    fwrite(&end, sizeof(int), 1, out);
+
+    struct codegen_parallel_counts counts = codegen_parallel_current_counts();
+    counts.resolver_entities -= counts_before.resolver_entities;
+    counts.stack_frame_elements -= counts_before.stack_frame_elements;
+    counts.instructions -= counts_before.instructions;
+    fwrite(&counts, sizeof(struct codegen_parallel_counts), 1, out);
+    // _exit doesn't flush, and it mustn't write out the stdout of the compiler again
+    _exit(fflush(out) == 0 && !ferror(out) ? 0 : 1);
+}
+
+static bool codegen_parallel_read_function(FILE* in, struct codegen_parallel_function* function)
+{
+    function->text = codegen_parallel_read_text(in);
+    function->strings = vector_create(sizeof(struct codegen_parallel_string));
+    function->data_lines = vector_create(sizeof(char*));
+    size_t total_strings = 0;
+    if (!function->text || fread(&total_strings, sizeof(size_t), 1, in) != 1)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < total_strings; i++)
+    {
+        struct codegen_parallel_string string = {};
+        string.label = codegen_parallel_read_text(in);
+        string.str = string.label ? codegen_parallel_read_text(in) : NULL;
+        if (!string.str)
+        {
+            return false;
+        }
+        vector_push(function->strings, &string);
+    }
+
+    size_t total_data_lines = 0;
+    if (fread(&total_data_lines, sizeof(size_t), 1, in) != 1)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < total_data_lines; i++)
+    {
+        char* line = codegen_parallel_read_text(in);
+        if (!line)
+        {
+            return false;
+        }
+        vector_push(function->data_lines, &line);
+    }
+    return true;
+}
+
+static bool codegen_parallel_read_result(FILE* in, struct codegen_parallel_result* result, int total_root_nodes)
+{
+    rewind(in);
+    int index = 0;
+    while (fread(&index, sizeof(int), 1, in) == 1 && index != -1)
+    {
+        if (index < 0 || index >= total_root_nodes || !codegen_parallel_read_function(in, &result->functions[index]))
+        {
+            return false;
+        }
+    }
+
+    struct codegen_parallel_counts counts;
+    if (index != -1 || fread(&counts, sizeof(struct codegen_parallel_counts), 1, in) != 1)
+    {
+        return false;
+    }
+    result->counts.resolver_entities += counts.resolver_entities;
+    result->counts.stack_frame_elements += counts.stack_frame_elements;
+    result->counts.instructions += counts.instructions;
+    return true;
+}
+
+// Forks the workers and waits for all of them, false if any of them couldn't be made or failed
+static bool codegen_parallel_run_workers(struct compiler_process* process, int total_workers, struct codegen_parallel_result* result)
+{
+    FILE** outputs = arena_calloc(total_workers, sizeof(FILE*));
+    pid_t* workers = arena_calloc(total_workers, sizeof(pid_t));
+    // The workers would write out what is buffered again
+    fflush(stdout);
+    if (process->ofile)
+    {
+        fflush(process->ofile);
+    }
+
+    bool ok = true;
+    int total_started = 0;
+    for (; total_started < total_workers; total_started++)
+    {
+        outputs[total_started] = tmpfile();
+        if (!outputs[total_started])
+        {
+            ok = false;
+            break;
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            codegen_parallel_worker(process, total_started, total_workers, outputs[total_started]);
+        }
+        if (pid < 0)
+        {
+            fclose(outputs[total_started]);
+            ok = false;
+            break;
+        }
+        workers[total_started] = pid;
+    }
+
+    int total_root_nodes = vector_count(process->node_tree_vec);
+    for (int i = 0; i < total_started; i++)
+    {
+        int status = 0;
+        if (waitpid(workers[i], &status, 0) != workers[i] || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ok = false;
+        }
+        // A worker that failed wrote nothing we could use
+        ok = ok && codegen_parallel_read_result(outputs[i], result, total_root_nodes);
+        fclose(outputs[i]);
+    }
+    arena_free(outputs);
+    arena_free(workers);
+    return ok;
+}
+
+bool codegen_parallel_generate_root(struct compiler_process* process)
+{
+    if (process->flags & (COMPILE_PROCESS_PROFILE_GENERATE | COMPILE_PROCESS_DUMP_IR))
+    {
+        return false;
+    }
+
+    // The child of a multithreaded process may only call async signal safe functions and a worker mallocs and prints,
+    // the driver pool and the server have other threads, compile_source would fork the application using the library
+    if (process->flags & (COMPILE_PROCESS_THREADED | COMPILE_PROCESS_LIBRARY))
+    {
+        return false;
+    }
+
+    struct vector* root = process->node_tree_vec;
+    int total_functions = 0;
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        total_functions += node->type == NODE_TYPE_FUNCTION;
+    }
+    int total_workers = codegen_parallel_total_workers(total_functions);
+    if (total_workers < 2)
+    {
+        return false;
+    }
+
+    struct codegen_parallel_result result = {.functions = arena_calloc(vector_count(root), sizeof(struct codegen_parallel_function))};
+    if (!codegen_parallel_run_workers(process, total_workers, &result))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct codegen_parallel_function* function = &result.functions[i];
+        if (!function->text)
+        {
+            continue;
+        }
+        asm_push_no_nl("%s", function->text);
+        // The same string in two functions has two labels, the .rodata writer puts them on the same memory
+        for (int j = 0; j < vector_count(function->strings); j++)
+        {
+            struct codegen_parallel_string* string = vector_at(function->strings, j);
+            codegen_register_string_with_label(string->str, string->label);
+        }
+        for (int j = 0; j < vector_count(function->data_lines); j++)
+        {
+            codegen_data_section_add("%s", (char*)vector_peek_ptr_at(function->data_lines, j));
+        }
+    }
+    if (compile_report_current)
+    {
+        compile_report_current->resolver_entities += result.counts.resolver_entities;
+        compile_report_current->stack_frame_elements += result.counts.stack_frame_elements;
+        compile_report_current->instructions += result.counts.instructions;
+    }
+    return true;
+}
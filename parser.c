@@ -1,20 +1,11 @@
 #include "compiler.h"
 #include "helpers/vector.h"
-#include <assert.h>
+#include "helpers/nameset.h"
 
 
 typedef struct datatype_struct_node_fix_private datatype_struct_node_fix_private;
-static struct compiler_process *current_process;
-
-static struct fixup_system* parser_fixup_sys;
-static struct token *parser_last_token;
-
-// extern means that the variable is elsewhere but we can reference it from here
-extern struct node* parser_current_body;
-extern struct node* parser_current_function;
-
-// NODE_TYPE_BLANK -> it means nothing
-struct node* parser_blank_node;
+// The file this thread is parsing, the rest of the parser state is in current_process->parser
+static _Thread_local struct compiler_process *current_process;
 extern struct expressionable_op_precedence_group op_precedence[TOTAL_OPERATOR_GROUPS];
 
 enum {
@@ -37,7 +28,7 @@ struct parser_scope_entity
 
 struct parser_scope_entity* parser_new_scope_entity(struct node* node, int stack_offset, int flags)
 {
-    struct parser_scope_entity* entity = calloc(1,sizeof(struct parser_scope_entity));
+    struct parser_scope_entity* entity = arena_calloc(1,sizeof(struct parser_scope_entity));
     entity->node = node;
     entity->flags = flags;
     entity ->stack_offset = stack_offset;
@@ -57,7 +48,9 @@ enum
     HISTORY_FLAG_INSIDE_STRUCTURE = 0b00001000,
     HISTORY_FLAG_INSIDE_FUNCTION_BODY = 0b00010000,
     HISTORY_FLAG_IN_SWITCH_STATEMENT = 0b00100000,
-    HISTORY_FLAG_PARENTHESIS_IS_NOT_A_FUNCTION_CALL = 0b01000000
+    HISTORY_FLAG_PARENTHESIS_IS_NOT_A_FUNCTION_CALL = 0b01000000,
+    // {1, 2, 3} -> ',' separates the elements, it isn't the comma operator
+    HISTORY_FLAG_IN_INITIALIZER_LIST = 0b10000000
 };
 
 struct history_cases
@@ -80,14 +73,14 @@ struct history
 
 static struct history* history_begin(int flags)
 {
-    struct history* history = calloc(1,sizeof(history));
+    struct history* history = arena_calloc(1,sizeof(struct history));
     history->flags = flags;
     return history;
 }
 
 static struct history* history_down(struct history* history, int flags)
 {
-    struct history* new_history = calloc(1,sizeof(struct history));
+    struct history* new_history = arena_calloc(1,sizeof(struct history));
     memcpy(new_history,history,sizeof(struct history));
     new_history->flags = flags;
 
@@ -97,7 +90,7 @@ static struct history* history_down(struct history* history, int flags)
 struct parser_history_switch parser_new_switch_statement(struct history* history)
 {
     memset(&history->_switch,0,sizeof(history->_switch));
-	history->_switch.case_data = calloc(1, sizeof(struct history_cases));
+	history->_switch.case_data = arena_calloc(1, sizeof(struct history_cases));
     history->_switch.case_data->cases = vector_create(sizeof(struct parsed_switch_case));
     history->flags |= HISTORY_FLAG_IN_SWITCH_STATEMENT;
     return history->_switch;
@@ -110,7 +103,7 @@ void parser_end_switch_statement(struct parser_history_switch* switch_history)
 
 void parser_register_case(struct history* history, struct node* case_node)
 {
-    assert(history->flags & HISTORY_FLAG_IN_SWITCH_STATEMENT);
+    compiler_assert(history->flags & HISTORY_FLAG_IN_SWITCH_STATEMENT);
     struct parsed_switch_case scase;
     scase.index = case_node->stmt._case.exp->llnum;
 
@@ -160,7 +153,7 @@ static struct token *token_next()
     {
         current_process->pos = next_token->pos;
     }
-    parser_last_token = next_token;
+    current_process->parser.last_token = next_token;
     return vector_peek(current_process->token_vec);
 }
 static struct token *token_peek_next();
@@ -283,8 +276,8 @@ static bool parser_left_op_has_priority(const char* op_left, const char* op_righ
 
 void parser_node_shift_children_left(struct node* node)
 {
-    assert(node->type == NODE_TYPE_EXPRESSION);
-    assert(node->exp.right->type == NODE_TYPE_EXPRESSION);
+    compiler_assert(node->type == NODE_TYPE_EXPRESSION);
+    compiler_assert(node->exp.right->type == NODE_TYPE_EXPRESSION);
 
     const char* right_op = node->exp.right->exp.op;
     struct node* new_exp_left_node = node->exp.left;
@@ -523,7 +516,7 @@ void parse_for_parentheses(struct history* history)
         node_pop();
     }
     // 50+20)
-    struct node* exp_node = parser_blank_node;
+    struct node* exp_node = current_process->parser.blank_node;
     if (!token_next_is_symbol(')'))
     {
         parse_expressionable_root(history_begin(0));
@@ -617,6 +610,11 @@ int parse_exp(struct history* history)
     }
     else if(S_EQ(token_peek_next()->sval,","))
     {
+        if (history->flags & HISTORY_FLAG_IN_INITIALIZER_LIST)
+        {
+            // The element of the initializer list ends here
+            return -1;
+        }
         parse_for_comma(history);
     }
     else
@@ -628,7 +626,7 @@ int parse_exp(struct history* history)
 
 void parse_identifier(struct history* history)
 {
-    assert(token_peek_next()->type == TOKEN_TYPE_IDENTIFIER);
+    compiler_assert(token_peek_next()->type == TOKEN_TYPE_IDENTIFIER);
     parse_single_token_to_node();
 }
 
@@ -691,17 +689,15 @@ void parser_get_datatype_tokens(struct token** datatype_token, struct token** da
 }
 int parser_get_random_type_index()
 {
-    static int x = 0;
-    x++;
-    return x;
+    return ++current_process->parser.random_type_index;
 }
 struct token* parser_build_random_type_name()
 {
     char tmp_name[25];
     sprintf(tmp_name,"customtypename_%i",parser_get_random_type_index());
-    char*sval = malloc(sizeof(tmp_name));
+    char*sval = arena_malloc(sizeof(tmp_name));
     strncpy(sval,tmp_name,sizeof(tmp_name));
-    struct token* token = calloc(1,sizeof(struct token));
+    struct token* token = arena_calloc(1,sizeof(struct token));
     token->sval = sval;
     return token;
 }
@@ -733,7 +729,7 @@ void parser_datatype_adjust_size_for_secondary(struct datatype* datatype,struct
     {
         return;
     }
-    struct datatype* secondary_data_type = calloc(1,sizeof(struct datatype));
+    struct datatype* secondary_data_type = arena_calloc(1,sizeof(struct datatype));
     parser_datatype_init_type_and_size_for_primitive(datatype_secondary_token,NULL,secondary_data_type);
     datatype->size += secondary_data_type->size;
     datatype->flags |= DATATYPE_FLAG_IS_SECONDARY;
@@ -796,9 +792,9 @@ size_t size_of_struct(const char* struct_name)
     {
         return 0;
     }
-    assert(sym->type == SYMBOL_TYPE_NODE);
+    compiler_assert(sym->type == SYMBOL_TYPE_NODE);
     struct node* node = sym->data;
-    assert(node->type == NODE_TYPE_STRUCT);
+    compiler_assert(node->type == NODE_TYPE_STRUCT);
     return node->_struct.body_n->body.size;
 }
 
@@ -809,9 +805,9 @@ size_t size_of_union(const char* union_name)
     {
         return 0;
     }
-    assert(sym->type == SYMBOL_TYPE_NODE);
+    compiler_assert(sym->type == SYMBOL_TYPE_NODE);
     struct node* node = sym->data;
-    assert(node->type == NODE_TYPE_UNION);
+    compiler_assert(node->type == NODE_TYPE_UNION);
     return node->_union.body_n->body.size;
 }
 
@@ -961,7 +957,7 @@ bool datatype_struct_node_fix(struct fixup* fixup)
 }
 void datatype_struct_node_end(struct fixup* fixup)
 {
-    free(fixup_private(fixup));
+    arena_free(fixup_private(fixup));
 }
 
 
@@ -980,10 +976,10 @@ void make_variable_node(struct datatype* dtype, struct token* name_token, struct
     //A fixup needs to be created if its a struct AND it doesn't have its struct_node set meaning it's declared later in the file
     if (var_node && var_node->var.type.type == DATA_TYPE_STRUCT && !var_node->var.type.struct_node)
     {
-        struct datatype_struct_node_fix_private* private = calloc(1, sizeof(datatype_struct_node_fix_private));
+        struct datatype_struct_node_fix_private* private = arena_calloc(1, sizeof(datatype_struct_node_fix_private));
         private->node = var_node;
         // Set the variables inside the fixup config and register it
-        fixup_register(parser_fixup_sys,&(struct fixup_config){.fix = datatype_struct_node_fix,.end = datatype_struct_node_end,.private = private});
+        fixup_register(current_process->parser.fixup_sys,&(struct fixup_config){.fix = datatype_struct_node_fix,.end = datatype_struct_node_end,.private = private});
     }
 }
 
@@ -995,7 +991,7 @@ void parser_scope_offset_for_stack(struct node* node, struct history* history)
     int offset = -variable_size(node);
     if (upward_stack)
     {
-        size_t stack_addition = function_node_argument_stack_addition(parser_current_function);
+        size_t stack_addition = function_node_argument_stack_addition(current_process->parser.current_function);
         offset = stack_addition;
         // If there is no last_entity, than that means that the stack_addition points to the first argument in memory, if there is a last_entity than we are further "up" the stack than we need to be and than the size of that variable to the basic stack_addition (the addition will be done in the later if check)
         if (last_entity)
@@ -1097,6 +1093,11 @@ struct array_brackets* parse_array_brackets(struct history* history)
         {
             //Nothing betwwn the brackets
             expect_sym(']');
+            // int x[] = {1, 2, 3} -> the size is 0 until the initializer is parsed
+            node_create(&(struct node){.type = NODE_TYPE_NUMBER,.llnum = 0});
+            make_bracket_node(node_pop());
+            array_brackets_add(brackets,node_pop());
+            continue;
         }
         parse_expressionable_root((history));
         expect_sym(']');
@@ -1108,6 +1109,65 @@ struct array_brackets* parse_array_brackets(struct history* history)
     return brackets;
 }
 
+// {1, 2, {3, 4}} -> every element is parsed on its own, a nested '{' starts another list
+void parse_initializer_list(struct history* history)
+{
+    expect_sym('{');
+    struct vector* values = vector_create(sizeof(struct node*));
+    while (!token_next_is_symbol('}'))
+    {
+        if (token_next_is_symbol('{'))
+        {
+            parse_initializer_list(history);
+        }
+        else
+        {
+            parse_expressionable_root(history_down(history,history->flags | HISTORY_FLAG_IN_INITIALIZER_LIST));
+        }
+        struct node* value_node = node_pop();
+        vector_push(values,&value_node);
+
+        if (!token_next_is_operator(","))
+        {
+            break;
+        }
+        // Skip ',', there can be one after the last element too
+        token_next();
+    }
+    expect_sym('}');
+    make_initializer_list_node(values);
+}
+
+// int x[] = {1, 2, 3} -> the first dimension is as big as the initializer
+static void parser_complete_unsized_array(struct datatype* dtype, struct node* value_node)
+{
+    struct node* first_bracket = vector_peek_ptr_at(array_brackets_node_vector(dtype->array.brackets),0);
+    if (first_bracket->bracket.inner->llnum != 0)
+    {
+        return;
+    }
+
+    if (value_node->type == NODE_TYPE_INITIALIZER_LIST)
+    {
+        struct vector* values = value_node->initializer.values;
+        size_t count = vector_count(values);
+        struct node* first_value = count ? vector_peek_ptr_at(values,0) : NULL;
+        if (first_value && first_value->type != NODE_TYPE_INITIALIZER_LIST && array_brackets_count(dtype) > 1)
+        {
+            // int x[][2] = {1, 2, 3, 4} -> the inner braces are left out, every row takes 2 values
+            size_t row_elements = array_brackets_calculate_size_from_index(dtype,dtype->array.brackets,1) / datatype_element_size(dtype);
+            count = (count + row_elements - 1) / row_elements;
+        }
+        first_bracket->bracket.inner->llnum = count;
+    }
+    else if (value_node->type == NODE_TYPE_STRING)
+    {
+        // char name[] = "abc" -> the terminating zero is part of the array
+        first_bracket->bracket.inner->llnum = strlen(value_node->sval) + 1;
+    }
+    dtype->array.size = array_brackets_calculate_size(dtype,dtype->array.brackets);
+}
+
 void parse_variable(struct datatype* dtype, struct token* name_token, struct history* history)
 {
     struct node* value_node = NULL;
@@ -1128,10 +1188,23 @@ void parse_variable(struct datatype* dtype, struct token* name_token, struct his
     {
         //Ignore the = operator
         struct token* val  = token_next();
-        parse_expressionable_root(history);
+        if (token_next_is_symbol('{'))
+        {
+            // int x[3] = {1, 2, 3}
+            parse_initializer_list(history);
+        }
+        else
+        {
+            parse_expressionable_root(history);
+        }
         value_node = node_pop();
     }
 
+    if (brackets && value_node)
+    {
+        parser_complete_unsized_array(dtype,value_node);
+    }
+
     make_variable_node_and_register(history,dtype,name_token,value_node);
 
 }
@@ -1148,6 +1221,35 @@ void parse_function_body(struct history* history)
 struct vector* parse_function_arguments(struct history*history);
 
 
+// -flazy-parse, see parser_parse_lazy_bodies
+static bool parser_function_body_can_wait(struct node* function_node)
+{
+    return current_process->flags & COMPILE_PROCESS_LAZY_PARSE && function_node->func.rtype.flags & DATATYPE_FLAG_IS_STATIC;
+}
+
+// Only remembers where the body starts and goes to the token after its '}'
+static void parser_skip_function_body(struct node* function_node)
+{
+    function_node->func.lazy_body_token = vector_peek_pointer(current_process->token_vec);
+    int depth = 0;
+    do
+    {
+        struct token* token = token_next();
+        if (!token)
+        {
+            compiler_error(current_process, "The body of the function %s doesn't end", function_node->func.name);
+        }
+        if (token->type == TOKEN_TYPE_SYMBOL && token->cval == '{')
+        {
+            depth++;
+        }
+        else if (token->type == TOKEN_TYPE_SYMBOL && token->cval == '}')
+        {
+            depth--;
+        }
+    } while (depth);
+}
+
 void parse_function(struct datatype* ret_type, struct token* name_Token, struct history* history)
 {
     struct vector* arguments_vector = NULL;
@@ -1155,7 +1257,8 @@ void parse_function(struct datatype* ret_type, struct token* name_Token, struct
 
     make_function_node(ret_type,name_Token->sval,NULL,NULL);
     struct node* function_node = node_peek();
-    parser_current_function = function_node;
+    function_node->pos = name_Token->pos;
+    current_process->parser.current_function = function_node;
     // Returning a struct in assembly is hard (return arguments are set in the EAX reg. but that's impossible here because of unlimited datasize) so a "pointer" is returned instead
     // In assembly, before calling the function, enough space for the return type will be created on the stack and the called function will modify those adresses
     if (datatype_is_struct_or_union(ret_type))
@@ -1171,7 +1274,11 @@ void parse_function(struct datatype* ret_type, struct token* name_Token, struct
     {
         function_node->func.flags |= FUNCTION_NODE_FLAG_IS_NATIVE;
     }
-    if (token_next_is_symbol('{'))
+    if (token_next_is_symbol('{') && parser_function_body_can_wait(function_node))
+    {
+        parser_skip_function_body(function_node);
+    }
+    else if (token_next_is_symbol('{'))
     {
         parse_function_body(history_begin(0));
         struct node* body_node = node_pop();
@@ -1186,7 +1293,7 @@ void parse_function(struct datatype* ret_type, struct token* name_Token, struct
         expect_sym(';');
     }
 
-    parser_current_function = NULL;
+    current_process->parser.current_function = NULL;
     parser_scope_finish();
 
 }
@@ -1314,8 +1421,8 @@ void parse_body_single_statement(size_t* variable_size, struct vector* body_vec,
     // make blank body node
     make_body_node(NULL,0,false,NULL);
     struct node* body_node = node_pop();
-    body_node->binded.owner = parser_current_body;
-    parser_current_body = body_node;
+    body_node->binded.owner = current_process->parser.current_body;
+    current_process->parser.current_body = body_node;
 
     struct node* stmt_node = NULL;
     parse_statement(history_down(history,history->flags));
@@ -1332,7 +1439,7 @@ void parse_body_single_statement(size_t* variable_size, struct vector* body_vec,
         largest_var_node = stmt_node;
     }
     parser_finalize_body(history,body_node,body_vec,variable_size,largest_var_node,largest_var_node);
-    parser_current_body = body_node->binded.owner;
+    current_process->parser.current_body = body_node->binded.owner;
     node_push(body_node);
 }
 
@@ -1342,8 +1449,8 @@ void parse_body_multiple_statements(size_t* variable_size, struct vector* body_v
     //Create blank body node
     make_body_node(NULL,0,false,NULL);
     struct node* body_node = node_pop();
-    body_node->binded.owner = parser_current_body;
-    parser_current_body = body_node;
+    body_node->binded.owner = current_process->parser.current_body;
+    current_process->parser.current_body = body_node;
 
     struct node* stmt_node = NULL;
     struct node*largest_possible_var_node = NULL;
@@ -1384,7 +1491,7 @@ void parse_body_multiple_statements(size_t* variable_size, struct vector* body_v
     // Push the body node to the stack
     node_push(body_node);
 
-    parser_current_body = body_node->binded.owner;
+    current_process->parser.current_body = body_node->binded.owner;
 }
 
 /**
@@ -1422,7 +1529,7 @@ void parse_body(size_t* variable_size, struct history*history)
         // We need to change the stack size inside function bodys
         if (history->flags & HISTORY_FLAG_INSIDE_FUNCTION_BODY)
         {
-            parser_current_function->func.stack_size += *variable_size;
+            current_process->parser.current_function->func.stack_size += *variable_size;
         }
     }
 }
@@ -1720,6 +1827,8 @@ struct  node* parse_else_or_else_if(struct history* history)
 
 void parse_if_stmt(struct history* history)
 {
+    // Statements that -fprofile-generate counts keep where their keyword is, the profile finds them by it
+    struct pos pos = token_peek_next()->pos;
     expect_keyword("if");
     expect_op("(");
     // Condition
@@ -1732,6 +1841,7 @@ void parse_if_stmt(struct history* history)
     parse_body(&var_size,history);
     struct node* body_node = node_pop();
     make_if_node(cond_node,body_node, parse_else_or_else_if(history));
+    node_peek()->pos = pos;
 }
 // Parses keyword(exp) pattern like while(exp) or if(exp) etc.
 void parse_keyword_parentheses_expression(const char* keyword)
@@ -1744,19 +1854,23 @@ void parse_keyword_parentheses_expression(const char* keyword)
 
 void parse_default(struct history* history)
 {
+	struct pos pos = token_peek_next()->pos;
 	expect_keyword("default");
 	expect_sym(':');
 	make_default_node();
+	node_peek()->pos = pos;
 	history->_switch.case_data->has_default_case = true;
 }
 
 void parse_case(struct history* history)
 {
+    struct pos pos = token_peek_next()->pos;
     expect_keyword("case");
     parse_expressionable_root(history);
     struct node* case_exp_node = node_pop();
     expect_sym(':');
     make_case_node(case_exp_node);
+    node_peek()->pos = pos;
 
     if (case_exp_node->type != NODE_TYPE_NUMBER)
     {
@@ -1770,6 +1884,7 @@ void parse_case(struct history* history)
 void parse_switch(struct history* history)
 {
     struct parser_history_switch _switch = parser_new_switch_statement(history);
+    struct pos pos = token_peek_next()->pos;
     parse_keyword_parentheses_expression("switch");
     struct node* switch_exp_node = node_pop();
     size_t variable_size = 0;
@@ -1778,11 +1893,13 @@ void parse_switch(struct history* history)
 
     // Make the switch node
     make_switch_node(switch_exp_node,body_node,_switch.case_data->cases,_switch.case_data->has_default_case);
+    node_peek()->pos = pos;
     parser_end_switch_statement(&_switch);
 }
 
 void parse_do_while(struct history*history)
 {
+    struct pos pos = token_peek_next()->pos;
     expect_keyword("do");
     size_t variable_size = 0;
     parse_body(&variable_size, history);
@@ -1792,16 +1909,19 @@ void parse_do_while(struct history*history)
     expect_sym(';');
 
     make_do_while_node(body_node,exp_node);
+    node_peek()->pos = pos;
 }
 
 void parse_while_stmt(struct history*history)
 {
+    struct pos pos = token_peek_next()->pos;
     parse_keyword_parentheses_expression("while");
     struct node* exp_node = node_pop();
     size_t variable_size = 0;
     parse_body(&variable_size,history);
     struct node* body_node = node_pop();
     make_while_node(exp_node,body_node);
+    node_peek()->pos = pos;
 }
 
 bool parse_for_loop_part(struct history* history)
@@ -1841,6 +1961,7 @@ void parse_for_stmt(struct history* history)
     struct node* body_node = NULL;
 
     // Need to parse 'for('
+    struct pos pos = token_peek_next()->pos;
     expect_keyword("for");
     expect_op("(");
     if (parse_for_loop_part(history))
@@ -1862,6 +1983,7 @@ void parse_for_stmt(struct history* history)
     body_node = node_pop();
 
     make_for_node(init_node,cond_node,loop_node,body_node);
+    node_peek()->pos = pos;
 }
 
 
@@ -2023,7 +2145,6 @@ int parse_expressionable_single(struct history* history)
     {
         return -1;
     }
-    history->flags |= NODE_FLAG_INSIDE_EXPRESSION;
     int res = -1;
     switch (token->type)
     {
@@ -2108,14 +2229,106 @@ int parse_next()
     return 0;
 }
 
+/*
+ * -flazy-parse
+ *
+ * The body of a static function is skipped when the parser gets to it, only the index of its '{' is kept. After the
+ * whole file is parsed the names the rest of the tree uses are collected. A skipped function with one of the names is
+ * parsed, the names in its body are added, until nothing new is found:
+ *
+ * static int a() { return b(); }     parsed, main calls it
+ * static int b() { return 1; }       parsed, a calls it
+ * static int c() { return 2; }       never parsed, removed from the tree
+ * int main() { return a(); }
+ *
+ * The functions left can't be called from this file, they are removed without being parsed, validated or generated.
+ * A skipped body is parsed after the globals that come after it, it can see them
+ */
+
+static bool parser_collect_names(struct node* node, void* private)
+{
+    if (node->type == NODE_TYPE_IDENTIFIER)
+    {
+        name_set_add(private, node->sval);
+    }
+    return true;
+}
+
+static void parser_parse_lazy_body(struct node* function_node)
+{
+    int resume_token = vector_peek_pointer(current_process->token_vec);
+    vector_set_peek_pointer(current_process->token_vec, function_node->func.lazy_body_token);
+
+    // The same state parse_function has around the body
+    parser_scope_new();
+    current_process->parser.current_function = function_node;
+    parse_function_body(history_begin(0));
+    function_node->func.body_n = node_pop();
+    function_node->func.lazy_body_token = 0;
+    current_process->parser.current_function = NULL;
+    parser_scope_finish();
+
+    vector_set_peek_pointer(current_process->token_vec, resume_token);
+}
+
+static bool parser_is_lazy_function(struct node* node)
+{
+    return node->type == NODE_TYPE_FUNCTION && node->func.lazy_body_token;
+}
+
+static void parser_parse_lazy_bodies()
+{
+    if (!(current_process->flags & COMPILE_PROCESS_LAZY_PARSE))
+    {
+        return;
+    }
+
+    struct vector* root = current_process->node_tree_vec;
+    struct name_set* names = name_set_create();
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (!parser_is_lazy_function(node))
+        {
+            node_walk(node, parser_collect_names, names);
+        }
+    }
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int i = 0; i < vector_count(root); i++)
+        {
+            struct node* node = vector_peek_ptr_at(root, i);
+            if (!parser_is_lazy_function(node) || !name_set_contains(names, node->func.name))
+            {
+                continue;
+            }
+            parser_parse_lazy_body(node);
+            node_walk(node->func.body_n, parser_collect_names, names);
+            changed = true;
+        }
+    }
+
+    for (int i = vector_count(root) - 1; i >= 0; i--)
+    {
+        if (parser_is_lazy_function(vector_peek_ptr_at(root, i)))
+        {
+            vector_pop_at(root, i);
+        }
+    }
+    name_set_free(names);
+}
+
 int parse(struct compiler_process *process)
 {
     scope_create_root(process);
     current_process = process;
-    parser_last_token = NULL;
-    node_set_vector(process->node_vec,process->node_tree_vec);
-    parser_blank_node = node_create(&(struct node){.type = NODE_TYPE_BLANK});
-    parser_fixup_sys = fixup_sys_new();
+    current_process->parser.last_token = NULL;
+    node_set_process(process);
+    current_process->parser.blank_node = node_create(&(struct node){.type = NODE_TYPE_BLANK});
+    current_process->parser.fixup_sys = fixup_sys_new();
     struct node *node = NULL;
     vector_set_peek_pointer(process->token_vec, 0);
     while (parse_next() == 0)
@@ -2123,9 +2336,10 @@ int parse(struct compiler_process *process)
         node = node_peek();
         vector_push(process->node_tree_vec, &node);
     }
+    parser_parse_lazy_bodies();
 
     // Resolves all fixups and asserts that it returns true (meaning all of it could be resolved)
-    assert(fixups_resolve(parser_fixup_sys));
+    compiler_assert(fixups_resolve(current_process->parser.fixup_sys));
     scope_free_root(process);
     return PARSE_ALL_OK;
 }
@@ -0,0 +1,168 @@
+#include "compiler.h"
+
+/*
+ * Pass manager
+ *
+ * The optimizations are passes with a name, they run in the order of the pipelines below when the optimization level
+ * is at least the level written next to them and they aren't turned off with -fno-<name>
+ *
+ * AST pipeline, once for the whole tree after validation:
+ *   deadcode       -O1
+ *
+ * IR pipeline, for every function the IR builds:
+ *   unreachable    -O0    blocks nothing jumps to, the IR code generators expect them to be gone, always runs
+ *   cse            -O1
+ *   licm           -O2
+ *   cse            -O2    the hoisted instructions can repeat each other inside the preheaders
+ *
+ * Code generation, the code generators ask compiler_pass_enabled before they generate the optimized form:
+ *   register-arguments  -O1    static functions take their first two arguments in ecx and edx
+ *   block-copy          -O1    big structures are copied with one mov sequence or rep movsd instead of push and pop
+ *   tail-calls          -O2    return f(x) overwrites our arguments and jumps to f
+ *
+ * -O0 generates every function the plain way, nothing is optimized. unreachable isn't an optimization the IR can do
+ * without, there is no -fno-unreachable
+ *
+ * -O0, -O1, -O2 and the -fno- flags are stored in the compile flags, so the cache and the compile server see them.
+ * Without any -O the compiler optimizes like -O2, as it always did
+ */
+
+struct compiler_pass
+{
+    const char* name;
+    // One of these
+    void (*run_ast)(struct compiler_process* process);
+    void (*run_ir)(struct ir_function* function);
+    // Runs whatever the flags say, it is in the table for its name in the time report
+    bool required;
+};
+
+static struct compiler_pass compiler_passes[COMPILER_TOTAL_PASSES] = {
+    [COMPILER_PASS_DEADCODE] = {.name = "deadcode", .run_ast = deadcode_eliminate},
+    [COMPILER_PASS_UNREACHABLE] = {.name = "unreachable", .run_ir = ir_function_remove_unreachable_blocks, .required = true},
+    [COMPILER_PASS_CSE] = {.name = "cse", .run_ir = ir_eliminate_common_subexpressions},
+    [COMPILER_PASS_LICM] = {.name = "licm", .run_ir = ir_hoist_loop_invariants},
+    // Nothing to run, the code generators check them
+    [COMPILER_PASS_TAIL_CALLS] = {.name = "tail-calls"},
+    [COMPILER_PASS_REGISTER_ARGUMENTS] = {.name = "register-arguments"},
+    [COMPILER_PASS_BLOCK_COPY] = {.name = "block-copy"},
+};
+
+struct compiler_pipeline_step
+{
+    int pass;
+    // The lowest optimization level the pass runs at
+    int level;
+};
+
+static struct compiler_pipeline_step compiler_ast_pipeline[] = {
+    {COMPILER_PASS_DEADCODE, 1},
+};
+
+static struct compiler_pipeline_step compiler_ir_pipeline[] = {
+    {COMPILER_PASS_UNREACHABLE, 0},
+    {COMPILER_PASS_CSE, 1},
+    {COMPILER_PASS_LICM, 2},
+    {COMPILER_PASS_CSE, 2},
+};
+
+static struct compiler_pipeline_step compiler_codegen_pipeline[] = {
+    {COMPILER_PASS_REGISTER_ARGUMENTS, 1},
+    {COMPILER_PASS_BLOCK_COPY, 1},
+    {COMPILER_PASS_TAIL_CALLS, 2},
+};
+
+const char* compiler_pass_name(int pass)
+{
+    return compiler_passes[pass].name;
+}
+
+int compiler_optimization_level(int flags)
+{
+    int level = (flags & COMPILE_PROCESS_OPTIMIZATION_LEVEL_MASK) / COMPILE_PROCESS_OPTIMIZATION_LEVEL_UNIT;
+    // 0 means no -O was given, the rest is -O0 + 1
+    return level ? level - 1 : 2;
+}
+
+static bool compiler_pass_should_run(struct compiler_process* process, struct compiler_pipeline_step* step)
+{
+    if (compiler_passes[step->pass].required)
+    {
+        return true;
+    }
+    return compiler_optimization_level(process->flags) >= step->level && !(process->flags & COMPILE_PROCESS_PASS_DISABLED(step->pass));
+}
+
+bool compiler_pass_enabled(struct compiler_process* process, int pass)
+{
+    for (size_t i = 0; i < sizeof(compiler_codegen_pipeline) / sizeof(struct compiler_pipeline_step); i++)
+    {
+        if (compiler_codegen_pipeline[i].pass == pass)
+        {
+            return compiler_pass_should_run(process, &compiler_codegen_pipeline[i]);
+        }
+    }
+    return false;
+}
+
+static void compiler_pass_run(struct compiler_process* process, struct compiler_pipeline_step* step, struct ir_function* function)
+{
+    if (!compiler_pass_should_run(process, step))
+    {
+        return;
+    }
+
+    struct compiler_pass* pass = &compiler_passes[step->pass];
+    compile_report_pass_start(process);
+    if (function)
+    {
+        pass->run_ir(function);
+    }
+    else
+    {
+        pass->run_ast(process);
+    }
+    compile_report_pass_end(process, step->pass);
+}
+
+void compiler_passes_run_ast(struct compiler_process* process)
+{
+    for (size_t i = 0; i < sizeof(compiler_ast_pipeline) / sizeof(struct compiler_pipeline_step); i++)
+    {
+        compiler_pass_run(process, &compiler_ast_pipeline[i], NULL);
+    }
+}
+
+void compiler_passes_run_ir(struct compiler_process* process, struct ir_function* function)
+{
+    for (size_t i = 0; i < sizeof(compiler_ir_pipeline) / sizeof(struct compiler_pipeline_step); i++)
+    {
+        compiler_pass_run(process, &compiler_ir_pipeline[i], function);
+    }
+}
+
+bool compiler_pass_flag_parse(const char* arg, int* flags)
+{
+    if (arg[0] == '-' && arg[1] == 'O' && arg[2] >= '0' && arg[2] <= '3' && !arg[3])
+    {
+        // -O3 is the same as -O2, there is nothing more to turn on
+        int level = arg[2] == '3' ? 2 : arg[2] - '0';
+        *flags = (*flags & ~COMPILE_PROCESS_OPTIMIZATION_LEVEL_MASK) | (level + 1) * COMPILE_PROCESS_OPTIMIZATION_LEVEL_UNIT;
+        return true;
+    }
+
+    if (strncmp(arg, "-fno-", 5) != 0)
+    {
+        return false;
+    }
+    for (int i = 0; i < COMPILER_TOTAL_PASSES; i++)
+    {
+        // -fno-unreachable is an unknown flag, the pass can't be turned off
+        if (S_EQ(arg + 5, compiler_passes[i].name) && !compiler_passes[i].required)
+        {
+            *flags |= COMPILE_PROCESS_PASS_DISABLED(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,356 @@
+#include "compiler.h"
+#include <stdlib.h>
+#include "helpers/vector.h"
+
+/*
+ * -fprofile-generate and -fprofile-use
+ *
+ * With -fprofile-generate the code generator puts a 64 bit counter in .bss for every function, if, loop, switch and
+ * case it generates, and increments it where the code of the node runs:
+ *
+ *   function entry     entries    after the stack frame is made
+ *   if                 entries    before the condition
+ *                      body       at the start of the body, the else ran entries - body times
+ *   while, do, for     entries    before the loop
+ *                      body       at the start of the body, once for every iteration
+ *   switch             entries    before the value is computed
+ *   case, default      entries    after its label, a case fallen into from the one above it is counted too
+ *
+ *   add dword [__profile_counters+8], 1
+ *   adc dword [__profile_counters+12], 0
+ *
+ * The first counted function that is called registers __profile_dump with atexit, which appends a line for every
+ * counter to the profile file:
+ *
+ *   file function line col entries|body count
+ *
+ * The file is $C_COMPILER_PROFILE at compile time, or compiler.profile in the directory the program runs in. Runs add
+ * new lines, -fprofile-use sums the lines of the same node and stores the counts in node->profile, the code generator
+ * lays out the ifs, loops and switches by them (see codegen.c). The file is written with realpath, ./a.c and /src/a.c
+ * are the same source for both flags. File and function names can't have spaces in them
+ *
+ * Only the AST code generator is instrumented, -fprofile-generate can't be used with -fuse-ir, -m64 or exec-jit
+ */
+
+#define PROFILE_COUNTER_SIZE 8
+#define PROFILE_HASH_BUCKETS 1024
+
+static const char* profile_counter_names[] = {
+    [PROFILE_COUNTER_ENTRIES] = "entries",
+    [PROFILE_COUNTER_BODY] = "body"};
+
+const char* profile_file_path()
+{
+    const char* env = getenv(PROFILE_FILE_ENV);
+    return env && *env ? env : PROFILE_DEFAULT_FILE;
+}
+
+// The name of the source in the profile, the same however the path was typed
+static const char* profile_source_file(struct compiler_process* process)
+{
+    if (!process->cfile.abs_path)
+    {
+        return "<source>";
+    }
+
+    char* real_path = realpath(process->cfile.abs_path, NULL);
+    if (!real_path)
+    {
+        return process->cfile.abs_path;
+    }
+    const char* source_file = arena_strdup(real_path);
+    free(real_path);
+    return source_file;
+}
+
+void profile_generate_counter(struct compiler_process* process, struct node* node, int counter)
+{
+    if (!(process->flags & COMPILE_PROCESS_PROFILE_GENERATE))
+    {
+        return;
+    }
+
+    struct code_generator* generator = process->generator;
+    struct profile_site site = {.function = generator->current_function->func.name, .pos = node->pos, .counter = counter};
+    int offset = vector_count(generator->profile_sites) * PROFILE_COUNTER_SIZE;
+    vector_push(generator->profile_sites, &site);
+
+    // The carry goes to the high half, a counter doesn't overflow in any real run
+    asm_push("add dword [__profile_counters+%i], 1", offset);
+    asm_push("adc dword [__profile_counters+%i], 0", offset + 4);
+}
+
+void profile_generate_function_entry(struct compiler_process* process, struct node* func_node)
+{
+    if (!(process->flags & COMPILE_PROCESS_PROFILE_GENERATE))
+    {
+        return;
+    }
+
+    // The arguments are on the stack and nothing is in the registers yet, the call can use eax, ecx and edx
+    int registered_label_id = codegen_label_count();
+    asm_push("cmp dword [__profile_registered], 0");
+    asm_push("jne .profile_registered_%i", registered_label_id);
+    asm_push("call __profile_register");
+    asm_push(".profile_registered_%i:", registered_label_id);
+    profile_generate_counter(process, func_node, PROFILE_COUNTER_ENTRIES);
+}
+
+/*
+ * __profile_dump:
+ * push ebp
+ * mov ebp, esp
+ * push ebx
+ * push dword str_1         ; "a"
+ * push dword str_2         ; the profile file
+ * call fopen
+ * ...
+ * push dword [__profile_counters+4]
+ * push dword [__profile_counters]
+ * push dword str_5         ; "entries"
+ * push dword 3             ; col
+ * push dword 1             ; line
+ * push dword str_4         ; the function
+ * push dword str_3         ; the source file
+ * push dword str_6         ; "%s %s %i %i %s %llu"
+ * push ebx
+ * call fprintf
+ * add esp, 36
+ * ...
+ */
+static void profile_generate_dump(struct compiler_process* process)
+{
+    struct vector* sites = process->generator->profile_sites;
+    const char* source_file = codegen_register_string(profile_source_file(process));
+    const char* format = codegen_register_string("%s %s %i %i %s %llu\n");
+
+    asm_push("__profile_dump:");
+    asm_push("push ebp");
+    asm_push("mov ebp, esp");
+    asm_push("push ebx");
+    asm_push("push dword %s", codegen_register_string("a"));
+    asm_push("push dword %s", codegen_register_string(profile_file_path()));
+    asm_push("call fopen");
+    asm_push("add esp, 8");
+    asm_push("cmp eax, 0");
+    asm_push("je .done");
+    asm_push("mov ebx, eax");
+    for (int i = 0; i < vector_count(sites); i++)
+    {
+        struct profile_site* site = vector_at(sites, i);
+        asm_push("push dword [__profile_counters+%i]", i * PROFILE_COUNTER_SIZE + 4);
+        asm_push("push dword [__profile_counters+%i]", i * PROFILE_COUNTER_SIZE);
+        asm_push("push dword %s", codegen_register_string(profile_counter_names[site->counter]));
+        asm_push("push dword %i", site->pos.col);
+        asm_push("push dword %i", site->pos.line);
+        asm_push("push dword %s", codegen_register_string(site->function));
+        asm_push("push dword %s", source_file);
+        asm_push("push dword %s", format);
+        asm_push("push ebx");
+        asm_push("call fprintf");
+        asm_push("add esp, 36");
+    }
+    asm_push("push ebx");
+    asm_push("call fclose");
+    asm_push("add esp, 4");
+    asm_push(".done:");
+    asm_push("pop ebx");
+    asm_push("pop ebp");
+    asm_push("ret");
+}
+
+void profile_generate_data(struct compiler_process* process)
+{
+    if (!(process->flags & COMPILE_PROCESS_PROFILE_GENERATE) || !vector_count(process->generator->profile_sites))
+    {
+        return;
+    }
+
+    asm_push("extern fopen");
+    asm_push("extern fprintf");
+    asm_push("extern fclose");
+    asm_push("extern atexit");
+    asm_push("section .text");
+    profile_generate_dump(process);
+
+    asm_push("__profile_register:");
+    asm_push("mov dword [__profile_registered], 1");
+    asm_push("push dword __profile_dump");
+    asm_push("call atexit");
+    asm_push("add esp, 4");
+    asm_push("ret");
+
+    asm_push("section .bss");
+    asm_push("__profile_registered: resd 1");
+    asm_push("__profile_counters: resb %i", vector_count(process->generator->profile_sites) * PROFILE_COUNTER_SIZE);
+}
+
+/*
+ * Reading the profile back
+ *
+ * The lines of this source file are summed into a hash table by function, line, col and counter, then every counted
+ * node gets its counts from it
+ */
+
+struct profile_record
+{
+    const char* function;
+    int line;
+    int col;
+    int counter;
+    unsigned long long count;
+    struct profile_record* next_in_bucket;
+};
+
+struct profile_table
+{
+    struct profile_record** buckets;
+    // The function the nodes being walked are in
+    const char* function;
+};
+
+// FNV-1a
+static unsigned int profile_hash(const char* function, int line, int col)
+{
+    unsigned int hash = 2166136261u;
+    for (const char* c = function; *c; c++)
+    {
+        hash ^= (unsigned char)*c;
+        hash *= 16777619u;
+    }
+    hash ^= line;
+    hash *= 16777619u;
+    hash ^= col;
+    hash *= 16777619u;
+    return hash % PROFILE_HASH_BUCKETS;
+}
+
+static struct profile_record* profile_find(struct profile_table* table, const char* function, int line, int col, int counter)
+{
+    struct profile_record* record = table->buckets[profile_hash(function, line, col)];
+    while (record)
+    {
+        if (record->line == line && record->col == col && record->counter == counter && S_EQ(record->function, function))
+        {
+            return record;
+        }
+        record = record->next_in_bucket;
+    }
+    return NULL;
+}
+
+static int profile_counter_from_name(const char* name)
+{
+    for (size_t i = 0; i < sizeof(profile_counter_names) / sizeof(const char*); i++)
+    {
+        if (S_EQ(name, profile_counter_names[i]))
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void profile_add_record(struct profile_table* table, const char* function, int line, int col, int counter, unsigned long long count)
+{
+    struct profile_record* record = profile_find(table, function, line, col, counter);
+    if (record)
+    {
+        record->count += count;
+        return;
+    }
+
+    record = arena_calloc(1, sizeof(struct profile_record));
+    record->function = arena_strdup(function);
+    record->line = line;
+    record->col = col;
+    record->counter = counter;
+    record->count = count;
+    struct profile_record** bucket = &table->buckets[profile_hash(function, line, col)];
+    record->next_in_bucket = *bucket;
+    *bucket = record;
+}
+
+static bool profile_node_is_counted(struct node* node)
+{
+    switch (node->type)
+    {
+    case NODE_TYPE_FUNCTION:
+    case NODE_TYPE_STATEMENT_IF:
+    case NODE_TYPE_STATEMENT_WHILE:
+    case NODE_TYPE_STATEMENT_DO_WHILE:
+    case NODE_TYPE_STATEMENT_FOR:
+    case NODE_TYPE_STATEMENT_SWITCH:
+    case NODE_TYPE_STATEMENT_CASE:
+    case NODE_TYPE_STATEMENT_DEFAULT:
+        return true;
+    }
+    return false;
+}
+
+static bool profile_attach(struct node* node, void* private)
+{
+    struct profile_table* table = private;
+    if (!profile_node_is_counted(node))
+    {
+        return true;
+    }
+
+    struct profile_record* entries = profile_find(table, table->function, node->pos.line, node->pos.col, PROFILE_COUNTER_ENTRIES);
+    struct profile_record* body = profile_find(table, table->function, node->pos.line, node->pos.col, PROFILE_COUNTER_BODY);
+    if (entries || body)
+    {
+        node->profile = arena_calloc(1, sizeof(struct node_profile));
+        node->profile->entries = entries ? entries->count : 0;
+        node->profile->body = body ? body->count : 0;
+    }
+    return true;
+}
+
+void profile_load(struct compiler_process* process)
+{
+    const char* path = profile_file_path();
+    FILE* fp = fopen(path, "r");
+    if (!fp)
+    {
+        compiler_warning(process, "Could not open the profile %s, compiling without it", path);
+        return;
+    }
+
+    struct profile_table table = {.buckets = arena_calloc(PROFILE_HASH_BUCKETS, sizeof(struct profile_record*))};
+    const char* source_file = profile_source_file(process);
+    char line_buffer[2048];
+    char file[1024];
+    char function[512];
+    char counter_name[16];
+    while (fgets(line_buffer, sizeof(line_buffer), fp))
+    {
+        int line = 0;
+        int col = 0;
+        unsigned long long count = 0;
+        if (sscanf(line_buffer, "%1023s %511s %i %i %15s %llu", file, function, &line, &col, counter_name, &count) != 6)
+        {
+            continue;
+        }
+        int counter = profile_counter_from_name(counter_name);
+        // The profile can have the lines of every file of the program
+        if (counter < 0 || strcmp(file, source_file) != 0)
+        {
+            continue;
+        }
+        profile_add_record(&table, function, line, col, counter, count);
+    }
+    fclose(fp);
+
+    struct vector* root = process->node_tree_vec;
+    for (int i = 0; i < vector_count(root); i++)
+    {
+        struct node* node = vector_peek_ptr_at(root, i);
+        if (node->type != NODE_TYPE_FUNCTION)
+        {
+            continue;
+        }
+        table.function = node->func.name;
+        node_walk(node, profile_attach, &table);
+    }
+}
@@ -1,5 +1,4 @@
 #include "compiler.h"
-#include <assert.h>
 #include <stdlib.h>
 #include <memory.h>
 struct resolver_default_entity_data* resolver_default_entity_private(struct resolver_entity* entity)
@@ -26,7 +25,7 @@ char* resolver_default_stack_asm_address(int stack_offset, char* out)
 
 struct resolver_default_entity_data* resolver_default_new_entity_data()
 {
-    struct resolver_default_entity_data* entity_data = calloc(sizeof(struct resolver_default_entity_data),1);
+    struct resolver_default_entity_data* entity_data = arena_calloc(sizeof(struct resolver_default_entity_data),1);
     return entity_data;
 }
 
@@ -108,7 +107,7 @@ void resolver_default_set_result_base(struct resolver_result* result, struct res
 struct resolver_default_entity_data* resolver_default_new_entity_data_for_var_node(struct node* var_node, int offset, int flags)
 {
     struct resolver_default_entity_data* entity_data = resolver_default_new_entity_data();
-    assert(variable_node(var_node));
+    compiler_assert(variable_node(var_node));
     entity_data->offset = offset;
     entity_data->flags = flags;
     entity_data->type = RESOLVER_DEFAULT_ENTITY_DATA_TYPE_VARIABLE;
@@ -136,7 +135,7 @@ struct resolver_default_entity_data* resolver_default_new_entity_data_for_functi
 
 struct resolver_entity* resolver_default_new_scope_entity(struct resolver_process* resolver, struct node* var_node, int offset,int flags)
 {
-    assert(var_node->type == NODE_TYPE_VARIABLE);
+    compiler_assert(var_node->type == NODE_TYPE_VARIABLE);
     struct resolver_default_entity_data*entity_data = resolver_default_new_entity_data_for_var_node(variable_node(var_node),offset,flags);
     return resolver_new_entity_for_var_node(resolver, variable_node(var_node),entity_data,offset);
 }
@@ -149,7 +148,7 @@ struct resolver_entity* resolver_default_register_function(struct resolver_proce
 
 void resolver_default_new_scope(struct resolver_process* resolver, int flags)
 {
-    struct resolver_default_scope_data* scope_data = calloc(sizeof(struct resolver_default_scope_data),1);
+    struct resolver_default_scope_data* scope_data = arena_calloc(sizeof(struct resolver_default_scope_data),1);
     scope_data->flags |= flags;
     resolver_new_scope(resolver,scope_data,flags);
 }
@@ -166,17 +165,17 @@ void* resolver_default_new_array_entity(struct resolver_result* result, struct n
 
 void resolver_default_delete_entity(struct resolver_entity* entity)
 {
-    free(entity->private);
+    arena_free(entity->private);
 }
 
 void resolver_default_delete_scope(struct resolver_scope* scope)
 {
-    free(scope->private);
+    arena_free(scope->private);
 }
 
 static void resolver_default_merge_array_calculate_out_offset(struct datatype* dtype, struct resolver_entity* entity, int* out_offset)
 {
-    assert(entity->array.array_index_node->type == NODE_TYPE_NUMBER);
+    compiler_assert(entity->array.array_index_node->type == NODE_TYPE_NUMBER);
     int index_val = entity->array.array_index_node->llnum;
     *(out_offset) += array_offset(dtype,entity->array.index,index_val);
 }
@@ -0,0 +1,194 @@
+#include "compiler.h"
+#include <time.h>
+#include <sys/resource.h>
+
+/*
+ * -ftime-report
+ *
+ * Every phase of compile_process is measured between compile_report_phase_start and compile_report_phase_end, the
+ * phase is named when it ends like the passes are: the wall time, the CPU time of the compiling thread, how much the peak memory of the process grew and what was
+ * allocated. The other modules count what they make through compile_report_current, it is NULL without -ftime-report
+ *
+ * -ftime-report prints a table to stderr, -ftime-report=json prints one JSON object per line for every compiled file
+ */
+
+_Thread_local struct compile_report* compile_report_current = NULL;
+
+static const char* compile_report_phase_names[COMPILE_TOTAL_PHASES] = {
+    [COMPILE_PHASE_LEX] = "lex",
+    [COMPILE_PHASE_PARSE] = "parse",
+    [COMPILE_PHASE_VALIDATE] = "validate",
+    [COMPILE_PHASE_AST_PASSES] = "passes",
+    [COMPILE_PHASE_CODEGEN] = "codegen",
+    [COMPILE_PHASE_ASSEMBLE] = "assemble"};
+
+static double compile_report_clock_ms(clockid_t clock)
+{
+    struct timespec time;
+    clock_gettime(clock, &time);
+    return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+}
+
+// Kilobytes, the peak of the whole process
+static long compile_report_peak_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void compile_report_begin(struct compiler_process* process)
+{
+    if (!(process->flags & (COMPILE_PROCESS_TIME_REPORT | COMPILE_PROCESS_TIME_REPORT_JSON)))
+    {
+        return;
+    }
+    process->report = arena_calloc(1, sizeof(struct compile_report));
+    compile_report_current = process->report;
+}
+
+void compile_report_phase_start(struct compiler_process* process)
+{
+    struct compile_report* report = process->report;
+    if (!report)
+    {
+        return;
+    }
+
+    struct arena_statistics allocated;
+    arena_statistics(&allocated);
+    report->start.wall_ms = compile_report_clock_ms(CLOCK_MONOTONIC);
+    report->start.cpu_ms = compile_report_clock_ms(CLOCK_THREAD_CPUTIME_ID);
+    report->start.peak_rss_kb = compile_report_peak_rss();
+    report->start.allocations = allocated.allocations;
+    report->start.allocated_bytes = allocated.bytes;
+}
+
+void compile_report_phase_end(struct compiler_process* process, int phase)
+{
+    struct compile_report* report = process->report;
+    if (!report)
+    {
+        return;
+    }
+
+    struct arena_statistics allocated;
+    arena_statistics(&allocated);
+    // The times of a phase measured more than once add up
+    struct compile_phase_report* phase_report = &report->phases[phase];
+    phase_report->ran = true;
+    phase_report->wall_ms += compile_report_clock_ms(CLOCK_MONOTONIC) - report->start.wall_ms;
+    phase_report->cpu_ms += compile_report_clock_ms(CLOCK_THREAD_CPUTIME_ID) - report->start.cpu_ms;
+    phase_report->peak_rss_delta_kb += compile_report_peak_rss() - report->start.peak_rss_kb;
+    phase_report->allocations += allocated.allocations - report->start.allocations;
+    phase_report->allocated_bytes += allocated.bytes - report->start.allocated_bytes;
+}
+
+void compile_report_pass_start(struct compiler_process* process)
+{
+    struct compile_report* report = process->report;
+    if (!report)
+    {
+        return;
+    }
+    report->pass_start.wall_ms = compile_report_clock_ms(CLOCK_MONOTONIC);
+    report->pass_start.cpu_ms = compile_report_clock_ms(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void compile_report_pass_end(struct compiler_process* process, int pass)
+{
+    struct compile_report* report = process->report;
+    if (!report)
+    {
+        return;
+    }
+    struct compile_pass_report* pass_report = &report->passes[pass];
+    pass_report->runs++;
+    pass_report->wall_ms += compile_report_clock_ms(CLOCK_MONOTONIC) - report->pass_start.wall_ms;
+    pass_report->cpu_ms += compile_report_clock_ms(CLOCK_THREAD_CPUTIME_ID) - report->pass_start.cpu_ms;
+}
+
+static void compile_report_print_table(struct compiler_process* process, struct compile_report* report, FILE* out)
+{
+    struct compile_phase_report total = {};
+    fprintf(out, "Time report for %s\n", process->cfile.abs_path ? process->cfile.abs_path : "<source>");
+    fprintf(out, "%-10s %12s %12s %14s %12s %14s\n", "phase", "wall ms", "cpu ms", "peak rss kb", "allocations", "bytes");
+    for (int i = 0; i < COMPILE_TOTAL_PHASES; i++)
+    {
+        struct compile_phase_report* phase = &report->phases[i];
+        if (!phase->ran)
+        {
+            continue;
+        }
+        fprintf(out, "%-10s %12.3f %12.3f %14ld %12zu %14zu\n", compile_report_phase_names[i], phase->wall_ms, phase->cpu_ms, phase->peak_rss_delta_kb, phase->allocations, phase->allocated_bytes);
+        total.wall_ms += phase->wall_ms;
+        total.cpu_ms += phase->cpu_ms;
+        total.peak_rss_delta_kb += phase->peak_rss_delta_kb;
+        total.allocations += phase->allocations;
+        total.allocated_bytes += phase->allocated_bytes;
+    }
+    fprintf(out, "%-10s %12.3f %12.3f %14ld %12zu %14zu\n", "total", total.wall_ms, total.cpu_ms, total.peak_rss_delta_kb, total.allocations, total.allocated_bytes);
+    fprintf(out, "tokens %zu, nodes %zu, resolver entities %zu, stack frame elements %zu, instructions %zu\n",
+            report->tokens, report->nodes, report->resolver_entities, report->stack_frame_elements, report->instructions);
+
+    fprintf(out, "%-20s %6s %12s %12s   (-O%i)\n", "pass", "runs", "wall ms", "cpu ms", compiler_optimization_level(process->flags));
+    for (int i = 0; i < COMPILER_TOTAL_PASSES; i++)
+    {
+        struct compile_pass_report* pass = &report->passes[i];
+        fprintf(out, "%-20s %6i %12.3f %12.3f\n", compiler_pass_name(i), pass->runs, pass->wall_ms, pass->cpu_ms);
+    }
+}
+
+static void compile_report_print_json(struct compiler_process* process, struct compile_report* report, FILE* out)
+{
+    // The file name is printed as it is, it is expected not to have quotes or backslashes in it
+    fprintf(out, "{\"file\":\"%s\",\"phases\":[", process->cfile.abs_path ? process->cfile.abs_path : "<source>");
+    bool first = true;
+    for (int i = 0; i < COMPILE_TOTAL_PHASES; i++)
+    {
+        struct compile_phase_report* phase = &report->phases[i];
+        if (!phase->ran)
+        {
+            continue;
+        }
+        fprintf(out, "%s{\"name\":\"%s\",\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"peak_rss_delta_kb\":%ld,\"allocations\":%zu,\"allocated_bytes\":%zu}",
+                first ? "" : ",", compile_report_phase_names[i], phase->wall_ms, phase->cpu_ms, phase->peak_rss_delta_kb, phase->allocations, phase->allocated_bytes);
+        first = false;
+    }
+    fprintf(out, "],\"optimization_level\":%i,\"passes\":[", compiler_optimization_level(process->flags));
+    for (int i = 0; i < COMPILER_TOTAL_PASSES; i++)
+    {
+        struct compile_pass_report* pass = &report->passes[i];
+        fprintf(out, "%s{\"name\":\"%s\",\"runs\":%i,\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", i ? "," : "", compiler_pass_name(i), pass->runs, pass->wall_ms, pass->cpu_ms);
+    }
+    fprintf(out, "],\"counts\":{\"tokens\":%zu,\"nodes\":%zu,\"resolver_entities\":%zu,\"stack_frame_elements\":%zu,\"instructions\":%zu}}\n",
+            report->tokens, report->nodes, report->resolver_entities, report->stack_frame_elements, report->instructions);
+}
+
+void compile_report_finish(struct compiler_process* process)
+{
+    struct compile_report* report = process->report;
+    if (!report)
+    {
+        return;
+    }
+    compile_report_current = NULL;
+
+    // compile_source gives the report to its caller
+    if (process->flags & COMPILE_PROCESS_LIBRARY)
+    {
+        return;
+    }
+
+    // Files compiled at the same time by ./main -o must not mix their lines
+    flockfile(stderr);
+    if (process->flags & COMPILE_PROCESS_TIME_REPORT_JSON)
+    {
+        compile_report_print_json(process, report, stderr);
+    }
+    else
+    {
+        compile_report_print_table(process, report, stderr);
+    }
+    funlockfile(stderr);
+}
@@ -1,7 +1,6 @@
 #include "compiler.h"
 #include <stdlib.h>
 #include "helpers/vector.h"
-#include <assert.h>
 void resolver_follow_part(struct resolver_process* resolver, struct node* node, struct resolver_result* result);
 struct resolver_entity* resolver_follow_exp (struct resolver_process* resolver, struct node* node, struct resolver_result* result);
 struct resolver_result* resolver_follow(struct resolver_process* resolver, struct node* node);
@@ -39,7 +38,7 @@ struct resolver_entity* resolver_entity_clone(struct resolver_entity* entity)
         return NULL;
     }
 
-    struct resolver_entity* entity_new = calloc(1, sizeof(struct resolver_entity));
+    struct resolver_entity* entity_new = arena_calloc(1, sizeof(struct resolver_entity));
     memcpy(entity_new,entity,sizeof(struct resolver_entity));
     return entity_new;
 }
@@ -57,7 +56,7 @@ struct resolver_entity* resolver_result_entity(struct resolver_result*result)
 
 struct resolver_result* resolver_new_result(struct resolver_process* process)
 {
-    struct resolver_result* result = calloc(1, sizeof(struct resolver_result));
+    struct resolver_result* result = arena_calloc(1, sizeof(struct resolver_result));
     result->array_data.array_entities = vector_create(sizeof(struct resolver_entity*));
     return result;
 }
@@ -65,7 +64,7 @@ struct resolver_result* resolver_new_result(struct resolver_process* process)
 void resolver_result_free(struct resolver_result* result)
 {
     vector_free(result->array_data.array_entities);
-    free(result);
+    arena_free(result);
 }
 
 struct resolver_scope* resolver_process_scope_current(struct resolver_process* process)
@@ -173,7 +172,7 @@ struct resolver_scope* resolver_scope_root(struct resolver_process*process)
 
 struct resolver_scope* resolver_new_scope_create()
 {
-    struct resolver_scope* scope = calloc(1,sizeof(struct resolver_scope));
+    struct resolver_scope* scope = arena_calloc(1,sizeof(struct resolver_scope));
     scope->entities = vector_create(sizeof(struct resolver_entity*));
     return scope;
 }
@@ -200,13 +199,13 @@ void resolver_finish_scope(struct resolver_process* resolver)
     struct resolver_scope* scope = resolver->scope.current;
     resolver->scope.current = scope->prev;
     resolver->callbacks.delete_scope(scope);
-    free(scope);
+    arena_free(scope);
 }
 
 
 struct resolver_process* resolver_new_process(struct compiler_process* compiler, struct resolver_callback* callbacks)
 {
-    struct resolver_process* process = calloc(1, sizeof(struct resolver_process));
+    struct resolver_process* process = arena_calloc(1, sizeof(struct resolver_process));
     process->compiler = compiler;
     memcpy(&process->callbacks, callbacks, sizeof(process->callbacks));
     process->scope.root = resolver_new_scope_create();
@@ -216,11 +215,12 @@ struct resolver_process* resolver_new_process(struct compiler_process* compiler,
 
 struct resolver_entity* resolver_create_new_entity(struct resolver_result* result, int type, void* private)
 {
-    struct resolver_entity*entity = calloc(1, sizeof(struct resolver_entity));
+    struct resolver_entity*entity = arena_calloc(1, sizeof(struct resolver_entity));
     if (!entity)
     {
         return NULL;
     }
+    COMPILE_REPORT_COUNT(resolver_entities);
     entity->type = type;
     entity->private = private;
     return entity;
@@ -248,7 +248,7 @@ struct resolver_entity* resolver_create_new_entity_for_array_brackets(struct res
     }
 
     entity->scope = scope;
-    assert(entity->scope);
+    compiler_assert(entity->scope);
     entity->name = NULL;
     entity->dtype = *dtype;
     entity->node = node;
@@ -273,7 +273,7 @@ struct resolver_entity* resolver_create_new_entity_for_merged_array_bracket(stru
     }
 
     entity->scope = scope;
-    assert(scope);
+    compiler_assert(scope);
     entity->name = NULL;
     entity->dtype = *dtype;
     entity->node = node;
@@ -347,7 +347,7 @@ struct resolver_entity* resolver_create_new_cast_entity( struct resolver_process
 
 struct resolver_entity* resolver_create_new_entity_for_var_node_custom_scope( struct resolver_process* process,struct node* var_node, void* private,struct resolver_scope* scope,int offset)
 {
-    assert(var_node->type == NODE_TYPE_VARIABLE);
+    compiler_assert(var_node->type == NODE_TYPE_VARIABLE);
     struct resolver_entity* entity = resolver_create_new_entity(NULL,RESOLVER_ENTITY_TYPE_VARIABLE,private);
     if (!entity)
     {
@@ -355,7 +355,7 @@ struct resolver_entity* resolver_create_new_entity_for_var_node_custom_scope( st
     }
 	
     entity->scope = scope;
-    assert(entity->scope);
+    compiler_assert(entity->scope);
     entity->dtype = var_node->var.type;
     entity->var_data.dtype = var_node->var.type;
     entity->node = var_node;
@@ -723,7 +723,7 @@ struct resolver_entity* resolver_follow_function_call (struct resolver_process*
     resolver_follow_part(resolver,node->exp.left,result);
     struct resolver_entity* left_entity = resolver_result_peek(result);
     struct resolver_entity* func_call_entity = resolver_create_new_entity_for_function_call(result,resolver,left_entity,NULL);
-    assert(func_call_entity);
+    compiler_assert(func_call_entity);
     func_call_entity->flags |= RESOLVER_ENTITY_FLAG_NO_MERGE_WITH_LEFT_ENTITY | RESOLVER_ENTITY_FLAG_NO_MERGE_WITH_NEXT_ENTITY;
     // Right node is the func arguments, left one is the func name
     resolver_build_function_call_arguments(resolver,node->exp.right,func_call_entity,&func_call_entity->func_call_data.stack_size);
@@ -789,7 +789,7 @@ void resolver_array_bracket_set_flags(struct resolver_entity* bracket_entity,str
 struct resolver_entity* resolver_follow_array_bracket(struct resolver_process* resolver, struct node* node, struct resolver_result* result)
 {
     // Make sure it's a bracket node
-    assert(node->type == NODE_TYPE_BRACKET);
+    compiler_assert(node->type == NODE_TYPE_BRACKET);
     int index = 0;
     struct datatype dtype;
     struct resolver_scope* scope = NULL;
@@ -860,7 +860,7 @@ struct resolver_entity* resolver_follow_unsupported_node(struct resolver_process
     }
 
     struct resolver_entity* unsupported_entity = resolver_create_new_entity_for_unsupported_node(result,node);
-    assert(unsupported_entity);
+    compiler_assert(unsupported_entity);
     resolver_result_entity_push(result,unsupported_entity);
     return unsupported_entity;
 }
@@ -973,7 +973,7 @@ void resolver_follow_part(struct resolver_process* resolver, struct node* node,
 
 void resolver_rule_apply_rules(struct resolver_entity* rule_entity,struct resolver_entity* left_entity,struct resolver_entity* right_entity)
 {
-    assert(rule_entity->type == RESOLVER_ENTITY_TYPE_RULE);
+    compiler_assert(rule_entity->type == RESOLVER_ENTITY_TYPE_RULE);
 
     // Apply the rules for both side entities
     if (left_entity)
@@ -1173,9 +1173,16 @@ void resolver_finalize_result_flags(struct resolver_process* resolver, struct re
     {
         flags |= RESOLVER_RESULT_FLAG_FINAL_INDIRECTION_REQUIRED_FOR_VALUE;
     }
+    else if (last_entity->type == RESOLVER_ENTITY_TYPE_ARRAY_BRACKET && !(last_entity->flags & RESOLVER_ENTITY_FLAG_DO_IS_POINTER_ARRAY_ENTITY) &&
+             (!(last_entity->dtype.flags & DATATYPE_FLAG_IS_ARRAY) || array_brackets_count(&last_entity->dtype) <= last_entity->array.index + 1))
+    {
+        // int abc[50]; abc[i]; -> a bracket with a runtime index isn't merged into the variable, it leaves the address of the element
+        // int abc[50][2]; abc[i]; -> is still an array, the address is the value
+        flags |= RESOLVER_RESULT_FLAG_FINAL_INDIRECTION_REQUIRED_FOR_VALUE;
+    }
     if (does_get_address)
     {
-        flags |= ~RESOLVER_RESULT_FLAG_FINAL_INDIRECTION_REQUIRED_FOR_VALUE;
+        flags &= ~RESOLVER_RESULT_FLAG_FINAL_INDIRECTION_REQUIRED_FOR_VALUE;
     }
     result->flags |= flags;
 }
@@ -1242,8 +1249,8 @@ void resolver_finalize_result(struct resolver_process* resolver, struct resolver
 // Node will be the expression node (for example a.b.c -> it will be a)
 struct resolver_result* resolver_follow(struct resolver_process* resolver, struct node* node)
 {
-    assert(resolver);
-    assert(node);
+    compiler_assert(resolver);
+    compiler_assert(node);
     struct resolver_result* result = resolver_new_result(resolver);
     resolver_follow_part(resolver,node,result);
     // Make sure we have a root entity
@@ -3,13 +3,12 @@
 #include <memory.h>
 #include <stdlib.h>
 
-#include <assert.h>
 
 
 
 struct scope* scope_alloc()
 {
-    struct scope* scope = calloc(1,sizeof(struct scope));
+    struct scope* scope = arena_calloc(1,sizeof(struct scope));
     scope->entities = vector_create(sizeof(void*));
     vector_set_peek_pointer_end(scope->entities);
     vector_set_flag(scope->entities,VECTOR_FLAG_PEEK_DECREMENT);
@@ -23,8 +22,8 @@ void scope_dealloc(struct scope* scope)
 
 struct scope* scope_create_root(struct compiler_process* process)
 {
-    assert(!process->scope.root);
-    assert(!process->scope.current);
+    compiler_assert(!process->scope.root);
+    compiler_assert(!process->scope.current);
 
 
     struct scope* root_scope = scope_alloc();
@@ -42,8 +41,8 @@ void scope_free_root(struct compiler_process* process)
 
 struct scope* scope_new(struct compiler_process* process, int flags)
 {
-    assert(process->scope.root);
-    assert(process->scope.current);
+    compiler_assert(process->scope.root);
+    compiler_assert(process->scope.current);
 
     struct scope* new_scope = scope_alloc();
     new_scope->flags = flags;
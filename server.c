@@ -0,0 +1,339 @@
+#define _GNU_SOURCE
+#include "compiler.h"
+#include "helpers/buffer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/*
+ * Compile server
+ *
+ * ./main -fserver [socket]                     ./client a.c a.asm -fuse-ir
+ *
+ *  accept <- | request | cwd | argv[1] | argv[2] | ... |  <- client
+ *  fork:   compile_source, the files are relative to the cwd of the client
+ *  send   -> | response | stdout | stderr |                -> printed by the client, its exit code is the status
+ *
+ * The server stays alive between requests, a build running the compiler thousands of times pays for starting the process
+ * once. Every compilation is a compile_source so an error can't end the server, its messages are sent to the client the
+ * same way the compiler would print them. Requests the server can't do the same way as ./main (exec-jit, more files,
+ * the cache, the time report) are answered with run_locally and the client runs ./main itself
+ *
+ * Every connection is handled by a child process forked for it, a make -j build gets its files compiled at the same time
+ * and an assert a source reaches in the compiler only ends that child. The client sees the connection close without a
+ * response and runs ./main, which fails the same way. The server never changes its working directory, the paths of a
+ * request are joined to the cwd the client sent. Only the user running the server can connect, the socket is created with mode
+ * 0600 and the uid of every client is checked with SO_PEERCRED
+ */
+
+struct compile_server_reply
+{
+    struct buffer* out;
+    struct buffer* err;
+    int exit_code;
+    bool run_locally;
+};
+
+const char* compile_server_default_socket()
+{
+    static _Thread_local char path[108];
+    const char* env = getenv(COMPILE_SERVER_SOCKET_ENV);
+    if (env && *env)
+    {
+        return env;
+    }
+    snprintf(path, sizeof(path), "/tmp/c_compiler-%u.sock", (unsigned)getuid());
+    return path;
+}
+
+static bool compile_server_read_all(int fd, void* data, size_t size)
+{
+    char* ptr = data;
+    while (size)
+    {
+        ssize_t res = read(fd, ptr, size);
+        if (res < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            return false;
+        }
+        ptr += res;
+        size -= res;
+    }
+    return true;
+}
+
+static bool compile_server_write_all(int fd, const void* data, size_t size)
+{
+    const char* ptr = data;
+    while (size)
+    {
+        ssize_t res = write(fd, ptr, size);
+        if (res < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (res <= 0)
+        {
+            return false;
+        }
+        ptr += res;
+        size -= res;
+    }
+    return true;
+}
+
+static bool compile_server_read_file(const char* filename, char** data_out, size_t* size_out)
+{
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+    {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = malloc(size > 0 ? size : 1);
+    bool ok = size >= 0 && fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!ok)
+    {
+        free(data);
+        return false;
+    }
+    *data_out = data;
+    *size_out = size;
+    return true;
+}
+
+// A relative path of the request is relative to the working directory of the client
+static char* compile_server_client_path(const char* cwd, const char* path)
+{
+    if (path[0] == '/')
+    {
+        return strdup(path);
+    }
+
+    char* result = malloc(strlen(cwd) + strlen(path) + 2);
+    sprintf(result, "%s/%s", cwd, path);
+    return result;
+}
+
+// ./main input output [object] [flags], argv has no program name
+static void compile_server_compile(const char* cwd, int argc, char** argv, struct compile_server_reply* reply)
+{
+    // Without both files ./main compiles ./test.c, that isn't worth a request
+    if (argc < 2 || argv[0][0] == '-')
+    {
+        reply->run_locally = true;
+        return;
+    }
+
+    const char* input_file = argv[0];
+    const char* output_file = argv[1];
+    int flags = COMPILE_PROCESS_EXECUTE_NASM;
+    for (int i = 2; i < argc; i++)
+    {
+        if (compile_flag_parse(argv[i], &flags))
+        {
+            continue;
+        }
+        if (S_EQ(argv[i], "object"))
+        {
+            flags |= COMPILE_PROCESS_EXPORT_AS_OBJECT;
+            continue;
+        }
+        // exec-jit would run the program inside the server, everything else is left to ./main
+        if (!S_EQ(argv[i], "exec"))
+        {
+            reply->run_locally = true;
+            return;
+        }
+    }
+    if (S_EQ(output_file, "exec-jit") || flags & (COMPILE_PROCESS_DUMP_IR | COMPILE_PROCESS_TIME_REPORT | COMPILE_PROCESS_TIME_REPORT_JSON | COMPILE_PROCESS_PROFILE_GENERATE | COMPILE_PROCESS_PROFILE_USE))
+    {
+        reply->run_locally = true;
+        return;
+    }
+
+    char* source = NULL;
+    size_t source_size = 0;
+    char* input_path = compile_server_client_path(cwd, input_file);
+    bool read = compile_server_read_file(input_path, &source, &source_size);
+    free(input_path);
+    if (!read)
+    {
+        reply->run_locally = true;
+        return;
+    }
+
+    struct compiler_output output;
+    int res = compile_source(source, source_size, flags, &output);
+    free(source);
+
+    bool has_errors = false;
+    for (int i = 0; i < output.total_diagnostics; i++)
+    {
+        struct compiler_diagnostic* diagnostic = &output.diagnostics[i];
+        buffer_printf(reply->err, "%s on line %i, col %i in file %s\n", diagnostic->message, diagnostic->line, diagnostic->col, input_file);
+        has_errors |= diagnostic->type == COMPILER_DIAGNOSTIC_ERROR;
+    }
+
+    if (res == COMPILER_FILE_COMPILED_OK)
+    {
+        char* output_path = compile_server_client_path(cwd, output_file);
+        FILE* out = fopen(output_path, "wb");
+        free(output_path);
+        if (!out || fwrite(output.data, 1, output.size, out) != output.size)
+        {
+            res = COMPILER_FAILED_WITH_ERRORS;
+        }
+        if (out && fclose(out) != 0)
+        {
+            res = COMPILER_FAILED_WITH_ERRORS;
+        }
+    }
+    compiler_output_free(&output);
+
+    // ./main exits with -1 on the first error, ERRORS is only printed when a phase fails without one
+    if (has_errors)
+    {
+        reply->exit_code = 255;
+        return;
+    }
+    buffer_printf(reply->out, res == COMPILER_FILE_COMPILED_OK ? "FINE\n" : "ERRORS\n");
+}
+
+// Only the user running the server may compile with it, the files are opened with its permissions
+static bool compile_server_client_allowed(int client)
+{
+    struct ucred credentials;
+    socklen_t size = sizeof(credentials);
+    return getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0 && credentials.uid == getuid();
+}
+
+static void compile_server_handle(int client)
+{
+    if (!compile_server_client_allowed(client))
+    {
+        // The client sees the connection closing and runs ./main itself
+        return;
+    }
+
+    struct compile_server_request request;
+    if (!compile_server_read_all(client, &request, sizeof(request)) || request.argc == 0 || request.size > COMPILE_SERVER_MAX_REQUEST_SIZE)
+    {
+        return;
+    }
+
+    char* data = malloc(request.size + 1);
+    if (!compile_server_read_all(client, data, request.size))
+    {
+        free(data);
+        return;
+    }
+    data[request.size] = 0;
+
+    // cwd, argv[1], argv[2], ... one after the other with their terminators
+    char** strings = calloc(request.argc + 1, sizeof(char*));
+    uint32_t total_strings = 0;
+    for (char* ptr = data; ptr < data + request.size && total_strings <= request.argc; ptr += strlen(ptr) + 1)
+    {
+        strings[total_strings++] = ptr;
+    }
+
+    struct compile_server_reply reply = {.out = buffer_create(), .err = buffer_create()};
+    if (total_strings != request.argc + 1 || strings[0][0] != '/')
+    {
+        reply.run_locally = true;
+    }
+    else
+    {
+        compile_server_compile(strings[0], request.argc, strings + 1, &reply);
+    }
+
+    struct compile_server_response response = {
+        .exit_code = reply.exit_code,
+        .run_locally = reply.run_locally,
+        .stdout_size = reply.out->len,
+        .stderr_size = reply.err->len};
+    if (compile_server_write_all(client, &response, sizeof(response)))
+    {
+        compile_server_write_all(client, reply.out->data, reply.out->len);
+        compile_server_write_all(client, reply.err->data, reply.err->len);
+    }
+
+    buffer_free(reply.out);
+    buffer_free(reply.err);
+    free(strings);
+    free(data);
+}
+
+int compile_server_run(const char* socket_path)
+{
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (server < 0 || strlen(socket_path) >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Could not create the server socket %s\n", socket_path);
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+    strcpy(address.sun_path, socket_path);
+
+    // A server that was killed leaves its socket behind
+    unlink(socket_path);
+    // The socket file is created with mode 0600, no thread is running yet so the umask can be changed for the bind
+    mode_t old_umask = umask(0177);
+    int bound = bind(server, (struct sockaddr*)&address, sizeof(address));
+    umask(old_umask);
+    if (bound != 0 || listen(server, 64) != 0)
+    {
+        fprintf(stderr, "Could not listen on %s\n", socket_path);
+        close(server);
+        return COMPILER_FAILED_WITH_ERRORS;
+    }
+
+    // A client that goes away before its response must not end the server, the children are reaped by the kernel
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN);
+    while (true)
+    {
+        int client = accept(server, NULL, NULL);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            break;
+        }
+
+        // make -j sends its files at the same time, every connection gets a child, if it can't be forked the client
+        // sees the connection close and runs ./main itself
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            // The compilation may wait for processes of its own
+            signal(SIGCHLD, SIG_DFL);
+            close(server);
+            compile_server_handle(client);
+            close(client);
+            _exit(0);
+        }
+        close(client);
+    }
+
+    close(server);
+    unlink(socket_path);
+    return COMPILER_FAILED_WITH_ERRORS;
+}
@@ -1,16 +1,45 @@
 #include "compiler.h"
-#include <assert.h>
 #include "helpers/vector.h"
 
 // because it's a 32 bit compiler it's 4, in 64 bit it's 8
 
 
+size_t stackframe_element_size(struct stack_frame_element* element)
+{
+    return element->size ? element->size : STACK_PUSH_SIZE;
+}
+
 void stackframe_pop(struct node* func_node)
 {
     struct stack_frame* frame = &func_node->func.frame;
+    struct stack_frame_element* element = vector_back(frame->elements);
+    frame->size -= stackframe_element_size(element);
     vector_pop(frame->elements);
 }
 
+// Removes {amount} bytes from the top of the stack frame, an element bigger than that is only made smaller
+static void stackframe_pop_bytes(struct node* func_node, size_t amount)
+{
+    struct stack_frame* frame = &func_node->func.frame;
+    while (amount)
+    {
+        struct stack_frame_element* element = vector_back_or_null(frame->elements);
+        compiler_assert(element);
+        size_t size = stackframe_element_size(element);
+        if (size <= amount)
+        {
+            stackframe_pop(func_node);
+            amount -= size;
+            continue;
+        }
+
+        // pop eax on a structure that was copied to the stack in one piece
+        element->size = size - amount;
+        frame->size -= amount;
+        amount = 0;
+    }
+}
+
 struct stack_frame_element* stackframe_back(struct node* func_node)
 {
     return vector_back_or_null(func_node->func.frame.elements);
@@ -32,9 +61,9 @@ void stackframe_pop_expecting(struct node*func_node, int expecting_type, const c
 {
     struct stack_frame*frame = &func_node->func.frame;
     struct stack_frame_element* last_element = stackframe_back(func_node);
-    assert(last_element);
-    assert(last_element->type == expecting_type && S_EQ(last_element->name,expecting_name));
-    stackframe_pop(func_node);
+    compiler_assert(last_element);
+    compiler_assert(last_element->type == expecting_type && S_EQ(last_element->name,expecting_name));
+    stackframe_pop_bytes(func_node,STACK_PUSH_SIZE);
 }
 
 // Makes peeking available on the stackframe
@@ -55,38 +84,36 @@ void stackframe_push(struct node* func_node, struct stack_frame_element* element
 {
     struct stack_frame* frame = &func_node->func.frame;
     // The stack grows downwards, so we need to calculate it in a specific way
-    // The offset is -> the number of elements in the frame (i.e. variables etc.) multiplied by the stack size (we need to make "one room" for all variables) and negative because it grows downwards
-    element->offset_from_bp = -(vector_count(frame->elements) * STACK_PUSH_SIZE);
+    // The offset is -> the size of everything that is already in the frame (i.e. variables etc.) and negative because it grows downwards
+    element->offset_from_bp = -(int)frame->size;
+    frame->size += stackframe_element_size(element);
     vector_push(frame->elements,element);
+    COMPILE_REPORT_COUNT(stack_frame_elements);
 }
 
 // Pushes {amount} of bytes to the stack (can be used to create room for variables)
 void stackframe_sub(struct node* func_node,int type, const char* name, size_t amount)
 {
     // Make sure that the push amount is aligned to the stack push size to avoid pushing wrong values (like 3 or 15 etc.)
-     assert((amount % STACK_PUSH_SIZE) == 0);
-     // How many pushes we need to achieve {amount} subtraction from stack
-     size_t total_pushes = amount / STACK_PUSH_SIZE;
-    for (int i = 0; i < total_pushes; ++i) {
-        stackframe_push(func_node,&(struct stack_frame_element){.type=type,.name = name});
-    }
+     compiler_assert((amount % STACK_PUSH_SIZE) == 0);
+     // One element no matter how big it is, the room for a 4 KB structure doesn't need a thousand of them
+     if (amount)
+     {
+         stackframe_push(func_node,&(struct stack_frame_element){.type=type,.name = name,.size = amount});
+     }
 
 }
 // Pops {amount} number of bytes from the stack (it can be used to reset, add to the stack etc.)
 void stackframe_add(struct node* func_node,int type, const char* name, size_t amount)
 {
     // Make sure that the push amount is aligned to the stack push size to avoid pushing wrong values (like 3 or 15 etc.)
-    assert((amount % STACK_PUSH_SIZE) == 0);
-    // How many pops we need to achieve {amount} addition from stack
-    size_t total_pushes = amount / STACK_PUSH_SIZE;
-    for (int i = 0; i < total_pushes; ++i) {
-        stackframe_pop(func_node);
-    }
+    compiler_assert((amount % STACK_PUSH_SIZE) == 0);
+    stackframe_pop_bytes(func_node,amount);
 }
 
 // If its empty nothing will happen, but if empty it will abort
 void stackframe_assert_empty(struct node*func_node)
 {
     struct stack_frame* frame = &func_node->func.frame;
-    assert(vector_count(frame->elements) == 0);
+    compiler_assert(vector_count(frame->elements) == 0);
 }
\ No newline at end of file
@@ -61,7 +61,7 @@ struct symbol* symresolver_register_symbol(struct compiler_process* process, con
         return NULL;
     }
 
-    struct symbol* sym = calloc(1,sizeof (struct  symbol));
+    struct symbol* sym = arena_calloc(1,sizeof (struct  symbol));
     sym->name = sym_name;
     sym->type = type;
     sym->data = data;
@@ -0,0 +1,78 @@
+#include "compiler.h"
+#include <stdlib.h>
+
+/*
+ * compile_source tests
+ *
+ * make test
+ *
+ * A program using the compiler as a library has to get an error result back for any source, nothing the source does
+ * may end the program. Every source is compiled with the AST code generator and with -fuse-ir, after the failures a
+ * good source has to compile again
+ */
+
+struct library_test
+{
+    const char* name;
+    const char* source;
+    // Part of the first error, NULL if the source has to compile
+    const char* expected_error;
+};
+
+static struct library_test library_tests[] = {
+    // Reaches an assert in the parser
+    {"case outside of a switch", "int main()\n{\n    case 3:\n    return 0;\n}\n", "Compiler bug"},
+    // The code generator had no exit point to jump to
+    {"break outside of a loop", "int main()\n{\n    break;\n    return 0;\n}\n", "break isn't inside a loop"},
+    {"continue outside of a loop", "int main()\n{\n    continue;\n    return 0;\n}\n", "continue isn't inside a loop"},
+    {"good source", "int main()\n{\n    int x = 3;\n    return x + 4;\n}\n", NULL},
+};
+
+static bool library_test_run(struct library_test* test, int flags)
+{
+    struct compiler_output output;
+    int res = compile_source(test->source, strlen(test->source), flags, &output);
+
+    const char* first_error = NULL;
+    for (int i = 0; i < output.total_diagnostics && !first_error; i++)
+    {
+        if (output.diagnostics[i].type == COMPILER_DIAGNOSTIC_ERROR)
+        {
+            first_error = output.diagnostics[i].message;
+        }
+    }
+
+    bool passed = false;
+    if (test->expected_error)
+    {
+        passed = res == COMPILER_FAILED_WITH_ERRORS && first_error && strstr(first_error, test->expected_error);
+    }
+    else
+    {
+        passed = res == COMPILER_FILE_COMPILED_OK && !first_error && output.size > 0;
+    }
+
+    printf("%s %-32s %s", passed ? "PASS" : "FAIL", test->name, flags & COMPILE_PROCESS_USE_IR ? "ir" : "ast");
+    if (!passed)
+    {
+        printf(": compile_source returned %i, %s", res, first_error ? first_error : "no error");
+    }
+    printf("\n");
+    compiler_output_free(&output);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int total_tests = sizeof(library_tests) / sizeof(library_tests[0]);
+    int failed = 0;
+    for (int i = 0; i < total_tests; i++)
+    {
+        bool passed = library_test_run(&library_tests[i], 0);
+        passed = library_test_run(&library_tests[i], COMPILE_PROCESS_USE_IR) && passed;
+        failed += !passed;
+    }
+
+    printf("%i of %i library tests passed\n", total_tests - failed, total_tests);
+    return failed ? 1 : 0;
+}
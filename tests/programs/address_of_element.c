@@ -0,0 +1,24 @@
+// expect: 94
+// &items[j] was parsed as (&items)[j], and taking the address set every result flag but the final indirection
+struct item
+{
+    int value;
+    int weight;
+    int next;
+};
+
+struct item items[8];
+
+int main()
+{
+    int i;
+    for (i = 0; i < 8; i++)
+    {
+        items[i].value = i * 3;
+        items[i].weight = i + 1;
+        items[i].next = 7 - i;
+    }
+    int j = 3;
+    struct item* it = &items[j];
+    return it->value * 10 + it->next;
+}
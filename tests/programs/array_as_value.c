@@ -0,0 +1,18 @@
+// expect: 77
+// An array used as a value, p = buf and first(buf), pushed its first element instead of its address
+char buf[8];
+
+int first(char* s)
+{
+    return *s;
+}
+
+int main()
+{
+    buf[0] = 7;
+    buf[1] = 9;
+    char* p = buf;
+    int a = *p;
+    int b = first(buf);
+    return a * 10 + b;
+}
@@ -0,0 +1,25 @@
+// expect: 52
+// Reading values[i] with a runtime index gave the address of the element instead of the element
+int globals[4];
+
+int main()
+{
+    int locals[4];
+    globals[0] = 3;
+    globals[1] = 5;
+    globals[2] = 7;
+    globals[3] = 11;
+    locals[0] = 3;
+    locals[1] = 5;
+    locals[2] = 7;
+    locals[3] = 11;
+
+    int sum = 0;
+    int i = 0;
+    while (i < 4)
+    {
+        sum = sum + globals[i] + locals[i];
+        i = i + 1;
+    }
+    return sum;
+}
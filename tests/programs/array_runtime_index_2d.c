@@ -0,0 +1,32 @@
+// expect: 168
+// m[i] is still an array and its address is the value, m[i][j] and c[k] are elements
+int m[3][4];
+char c[10];
+
+int main()
+{
+    int i;
+    int j;
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            m[i][j] = i * 10 + j;
+        }
+    }
+    for (i = 0; i < 10; i++)
+    {
+        c[i] = i + 1;
+    }
+
+    int sum = 0;
+    for (i = 0; i < 3; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            sum = sum + m[i][j];
+        }
+    }
+    int k = 7;
+    return sum + c[k] + m[2][k - 5];
+}
@@ -0,0 +1,20 @@
+// expect: 12
+// flags: -fprofile-use
+// profile: f 8 7 entries 100
+// profile: f 8 7 body 1
+// The if is cold by the profile, its body is written after the ret and jumps back
+int f(int x)
+{
+    if (x > 100)
+    {
+        x = x - 100;
+    }
+    return x;
+}
+
+int main()
+{
+    int a = f(7);
+    int b = f(105);
+    return a + b;
+}
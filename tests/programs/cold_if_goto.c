@@ -0,0 +1,21 @@
+// expect: 7
+// flags: -fprofile-use
+// profile: f 9 7 entries 100
+// profile: f 9 7 body 1
+// The if is cold by the profile and would be written after the ret, the goto label used to take the cold block
+// as its own local label
+int f(int x)
+{
+    if (x > 100)
+    {
+        x = x - 100;
+    }
+    goto done;
+done:
+    return x;
+}
+
+int main()
+{
+    return f(7);
+}
@@ -0,0 +1,15 @@
+// expect: 9
+// A loop body after a condition was sized like a union, its locals overlapped each other
+int main()
+{
+    int i = 0;
+    int total = 0;
+    int round;
+    for (round = 0; round < 3; round++)
+    {
+        int n = 1;
+        int difference = 2;
+        total = total + n + difference + i;
+    }
+    return total;
+}
@@ -0,0 +1,24 @@
+// error: structure parameter passed by value
+// flags: -m64
+// paths: ast
+// The x86-64 code generator only has registers for the arguments, it used to assert on the structure
+struct point
+{
+    int x;
+    int y;
+    int z;
+};
+
+int sum(struct point p)
+{
+    return p.x + p.y + p.z;
+}
+
+int main()
+{
+    struct point p;
+    p.x = 3;
+    p.y = 4;
+    p.z = 5;
+    return sum(p);
+}
@@ -0,0 +1,7 @@
+// error: Unknown flag -fno-unreachable
+// flags: -fno-unreachable
+// The IR code generators need the unreachable blocks removed, the pass can't be turned off
+int main()
+{
+    return 0;
+}
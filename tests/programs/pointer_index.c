@@ -0,0 +1,25 @@
+// expect: 33
+// s[n] on a char* added the index to the address of s instead of the pointer in it
+char buf[8];
+
+int length(char* s)
+{
+    int n = 0;
+    while (s[n])
+    {
+        n = n + 1;
+    }
+    return n;
+}
+
+int main()
+{
+    buf[0] = 97;
+    buf[1] = 98;
+    buf[2] = 99;
+    buf[3] = 0;
+    char* p = buf;
+    int a = length(p);
+    int b = length(buf);
+    return a * 10 + b;
+}
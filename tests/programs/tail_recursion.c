@@ -0,0 +1,25 @@
+// expect: 86
+// sum calls itself a hundred thousand times, wrap's call to twice swaps its arguments before the jump
+int sum(int n, int acc)
+{
+    if (n == 0)
+    {
+        return acc;
+    }
+    return sum(n - 1, (acc + n) & 65535);
+}
+
+int twice(int a, int b)
+{
+    return a + b + a + b;
+}
+
+int wrap(int x, int y)
+{
+    return twice(y, x);
+}
+
+int main()
+{
+    return sum(100000, 0) % 256 + wrap(1, 2);
+}
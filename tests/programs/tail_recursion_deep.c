@@ -0,0 +1,26 @@
+// expect: 70
+// Ten million calls deep, the stack only holds them if return sum(...) is a jump. With -O0 or -fno-tail-calls this
+// overflows the stack
+int sum(int n, int acc)
+{
+    if (n == 0)
+    {
+        return acc;
+    }
+    return sum(n - 1, (acc + n) & 65535);
+}
+
+int twice(int a, int b)
+{
+    return a + b + a + b;
+}
+
+int wrap(int x, int y)
+{
+    return twice(y, x);
+}
+
+int main()
+{
+    return sum(10000000, 0) % 256 + wrap(1, 2);
+}
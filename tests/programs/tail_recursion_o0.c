@@ -0,0 +1,26 @@
+// expect: 86
+// flags: -O0
+// The same calls generated the plain way
+int sum(int n, int acc)
+{
+    if (n == 0)
+    {
+        return acc;
+    }
+    return sum(n - 1, (acc + n) & 65535);
+}
+
+int twice(int a, int b)
+{
+    return a + b + a + b;
+}
+
+int wrap(int x, int y)
+{
+    return twice(y, x);
+}
+
+int main()
+{
+    return sum(100000, 0) % 256 + wrap(1, 2);
+}
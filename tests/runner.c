@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+/*
+ * Regression tests
+ *
+ * make test
+ * ./build/test_runner [-programs=DIR]
+ *
+ * Every program in tests/programs is compiled by ./main and run inside it with exec-jit, once by the AST code
+ * generator and once with -fuse-ir. The comments at the top of the program say what it has to do:
+ *
+ *  // expect: 42                   main returns 42
+ *  // error: text                  the compilation fails and the output has text in it, only the assembly is written
+ *  // flags: -O0 -fno-tail-calls   more flags for ./main
+ *  // paths: ast                   only these of ast and ir
+ *  // profile: f 3 7 entries 100   a line of the -fprofile-use file, the path of the program is put in front of it
+ *
+ * A test passes if every path it runs on passes, the runner exits with 1 if any test failed
+ */
+
+#define TEST_OUTPUT_DIRECTORY "./build/tests"
+#define TEST_MAX_PROGRAMS 256
+#define TEST_MAX_PROFILE_LINES 16
+
+enum
+{
+    TEST_PATH_AST = 1,
+    TEST_PATH_IR = 2
+};
+
+struct test_program
+{
+    char path[PATH_MAX];
+    const char* name;
+    int paths;
+    bool expects_error;
+    int expected_exit_code;
+    char expected_error[256];
+    char flags[256];
+    char profile_lines[TEST_MAX_PROFILE_LINES][128];
+    int total_profile_lines;
+};
+
+static char* test_trim(char* text)
+{
+    while (*text == ' ')
+    {
+        text++;
+    }
+    size_t length = strlen(text);
+    while (length && (text[length - 1] == '\n' || text[length - 1] == ' '))
+    {
+        text[--length] = 0;
+    }
+    return text;
+}
+
+// Reads the // lines at the top of the program
+static bool test_read_directives(struct test_program* program)
+{
+    FILE* file = fopen(program->path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    program->paths = TEST_PATH_AST | TEST_PATH_IR;
+    bool has_expectation = false;
+    char line[512];
+    while (fgets(line, sizeof(line), file) && strncmp(line, "//", 2) == 0)
+    {
+        char* text = test_trim(line + 2);
+        if (strncmp(text, "expect:", 7) == 0)
+        {
+            program->expected_exit_code = atoi(text + 7);
+            has_expectation = true;
+        }
+        else if (strncmp(text, "error:", 6) == 0)
+        {
+            snprintf(program->expected_error, sizeof(program->expected_error), "%s", test_trim(text + 6));
+            program->expects_error = true;
+            has_expectation = true;
+        }
+        else if (strncmp(text, "flags:", 6) == 0)
+        {
+            snprintf(program->flags, sizeof(program->flags), "%s", test_trim(text + 6));
+        }
+        else if (strncmp(text, "paths:", 6) == 0)
+        {
+            program->paths = (strstr(text, "ast") ? TEST_PATH_AST : 0) | (strstr(text, " ir") ? TEST_PATH_IR : 0);
+        }
+        else if (strncmp(text, "profile:", 8) == 0 && program->total_profile_lines < TEST_MAX_PROFILE_LINES)
+        {
+            snprintf(program->profile_lines[program->total_profile_lines++], sizeof(program->profile_lines[0]), "%s", test_trim(text + 8));
+        }
+    }
+    fclose(file);
+    return has_expectation;
+}
+
+// The profile file names the program by its real path, the same one ./main is given
+static bool test_write_profile(struct test_program* program, char* profile_path, size_t size)
+{
+    snprintf(profile_path, size, "%s/%s.profile", TEST_OUTPUT_DIRECTORY, program->name);
+    FILE* file = fopen(profile_path, "w");
+    if (!file)
+    {
+        return false;
+    }
+    for (int i = 0; i < program->total_profile_lines; i++)
+    {
+        fprintf(file, "%s %s\n", program->path, program->profile_lines[i]);
+    }
+    return fclose(file) == 0;
+}
+
+// Runs ./main on the program, the output of the compiler and of the program goes to output
+static int test_run_compiler(struct test_program* program, int path, char* output, size_t output_size)
+{
+    char profile[PATH_MAX + 64] = "";
+    if (program->total_profile_lines)
+    {
+        char profile_path[PATH_MAX];
+        if (!test_write_profile(program, profile_path, sizeof(profile_path)))
+        {
+            snprintf(output, output_size, "Could not write the profile");
+            return -1;
+        }
+        snprintf(profile, sizeof(profile), "C_COMPILER_PROFILE=%s ", profile_path);
+    }
+
+    char cmd[PATH_MAX * 3];
+    const char* ir_flag = path == TEST_PATH_IR ? "-fuse-ir" : "";
+    if (program->expects_error)
+    {
+        // Nothing runs, only the assembly is written so -m64 can be tested too
+        snprintf(cmd, sizeof(cmd), "%s./main %s %s/%s.asm %s %s 2>&1", profile, program->path, TEST_OUTPUT_DIRECTORY, program->name, ir_flag, program->flags);
+    }
+    else
+    {
+        snprintf(cmd, sizeof(cmd), "%s./main %s exec-jit %s %s 2>&1", profile, program->path, ir_flag, program->flags);
+    }
+
+    FILE* pipe = popen(cmd, "r");
+    if (!pipe)
+    {
+        snprintf(output, output_size, "Could not run %s", cmd);
+        return -1;
+    }
+    // The compiler echoes the assembly, all of it is read so ./main doesn't die writing into a closed pipe
+    size_t total = 0;
+    char discard[4096];
+    while (total < output_size - 1 && !feof(pipe))
+    {
+        total += fread(output + total, 1, output_size - 1 - total, pipe);
+    }
+    output[total] = 0;
+    while (fread(discard, 1, sizeof(discard), pipe) > 0)
+    {
+    }
+    int status = pclose(pipe);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+static bool test_run_path(struct test_program* program, int path)
+{
+    char output[4096];
+    int exit_code = test_run_compiler(program, path, output, sizeof(output));
+    const char* path_name = path == TEST_PATH_IR ? "ir" : "ast";
+    bool compile_failed = strstr(output, "ERRORS") != NULL;
+
+    bool passed = false;
+    if (program->expects_error)
+    {
+        // ./main returns -1 when the compilation fails, an assert would abort it, the ERRORS line may be past the output kept
+        passed = exit_code == 255 && strstr(output, program->expected_error);
+    }
+    else
+    {
+        passed = !compile_failed && exit_code == program->expected_exit_code;
+    }
+
+    if (passed)
+    {
+        printf("PASS %-32s %s\n", program->name, path_name);
+        return true;
+    }
+
+    if (program->expects_error)
+    {
+        printf("FAIL %-32s %s: expected an error with \"%s\", ./main exited with %i\n", program->name, path_name, program->expected_error, exit_code);
+    }
+    else
+    {
+        printf("FAIL %-32s %s: expected %i, got %i\n", program->name, path_name, program->expected_exit_code, exit_code);
+    }
+    printf("%s", output);
+    return false;
+}
+
+static int test_compare_names(const void* a, const void* b)
+{
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+int main(int argc, char** argv)
+{
+    const char* programs_directory = "./tests/programs";
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-programs=", 10) == 0)
+        {
+            programs_directory = argv[i] + 10;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown argument %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    DIR* dir = opendir(programs_directory);
+    if (!dir)
+    {
+        fprintf(stderr, "Could not open %s\n", programs_directory);
+        return 1;
+    }
+    char* names[TEST_MAX_PROGRAMS];
+    int total_names = 0;
+    struct dirent* dirent = NULL;
+    while ((dirent = readdir(dir)) != NULL && total_names < TEST_MAX_PROGRAMS)
+    {
+        size_t length = strlen(dirent->d_name);
+        if (length > 2 && strcmp(dirent->d_name + length - 2, ".c") == 0)
+        {
+            names[total_names++] = strndup(dirent->d_name, length - 2);
+        }
+    }
+    closedir(dir);
+    qsort(names, total_names, sizeof(char*), test_compare_names);
+    mkdir(TEST_OUTPUT_DIRECTORY, 0755);
+
+    int failed = 0;
+    for (int i = 0; i < total_names; i++)
+    {
+        struct test_program program = {.name = names[i]};
+        char relative_path[PATH_MAX];
+        snprintf(relative_path, sizeof(relative_path), "%s/%s.c", programs_directory, names[i]);
+        if (!realpath(relative_path, program.path) || !test_read_directives(&program))
+        {
+            printf("FAIL %-32s has no // expect: or // error: line\n", names[i]);
+            failed++;
+            free(names[i]);
+            continue;
+        }
+
+        bool passed = true;
+        if (program.paths & TEST_PATH_AST)
+        {
+            passed = test_run_path(&program, TEST_PATH_AST) && passed;
+        }
+        if (program.paths & TEST_PATH_IR)
+        {
+            passed = test_run_path(&program, TEST_PATH_IR) && passed;
+        }
+        failed += !passed;
+        free(names[i]);
+    }
+
+    printf("%i of %i tests passed\n", total_names - failed, total_names);
+    return failed ? 1 : 0;
+}
@@ -1,8 +1,8 @@
 #include "compiler.h"
 #include "helpers/vector.h"
 
-static struct compiler_process* validator_current_compile_process;
-static struct node* current_function;
+static _Thread_local struct compiler_process* validator_current_compile_process;
+static _Thread_local struct node* current_function;
 
 void validation_new_scope(int flags)
 {
@@ -55,7 +55,7 @@ void validate_variable(struct node* var_node)
 	// If it's not null then its already exist
 	if (entity)
 	{
-		compiler_node_error(var_node, "You already defined a variable with the name %s",var_node->var.name);
+		compiler_node_error(validator_current_compile_process,var_node, "You already defined a variable with the name %s",var_node->var.name);
 	}
 	resolver_default_new_scope_entity(validator_current_compile_process->resolver,var_node,0,0);
 }
@@ -83,7 +83,7 @@ void validate_symbol_unique(const char*name, const char*type_of_symbol, struct n
 	// If it's already registered then we have a duplicate
 	if (sym)
 	{
-		compiler_node_error(node,"Cannot define %s you have aldready defined a symbol with the name %s",type_of_symbol,name);
+		compiler_node_error(validator_current_compile_process,node,"Cannot define %s you have aldready defined a symbol with the name %s",type_of_symbol,name);
 	}
 	
 	symresolver_register_symbol(validator_current_compile_process,node->func.name, SYMBOL_TYPE_NODE,node);